@@ -102,6 +102,19 @@ if(tomlplusplus_ADDED)
     $<BUILD_INTERFACE:${tomlplusplus_SOURCE_DIR}>/)
 endif()
 
+# zstd, compression of the SBC binary files
+# https://github.com/facebook/zstd
+CPMAddPackage(NAME zstd
+  VERSION 1.5.5
+  GITHUB_REPOSITORY facebook/zstd
+  SOURCE_SUBDIR build/cmake
+  OPTIONS "ZSTD_BUILD_PROGRAMS OFF" "ZSTD_BUILD_TESTS OFF"
+  "ZSTD_BUILD_SHARED OFF" "ZSTD_BUILD_STATIC ON")
+if(zstd_ADDED)
+  target_include_directories(libzstd_static SYSTEM INTERFACE
+    $<BUILD_INTERFACE:${zstd_SOURCE_DIR}>/lib)
+endif()
+
 CPMAddPackage(NAME date
   VERSION 3.0.1
   GITHUB_REPOSITORY HowardHinnant/date
@@ -0,0 +1,15 @@
+#ifndef CAENEMULATOR_CAENCOMM_H
+#define CAENEMULATOR_CAENCOMM_H
+#pragma once
+
+// SBCQueens includes CAENComm.h but does not call it: the digitizer is
+// only reached through CAENDigitizer.h. Kept so the includes are the same
+// with the emulator (see caen_emulator.hpp).
+
+#include <stdint.h>
+
+typedef enum CAENComm_ErrorCode {
+    CAENComm_Success = 0
+} CAENComm_ErrorCode;
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef CAENEMULATOR_CAENDIGITIZER_H
+#define CAENEMULATOR_CAENDIGITIZER_H
+#pragma once
+
+// The functions of the CAEN digitizer library used by SBCQueens, with the
+// signatures of the CAEN headers, implemented by the software emulator
+// (see caen_emulator.hpp).
+
+#include "CAENDigitizerType.h"
+
+#ifndef CAENDGTZ_API
+#define CAENDGTZ_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Connection
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_OpenDigitizer(
+    CAEN_DGTZ_ConnectionType LinkType, int LinkNum, int ConetNode,
+    uint32_t VMEBaseAddress, int* handle);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_CloseDigitizer(int handle);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_GetInfo(int handle,
+    CAEN_DGTZ_BoardInfo_t* BoardInfo);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_Reset(int handle);
+
+// Registers
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_WriteRegister(int handle,
+    uint32_t Address, uint32_t Data);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_ReadRegister(int handle,
+    uint32_t Address, uint32_t* Data);
+
+// Acquisition settings
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetRecordLength(int handle,
+    uint32_t size, ...);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_GetRecordLength(int handle,
+    uint32_t* size, ...);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetPostTriggerSize(int handle,
+    uint32_t percent);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetMaxNumEventsBLT(int handle,
+    uint32_t numEvents);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetDecimationFactor(int handle,
+    uint16_t factor);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetAcquisitionMode(int handle,
+    CAEN_DGTZ_AcqMode_t mode);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetIOLevel(int handle,
+    CAEN_DGTZ_IOLevel_t level);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetChannelEnableMask(int handle,
+    uint32_t mask);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetGroupEnableMask(int handle,
+    uint32_t mask);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetChannelDCOffset(int handle,
+    uint32_t channel, uint32_t Tvalue);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetGroupDCOffset(int handle,
+    uint32_t group, uint32_t Tvalue);
+
+// Triggers
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SendSWtrigger(int handle);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetSWTriggerMode(int handle,
+    CAEN_DGTZ_TriggerMode_t mode);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetExtTriggerInputMode(int handle,
+    CAEN_DGTZ_TriggerMode_t mode);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetChannelSelfTrigger(int handle,
+    CAEN_DGTZ_TriggerMode_t mode, uint32_t channelmask);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetGroupSelfTrigger(int handle,
+    CAEN_DGTZ_TriggerMode_t mode, uint32_t groupmask);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetChannelGroupMask(int handle,
+    uint32_t group, uint32_t channelmask);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetChannelTriggerThreshold(
+    int handle, uint32_t channel, uint32_t Tvalue);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetGroupTriggerThreshold(
+    int handle, uint32_t group, uint32_t Tvalue);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetTriggerPolarity(int handle,
+    uint32_t channel, CAEN_DGTZ_TriggerPolarity_t Polarity);
+
+// Acquisition
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SWStartAcquisition(int handle);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SWStopAcquisition(int handle);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_ClearData(int handle);
+
+// Interrupts
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_SetInterruptConfig(int handle,
+    CAEN_DGTZ_EnaDis_t state, uint8_t level, uint32_t status_id,
+    uint16_t event_number, CAEN_DGTZ_IRQMode_t mode);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_IRQWait(int handle,
+    uint32_t timeout);
+
+// Readout
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_MallocReadoutBuffer(int handle,
+    char** buffer, uint32_t* size);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_FreeReadoutBuffer(char** buffer);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_ReadData(int handle,
+    CAEN_DGTZ_ReadMode_t mode, char* buffer, uint32_t* bufferSize);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_GetNumEvents(int handle,
+    char* buffer, uint32_t buffsize, uint32_t* numEvents);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_GetEventInfo(int handle,
+    char* buffer, uint32_t buffsize, int32_t numEvent,
+    CAEN_DGTZ_EventInfo_t* eventInfo, char** EventPtr);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_AllocateEvent(int handle,
+    void** Evt);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_DecodeEvent(int handle,
+    char* evtPtr, void** Evt);
+CAEN_DGTZ_ErrorCode CAENDGTZ_API CAEN_DGTZ_FreeEvent(int handle, void** Evt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef CAENEMULATOR_CAENDIGITIZERTYPE_H
+#define CAENEMULATOR_CAENDIGITIZERTYPE_H
+#pragma once
+
+// Types of the CAEN digitizer library used by SBCQueens, for the software
+// emulator (see caen_emulator.hpp). Only the subset this project uses is
+// here. Names, values and layouts are the same as the ones of the CAEN
+// headers so the code compiles the same against either.
+
+#include <stdint.h>
+
+#define MAX_UINT16_CHANNEL_SIZE 64
+#define MAX_LICENSE_LENGTH 17
+
+typedef enum CAEN_DGTZ_ErrorCode {
+    CAEN_DGTZ_Success = 0,
+    CAEN_DGTZ_CommError = -1,
+    CAEN_DGTZ_GenericError = -2,
+    CAEN_DGTZ_InvalidParam = -3,
+    CAEN_DGTZ_InvalidLinkType = -4,
+    CAEN_DGTZ_InvalidHandle = -5,
+    CAEN_DGTZ_MaxDevicesError = -6,
+    CAEN_DGTZ_BadBoardType = -7,
+    CAEN_DGTZ_BadInterruptLev = -8,
+    CAEN_DGTZ_BadEventNumber = -9,
+    CAEN_DGTZ_ReadDeviceRegisterFail = -10,
+    CAEN_DGTZ_WriteDeviceRegisterFail = -11,
+    CAEN_DGTZ_InvalidChannelNumber = -13,
+    CAEN_DGTZ_ChannelBusy = -14,
+    CAEN_DGTZ_FPIOModeInvalid = -15,
+    CAEN_DGTZ_WrongAcqMode = -16,
+    CAEN_DGTZ_FunctionNotAllowed = -17,
+    CAEN_DGTZ_Timeout = -18,
+    CAEN_DGTZ_InvalidBuffer = -19,
+    CAEN_DGTZ_EventNotFound = -20,
+    CAEN_DGTZ_InvalidEvent = -21,
+    CAEN_DGTZ_OutOfMemory = -22,
+    CAEN_DGTZ_CalibrationError = -23,
+    CAEN_DGTZ_DigitizerNotFound = -24,
+    CAEN_DGTZ_DigitizerAlreadyOpen = -25,
+    CAEN_DGTZ_DigitizerNotReady = -26,
+    CAEN_DGTZ_InterruptNotConfigured = -27,
+    CAEN_DGTZ_DigitizerMemoryCorrupted = -28,
+    CAEN_DGTZ_DPPFirmwareNotSupported = -29,
+    CAEN_DGTZ_InvalidLicense = -30,
+    CAEN_DGTZ_InvalidDigitizerStatus = -31,
+    CAEN_DGTZ_UnsupportedTrace = -32,
+    CAEN_DGTZ_InvalidProbe = -33,
+    CAEN_DGTZ_UnsupportedBaseAddress = -34,
+    CAEN_DGTZ_NotYetImplemented = -99
+} CAEN_DGTZ_ErrorCode;
+
+typedef enum {
+    CAEN_DGTZ_USB = 0,
+    CAEN_DGTZ_OpticalLink = 1,
+    CAEN_DGTZ_USB_A4818_V2718 = 2,
+    CAEN_DGTZ_USB_A4818_V3718 = 3,
+    CAEN_DGTZ_USB_A4818_V4718 = 4,
+    CAEN_DGTZ_USB_A4818 = 5,
+    CAEN_DGTZ_ETH_V4718 = 6,
+    CAEN_DGTZ_USB_V4718 = 7
+} CAEN_DGTZ_ConnectionType;
+
+#define CAEN_DGTZ_PCI_OpticalLink CAEN_DGTZ_OpticalLink
+
+typedef enum {
+    CAEN_DGTZ_VME64_FORM_FACTOR = 0,
+    CAEN_DGTZ_VME64X_FORM_FACTOR = 1,
+    CAEN_DGTZ_DESKTOP_FORM_FACTOR = 2,
+    CAEN_DGTZ_NIM_FORM_FACTOR = 3
+} CAEN_DGTZ_BoardFormFactor_t;
+
+typedef enum {
+    CAEN_DGTZ_XX724_FAMILY_CODE = 0,
+    CAEN_DGTZ_XX721_FAMILY_CODE = 1,
+    CAEN_DGTZ_XX731_FAMILY_CODE = 2,
+    CAEN_DGTZ_XX720_FAMILY_CODE = 3,
+    CAEN_DGTZ_XX740_FAMILY_CODE = 4,
+    CAEN_DGTZ_XX751_FAMILY_CODE = 5,
+    CAEN_DGTZ_XX742_FAMILY_CODE = 6,
+    CAEN_DGTZ_XX780_FAMILY_CODE = 7,
+    CAEN_DGTZ_XX761_FAMILY_CODE = 8,
+    CAEN_DGTZ_XX743_FAMILY_CODE = 9,
+    CAEN_DGTZ_XX730_FAMILY_CODE = 11,
+    CAEN_DGTZ_XX790_FAMILY_CODE = 12,
+    CAEN_DGTZ_XX781_FAMILY_CODE = 13,
+    CAEN_DGTZ_XX725_FAMILY_CODE = 14,
+    CAEN_DGTZ_XX782_FAMILY_CODE = 16
+} CAEN_DGTZ_BoardFamilyCode_t;
+
+typedef enum {
+    CAEN_DGTZ_SW_CONTROLLED = 0,
+    CAEN_DGTZ_S_IN_CONTROLLED = 1,
+    CAEN_DGTZ_FIRST_TRG_CONTROLLED = 2,
+    CAEN_DGTZ_LVDS_CONTROLLED = 3
+} CAEN_DGTZ_AcqMode_t;
+
+typedef enum {
+    CAEN_DGTZ_IOLevel_NIM = 0,
+    CAEN_DGTZ_IOLevel_TTL = 1
+} CAEN_DGTZ_IOLevel_t;
+
+typedef enum {
+    CAEN_DGTZ_TriggerOnRisingEdge = 0,
+    CAEN_DGTZ_TriggerOnFallingEdge = 1
+} CAEN_DGTZ_TriggerPolarity_t;
+
+typedef enum {
+    CAEN_DGTZ_TRGMODE_DISABLED = 0,
+    CAEN_DGTZ_TRGMODE_EXTOUT_ONLY = 2,
+    CAEN_DGTZ_TRGMODE_ACQ_ONLY = 1,
+    CAEN_DGTZ_TRGMODE_ACQ_AND_EXTOUT = 3
+} CAEN_DGTZ_TriggerMode_t;
+
+typedef enum {
+    CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT = 0,
+    CAEN_DGTZ_SLAVE_TERMINATED_READOUT_2eVME = 1,
+    CAEN_DGTZ_SLAVE_TERMINATED_READOUT_2eSST = 2,
+    CAEN_DGTZ_POLLING_MBLT = 3,
+    CAEN_DGTZ_POLLING_2eVME = 4,
+    CAEN_DGTZ_POLLING_2eSST = 5
+} CAEN_DGTZ_ReadMode_t;
+
+typedef enum {
+    CAEN_DGTZ_IRQ_MODE_RORA = 0,
+    CAEN_DGTZ_IRQ_MODE_ROAK = 1
+} CAEN_DGTZ_IRQMode_t;
+
+typedef enum {
+    CAEN_DGTZ_DISABLE = 0,
+    CAEN_DGTZ_ENABLE = 1
+} CAEN_DGTZ_EnaDis_t;
+
+typedef struct {
+    char ModelName[12];
+    uint32_t Model;
+    uint32_t Channels;
+    uint32_t FormFactor;
+    uint32_t FamilyCode;
+    char ROC_FirmwareRel[20];
+    char AMC_FirmwareRel[40];
+    uint32_t SerialNumber;
+    char MezzanineSerNum[4][8];
+    uint32_t PCB_Revision;
+    uint32_t ADC_NBits;
+    uint32_t SAMCorrectionDataLoaded;
+    int CommHandle;
+    int VMEHandle;
+    char License[MAX_LICENSE_LENGTH];
+} CAEN_DGTZ_BoardInfo_t;
+
+typedef struct {
+    uint32_t EventSize;
+    uint32_t BoardId;
+    uint32_t Pattern;
+    uint32_t ChannelMask;
+    uint32_t EventCounter;
+    uint32_t TriggerTimeTag;
+} CAEN_DGTZ_EventInfo_t;
+
+typedef struct {
+    uint32_t ChSize[MAX_UINT16_CHANNEL_SIZE];
+    uint16_t* DataChannel[MAX_UINT16_CHANNEL_SIZE];
+} CAEN_DGTZ_UINT16_EVENT_t;
+
+#endif
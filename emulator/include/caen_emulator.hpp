@@ -0,0 +1,119 @@
+#ifndef CAENEMULATOR_H
+#define CAENEMULATOR_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <cstdint>
+#include <string>
+
+// C++ 3rd party includes
+// my includes
+
+// Software stand-in for the CAEN digitizer library, built instead of it
+// with -DCAEN_EMULATOR=ON. It implements the CAEN_DGTZ_* calls SBCQueens
+// uses so CAEN<>, SiPMAcquisitionManager and the writers run, at full
+// rate, without a digitizer.
+//
+// Every board has a thread that plays the digitizer: it triggers at
+// Config::TriggerRate and, while its memory has a free buffer, writes the
+// event in the x740 (V1740D, DT5740D) or x730 (DT5730B) standard event
+// format. Triggers that find the memory full are lost and counted, like
+// in the digitizer. The readout (0x812C, CAEN_DGTZ_ReadData, interrupts)
+// empties the memory the same way the digitizer's does, so the rate the
+// pipeline keeps up with, and what it drops, can be measured.
+//
+// Every channel sees a SiPM: dark counts, with prompt crosstalk and
+// afterpulsing, and SiPMConfig::LightMean photoelectrons at the trigger
+// position of the triggers that are not software triggers, on top of the
+// baseline set by the DC offset and gaussian noise.
+//
+// Not emulated: trigger thresholds and self-trigger logic (all the enabled
+// sources trigger at TriggerRate), decimation, IO levels, zero suppression
+// and the DPP firmwares.
+namespace SBCQueens::CAENEmulator {
+
+struct SiPMConfig {
+    // Dark count rate in Hz
+    double DarkRate = 100e3;
+    // Peak height of one photoelectron, in ADC counts
+    double Gain = 40.0;
+    // Relative spread of the gain between avalanches
+    double GainSpread = 0.05;
+    // Probability of an avalanche to fire a neighbour cell
+    double Crosstalk = 0.1;
+    // Probability of a cell to afterpulse
+    double Afterpulsing = 0.05;
+    // Mean delay of the afterpulses, in ns
+    double AfterpulseDelay = 100.0;
+    // Recovery time of a cell, in ns. Afterpulses that come early are
+    // smaller.
+    double RecoveryTime = 50.0;
+    // Of the pulse shape, in ns
+    double RiseTime = 5.0;
+    double FallTime = 50.0;
+    // Mean number of photoelectrons per trigger (poisson)
+    double LightMean = 2.0;
+    // RMS of the baseline in ADC counts
+    double Noise = 2.0;
+    // SiPM pulses go down from the baseline
+    bool NegativePulses = true;
+};
+
+struct Config {
+    // DT5730B, DT5740D or V1740D. Has to be the model CAEN<> is created
+    // with, as the emulator cannot ask the hardware.
+    std::string Model = "V1740D";
+    // In Hz, of all the trigger sources but the software trigger.
+    // 0 = only software triggers.
+    double TriggerRate = 1e3;
+    // Triggers at exactly 1/TriggerRate instead of randomly
+    bool PeriodicTrigger = false;
+    // Of the link in bytes/s, CAEN_DGTZ_ReadData takes as long as the
+    // transfer would. 0 = instant.
+    double LinkBandwidth = 0.0;
+    uint32_t SerialNumber = 1;
+    // Of the random numbers, so runs can be repeated
+    uint64_t Seed = 0;
+    SiPMConfig SiPM;
+};
+
+// Of a board since it was opened
+struct Statistics {
+    uint64_t Triggers = 0;
+    // Triggers that made it into the digitizer memory
+    uint64_t EventsStored = 0;
+    // Triggers lost because the memory was full
+    uint64_t EventsDropped = 0;
+    uint64_t EventsRead = 0;
+    uint64_t BytesRead = 0;
+    // Calls to CAEN_DGTZ_ReadData that returned events
+    uint64_t Transfers = 0;
+    // How late, in s, the emulator is making the events of the last
+    // triggers. If it grows, the emulator, not the readout, is what cannot
+    // keep up with the trigger rate.
+    double GeneratorLag = 0.0;
+};
+
+// The default config, changed by the environment variables
+// CAEN_EMULATOR_MODEL, CAEN_EMULATOR_TRIGGER_RATE,
+// CAEN_EMULATOR_DARK_RATE, CAEN_EMULATOR_GAIN, CAEN_EMULATOR_CROSSTALK,
+// CAEN_EMULATOR_AFTERPULSING, CAEN_EMULATOR_LIGHT_MEAN and
+// CAEN_EMULATOR_LINK_BANDWIDTH. It is what boards use if set_config(...)
+// was not called, for example from the GUI.
+Config config_from_environment();
+
+// Config of the board at (link_num, conet_node). It is read when the board
+// is opened and every time its acquisition starts. Throws
+// std::invalid_argument if the model is not emulated.
+void set_config(const Config& config, const int& link_num = 0,
+                const int& conet_node = 0);
+
+// Statistics of the board at (link_num, conet_node), also after it is
+// closed. All zeros if it was never opened.
+Statistics get_statistics(const int& link_num = 0, const int& conet_node = 0);
+
+}  // namespace SBCQueens::CAENEmulator
+
+#endif
@@ -0,0 +1,1375 @@
+#include "caen_emulator.hpp"
+
+// C STD includes
+#include <cstdlib>
+#include <cstring>
+// C 3rd party includes
+#include <CAENDigitizer.h>
+// C++ STD includes
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// C++ 3rd party includes
+// my includes
+#include "sipm_pulse_generator.hpp"
+
+namespace SBCQueens::CAENEmulator {
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr uint32_t kHeaderWords = 4;
+constexpr uint32_t kChannelsPerGroup = 8;
+constexpr uint32_t kSamplesPerBlock = 8;
+constexpr uint32_t kWordsPerBlock = 3;
+// 2^10 = 1024 buffers, the most the digitizers have
+constexpr uint32_t kMaxBufferCode = 10;
+// The trigger time tag counts every 8 ns and rolls over at 31 bits
+constexpr double kTriggerTimeTagPeriod = 8.0;
+constexpr uint32_t kTriggerTimeTagMask = 0x7FFFFFFF;
+// Longest the generator thread sleeps, so it notices a stop
+constexpr auto kMaxGeneratorSleep = std::chrono::milliseconds(1);
+
+// Registers that do something, the rest only keep what is written
+constexpr uint32_t kBufferOrganizationAddr = 0x800C;
+constexpr uint32_t kAcquisitionControlAddr = 0x8100;
+constexpr uint32_t kAcquisitionStatusAddr = 0x8104;
+constexpr uint32_t kSoftwareTriggerAddr = 0x8108;
+constexpr uint32_t kPostTriggerAddr = 0x8114;
+constexpr uint32_t kEventsStoredAddr = 0x812C;
+constexpr uint32_t kSoftwareClearAddr = 0xEF28;
+
+struct BoardModel {
+    std::string_view Name;
+    uint32_t FamilyCode;
+    uint32_t FormFactor;
+    uint32_t Channels;
+    // 0 = no groups, the masks are of channels
+    uint32_t Groups;
+    uint32_t ADCBits;
+    // In ns
+    double SamplePeriod;
+    // In samples
+    uint32_t MemoryPerChannel;
+    // Record lengths are rounded up to a multiple of it
+    uint32_t RecordLengthStep;
+
+    // Groups or channels, what the masks are made of
+    [[nodiscard]] uint32_t units() const noexcept {
+        return Groups > 0 ? Groups : Channels;
+    }
+};
+
+constexpr std::array<BoardModel, 3> kModels = {{
+    {"DT5730B", CAEN_DGTZ_XX730_FAMILY_CODE, CAEN_DGTZ_DESKTOP_FORM_FACTOR,
+     8, 0, 14, 2.0, 5120000, 10},
+    {"DT5740D", CAEN_DGTZ_XX740_FAMILY_CODE, CAEN_DGTZ_DESKTOP_FORM_FACTOR,
+     32, 4, 12, 16.0, 192000, kSamplesPerBlock},
+    {"V1740D", CAEN_DGTZ_XX740_FAMILY_CODE, CAEN_DGTZ_VME64_FORM_FACTOR,
+     64, 8, 12, 16.0, 192000, kSamplesPerBlock}
+}};
+
+const BoardModel* find_model(std::string_view name) noexcept {
+    for (const auto& model : kModels) {
+        if (model.Name == name) {
+            return &model;
+        }
+    }
+    return nullptr;
+}
+
+// The readout buffer is little endian
+uint32_t read_word(const char* ptr) noexcept {
+    uint32_t word = 0;
+    std::memcpy(&word, ptr, sizeof(word));
+    if constexpr (std::endian::native == std::endian::big) {
+        word = ((word & 0x000000FFu) << 24) | ((word & 0x0000FF00u) << 8)
+             | ((word & 0x00FF0000u) >> 8) | ((word & 0xFF000000u) >> 24);
+    }
+    return word;
+}
+
+void write_word(char* ptr, uint32_t word) noexcept {
+    if constexpr (std::endian::native == std::endian::big) {
+        word = ((word & 0x000000FFu) << 24) | ((word & 0x0000FF00u) << 8)
+             | ((word & 0x00FF0000u) >> 8) | ((word & 0xFF000000u) >> 24);
+    }
+    std::memcpy(ptr, &word, sizeof(word));
+}
+
+bool acquires(const CAEN_DGTZ_TriggerMode_t& mode) noexcept {
+    return mode == CAEN_DGTZ_TRGMODE_ACQ_ONLY
+        or mode == CAEN_DGTZ_TRGMODE_ACQ_AND_EXTOUT;
+}
+
+struct Address {
+    int LinkNum = 0;
+    int ConetNode = 0;
+
+    auto operator<=>(const Address&) const = default;
+};
+
+struct AtomicStatistics {
+    std::atomic<uint64_t> Triggers = 0;
+    std::atomic<uint64_t> EventsStored = 0;
+    std::atomic<uint64_t> EventsDropped = 0;
+    std::atomic<uint64_t> EventsRead = 0;
+    std::atomic<uint64_t> BytesRead = 0;
+    std::atomic<uint64_t> Transfers = 0;
+    std::atomic<double> GeneratorLag = 0.0;
+
+    [[nodiscard]] Statistics load() const noexcept {
+        return {Triggers.load(), EventsStored.load(), EventsDropped.load(),
+                EventsRead.load(), BytesRead.load(), Transfers.load(),
+                GeneratorLag.load()};
+    }
+};
+
+// Events as they are saved with the current settings
+struct EventLayout {
+    uint32_t RecordLength = 0;
+    // Enabled groups (x740) or channels (x730)
+    uint32_t Mask = 0;
+    uint32_t TriggerSample = 0;
+    // Header included
+    uint32_t Words = kHeaderWords;
+
+    [[nodiscard]] std::size_t bytes() const noexcept {
+        return Words*sizeof(uint32_t);
+    }
+};
+
+// What CAEN_DGTZ_AllocateEvent hands out: the event and the memory of
+// its channels
+struct DecodedEvent {
+    CAEN_DGTZ_UINT16_EVENT_t Event{};
+    std::array<std::vector<uint16_t>, MAX_UINT16_CHANNEL_SIZE> Channels;
+};
+
+// The digitizer: its settings, its memory, and the thread that triggers
+class Board {
+    const BoardModel& _model;
+    const Address _address;
+    const int _handle;
+    const uint32_t _serial_number;
+    std::shared_ptr<AtomicStatistics> _stats;
+
+    // Settings. Changes are used from the next acquisition start.
+    std::mutex _settings_mutex;
+    std::map<uint32_t, uint32_t> _registers;
+    uint32_t _record_length = 0;
+    uint32_t _buffer_code = 0;
+    uint32_t _post_trigger_percent = 50;
+    // Set by 0x8114, in samples, instead of the percent
+    uint32_t _post_trigger_samples = 0;
+    bool _post_trigger_in_samples = false;
+    uint32_t _max_events_blt = 1;
+    uint32_t _enable_mask = 0;
+    uint32_t _self_trigger_mask = 0;
+    CAEN_DGTZ_TriggerMode_t _sw_trigger_mode = CAEN_DGTZ_TRGMODE_ACQ_ONLY;
+    CAEN_DGTZ_TriggerMode_t _ext_trigger_mode = CAEN_DGTZ_TRGMODE_ACQ_ONLY;
+    CAEN_DGTZ_TriggerMode_t _self_trigger_mode = CAEN_DGTZ_TRGMODE_DISABLED;
+    // Per group (x740) or channel (x730)
+    std::array<uint32_t, 8> _dc_offsets = {};
+
+    // Memory: a ring of _capacity events, of _layout.bytes() each. The
+    // producer only writes the free slot after the stored events, so the
+    // readout copies the stored ones without holding the mutex.
+    std::mutex _memory_mutex;
+    std::condition_variable _events_cv;
+    std::vector<char> _memory;
+    std::size_t _capacity = 0;
+    std::size_t _head = 0;
+    std::size_t _count = 0;
+    std::atomic<double> _link_bandwidth = 0.0;
+    bool _irq_enabled = false;
+    uint16_t _irq_events = 1;
+
+    // Everything below is used by whoever holds _producer_mutex: the
+    // generator thread or a software trigger.
+    std::mutex _producer_mutex;
+    Config _config;
+    EventLayout _layout;
+    std::vector<double> _baselines;
+    std::unique_ptr<SiPMPulseGenerator> _pulses;
+    std::vector<uint16_t> _samples;
+    uint32_t _event_counter = 0;
+    // Acquisition control bit 3: the event counter also counts the lost
+    // triggers
+    bool _count_all_triggers = false;
+    uint64_t _acquisitions = 0;
+    clock_type::time_point _start;
+
+    std::atomic<bool> _running = false;
+    std::atomic<bool> _stop = false;
+    std::mutex _stop_mutex;
+    std::condition_variable _stop_cv;
+    std::thread _generator;
+
+    void _reset_settings() {
+        _registers.clear();
+        _post_trigger_percent = 50;
+        _post_trigger_samples = 0;
+        _post_trigger_in_samples = false;
+        _max_events_blt = 1;
+        _enable_mask = 0;
+        _self_trigger_mask = 0;
+        _sw_trigger_mode = CAEN_DGTZ_TRGMODE_ACQ_ONLY;
+        _ext_trigger_mode = CAEN_DGTZ_TRGMODE_ACQ_ONLY;
+        _self_trigger_mode = CAEN_DGTZ_TRGMODE_DISABLED;
+        _dc_offsets.fill(0x8000);
+        _set_record_length(1024);
+    }
+
+    void _set_record_length(const uint32_t& size) noexcept {
+        const uint32_t step = _model.RecordLengthStep;
+        _record_length = (size + step - 1) / step*step;
+        const auto buffers = _model.MemoryPerChannel / _record_length;
+        _buffer_code = std::min<uint32_t>(kMaxBufferCode,
+            std::bit_width(std::max<uint32_t>(buffers, 1)) - 1);
+    }
+
+    // Needs _settings_mutex
+    [[nodiscard]] EventLayout _current_layout() const noexcept {
+        EventLayout layout;
+        layout.RecordLength = _record_length;
+        layout.Mask = _enable_mask;
+        const uint32_t post = _post_trigger_in_samples ? _post_trigger_samples
+            : _record_length*_post_trigger_percent / 100;
+        layout.TriggerSample = _record_length - std::min(post, _record_length);
+        const uint32_t units = std::popcount(_enable_mask);
+        if (_model.Groups > 0) {
+            layout.Words += units*kChannelsPerGroup*_record_length
+                / kSamplesPerBlock*kWordsPerBlock;
+        } else {
+            layout.Words += units*_record_length / 2;
+        }
+        return layout;
+    }
+
+    void _write_event(char* out, const clock_type::time_point& time,
+                      const bool& light) {
+        const auto ns = std::chrono::duration<double, std::nano>(
+            time - _start).count();
+        const auto ttt = static_cast<uint64_t>(ns / kTriggerTimeTagPeriod);
+        write_word(out, (0xAu << 28) | _layout.Words);
+        write_word(out + 4, _layout.Mask & 0xFF);
+        write_word(out + 8, _event_counter & 0x00FFFFFF);
+        write_word(out + 12, static_cast<uint32_t>(ttt) & kTriggerTimeTagMask);
+        _event_counter++;
+
+        const uint32_t rl = _layout.RecordLength;
+        char* data = out + kHeaderWords*sizeof(uint32_t);
+        for (uint32_t unit = 0; unit < _model.units(); unit++) {
+            if (not ((_layout.Mask >> unit) & 0x1)) {
+                continue;
+            }
+
+            if (_model.Groups == 0) {
+                _pulses->generate(std::span(_samples).first(rl),
+                    _baselines[unit], _layout.TriggerSample, light);
+                for (uint32_t j = 0; j < rl; j += 2) {
+                    write_word(data, _samples[j]
+                        | (static_cast<uint32_t>(_samples[j + 1]) << 16));
+                    data += sizeof(uint32_t);
+                }
+                continue;
+            }
+
+            for (uint32_t ch = 0; ch < kChannelsPerGroup; ch++) {
+                _pulses->generate(std::span(_samples).subspan(ch*rl, rl),
+                    _baselines[unit], _layout.TriggerSample, light);
+            }
+
+            // 8 samples of a channel in 3 words, channel after channel
+            for (uint32_t j = 0; j < rl; j += kSamplesPerBlock) {
+                for (uint32_t ch = 0; ch < kChannelsPerGroup; ch++) {
+                    const uint16_t* s = _samples.data() + ch*rl + j;
+                    write_word(data, s[0] | (s[1] << 12)
+                        | (static_cast<uint32_t>(s[2]) << 24));
+                    write_word(data + 4, (s[2] >> 8) | (s[3] << 4)
+                        | (s[4] << 16) | (static_cast<uint32_t>(s[5]) << 28));
+                    write_word(data + 8, (s[5] >> 4) | (s[6] << 8)
+                        | (static_cast<uint32_t>(s[7]) << 20));
+                    data += kWordsPerBlock*sizeof(uint32_t);
+                }
+            }
+        }
+    }
+
+    // A trigger at time. It is lost if the memory is full.
+    void _trigger(const clock_type::time_point& time, const bool& light) {
+        std::lock_guard producer_lock(_producer_mutex);
+        _stats->Triggers++;
+
+        std::size_t slot = 0;
+        {
+            std::lock_guard lock(_memory_mutex);
+            if (_count >= _capacity) {
+                _stats->EventsDropped++;
+                if (_count_all_triggers) {
+                    _event_counter++;
+                }
+                return;
+            }
+            slot = (_head + _count) % _capacity;
+        }
+
+        _write_event(_memory.data() + slot*_layout.bytes(), time, light);
+
+        {
+            std::lock_guard lock(_memory_mutex);
+            _count++;
+        }
+        _stats->EventsStored++;
+        _events_cv.notify_all();
+    }
+
+    void _generate_loop(const double rate, const bool periodic,
+                        const uint64_t seed) {
+        std::mt19937_64 rng(seed);
+        std::exponential_distribution<double> interval(rate);
+        auto next_interval = [&]() {
+            return std::chrono::duration_cast<clock_type::duration>(
+                std::chrono::duration<double>(periodic ? 1.0 / rate
+                                                       : interval(rng)));
+        };
+
+        auto next = _start + next_interval();
+        while (not _stop) {
+            const auto now = clock_type::now();
+            // Triggers that came while sleeping, or while the events were
+            // being made, come out in a burst with their own times.
+            while (next <= now and not _stop) {
+                _trigger(next, true);
+                next += next_interval();
+            }
+
+            _stats->GeneratorLag = std::max(0.0,
+                std::chrono::duration<double>(clock_type::now() - next).count());
+            std::unique_lock lock(_stop_mutex);
+            _stop_cv.wait_until(lock, std::min(next, now + kMaxGeneratorSleep),
+                                [&]() { return _stop.load(); });
+        }
+    }
+
+ public:
+    Board(const BoardModel& model, const Address& address, const int& handle,
+          const Config& config, std::shared_ptr<AtomicStatistics> stats) :
+        _model{model},
+        _address{address},
+        _handle{handle},
+        _serial_number{config.SerialNumber},
+        _stats{std::move(stats)},
+        _config{config}
+    {
+        _reset_settings();
+    }
+
+    ~Board() { stop(); }
+
+    Board(const Board&) = delete;
+    Board& operator=(const Board&) = delete;
+
+    [[nodiscard]] const BoardModel& model() const noexcept { return _model; }
+    [[nodiscard]] const Address& address() const noexcept { return _address; }
+
+    void fill_info(CAEN_DGTZ_BoardInfo_t& info) {
+        info = CAEN_DGTZ_BoardInfo_t{};
+        std::strncpy(info.ModelName, _model.Name.data(),
+                     std::min(_model.Name.size(), sizeof(info.ModelName) - 1));
+        info.Channels = _model.Channels;
+        info.FormFactor = _model.FormFactor;
+        info.FamilyCode = _model.FamilyCode;
+        std::strncpy(info.ROC_FirmwareRel, "emulator",
+                     sizeof(info.ROC_FirmwareRel) - 1);
+        std::strncpy(info.AMC_FirmwareRel, "emulator",
+                     sizeof(info.AMC_FirmwareRel) - 1);
+        info.SerialNumber = _serial_number;
+        info.ADC_NBits = _model.ADCBits;
+        info.CommHandle = _handle;
+        info.VMEHandle = -1;
+    }
+
+    void start(const Config& config) {
+        stop();
+        std::lock_guard producer_lock(_producer_mutex);
+        double rate = 0.0;
+        {
+            std::lock_guard lock(_settings_mutex);
+            _config = config;
+            _link_bandwidth = config.LinkBandwidth;
+            auto it = _registers.find(kAcquisitionControlAddr);
+            _count_all_triggers = it != _registers.end()
+                and (it->second & (1u << 3)) != 0;
+            const auto layout = _current_layout();
+            const double max_adc = std::exp2(_model.ADCBits) - 1.0;
+            _baselines.resize(_model.units());
+            for (uint32_t unit = 0; unit < _model.units(); unit++) {
+                _baselines[unit] = max_adc*_dc_offsets[unit] / 0xFFFF;
+            }
+
+            const bool triggers = acquires(_ext_trigger_mode)
+                or (acquires(_self_trigger_mode) and _self_trigger_mask != 0);
+            rate = triggers ? _config.TriggerRate : 0.0;
+
+            std::lock_guard memory_lock(_memory_mutex);
+            _layout = layout;
+            _capacity = std::size_t{1} << _buffer_code;
+            _memory.resize(_capacity*_layout.bytes());
+            _head = 0;
+            _count = 0;
+        }
+
+        // Every board and acquisition gets its own random numbers
+        const uint64_t seed = _config.Seed
+            + 0x9E3779B97F4A7C15ull*static_cast<uint64_t>(
+                (_address.LinkNum << 8) + _address.ConetNode + 1)
+            + _acquisitions++;
+        const uint32_t channels = _model.Groups > 0 ? kChannelsPerGroup : 1;
+        _samples.resize(channels*_layout.RecordLength);
+        _pulses = std::make_unique<SiPMPulseGenerator>(_config.SiPM,
+            _model.SamplePeriod, _model.ADCBits, seed);
+        _event_counter = 0;
+        _start = clock_type::now();
+        _stop = false;
+        _running = true;
+
+        if (rate > 0.0) {
+            _generator = std::thread(&Board::_generate_loop, this, rate,
+                                     _config.PeriodicTrigger, seed + 1);
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard lock(_stop_mutex);
+            _stop = true;
+        }
+        _stop_cv.notify_all();
+        if (_generator.joinable()) {
+            _generator.join();
+        }
+        _running = false;
+    }
+
+    void software_trigger() {
+        bool enabled = false;
+        {
+            std::lock_guard lock(_settings_mutex);
+            enabled = acquires(_sw_trigger_mode);
+        }
+
+        // Random triggers: no light, only dark counts
+        if (_running and enabled) {
+            _trigger(clock_type::now(), false);
+        }
+    }
+
+    void clear() {
+        std::lock_guard lock(_memory_mutex);
+        _head = 0;
+        _count = 0;
+    }
+
+    void reset() {
+        stop();
+        clear();
+        std::lock_guard lock(_settings_mutex);
+        _reset_settings();
+    }
+
+    CAEN_DGTZ_ErrorCode read_register(const uint32_t& addr, uint32_t& value) {
+        if (addr == kEventsStoredAddr) {
+            std::lock_guard lock(_memory_mutex);
+            value = static_cast<uint32_t>(_count);
+            return CAEN_DGTZ_Success;
+        }
+
+        if (addr == kAcquisitionStatusAddr) {
+            std::lock_guard lock(_memory_mutex);
+            // Run, event ready, memory full and board ready bits
+            value = (_running << 2) | ((_count > 0) << 3)
+                | ((_capacity > 0 and _count >= _capacity) << 4) | (1 << 8);
+            return CAEN_DGTZ_Success;
+        }
+
+        std::lock_guard lock(_settings_mutex);
+        if (addr == kBufferOrganizationAddr) {
+            value = _buffer_code;
+        } else {
+            auto it = _registers.find(addr);
+            value = it == _registers.end() ? 0 : it->second;
+        }
+        return CAEN_DGTZ_Success;
+    }
+
+    CAEN_DGTZ_ErrorCode write_register(const uint32_t& addr,
+                                       const uint32_t& value) {
+        if (addr == kSoftwareTriggerAddr) {
+            software_trigger();
+            return CAEN_DGTZ_Success;
+        }
+
+        if (addr == kSoftwareClearAddr) {
+            clear();
+            return CAEN_DGTZ_Success;
+        }
+
+        std::lock_guard lock(_settings_mutex);
+        _registers[addr] = value;
+        if (addr == kBufferOrganizationAddr) {
+            _buffer_code = std::min(value & 0xF, kMaxBufferCode);
+        } else if (addr == kPostTriggerAddr) {
+            _post_trigger_samples = value;
+            _post_trigger_in_samples = true;
+        }
+        return CAEN_DGTZ_Success;
+    }
+
+    CAEN_DGTZ_ErrorCode set_record_length(const uint32_t& size) {
+        if (size == 0 or size > _model.MemoryPerChannel) {
+            return CAEN_DGTZ_InvalidParam;
+        }
+
+        std::lock_guard lock(_settings_mutex);
+        _set_record_length(size);
+        return CAEN_DGTZ_Success;
+    }
+
+    uint32_t record_length() {
+        std::lock_guard lock(_settings_mutex);
+        return _record_length;
+    }
+
+    CAEN_DGTZ_ErrorCode set_post_trigger(const uint32_t& percent) {
+        if (percent > 100) {
+            return CAEN_DGTZ_InvalidParam;
+        }
+
+        std::lock_guard lock(_settings_mutex);
+        _post_trigger_percent = percent;
+        _post_trigger_in_samples = false;
+        return CAEN_DGTZ_Success;
+    }
+
+    CAEN_DGTZ_ErrorCode set_max_events_blt(const uint32_t& n) {
+        if (n == 0 or n > 1023) {
+            return CAEN_DGTZ_InvalidParam;
+        }
+
+        std::lock_guard lock(_settings_mutex);
+        _max_events_blt = n;
+        return CAEN_DGTZ_Success;
+    }
+
+    // with_groups: if it is a group or a channel function, which has to
+    // match the family
+    CAEN_DGTZ_ErrorCode set_enable_mask(const uint32_t& mask,
+                                        const bool& with_groups) {
+        if (with_groups != (_model.Groups > 0)) {
+            return CAEN_DGTZ_FunctionNotAllowed;
+        }
+
+        std::lock_guard lock(_settings_mutex);
+        _enable_mask = mask & ((1u << _model.units()) - 1);
+        return CAEN_DGTZ_Success;
+    }
+
+    CAEN_DGTZ_ErrorCode set_self_trigger(const CAEN_DGTZ_TriggerMode_t& mode,
+                                         const uint32_t& mask,
+                                         const bool& with_groups) {
+        if (with_groups != (_model.Groups > 0)) {
+            return CAEN_DGTZ_FunctionNotAllowed;
+        }
+
+        std::lock_guard lock(_settings_mutex);
+        _self_trigger_mode = mode;
+        _self_trigger_mask = mask & ((1u << _model.units()) - 1);
+        return CAEN_DGTZ_Success;
+    }
+
+    // Group or channel settings that are only checked
+    CAEN_DGTZ_ErrorCode check_unit(const uint32_t& unit,
+                                   const bool& with_groups) const noexcept {
+        if (with_groups != (_model.Groups > 0)) {
+            return CAEN_DGTZ_FunctionNotAllowed;
+        }
+
+        return unit < _model.units() ? CAEN_DGTZ_Success
+                                     : CAEN_DGTZ_InvalidChannelNumber;
+    }
+
+    CAEN_DGTZ_ErrorCode set_dc_offset(const uint32_t& unit,
+                                      const uint32_t& value,
+                                      const bool& with_groups) {
+        auto err = check_unit(unit, with_groups);
+        if (err != CAEN_DGTZ_Success) {
+            return err;
+        }
+
+        std::lock_guard lock(_settings_mutex);
+        _dc_offsets[unit] = value & 0xFFFF;
+        return CAEN_DGTZ_Success;
+    }
+
+    void set_trigger_modes(const CAEN_DGTZ_TriggerMode_t* sw,
+                           const CAEN_DGTZ_TriggerMode_t* ext) {
+        std::lock_guard lock(_settings_mutex);
+        if (sw) {
+            _sw_trigger_mode = *sw;
+        }
+        if (ext) {
+            _ext_trigger_mode = *ext;
+        }
+    }
+
+    // Size of the readout buffer that fits a block transfer
+    uint32_t readout_buffer_size() {
+        std::lock_guard lock(_settings_mutex);
+        return static_cast<uint32_t>(_max_events_blt
+            * _current_layout().bytes());
+    }
+
+    // Moves up to MaxNumEventsBLT events, that fit in capacity bytes, to
+    // buffer
+    CAEN_DGTZ_ErrorCode read_data(char* buffer, const uint32_t& capacity,
+                                  uint32_t& size) {
+        uint32_t max_events = 0;
+        {
+            std::lock_guard lock(_settings_mutex);
+            max_events = _max_events_blt;
+        }
+
+        std::size_t head = 0;
+        std::size_t n = 0;
+        std::size_t event_bytes = 0;
+        std::size_t events = 0;
+        {
+            std::lock_guard lock(_memory_mutex);
+            event_bytes = _layout.bytes();
+            events = _capacity;
+            head = _head;
+            n = std::min<std::size_t>({_count, max_events,
+                                       capacity / event_bytes});
+        }
+
+        // The producer does not touch the stored events, so they are
+        // copied without the lock
+        const std::size_t first = std::min(n, events - head);
+        std::memcpy(buffer, _memory.data() + head*event_bytes,
+                    first*event_bytes);
+        std::memcpy(buffer + first*event_bytes, _memory.data(),
+                    (n - first)*event_bytes);
+        size = static_cast<uint32_t>(n*event_bytes);
+
+        {
+            std::lock_guard lock(_memory_mutex);
+            _head = (_head + n) % std::max<std::size_t>(events, 1);
+            _count -= n;
+        }
+
+        if (n > 0) {
+            _stats->EventsRead += n;
+            _stats->BytesRead += size;
+            _stats->Transfers++;
+            const double bandwidth = _link_bandwidth;
+            if (bandwidth > 0.0) {
+                std::this_thread::sleep_for(std::chrono::duration<double>(
+                    size / bandwidth));
+            }
+        }
+        return CAEN_DGTZ_Success;
+    }
+
+    CAEN_DGTZ_ErrorCode set_interrupts(const bool& enabled,
+                                       const uint16_t& n_events) {
+        {
+            std::lock_guard lock(_memory_mutex);
+            _irq_enabled = enabled;
+            _irq_events = std::max<uint16_t>(n_events, 1);
+        }
+        _events_cv.notify_all();
+        return CAEN_DGTZ_Success;
+    }
+
+    CAEN_DGTZ_ErrorCode irq_wait(const uint32_t& timeout) {
+        std::unique_lock lock(_memory_mutex);
+        if (not _irq_enabled) {
+            return CAEN_DGTZ_InterruptNotConfigured;
+        }
+
+        const bool raised = _events_cv.wait_for(lock,
+            std::chrono::milliseconds(timeout),
+            [&]() { return not _irq_enabled or _count >= _irq_events; });
+        return raised and _irq_enabled ? CAEN_DGTZ_Success : CAEN_DGTZ_Timeout;
+    }
+};
+
+struct Registry {
+    std::mutex Mutex;
+    int NextHandle = 0;
+    std::map<int, std::shared_ptr<Board>> Boards;
+    std::map<Address, Config> Configs;
+    std::map<Address, std::shared_ptr<AtomicStatistics>> Stats;
+    // Sizes of the buffers of CAEN_DGTZ_MallocReadoutBuffer
+    std::unordered_map<const char*, uint32_t> ReadoutBuffers;
+    std::unordered_map<const void*, std::unique_ptr<DecodedEvent>> Events;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+std::shared_ptr<Board> get_board(const int& handle) {
+    auto& reg = registry();
+    std::lock_guard lock(reg.Mutex);
+    auto it = reg.Boards.find(handle);
+    return it == reg.Boards.end() ? nullptr : it->second;
+}
+
+// Needs registry().Mutex
+Config config_of(const Address& address) {
+    auto& reg = registry();
+    auto it = reg.Configs.find(address);
+    return it == reg.Configs.end() ? config_from_environment() : it->second;
+}
+
+double env_or(const char* name, const double& value) {
+    const char* env = std::getenv(name);
+    return env ? std::strtod(env, nullptr) : value;
+}
+
+// Walks the events of a readout buffer. f(offset, words) is called for
+// each, until it returns false.
+template<typename F>
+CAEN_DGTZ_ErrorCode for_each_event(const char* buffer, const uint32_t& size,
+                                   F&& f) {
+    uint32_t offset = 0;
+    while (offset + kHeaderWords*sizeof(uint32_t) <= size) {
+        const uint32_t w0 = read_word(buffer + offset);
+        const uint32_t words = w0 & 0x0FFFFFFF;
+        if ((w0 >> 28) != 0xA or words < kHeaderWords
+            or offset + words*sizeof(uint32_t) > size) {
+            return CAEN_DGTZ_InvalidEvent;
+        }
+
+        if (not f(offset, words)) {
+            break;
+        }
+        offset += words*sizeof(uint32_t);
+    }
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode decode(const BoardModel& model, const char* event,
+                           DecodedEvent& out) {
+    const uint32_t words = read_word(event) & 0x0FFFFFFF;
+    const uint32_t mask = read_word(event + 4) & 0xFF;
+    const uint32_t units = std::popcount(mask);
+    const uint32_t data_words = words - kHeaderWords;
+    for (auto& size : out.Event.ChSize) {
+        size = 0;
+    }
+    if (units == 0) {
+        return data_words == 0 ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidEvent;
+    }
+
+    const uint32_t unit_words = data_words / units;
+    const char* data = event + kHeaderWords*sizeof(uint32_t);
+    if (model.Groups == 0) {
+        const uint32_t rl = 2*unit_words;
+        for (uint32_t ch = 0; ch < model.Channels; ch++) {
+            if (not ((mask >> ch) & 0x1)) {
+                continue;
+            }
+
+            auto& samples = out.Channels[ch];
+            samples.resize(rl);
+            for (uint32_t j = 0; j < unit_words; j++) {
+                const uint32_t word = read_word(data);
+                samples[2*j] = word & 0x3FFF;
+                samples[2*j + 1] = (word >> 16) & 0x3FFF;
+                data += sizeof(uint32_t);
+            }
+            out.Event.ChSize[ch] = rl;
+            out.Event.DataChannel[ch] = samples.data();
+        }
+        return CAEN_DGTZ_Success;
+    }
+
+    constexpr uint32_t kGroupBlockWords = kWordsPerBlock*kChannelsPerGroup;
+    if (unit_words % kGroupBlockWords != 0) {
+        return CAEN_DGTZ_InvalidEvent;
+    }
+
+    const uint32_t rl = unit_words / kGroupBlockWords*kSamplesPerBlock;
+    for (uint32_t gr = 0; gr < model.Groups; gr++) {
+        if (not ((mask >> gr) & 0x1)) {
+            continue;
+        }
+
+        for (uint32_t ch = 0; ch < kChannelsPerGroup; ch++) {
+            out.Channels[gr*kChannelsPerGroup + ch].resize(rl);
+        }
+
+        for (uint32_t j = 0; j < rl; j += kSamplesPerBlock) {
+            for (uint32_t ch = 0; ch < kChannelsPerGroup; ch++) {
+                const uint32_t a = read_word(data);
+                const uint32_t b = read_word(data + 4);
+                const uint32_t c = read_word(data + 8);
+                uint16_t* s = out.Channels[gr*kChannelsPerGroup + ch].data() + j;
+                s[0] = a & 0xFFF;
+                s[1] = (a >> 12) & 0xFFF;
+                s[2] = ((a >> 24) | (b << 8)) & 0xFFF;
+                s[3] = (b >> 4) & 0xFFF;
+                s[4] = (b >> 16) & 0xFFF;
+                s[5] = ((b >> 28) | (c << 4)) & 0xFFF;
+                s[6] = (c >> 8) & 0xFFF;
+                s[7] = (c >> 20) & 0xFFF;
+                data += kWordsPerBlock*sizeof(uint32_t);
+            }
+        }
+
+        for (uint32_t ch = 0; ch < kChannelsPerGroup; ch++) {
+            const uint32_t i = gr*kChannelsPerGroup + ch;
+            out.Event.ChSize[i] = rl;
+            out.Event.DataChannel[i] = out.Channels[i].data();
+        }
+    }
+    return CAEN_DGTZ_Success;
+}
+
+}  // namespace
+
+Config config_from_environment() {
+    Config config;
+    if (const char* model = std::getenv("CAEN_EMULATOR_MODEL")) {
+        config.Model = model;
+    }
+    config.TriggerRate = env_or("CAEN_EMULATOR_TRIGGER_RATE", config.TriggerRate);
+    config.LinkBandwidth = env_or("CAEN_EMULATOR_LINK_BANDWIDTH",
+                                  config.LinkBandwidth);
+    auto& sipm = config.SiPM;
+    sipm.DarkRate = env_or("CAEN_EMULATOR_DARK_RATE", sipm.DarkRate);
+    sipm.Gain = env_or("CAEN_EMULATOR_GAIN", sipm.Gain);
+    sipm.Crosstalk = env_or("CAEN_EMULATOR_CROSSTALK", sipm.Crosstalk);
+    sipm.Afterpulsing = env_or("CAEN_EMULATOR_AFTERPULSING", sipm.Afterpulsing);
+    sipm.LightMean = env_or("CAEN_EMULATOR_LIGHT_MEAN", sipm.LightMean);
+    return config;
+}
+
+void set_config(const Config& config, const int& link_num,
+                const int& conet_node) {
+    if (find_model(config.Model) == nullptr) {
+        throw std::invalid_argument("The CAEN emulator does not have the "
+                                    "model " + config.Model);
+    }
+
+    auto& reg = registry();
+    std::lock_guard lock(reg.Mutex);
+    reg.Configs[Address{link_num, conet_node}] = config;
+}
+
+Statistics get_statistics(const int& link_num, const int& conet_node) {
+    auto& reg = registry();
+    std::lock_guard lock(reg.Mutex);
+    auto it = reg.Stats.find(Address{link_num, conet_node});
+    return it == reg.Stats.end() ? Statistics{} : it->second->load();
+}
+
+}  // namespace SBCQueens::CAENEmulator
+
+// The CAEN API, on top of the boards above
+using namespace SBCQueens::CAENEmulator;
+
+extern "C" {
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_OpenDigitizer(CAEN_DGTZ_ConnectionType,
+                                            int LinkNum, int ConetNode,
+                                            uint32_t, int* handle) {
+    if (handle == nullptr) {
+        return CAEN_DGTZ_InvalidParam;
+    }
+
+    auto& reg = registry();
+    std::lock_guard lock(reg.Mutex);
+    const Address address{LinkNum, ConetNode};
+    for (const auto& [other, board] : reg.Boards) {
+        (void)other;
+        if (board->address() == address) {
+            return CAEN_DGTZ_DigitizerAlreadyOpen;
+        }
+    }
+
+    const auto config = config_of(address);
+    const BoardModel* model = find_model(config.Model);
+    if (model == nullptr) {
+        return CAEN_DGTZ_DigitizerNotFound;
+    }
+
+    auto stats = std::make_shared<AtomicStatistics>();
+    reg.Stats[address] = stats;
+    *handle = reg.NextHandle++;
+    reg.Boards[*handle] = std::make_shared<Board>(*model, address, *handle,
+                                                  config, std::move(stats));
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_CloseDigitizer(int handle) {
+    std::shared_ptr<Board> board;
+    {
+        auto& reg = registry();
+        std::lock_guard lock(reg.Mutex);
+        auto it = reg.Boards.find(handle);
+        if (it == reg.Boards.end()) {
+            return CAEN_DGTZ_InvalidHandle;
+        }
+        board = std::move(it->second);
+        reg.Boards.erase(it);
+    }
+
+    board->stop();
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_GetInfo(int handle,
+                                      CAEN_DGTZ_BoardInfo_t* BoardInfo) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+    if (BoardInfo == nullptr) {
+        return CAEN_DGTZ_InvalidParam;
+    }
+
+    board->fill_info(*BoardInfo);
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_Reset(int handle) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+
+    board->reset();
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_WriteRegister(int handle, uint32_t Address,
+                                            uint32_t Data) {
+    auto board = get_board(handle);
+    return board ? board->write_register(Address, Data)
+                 : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_ReadRegister(int handle, uint32_t Address,
+                                           uint32_t* Data) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+    if (Data == nullptr) {
+        return CAEN_DGTZ_InvalidParam;
+    }
+
+    return board->read_register(Address, *Data);
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetRecordLength(int handle, uint32_t size, ...) {
+    auto board = get_board(handle);
+    return board ? board->set_record_length(size) : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_GetRecordLength(int handle, uint32_t* size,
+                                              ...) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+    if (size == nullptr) {
+        return CAEN_DGTZ_InvalidParam;
+    }
+
+    *size = board->record_length();
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetPostTriggerSize(int handle,
+                                                 uint32_t percent) {
+    auto board = get_board(handle);
+    return board ? board->set_post_trigger(percent) : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetMaxNumEventsBLT(int handle,
+                                                 uint32_t numEvents) {
+    auto board = get_board(handle);
+    return board ? board->set_max_events_blt(numEvents)
+                 : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetDecimationFactor(int handle,
+                                                  uint16_t factor) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+    if (board->model().Groups == 0) {
+        return CAEN_DGTZ_FunctionNotAllowed;
+    }
+
+    // Only checked, the waveforms are not decimated
+    return std::has_single_bit(factor) and factor <= 128
+        ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidParam;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetAcquisitionMode(int handle,
+                                                 CAEN_DGTZ_AcqMode_t) {
+    return get_board(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetIOLevel(int handle, CAEN_DGTZ_IOLevel_t) {
+    return get_board(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetChannelEnableMask(int handle, uint32_t mask) {
+    auto board = get_board(handle);
+    return board ? board->set_enable_mask(mask, false)
+                 : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetGroupEnableMask(int handle, uint32_t mask) {
+    auto board = get_board(handle);
+    return board ? board->set_enable_mask(mask, true)
+                 : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetChannelDCOffset(int handle, uint32_t channel,
+                                                 uint32_t Tvalue) {
+    auto board = get_board(handle);
+    return board ? board->set_dc_offset(channel, Tvalue, false)
+                 : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetGroupDCOffset(int handle, uint32_t group,
+                                               uint32_t Tvalue) {
+    auto board = get_board(handle);
+    return board ? board->set_dc_offset(group, Tvalue, true)
+                 : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SendSWtrigger(int handle) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+
+    board->software_trigger();
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetSWTriggerMode(int handle,
+                                               CAEN_DGTZ_TriggerMode_t mode) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+
+    board->set_trigger_modes(&mode, nullptr);
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetExtTriggerInputMode(int handle,
+        CAEN_DGTZ_TriggerMode_t mode) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+
+    board->set_trigger_modes(nullptr, &mode);
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetChannelSelfTrigger(int handle,
+        CAEN_DGTZ_TriggerMode_t mode, uint32_t channelmask) {
+    auto board = get_board(handle);
+    return board ? board->set_self_trigger(mode, channelmask, false)
+                 : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetGroupSelfTrigger(int handle,
+        CAEN_DGTZ_TriggerMode_t mode, uint32_t groupmask) {
+    auto board = get_board(handle);
+    return board ? board->set_self_trigger(mode, groupmask, true)
+                 : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetChannelGroupMask(int handle, uint32_t group,
+                                                  uint32_t) {
+    auto board = get_board(handle);
+    return board ? board->check_unit(group, true) : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetChannelTriggerThreshold(int handle,
+        uint32_t channel, uint32_t) {
+    auto board = get_board(handle);
+    return board ? board->check_unit(channel, false) : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetGroupTriggerThreshold(int handle,
+        uint32_t group, uint32_t) {
+    auto board = get_board(handle);
+    return board ? board->check_unit(group, true) : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetTriggerPolarity(int handle, uint32_t,
+        CAEN_DGTZ_TriggerPolarity_t) {
+    return get_board(handle) ? CAEN_DGTZ_Success : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SWStartAcquisition(int handle) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+
+    Config config;
+    {
+        auto& reg = registry();
+        std::lock_guard lock(reg.Mutex);
+        config = config_of(board->address());
+    }
+
+    // The model cannot change under an open board
+    if (config.Model != board->model().Name) {
+        return CAEN_DGTZ_BadBoardType;
+    }
+
+    board->start(config);
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SWStopAcquisition(int handle) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+
+    board->stop();
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_ClearData(int handle) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+
+    board->clear();
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_SetInterruptConfig(int handle,
+        CAEN_DGTZ_EnaDis_t state, uint8_t, uint32_t, uint16_t event_number,
+        CAEN_DGTZ_IRQMode_t) {
+    auto board = get_board(handle);
+    return board ? board->set_interrupts(state == CAEN_DGTZ_ENABLE,
+                                         event_number)
+                 : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_IRQWait(int handle, uint32_t timeout) {
+    auto board = get_board(handle);
+    return board ? board->irq_wait(timeout) : CAEN_DGTZ_InvalidHandle;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_MallocReadoutBuffer(int handle, char** buffer,
+                                                  uint32_t* size) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+    if (buffer == nullptr or size == nullptr) {
+        return CAEN_DGTZ_InvalidParam;
+    }
+
+    *size = board->readout_buffer_size();
+    *buffer = static_cast<char*>(std::malloc(*size));
+    if (*buffer == nullptr) {
+        return CAEN_DGTZ_OutOfMemory;
+    }
+
+    auto& reg = registry();
+    std::lock_guard lock(reg.Mutex);
+    reg.ReadoutBuffers[*buffer] = *size;
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_FreeReadoutBuffer(char** buffer) {
+    if (buffer == nullptr or *buffer == nullptr) {
+        return CAEN_DGTZ_Success;
+    }
+
+    {
+        auto& reg = registry();
+        std::lock_guard lock(reg.Mutex);
+        reg.ReadoutBuffers.erase(*buffer);
+    }
+    std::free(*buffer);
+    *buffer = nullptr;
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_ReadData(int handle, CAEN_DGTZ_ReadMode_t,
+                                       char* buffer, uint32_t* bufferSize) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+    if (buffer == nullptr or bufferSize == nullptr) {
+        return CAEN_DGTZ_InvalidBuffer;
+    }
+
+    // Buffers not from CAEN_DGTZ_MallocReadoutBuffer are trusted to be
+    // big enough, as the CAEN library does
+    uint32_t capacity = UINT32_MAX;
+    {
+        auto& reg = registry();
+        std::lock_guard lock(reg.Mutex);
+        auto it = reg.ReadoutBuffers.find(buffer);
+        if (it != reg.ReadoutBuffers.end()) {
+            capacity = it->second;
+        }
+    }
+
+    return board->read_data(buffer, capacity, *bufferSize);
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_GetNumEvents(int handle, char* buffer,
+                                           uint32_t buffsize,
+                                           uint32_t* numEvents) {
+    if (not get_board(handle)) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+    if (numEvents == nullptr or (buffer == nullptr and buffsize > 0)) {
+        return CAEN_DGTZ_InvalidParam;
+    }
+
+    *numEvents = 0;
+    return for_each_event(buffer, buffsize, [&](uint32_t, uint32_t) {
+        (*numEvents)++;
+        return true;
+    });
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_GetEventInfo(int handle, char* buffer,
+                                           uint32_t buffsize,
+                                           int32_t numEvent,
+                                           CAEN_DGTZ_EventInfo_t* eventInfo,
+                                           char** EventPtr) {
+    if (not get_board(handle)) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+    if (buffer == nullptr or eventInfo == nullptr or EventPtr == nullptr
+        or numEvent < 0) {
+        return CAEN_DGTZ_InvalidParam;
+    }
+
+    int32_t i = 0;
+    char* event = nullptr;
+    auto err = for_each_event(buffer, buffsize, [&](uint32_t offset, uint32_t) {
+        if (i++ == numEvent) {
+            event = buffer + offset;
+            return false;
+        }
+        return true;
+    });
+    if (event == nullptr) {
+        return err != CAEN_DGTZ_Success ? err : CAEN_DGTZ_EventNotFound;
+    }
+
+    const uint32_t w1 = read_word(event + 4);
+    eventInfo->EventSize = (read_word(event) & 0x0FFFFFFF)*sizeof(uint32_t);
+    eventInfo->BoardId = w1 >> 27;
+    eventInfo->Pattern = (w1 >> 8) & 0xFFFF;
+    eventInfo->ChannelMask = w1 & 0xFF;
+    eventInfo->EventCounter = read_word(event + 8) & 0x00FFFFFF;
+    eventInfo->TriggerTimeTag = read_word(event + 12);
+    *EventPtr = event;
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_AllocateEvent(int handle, void** Evt) {
+    if (not get_board(handle)) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+    if (Evt == nullptr) {
+        return CAEN_DGTZ_InvalidParam;
+    }
+
+    auto event = std::make_unique<DecodedEvent>();
+    *Evt = &event->Event;
+    auto& reg = registry();
+    std::lock_guard lock(reg.Mutex);
+    reg.Events[*Evt] = std::move(event);
+    return CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_DecodeEvent(int handle, char* evtPtr,
+                                          void** Evt) {
+    auto board = get_board(handle);
+    if (not board) {
+        return CAEN_DGTZ_InvalidHandle;
+    }
+    if (evtPtr == nullptr or Evt == nullptr) {
+        return CAEN_DGTZ_InvalidParam;
+    }
+
+    DecodedEvent* event = nullptr;
+    {
+        auto& reg = registry();
+        std::lock_guard lock(reg.Mutex);
+        auto it = reg.Events.find(*Evt);
+        if (it == reg.Events.end()) {
+            return CAEN_DGTZ_InvalidBuffer;
+        }
+        event = it->second.get();
+    }
+
+    if ((read_word(evtPtr) >> 28) != 0xA) {
+        return CAEN_DGTZ_InvalidEvent;
+    }
+
+    return decode(board->model(), evtPtr, *event);
+}
+
+CAEN_DGTZ_ErrorCode CAEN_DGTZ_FreeEvent(int, void** Evt) {
+    if (Evt == nullptr or *Evt == nullptr) {
+        return CAEN_DGTZ_Success;
+    }
+
+    auto& reg = registry();
+    std::lock_guard lock(reg.Mutex);
+    reg.Events.erase(*Evt);
+    *Evt = nullptr;
+    return CAEN_DGTZ_Success;
+}
+
+}  // extern "C"
@@ -0,0 +1,148 @@
+#include "sipm_pulse_generator.hpp"
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <cmath>
+
+// C++ 3rd party includes
+// my includes
+
+namespace SBCQueens::CAENEmulator {
+
+namespace {
+
+// Samples of noise the waveforms are sliced from, at least
+constexpr std::size_t kMinNoiseSamples = 1 << 16;
+// The pulse shape is cut once it falls below this fraction of its peak
+constexpr double kPulseCut = 1e-3;
+constexpr std::size_t kMaxPulseSamples = 1 << 16;
+// Cells a crosstalk chain can fire, so a Crosstalk close to 1 ends
+constexpr uint32_t kMaxCrosstalkCells = 64;
+
+}  // namespace
+
+SiPMPulseGenerator::SiPMPulseGenerator(const SiPMConfig& config,
+                                       const double& sample_period,
+                                       const uint32_t& adc_bits,
+                                       const uint64_t& seed) :
+    _config{config},
+    _sample_period{sample_period},
+    _max_adc{std::exp2(adc_bits) - 1.0},
+    _rng{seed}
+{
+    const double rise = std::max(_config.RiseTime, 1e-3);
+    const double fall = std::max(_config.FallTime, 1e-3);
+    auto shape = [&](const double& t) {
+        if (std::abs(fall - rise) < 1e-6) {
+            return t / fall * std::exp(-t / fall);
+        }
+        return std::exp(-t / fall) - std::exp(-t / rise);
+    };
+
+    double peak = 0.0;
+    for (std::size_t k = 0; k < kMaxPulseSamples; k++) {
+        const double value = shape(k*_sample_period);
+        _pulse.push_back(static_cast<float>(value));
+        peak = std::max(peak, value);
+        if (value < peak*kPulseCut) {
+            break;
+        }
+    }
+
+    for (auto& value : _pulse) {
+        value = static_cast<float>(static_cast<double>(value) / peak);
+    }
+
+    _noise.resize(kMinNoiseSamples);
+    for (auto& value : _noise) {
+        value = static_cast<float>(_config.Noise*_normal(_rng));
+    }
+}
+
+void SiPMPulseGenerator::_add_pulse(std::span<float> out, const int64_t& t,
+                                    const double& amplitude) noexcept {
+    const auto size = static_cast<int64_t>(out.size());
+    const auto height = static_cast<float>(
+        _config.NegativePulses ? -amplitude : amplitude);
+    const int64_t first = std::max<int64_t>(0, -t);
+    const int64_t last = std::min<int64_t>(_pulse.size(), size - t);
+    for (int64_t k = first; k < last; k++) {
+        out[t + k] += height*_pulse[k];
+    }
+}
+
+void SiPMPulseGenerator::_add_avalanche(std::span<float> out,
+                                        const double& t) {
+    uint32_t cells = 1;
+    while (cells < kMaxCrosstalkCells and uniform() < _config.Crosstalk) {
+        cells++;
+    }
+
+    const double gain = _config.Gain*(1.0 + _config.GainSpread*_normal(_rng));
+    _add_pulse(out, static_cast<int64_t>(std::floor(t)), cells*gain);
+
+    // The cell fires again once it has partly recovered
+    for (uint32_t cell = 0; cell < cells; cell++) {
+        if (uniform() >= _config.Afterpulsing) {
+            continue;
+        }
+
+        const double delay = -_config.AfterpulseDelay*std::log1p(-uniform());
+        const double recovered = _config.RecoveryTime > 0.0
+            ? 1.0 - std::exp(-delay / _config.RecoveryTime) : 1.0;
+        _add_pulse(out,
+            static_cast<int64_t>(std::floor(t + delay / _sample_period)),
+            recovered*gain);
+    }
+}
+
+void SiPMPulseGenerator::generate(std::span<uint16_t> out,
+                                  const double& baseline,
+                                  const uint32_t& trigger_sample,
+                                  const bool& light) {
+    const std::size_t n = out.size();
+    if (_noise.size() < 2*n) {
+        const std::size_t old_size = _noise.size();
+        _noise.resize(2*n);
+        for (std::size_t i = old_size; i < _noise.size(); i++) {
+            _noise[i] = static_cast<float>(_config.Noise*_normal(_rng));
+        }
+    }
+
+    const auto start = static_cast<std::size_t>(
+        uniform()*static_cast<double>(_noise.size() - n));
+    _work.resize(n);
+    const auto base = static_cast<float>(baseline);
+    for (std::size_t i = 0; i < n; i++) {
+        _work[i] = base + _noise[start + i];
+    }
+
+    if (light and _config.LightMean > 0.0) {
+        std::poisson_distribution<uint32_t> photons(_config.LightMean);
+        const uint32_t n_pe = photons(_rng);
+        for (uint32_t i = 0; i < n_pe; i++) {
+            _add_avalanche(_work, trigger_sample);
+        }
+    }
+
+    // Dark counts from before the window leave their tails in it
+    if (_config.DarkRate > 0.0) {
+        const double window = static_cast<double>(n + _pulse.size());
+        std::poisson_distribution<uint32_t> dark(
+            _config.DarkRate*window*_sample_period*1e-9);
+        const uint32_t n_dark = dark(_rng);
+        for (uint32_t i = 0; i < n_dark; i++) {
+            const double t = uniform()*window - static_cast<double>(_pulse.size());
+            _add_avalanche(_work, t);
+        }
+    }
+
+    for (std::size_t i = 0; i < n; i++) {
+        const double value = std::clamp<double>(_work[i], 0.0, _max_adc);
+        out[i] = static_cast<uint16_t>(std::lround(value));
+    }
+}
+
+}  // namespace SBCQueens::CAENEmulator
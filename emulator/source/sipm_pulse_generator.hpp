@@ -0,0 +1,61 @@
+#ifndef CAENEMULATOR_SIPMPULSEGENERATOR_H
+#define CAENEMULATOR_SIPMPULSEGENERATOR_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+// C++ 3rd party includes
+// my includes
+#include "caen_emulator.hpp"
+
+namespace SBCQueens::CAENEmulator {
+
+// Makes the waveforms of a SiPM channel, see SiPMConfig.
+//
+// The pulse shape, exp(-t/fall) - exp(-t/rise) scaled so its highest
+// sample is 1, and a long stretch of gaussian noise are computed once;
+// each waveform is a random slice of the noise plus the pulses, so
+// making one costs little more than a copy of record length samples.
+class SiPMPulseGenerator {
+    SiPMConfig _config;
+    // In ns
+    double _sample_period;
+    double _max_adc;
+
+    std::mt19937_64 _rng;
+    std::uniform_real_distribution<double> _uniform{0.0, 1.0};
+    std::normal_distribution<double> _normal{0.0, 1.0};
+
+    std::vector<float> _pulse;
+    std::vector<float> _noise;
+    std::vector<float> _work;
+
+    // Adds the avalanche of a cell at sample t, with its crosstalk and
+    // afterpulses
+    void _add_avalanche(std::span<float> out, const double& t);
+    void _add_pulse(std::span<float> out, const int64_t& t,
+                    const double& amplitude) noexcept;
+
+ public:
+    SiPMPulseGenerator(const SiPMConfig& config, const double& sample_period,
+                       const uint32_t& adc_bits, const uint64_t& seed);
+
+    // Fills out (record length samples) with a waveform around baseline,
+    // in ADC counts. If light is true, LightMean photoelectrons (on
+    // average) arrive at trigger_sample.
+    void generate(std::span<uint16_t> out, const double& baseline,
+                  const uint32_t& trigger_sample, const bool& light);
+
+    // Uniform in [0, 1)
+    double uniform() { return _uniform(_rng); }
+};
+
+}  // namespace SBCQueens::CAENEmulator
+
+#endif
@@ -19,13 +19,21 @@
 #include <stdexcept>
 #include <algorithm>
 #include <span>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <functional>
 
 // C++ 3rd party includes
 #include <CAENComm.h>
 #include <CAENDigitizer.h>
+#include <readerwriterqueue.h>
 
 // my includes
 #include "logger_helpers.hpp"
+#include "sbcqueens-gui/caen_x740_decoder.hpp"
+#include "sbcqueens-gui/multithreading_helpers/WorkerPool.hpp"
 
 namespace SBCQueens {
 
@@ -266,6 +274,234 @@ struct CAENGlobalConfig {
     // TODO(Any): there are also majority values for TRG-OUT
 };
 
+// Settings of the readout ring (see CAEN::StartReadoutRing). They trade
+// latency for throughput: waiting for more events before a block transfer
+// means fewer and bigger transfers but the events sit longer in the
+// digitizer.
+struct CAENReadoutConfig {
+    // Number of readout buffers in the ring. 0 disables the ring.
+    uint32_t NumBuffers = 4;
+    // Events the digitizer has to have before a block transfer is made.
+    // 0 = chosen from the trigger rate, see CAENReadoutThreshold.
+    uint32_t MinEventsPerTransfer = 0;
+    // Max time, in ms, an event waits in the digitizer when there are
+    // less than MinEventsPerTransfer events.
+    uint32_t MaxLatency = 100;
+    // Smallest transfer, in events, the adaptive threshold aims for so
+    // MBLT transfers stay efficient.
+    uint32_t MinBlockEvents = 16;
+    // Threads used to decode a readout block, see CAEN::SetDecodeThreads.
+    // 0 = one per hardware thread.
+    uint32_t DecodeThreads = 1;
+    // Use the in-house x740 decoder instead of CAEN_DGTZ_DecodeEvent.
+    // Ignored by other families.
+    bool NativeDecode = false;
+    // Sleep until the digitizer raises an interrupt, instead of polling
+    // its event counter, see CAENEventWaiter.
+    bool UseInterrupts = false;
+};
+
+struct CAENReadoutStatistics {
+    // Filled buffers waiting to be decoded
+    uint32_t Occupancy = 0;
+    uint32_t Capacity = 0;
+    // Times the readout found all the buffers filled and had to wait,
+    // while the events pile up in the digitizer.
+    uint64_t Overruns = 0;
+    uint64_t Transfers = 0;
+    uint64_t TransferredBytes = 0;
+};
+
+// Picks how many events to wait for before a readout from the measured
+// trigger rate, instead of a fixed fraction of the digitizer buffer.
+//
+// The threshold is the number of events expected in max_latency, so there
+// is a readout about every max_latency: at low rates waveforms do not sit
+// in the digitizer for seconds. It is not lower than min_block_events so
+// transfers stay big enough to be efficient; when that takes longer than
+// max_latency, isLate() tells the caller to read whatever is there. It is
+// not higher than the buffer minus the events expected during two
+// readouts, so at high rates the digitizer does not fill up while it is
+// being read.
+class CAENReadoutThreshold {
+    using clock = std::chrono::steady_clock;
+    // Weight of the newest rate measurement
+    static constexpr double kSmoothing = 0.3;
+
+    std::chrono::milliseconds _max_latency;
+    uint32_t _min_block_events;
+    uint32_t _max_events;
+    // Smoothed trigger rate, in Hz
+    double _rate = 0.0;
+    uint32_t _threshold;
+    clock::time_point _last_readout;
+
+ public:
+    // max_events is the number of events the digitizer can hold.
+    CAENReadoutThreshold(const std::chrono::milliseconds& max_latency
+                            = std::chrono::milliseconds(100),
+                         const uint32_t& min_block_events = 16,
+                         const uint32_t& max_events = 1024,
+                         const clock::time_point& now = clock::now()) :
+        _max_latency{max_latency},
+        _min_block_events{std::max(1u, min_block_events)},
+        _max_events{std::max(1u, max_events)},
+        // Until there is a rate, isLate() takes care of low rates
+        _threshold{std::min(_min_block_events, _max_events)},
+        _last_readout{now} { }
+
+    // Call after every readout with the measured trigger rate (Hz) and
+    // how long the readout took.
+    void update(const double& trigger_rate,
+                const std::chrono::duration<double>& readout_time,
+                const clock::time_point& now = clock::now()) noexcept {
+        _last_readout = now;
+        _rate = _rate == 0.0 ? trigger_rate
+            : kSmoothing*trigger_rate + (1.0 - kSmoothing)*_rate;
+
+        const double latency_events = _rate
+            * std::chrono::duration<double>(_max_latency).count();
+        const double headroom = 2.0*_rate*readout_time.count();
+        const double cap = std::max(1.0, _max_events - headroom);
+
+        const double n = std::min(std::max(latency_events,
+                                           static_cast<double>(_min_block_events)),
+                                  cap);
+        _threshold = std::clamp(static_cast<uint32_t>(n), 1u, _max_events);
+    }
+
+    [[nodiscard]] uint32_t get() const noexcept { return _threshold; }
+    [[nodiscard]] double getRate() const noexcept { return _rate; }
+
+    // True if the last readout was more than max_latency ago
+    [[nodiscard]] bool isLate(const clock::time_point& now
+                                = clock::now()) const noexcept {
+        return now - _last_readout >= _max_latency;
+    }
+};
+
+// CAEN interrupt API calls used by CAENEventWaiter. Defaults to the CAEN
+// library, but they can be replaced by a software stand-in to test the
+// wake up path without a digitizer.
+struct CAENInterruptAPI {
+    std::function<CAEN_DGTZ_ErrorCode(int, CAEN_DGTZ_EnaDis_t, uint8_t,
+        uint32_t, uint16_t, CAEN_DGTZ_IRQMode_t)> SetInterruptConfig
+            = CAEN_DGTZ_SetInterruptConfig;
+    std::function<CAEN_DGTZ_ErrorCode(int, uint32_t)> IRQWait
+            = CAEN_DGTZ_IRQWait;
+};
+
+struct CAENEventWaiterStatistics {
+    uint64_t Interrupts = 0;
+    uint64_t Timeouts = 0;
+    // Reads of the events in buffer register
+    uint64_t RegisterReads = 0;
+};
+
+// Waits until the digitizer holds enough events to be read.
+//
+// With interrupts enabled, the digitizer raises one when it holds the
+// number of events given to enableInterrupts(...) and wait(...) sleeps in
+// IRQWait until then. The interrupt is released by the readout (RORA).
+// If IRQWait times out the register is still read once, so a missed
+// interrupt or a slow trigger rate does not stall the readout.
+//
+// Without interrupts it reads the register every poll period, which is a
+// bus transaction each time and up to a poll period of latency.
+//
+// Only one thread should use it at a time; the statistics can be read from
+// any thread.
+class CAENEventWaiter {
+    CAENInterruptAPI _api;
+    std::chrono::microseconds _poll_period;
+    bool _irq_enabled = false;
+
+    std::atomic<uint64_t> _interrupts = 0;
+    std::atomic<uint64_t> _timeouts = 0;
+    std::atomic<uint64_t> _register_reads = 0;
+
+ public:
+    explicit CAENEventWaiter(
+        const std::chrono::microseconds& poll_period
+            = std::chrono::microseconds(1000),
+        CAENInterruptAPI api = {}) :
+        _api{std::move(api)}, _poll_period{poll_period} { }
+
+    // The interrupt is raised once the digitizer holds n_events events.
+    CAEN_DGTZ_ErrorCode enableInterrupts(const int& handle,
+                                         const uint16_t& n_events) noexcept {
+        auto err = _api.SetInterruptConfig(handle, CAEN_DGTZ_ENABLE, 1,
+            0xAAAA, std::max<uint16_t>(1, n_events), CAEN_DGTZ_IRQ_MODE_RORA);
+        _irq_enabled = err == CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success;
+        return err;
+    }
+
+    CAEN_DGTZ_ErrorCode disableInterrupts(const int& handle) noexcept {
+        if (not _irq_enabled) {
+            return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success;
+        }
+
+        _irq_enabled = false;
+        return _api.SetInterruptConfig(handle, CAEN_DGTZ_DISABLE, 1, 0xAAAA,
+                                       1, CAEN_DGTZ_IRQ_MODE_RORA);
+    }
+
+    [[nodiscard]] bool interruptsEnabled() const noexcept {
+        return _irq_enabled;
+    }
+
+    // Waits up to timeout for n_events events. read_events(uint32_t&) has
+    // to read the events in buffer register and return its error code.
+    //
+    // events is the number of events the digitizer holds: at least
+    // n_events after an interrupt, or what the register said after a
+    // timeout, which can be less than n_events.
+    template<typename ReadEvents>
+    CAEN_DGTZ_ErrorCode wait(const int& handle, const uint32_t& n_events,
+                             const std::chrono::milliseconds& timeout,
+                             ReadEvents&& read_events,
+                             uint32_t& events) noexcept {
+        events = 0;
+        if (_irq_enabled) {
+            auto err = _api.IRQWait(handle, static_cast<uint32_t>(timeout.count()));
+            if (err == CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+                _interrupts++;
+                events = n_events;
+                return err;
+            }
+
+            if (err != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Timeout) {
+                return err;
+            }
+
+            _timeouts++;
+            _register_reads++;
+            return read_events(events);
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            _register_reads++;
+            auto err = read_events(events);
+            if (err != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success
+                or events >= n_events) {
+                return err;
+            }
+
+            if (std::chrono::steady_clock::now() >= deadline) {
+                _timeouts++;
+                return err;
+            }
+
+            std::this_thread::sleep_for(_poll_period);
+        }
+    }
+
+    [[nodiscard]] CAENEventWaiterStatistics getStatistics() const noexcept {
+        return {_interrupts.load(), _timeouts.load(), _register_reads.load()};
+    }
+};
+
 // Help structure to link an array of booleans to a single uint8_t
 // without the use of other C++ features which makes it trickier to use
 struct ChannelsMask {
@@ -292,6 +528,8 @@ struct ChannelsMask {
 
         return CH[iter];
     }
+
+    bool operator==(const ChannelsMask&) const = default;
 };
 
 // As a general case, this holds all the configuration values for a channel
@@ -320,8 +558,75 @@ struct CAENGroupConfig {
 
     // In ADC counts
     uint32_t TriggerThreshold = 0;
+
+    bool operator==(const CAENGroupConfig&) const = default;
 };
 
+// Settings that differ between two configurations of a digitizer, so
+// CAEN::Reconfigure only writes those.
+struct CAENConfigDiff {
+    // Record length, events per read or the enabled channels changed. The
+    // digitizer memory is organised again and every buffer of the event
+    // size reallocated, so it needs the whole CAEN::Setup.
+    bool NeedsReset = false;
+    // Trigger modes, acquisition mode, trigger polarity and IO level
+    bool TriggerModes = false;
+    // Trigger overlapping, memory full mode, majority and TRG-IN as gate
+    bool BoardRegisters = false;
+    bool Decimation = false;
+    // Also when the decimation changes, as it is in samples
+    bool PostTrigger = false;
+    // Channels that self trigger, of any group
+    bool TriggerMasks = false;
+    // Groups (or channels) whose threshold, offsets or range changed
+    std::array<bool, 8> Groups = {};
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return NeedsReset + TriggerModes + BoardRegisters + Decimation
+            + PostTrigger + TriggerMasks
+            + std::count(Groups.begin(), Groups.end(), true);
+    }
+    [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+};
+
+inline CAENConfigDiff diff_configs(const CAENGlobalConfig& old_global,
+        const std::array<CAENGroupConfig, 8>& old_groups,
+        const CAENGlobalConfig& new_global,
+        const std::array<CAENGroupConfig, 8>& new_groups) noexcept {
+    CAENConfigDiff diff;
+    diff.NeedsReset = old_global.RecordLength != new_global.RecordLength
+        or old_global.MaxEventsPerRead != new_global.MaxEventsPerRead;
+    diff.TriggerModes = old_global.EXTTriggerMode != new_global.EXTTriggerMode
+        or old_global.SWTriggerMode != new_global.SWTriggerMode
+        or old_global.CHTriggerMode != new_global.CHTriggerMode
+        or old_global.AcqMode != new_global.AcqMode
+        or old_global.TriggerPolarity != new_global.TriggerPolarity
+        or old_global.IOLevel != new_global.IOLevel;
+    diff.BoardRegisters
+        = old_global.TriggerOverlappingEn != new_global.TriggerOverlappingEn
+        or old_global.MemoryFullModeSelection != new_global.MemoryFullModeSelection
+        or old_global.MajorityLevel != new_global.MajorityLevel
+        or old_global.MajorityCoincidenceWindow != new_global.MajorityCoincidenceWindow
+        or old_global.EXTAsGate != new_global.EXTAsGate;
+    diff.Decimation = old_global.DecimationFactor != new_global.DecimationFactor;
+    diff.PostTrigger = diff.Decimation
+        or old_global.PostTriggerPorcentage != new_global.PostTriggerPorcentage;
+
+    for (std::size_t i = 0; i < old_groups.size(); i++) {
+        const auto& old_group = old_groups[i];
+        const auto& new_group = new_groups[i];
+        diff.NeedsReset |= old_group.Enabled != new_group.Enabled
+            or old_group.AcquisitionMask != new_group.AcquisitionMask;
+        diff.TriggerMasks |= old_group.TriggerMask != new_group.TriggerMask;
+        diff.Groups[i] = old_group.DCOffset != new_group.DCOffset
+            or old_group.DCCorrections != new_group.DCCorrections
+            or old_group.DCRange != new_group.DCRange
+            or old_group.TriggerThreshold != new_group.TriggerThreshold;
+    }
+
+    return diff;
+}
+
 // Events structure: holds the raw data of the event, the info (timestamp),
 // and the pointer to the point in the original buffer.
 // This uses CAEN functions to allocate memory, so if handle does not
@@ -410,6 +715,67 @@ class CAENEvent {
     }
 };
 
+// Gets a vector with the numbers of the channels as per CAEN specification.
+// Takes into account if the digitizer has groups or not.
+inline std::vector<std::size_t> get_enabled_channels(
+        const CAENDigitizerModelConstants& model_constants,
+        const std::array<CAENGroupConfig, 8>& groups) {
+    std::vector<std::size_t> out;
+    for(std::size_t group_num = 0; group_num < groups.size(); group_num++) {
+        const auto& group = groups[group_num];
+        if (not group.Enabled) {
+            continue;
+        }
+
+        // If the digitizer does not support groups, group_num = ch
+        if(model_constants.NumberOfGroups == 0) {
+            out.push_back(group_num);
+            continue;
+        }
+
+        // Othewise, calculate using the AcquisitionMask
+        for(std::size_t ch = 0; ch < model_constants.NumChannelsPerGroup; ch++) {
+            if(group.AcquisitionMask.at(ch)) {
+                out.push_back(ch + model_constants.NumChannelsPerGroup * group_num);
+            }
+        }
+    }
+    return out;
+}
+
+// Copies the channels en_chs of a decoded event into out, one row of
+// record_length samples per channel. Returns false, without copying, if
+// the event does not have record_length samples.
+template <typename DataType>
+bool copy_caen_event(const CAENEvent& event,
+                     const std::vector<std::size_t>& en_chs,
+                     const uint32_t& record_length,
+                     std::span<DataType> out) noexcept {
+    const CAEN_DGTZ_UINT16_EVENT_t* data = event.getData();
+
+    if (data->ChSize[0] != record_length) {
+        return false;
+    }
+
+    for (std::size_t ch_index = 0; ch_index < en_chs.size(); ch_index++) {
+        // We get the actual CAEN Channel number
+        const auto& en_ch = en_chs[ch_index];
+        // Get the size and data from the CAEN data structure
+        // The size must be the record length. There is one exception if
+        // Overlapping waveforms is enabled. But that is a dangerous
+        // configuration anyways.
+        auto ch_size = data->ChSize[en_ch];
+        auto ch_data = data->DataChannel[en_ch];
+
+        // Now we copy to our own structure
+        for(std::size_t i = 0; i < ch_size; i++) {
+            out[record_length*ch_index + i] = ch_data[i];
+        }
+    }
+
+    return true;
+}
+
 template <typename DataType = uint16_t>
 requires std::is_same_v<DataType, uint16_t> or std::is_same_v<DataType, uint8_t>
 class CAENWaveforms {
@@ -422,7 +788,7 @@ class CAENWaveforms {
     CAENWaveforms(const CAENDigitizerModelConstants& model_constants,
                   const CAENGlobalConfig& gp_config,
                   const std::array<CAENGroupConfig, 8>& groups) :
-            _en_chs{_get_en_chs(model_constants, groups)},
+            _en_chs{get_enabled_channels(model_constants, groups)},
             _num_en_chs{_en_chs.size()},
             _record_length{gp_config.RecordLength},
             _data(_num_en_chs*_record_length)
@@ -449,27 +815,8 @@ class CAENWaveforms {
     // Copies values from event into the internal buffer
     // Does not copy if record length does not match the size
     void copy(const std::unique_ptr<CAENEvent>& event) {
-        const CAEN_DGTZ_UINT16_EVENT_t* data = event->getData();
-
-        if (data->ChSize[0] != _record_length) {
-            return;
-        }
-
-        _info = event->getInfo();
-        for (std::size_t ch_index = 0; ch_index < _en_chs.size(); ch_index++) {
-            // We get the actual CAEN Channel number
-            const auto& en_ch = _en_chs[ch_index];
-            // Get the size and data from the CAEN data structure
-            // The size must be the record length. There is one exception if
-            // Overlapping waveforms is enabled. But that is a dangerous
-            // configuration anyways.
-            auto ch_size = data->ChSize[en_ch];
-            auto ch_data = data->DataChannel[en_ch];
-
-            // Now we copy to our own structure
-            for(std::size_t i = 0; i < ch_size; i++) {
-                _data[_record_length*ch_index + i] = ch_data[i];
-            }
+        if (copy_caen_event(*event, _en_chs, _record_length, getData())) {
+            _info = event->getInfo();
         }
     }
 
@@ -499,35 +846,197 @@ class CAENWaveforms {
         return std::span<DataType>(_data);
     }
 
+    // For decoders that write straight into getData()
+    void setInfo(const CAEN_DGTZ_EventInfo_t& info) noexcept {
+        _info = info;
+    }
+
+    // Exchanges the contents of both waveforms without copying. Useful to
+    // hand the waveforms to another thread while the digitizer keeps
+    // using this object.
+    void swap(CAENWaveforms<DataType>& other) noexcept {
+        _en_chs.swap(other._en_chs);
+        std::swap(_num_en_chs, other._num_en_chs);
+        std::swap(_record_length, other._record_length);
+        std::swap(_info, other._info);
+        _data.swap(other._data);
+    }
+
  private:
     // Raw waveform data as one continuous 1-D array
     std::vector<DataType> _data;
-    // Gets a vector with the numbers of the channels as per CAEN specification.
-    // Takes into account if the digitizer has groups or not.
-    std::vector<std::size_t> _get_en_chs(
-            const CAENDigitizerModelConstants& model_constants,
-            const std::array<CAENGroupConfig, 8>& groups) {
-        std::vector<std::size_t> out;
-        for(std::size_t group_num = 0; group_num < groups.size(); group_num++) {
-            const auto& group = groups[group_num];
-            if (not group.Enabled) {
-                continue;
-            }
+};
 
-            // If the digitizer does not support groups, group_num = ch
-            if(model_constants.NumberOfGroups == 0) {
-                out.push_back(group_num);
-                continue;
-            }
+// One event of a CAENWaveformBatch. It does not own anything: it is only
+// valid while the batch is alive and not swapped or reallocated. Has the
+// same accessors as CAENWaveforms.
+template <typename DataType = uint16_t>
+class CAENWaveformView {
+    std::span<DataType> _data;
+    CAEN_DGTZ_EventInfo_t* _info = nullptr;
+    const std::vector<std::size_t>* _en_chs = nullptr;
+    uint32_t _record_length = 0;
+ public:
+    CAENWaveformView() = default;
+    CAENWaveformView(std::span<DataType> data, CAEN_DGTZ_EventInfo_t& info,
+                     const std::vector<std::size_t>& en_chs,
+                     const uint32_t& record_length) :
+        _data{data}, _info{&info}, _en_chs{&en_chs},
+        _record_length{record_length} { }
+
+    [[nodiscard]] bool empty() const noexcept { return _info == nullptr; }
+    [[nodiscard]] const uint32_t& getRecordLength() const noexcept {
+        return _record_length;
+    }
+    [[nodiscard]] std::size_t getTotalSize() const noexcept {
+        return _data.size();
+    }
+    [[nodiscard]] std::size_t getNumEnabledChannels() const noexcept {
+        return _en_chs->size();
+    }
+    [[nodiscard]] const std::vector<std::size_t>& getEnabledChannels() const noexcept {
+        return *_en_chs;
+    }
+    [[nodiscard]] const CAEN_DGTZ_EventInfo_t& getInfo() const noexcept {
+        return *_info;
+    }
+    [[nodiscard]] std::span<DataType> getData() const noexcept {
+        return _data;
+    }
+    // Samples of the row-th enabled channel
+    [[nodiscard]] std::span<DataType> getChannel(const std::size_t& row) const noexcept {
+        return _data.subspan(row*_record_length, _record_length);
+    }
 
-            // Othewise, calculate using the AcquisitionMask
-            for(std::size_t ch = 0; ch < model_constants.NumChannelsPerGroup; ch++) {
-                if(group.AcquisitionMask.at(ch)) {
-                    out.push_back(ch + model_constants.NumChannelsPerGroup * group_num);
-                }
-            }
+    void setInfo(const CAEN_DGTZ_EventInfo_t& info) const noexcept {
+        *_info = info;
+    }
+
+    // Copies values from event. Does not copy, and returns false, if the
+    // record length does not match.
+    bool copy(const CAENEvent& event) const noexcept {
+        if (not copy_caen_event(event, *_en_chs, _record_length, _data)) {
+            return false;
         }
-        return out;
+
+        *_info = event.getInfo();
+        return true;
+    }
+};
+
+// All the waveforms of a readout in a single allocation, laid out as
+// [event][channel][sample], plus the info of every event in a parallel
+// array. It is allocated once for the max number of events a readout can
+// return and then reused, so decoding, saving and plotting go over the
+// same contiguous memory and handing it to another thread is a swap.
+//
+// Only the first size() events are valid.
+template <typename DataType = uint16_t>
+requires std::is_same_v<DataType, uint16_t> or std::is_same_v<DataType, uint8_t>
+class CAENWaveformBatch {
+    std::vector<std::size_t> _en_chs = {};
+    uint32_t _record_length = 0;
+    // Samples of a single event
+    std::size_t _event_size = 0;
+    std::size_t _capacity = 0;
+    std::size_t _size = 0;
+    std::vector<DataType> _data;
+    std::vector<CAEN_DGTZ_EventInfo_t> _infos;
+ public:
+    CAENWaveformBatch() = default;
+    CAENWaveformBatch(const CAENDigitizerModelConstants& model_constants,
+                      const CAENGlobalConfig& gp_config,
+                      const std::array<CAENGroupConfig, 8>& groups,
+                      const std::size_t& capacity) :
+        _en_chs{get_enabled_channels(model_constants, groups)},
+        _record_length{gp_config.RecordLength},
+        _event_size{_en_chs.size()*_record_length},
+        _capacity{capacity},
+        _data(_capacity*_event_size),
+        _infos(_capacity)
+    { }
+
+    [[nodiscard]] const uint32_t& getRecordLength() const noexcept {
+        return _record_length;
+    }
+    [[nodiscard]] std::size_t getNumEnabledChannels() const noexcept {
+        return _en_chs.size();
+    }
+    [[nodiscard]] const std::vector<std::size_t>& getEnabledChannels() const noexcept {
+        return _en_chs;
+    }
+    // Number of samples of a single event
+    [[nodiscard]] const std::size_t& getEventSize() const noexcept {
+        return _event_size;
+    }
+
+    [[nodiscard]] const std::size_t& size() const noexcept { return _size; }
+    [[nodiscard]] const std::size_t& capacity() const noexcept { return _capacity; }
+    [[nodiscard]] bool empty() const noexcept { return _size == 0; }
+    // Sets the number of valid events, up to capacity(). Nothing is
+    // allocated or cleared.
+    void resize(const std::size_t& n) noexcept {
+        _size = std::min(n, _capacity);
+    }
+
+    // Event i, valid or not, as long as i < capacity()
+    [[nodiscard]] CAENWaveformView<DataType> operator[](const std::size_t& i) noexcept {
+        return {std::span<DataType>(_data).subspan(i*_event_size, _event_size),
+                _infos[i], _en_chs, _record_length};
+    }
+    [[nodiscard]] std::span<const DataType> getData(const std::size_t& i) const noexcept {
+        return std::span<const DataType>(_data).subspan(i*_event_size, _event_size);
+    }
+    [[nodiscard]] const CAEN_DGTZ_EventInfo_t& getInfo(const std::size_t& i) const noexcept {
+        return _infos[i];
+    }
+
+    // Samples of all the valid events
+    [[nodiscard]] std::span<const DataType> getData() const noexcept {
+        return std::span<const DataType>(_data).first(_size*_event_size);
+    }
+    [[nodiscard]] std::span<const CAEN_DGTZ_EventInfo_t> getInfos() const noexcept {
+        return std::span<const CAEN_DGTZ_EventInfo_t>(_infos).first(_size);
+    }
+
+    // True if both batches have the same channels, record length and
+    // capacity, so their contents can be swapped.
+    [[nodiscard]] bool hasSameLayout(const CAENWaveformBatch& other) const noexcept {
+        return _en_chs == other._en_chs and _record_length == other._record_length
+            and _capacity == other._capacity;
+    }
+
+    // Exchanges the contents of both batches without copying. Views of
+    // either batch are not valid after this.
+    void swap(CAENWaveformBatch& other) noexcept {
+        _en_chs.swap(other._en_chs);
+        std::swap(_record_length, other._record_length);
+        std::swap(_event_size, other._event_size);
+        std::swap(_capacity, other._capacity);
+        std::swap(_size, other._size);
+        _data.swap(other._data);
+        _infos.swap(other._infos);
+    }
+
+    // Copies the valid events of other, from first and up to n, after the
+    // valid events of this batch. Returns how many were copied: fewer than
+    // n once this batch is full, 0 if the channels or record length are
+    // not the same.
+    std::size_t append(const CAENWaveformBatch& other, const std::size_t& first,
+                       const std::size_t& n) noexcept {
+        if (_en_chs != other._en_chs or _record_length != other._record_length
+            or first >= other._size) {
+            return 0;
+        }
+
+        const std::size_t count = std::min({n, other._size - first,
+                                            _capacity - _size});
+        std::copy_n(other._data.begin() + first*_event_size,
+                    count*_event_size, _data.begin() + _size*_event_size);
+        std::copy_n(other._infos.begin() + first, count,
+                    _infos.begin() + _size);
+        _size += count;
+        return count;
     }
 };
 
@@ -597,7 +1106,9 @@ class CAEN {
     // CAEN ENUMS. Holds the latest error thrown by any of the CAEN APIs funcs
     CAEN_DGTZ_ErrorCode _err_code = CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success;
 
-    bool _has_error = false;
+    // Atomic: with several boards, read_board sets it from its own thread
+    // while the acquisition loop polls HasError
+    std::atomic<bool> _has_error = false;
     bool _has_warning = false;
 
     // Communicated with the outside world: errors, warnings and debug msgs
@@ -610,11 +1121,49 @@ class CAEN {
     // unique_ptr because only this class should manage this resource;
     // Its lifetime is the same as the acquisition is enabled.
     // Only 1 required at a time.
-    // TODO(Any): for multiprocessing of data this is where I would start.
-    //  - adding a circular buffer of CAEN data will allow to further
-    //  - acquire more CAENData while the previous CAENData is being
-    //  - processed
     CAENData_ptr _caen_raw_data;
+    // Data that DecodeEvents and co. work on. Either _caen_raw_data or the
+    // ring buffer that was last retrieved.
+    CAENData* _current_data = nullptr;
+
+    // Readout ring. A readout thread keeps moving data from the digitizer
+    // into free buffers while the filled ones are decoded.
+    CAENReadoutConfig _readout_config;
+    std::vector<CAENData_ptr> _readout_ring;
+    // Single producer single consumer each: the readout thread only takes
+    // from _free_readout_buffers and only adds to _filled_readout_buffers.
+    moodycamel::BlockingReaderWriterQueue<CAENData*> _free_readout_buffers;
+    moodycamel::BlockingReaderWriterQueue<CAENData*> _filled_readout_buffers;
+    // Buffer being decoded, given back to the ring on the next retrieve.
+    CAENData* _held_readout_buffer = nullptr;
+    std::thread _readout_thread;
+    std::atomic<bool> _readout_stop = false;
+    // Error from the readout thread, reported by RetrieveReadoutBlock
+    std::atomic<CAEN_DGTZ_ErrorCode> _readout_err_code
+        = CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success;
+    // MinEventsPerTransfer, can be changed while the ring runs
+    std::atomic<uint32_t> _readout_min_events = 1;
+    std::atomic<uint64_t> _readout_overruns = 0;
+    std::atomic<uint64_t> _readout_transfers = 0;
+    std::atomic<uint64_t> _readout_bytes = 0;
+    // Serializes the communication with the digitizer (register access,
+    // triggers and block transfers) while the readout thread is running.
+    // CAEN_DGTZ_GetEventInfo and CAEN_DGTZ_DecodeEvent only work on
+    // memory so decoding does not need it.
+    std::mutex _link_mutex;
+
+    void _readout_loop() noexcept;
+
+    // Sleeps until there are events, either by interrupts or polling.
+    // 200 us of polling matches what a single block transfer takes.
+    CAENEventWaiter _event_waiter{std::chrono::microseconds(200)};
+    // Reads the events in buffer register without logging, for the
+    // readout thread and _event_waiter.
+    CAEN_DGTZ_ErrorCode _read_events_in_buffer(uint32_t& events) noexcept {
+        std::lock_guard lock(_link_mutex);
+        // For 5730 it is the register 0x812C, see GetEventsInBuffer
+        return CAEN_DGTZ_ReadRegister(_caen_api_handle, 0x812C, &events);
+    }
     // Contains information about the configuration of the digitizer
     CAENGlobalConfig _global_config;
     // Contains information about all of the groups, see CAENGroupConfig struct
@@ -622,6 +1171,22 @@ class CAEN {
     // 8 groups from any digitizer.
     std::array<CAENGroupConfig, 8> _group_configs;
 
+    // Parts of Setup, also used by Reconfigure. They write what is in
+    // _global_config and _group_configs.
+    void _setup_decimation() noexcept;
+    void _setup_post_trigger() noexcept;
+    void _setup_trigger_modes() noexcept;
+    void _setup_board_registers() noexcept;
+    void _setup_self_trigger() noexcept;
+    void _setup_group(const std::size_t& grp_n) noexcept;
+
+    // Last value written to the registers only this class writes, not the
+    // CAEN library, since the last Reset. Cleared by Reset.
+    std::unordered_map<uint32_t, uint32_t> _register_shadow;
+    // Writes to a register of _register_shadow, unless it has that value
+    void _write_shadowed_register(const uint32_t& addr,
+                                  const uint32_t& value) noexcept;
+
     // BoardInfo obtained during setup(...). It is a CAEN API struct.
     // Contains information about the digitizer such as firmware version,
     // family, and others.
@@ -636,10 +1201,29 @@ class CAEN {
     // There can only be a max of 1024 of events at a time, but this
     // can be tweeked in teh future.
     std::array<CAENEvent_ptr, EventBufferSize> _events;
-    // shared_ptr as anyone can manage this resource even if CAEN
-    // is no longer in use. Its lifetime is independent of CAEN
-    using CAENWaveforms_ptr = std::shared_ptr<CAENWaveforms<uint16_t>>;
-    std::array<CAENWaveforms_ptr, EventBufferSize> _waveforms;
+    // Decoded waveforms of the current data. Allocated in
+    // EnableAcquisition for the max number of events in a readout.
+    CAENWaveformBatch<uint16_t> _waveforms;
+    // Splits DecodeEvents between threads. nullptr = decode serially.
+    std::unique_ptr<WorkerPool> _decode_pool;
+
+    // Decodes events [begin, end) of the current data into _waveforms.
+    // Safe to call from several threads as long as the ranges do not
+    // overlap: every event has its own CAENEvent and CAENWaveforms and it
+    // does not touch _err_code. Stops at the first error and returns it
+    // with the event where it happened.
+    std::pair<CAEN_DGTZ_ErrorCode, uint32_t> _decode_range(
+        const uint32_t& begin, const uint32_t& end) noexcept;
+
+    // Decode with X740::decode_event instead of the CAEN API.
+    bool _native_decode = false;
+    // Position of each event in the current data, in bytes. Only filled
+    // when decoding natively.
+    std::vector<uint32_t> _event_offsets;
+    // Same as _decode_range but with X740::decode_event. Needs
+    // _event_offsets.
+    std::pair<CAEN_DGTZ_ErrorCode, uint32_t> _decode_range_native(
+        const uint32_t& begin, const uint32_t& end) noexcept;
 
     // Translates the connection info data to a single number that should
     // be unique.
@@ -804,6 +1388,8 @@ class CAEN {
     }
 
     ~CAEN() {
+        StopReadoutRing();
+
         auto id = _hash_connection_info(
             ConnectionType, LinkNum, ConetNode, VMEBaseAddress);
         _connection_info_map.erase(id);
@@ -833,6 +1419,8 @@ class CAEN {
 
     // Check whenever the port is connected
     bool IsConnected() noexcept { return _is_connected; }
+    // Check whenever the acquisition is enabled
+    bool IsAcquiring() noexcept { return _is_acquiring; }
     // Check if it has error.
     bool HasError() noexcept { return _has_error; }
     // Resets warning flag
@@ -844,7 +1432,16 @@ class CAEN {
     const auto& GetGlobalConfiguration() noexcept { return _global_config; }
     const auto& GetGroupConfigurations() noexcept { return _group_configs; }
     const auto& GetNumberOfEvents() noexcept {
-        return _caen_raw_data->NumEvents;
+        return _current_data->NumEvents;
+    }
+    // Readout buffer of the latest retrieved data, as CAEN_DGTZ_ReadData
+    // left it. Valid until the next retrieve.
+    std::span<const char> GetRawData() noexcept {
+        if (_current_data == nullptr or _current_data->Buffer == nullptr) {
+            return {};
+        }
+
+        return {_current_data->Buffer, _current_data->DataSize};
     }
     const auto& GetCurrentPossibleMaxBuffer() noexcept {
         return _current_max_buffers;
@@ -855,6 +1452,14 @@ class CAEN {
     // during this step.
     void Setup(const CAENGlobalConfig&,
         const std::array<CAENGroupConfig, 8>&) noexcept;
+    // Changes the setup to these configurations writing only the settings
+    // that changed, see diff_configs. If the record length, events per
+    // read or enabled channels changed it does a full Setup instead, and
+    // EnableAcquisition if it was acquiring. Otherwise the memory is kept
+    // and, if it was acquiring, the acquisition is resumed with the
+    // digitizer memory cleared. Returns what changed.
+    CAENConfigDiff Reconfigure(const CAENGlobalConfig&,
+        const std::array<CAENGroupConfig, 8>&) noexcept;
     // Reset. Returns all internal registers to defaults. It also releases
     // any dynamic memory.
     void Reset() noexcept;
@@ -863,7 +1468,12 @@ class CAEN {
     void EnableAcquisition() noexcept;
     // Disables the acquisition.
     // Does not disables acquisition if resource there are errors.
-    void DisableAcquisition() noexcept;// Writes to register ADDR with VALUE
+    void DisableAcquisition() noexcept;
+    // Starts the acquisition again, with the digitizer memory cleared,
+    // reusing the memory EnableAcquisition() allocated. Does nothing if
+    // there are errors or EnableAcquisition() was never called.
+    void ResumeAcquisition() noexcept;
+    // Writes to register ADDR with VALUE
     // Does write to register if there are errors.
     void WriteRegister(const uint32_t& addr, const uint32_t& value) noexcept;
     // Reads contents of register ADDR into value
@@ -892,24 +1502,123 @@ class CAEN {
     bool RetrieveDataUntilNEvents(const uint32_t& n) noexcept;
     // Decodes event i from the data retrieved by any call from RetrieveData
     // If i is out of bounds, returns the event at the end of the buffer.
-    // if there is an error during acquisition, this returns a nullptr;
-    auto DecodeEvent(const uint32_t& i) noexcept;
-    // Decodes the latest acquired events.
+    // if there is an error during acquisition, it is not decoded.
+    CAENWaveformView<uint16_t> DecodeEvent(const uint32_t& i) noexcept;
+    // Decodes the latest acquired events. The events are split between
+    // the decode threads (see SetDecodeThreads) but they end in the same
+    // waveforms as when decoded serially.
     // If there are errors it does nothing.
     void DecodeEvents() noexcept;
+    // Number of threads, including the caller, DecodeEvents uses.
+    // 1 = serial decoding, 0 = one per hardware thread.
+    void SetDecodeThreads(const std::size_t& n) noexcept {
+        if (n == 1) {
+            _decode_pool.reset();
+        } else {
+            _decode_pool = std::make_unique<WorkerPool>(n);
+        }
+    }
+    std::size_t GetDecodeThreads() noexcept {
+        return _decode_pool ? _decode_pool->size() : 1;
+    }
+    // Makes DecodeEvents unpack the x740 events itself, straight into the
+    // waveforms, without CAEN_DGTZ_DecodeEvent. GetEvent(i) is not
+    // updated while it is enabled, use GetWaveform(i).
+    // Only the x740 family supports it.
+    void SetNativeDecode(const bool& enable) noexcept {
+        if (enable and Family != CAENDigitizerFamilies::x740) {
+            _logger->warn("Native decoding is only supported by the x740 "
+                          "family. Using the CAEN API.");
+            _native_decode = false;
+            return;
+        }
+        _native_decode = enable;
+    }
+    bool IsNativeDecode() noexcept { return _native_decode; }
+    // Decodes the current data with both the CAEN API and the native
+    // decoder and compares them sample by sample. Returns the number of
+    // events that differ, and logs the first one. Meant to validate the
+    // native decoder against real or recorded buffers; it overwrites the
+    // current waveforms and events.
+    uint32_t VerifyNativeDecode() noexcept;
     // Clears the digitizer buffer. It stops the acquisition and resumes it
     // after clearing the data without doing any reallocation of memory.
+    // Stops the readout ring.
     void ClearData() noexcept;
-    // Returns a const pointer to the event held @ index i.
+    // Starts a readout thread that moves the data from the digitizer into
+    // a ring of config.NumBuffers readout buffers. Use RetrieveReadoutBlock
+    // instead of RetrieveData while it runs. Does nothing if there are
+    // errors, it is not acquiring or config.NumBuffers is 0.
+    // Disabling the acquisition or any reconfiguration stops it.
+    void StartReadoutRing(const CAENReadoutConfig& config) noexcept;
+    // Stops the readout thread and frees the ring. The data in the ring
+    // that was not retrieved is lost.
+    void StopReadoutRing() noexcept;
+    bool IsReadoutRingRunning() noexcept { return _readout_thread.joinable(); }
+    // Gives back the previous block to the ring and waits up to timeout
+    // for the next one. Returns true if there is new data to decode.
+    bool RetrieveReadoutBlock(const std::chrono::milliseconds& timeout) noexcept;
+    // Makes the digitizer raise an interrupt once it holds n_events
+    // events, so WaitForEvents and the readout ring sleep instead of
+    // polling the digitizer. StartReadoutRing enables it by itself when
+    // CAENReadoutConfig::UseInterrupts is set, and StopReadoutRing
+    // disables it.
+    void EnableInterrupts(const uint32_t& n_events) noexcept;
+    void DisableInterrupts() noexcept;
+    bool InterruptsEnabled() noexcept {
+        return _event_waiter.interruptsEnabled();
+    }
+    // Waits up to timeout for the digitizer to hold n events. Returns
+    // true if it does. Do not use it while the readout ring is running.
+    bool WaitForEvents(const uint32_t& n,
+                       const std::chrono::milliseconds& timeout) noexcept;
+    // Changes how many events the readout ring waits for before a
+    // transfer, for example from CAENReadoutThreshold. Takes effect in the
+    // next transfer.
+    void SetReadoutThreshold(const uint32_t& n) noexcept {
+        _readout_min_events = std::clamp(n, 1u, std::max(1u, _current_max_buffers));
+    }
+    uint32_t GetReadoutThreshold() noexcept { return _readout_min_events; }
+    CAENEventWaiterStatistics GetEventWaiterStatistics() noexcept {
+        return _event_waiter.getStatistics();
+    }
+    CAENReadoutStatistics GetReadoutStatistics() noexcept {
+        return {static_cast<uint32_t>(_filled_readout_buffers.size_approx()),
+                static_cast<uint32_t>(_readout_ring.size()),
+                _readout_overruns.load(),
+                _readout_transfers.load(),
+                _readout_bytes.load()};
+    }
+    // Returns a view of the waveform held @ index i.
     // If i value is higher the latest acquired number of events, it returns
     // the last event. Use GetNumberOfevents() to check for the number
-    // of events in memory
-    auto GetWaveform(const std::size_t& i) noexcept {
-        if (i >= _current_max_buffers) {
-            return _waveforms[_current_max_buffers - 1];
+    // of events in memory. The view is valid until the next
+    // SwapWaveforms(...) or EnableAcquisition().
+    CAENWaveformView<uint16_t> GetWaveform(const std::size_t& i) noexcept {
+        if (_waveforms.capacity() == 0) {
+            return {};
+        }
+
+        return _waveforms[std::min(i, _waveforms.capacity() - 1)];
+    }
+
+    // All the waveforms decoded by the last DecodeEvents()
+    const CAENWaveformBatch<uint16_t>& GetWaveforms() noexcept {
+        return _waveforms;
+    }
+
+    // Hands the decoded waveforms to other and takes its memory to decode
+    // the next readout, without copying. other has to have the same layout
+    // (see CAENWaveformBatch::hasSameLayout), otherwise nothing is done
+    // and it returns false.
+    bool SwapWaveforms(CAENWaveformBatch<uint16_t>& other) noexcept {
+        if (not _waveforms.hasSameLayout(other)) {
+            return false;
         }
 
-        return _waveforms[i];
+        _waveforms.swap(other);
+        _waveforms.resize(0);
+        return true;
     }
 
     // Returns a const pointer to CAENEvent. Its lifespans its
@@ -979,10 +1688,14 @@ void CAEN<T, N>::Reset() noexcept {
         return;
     }
 
+    StopReadoutRing();
+
     _err_code = CAEN_DGTZ_Reset(_caen_api_handle);
     _print_if_err("CAEN_DGTZ_Reset", __FUNCTION__);
+    _register_shadow.clear();
 
     _caen_raw_data.reset();
+    _current_data = nullptr;
     for(auto& event : _events){
         event.reset();
     }
@@ -1032,31 +1745,149 @@ void CAEN<T, N>::Setup(const CAENGlobalConfig& global_config,
     ReadRegister(0x800C, _current_max_buffers);
     _current_max_buffers = std::exp2(_current_max_buffers);
 
-    if (Family == CAENDigitizerFamilies::x740 or Family == CAENDigitizerFamilies::x724) {
-        if(_global_config.DecimationFactor < 1) {
-            _global_config.DecimationFactor = 1;
-        } else if (_global_config.DecimationFactor > 128) {
-            _global_config.DecimationFactor = 128;
+    _setup_decimation();
+    _setup_post_trigger();
+    _setup_trigger_modes();
+    _setup_board_registers();
+
+    // Channel stuff
+    _group_configs = gr_configs;
+    if (Family == CAENDigitizerFamilies::x730) {
+        // For DT5730B, there are no groups only channels so we take
+        // each configuration as a channel
+        // First, we make the channel mask
+        uint32_t channel_mask = 0;
+        for (std::size_t ch = 0; ch < gr_configs.size(); ch++) {
+            channel_mask |= _group_configs[ch].Enabled << ch;
         }
 
-        // Next lines is to round to the next power of 2
-        // as CAEN_DGTZ_SetDecimationFactor only allows
-        // powers of 2 up to 128
-        uint16_t out = std::log2(_global_config.DecimationFactor);
-        _global_config.DecimationFactor = 1 << out;
+        // Then enable those channels
+        _err_code = CAEN_DGTZ_SetChannelEnableMask(handle, channel_mask);
+        _print_if_err("CAEN_DGTZ_SetChannelEnableMask", __FUNCTION__);
+    } else if (Family == CAENDigitizerFamilies::x740) {
+        uint32_t group_mask = 0;
+        for (std::size_t grp_n = 0; grp_n < gr_configs.size(); grp_n++) {
+            group_mask |= gr_configs[grp_n].Enabled << grp_n;
+        }
+
+        _err_code = CAEN_DGTZ_SetGroupEnableMask(handle, group_mask);
+        _print_if_err("CAEN_DGTZ_SetGroupEnableMask", __FUNCTION__);
+    } else {
+        // custom error message if not above models
+        _err_code = CAEN_DGTZ_ErrorCode::CAEN_DGTZ_BadBoardType;
+        _print_if_err("setup", __FUNCTION__,
+                      "This API does not support your model/family."
+                      " Maybe help writing the support code? :)");
+        return;
+    }
+
+    _setup_self_trigger();
+    for (std::size_t grp_n = 0; grp_n < gr_configs.size(); grp_n++) {
+        _setup_group(grp_n);
+    }
+}
+
+template<typename T, size_t N>
+CAENConfigDiff CAEN<T, N>::Reconfigure(const CAENGlobalConfig& global_config,
+    const std::array<CAENGroupConfig, 8>& gr_configs) noexcept {
+    auto diff = diff_configs(_global_config, _group_configs,
+                             global_config, gr_configs);
+    if (_has_error or not _is_connected or diff.empty()) {
+        return diff;
+    }
+
+    if (diff.NeedsReset or not _caen_raw_data) {
+        diff.NeedsReset = true;
+        const bool was_acquiring = _is_acquiring;
+        Setup(global_config, gr_configs);
+        if (was_acquiring) {
+            EnableAcquisition();
+        }
+        return diff;
+    }
+
+    // Most settings can only be changed while the acquisition is stopped
+    const bool was_acquiring = _is_acquiring;
+    DisableAcquisition();
+
+    const auto record_length = _global_config.RecordLength;
+    _global_config = global_config;
+    // As the digitizer rounded it during Setup
+    _global_config.RecordLength = record_length;
+    _group_configs = gr_configs;
 
-        _err_code = CAEN_DGTZ_SetDecimationFactor(handle, _global_config.DecimationFactor);
+    if (diff.Decimation) {
+        _setup_decimation();
     }
 
+    if (diff.PostTrigger) {
+        _setup_post_trigger();
+    }
+
+    if (diff.TriggerModes) {
+        _setup_trigger_modes();
+    }
+
+    if (diff.BoardRegisters) {
+        _setup_board_registers();
+    }
+
+    if (diff.TriggerModes or diff.TriggerMasks) {
+        _setup_self_trigger();
+    }
+
+    for (std::size_t grp_n = 0; grp_n < diff.Groups.size(); grp_n++) {
+        if (diff.Groups[grp_n]) {
+            _setup_group(grp_n);
+        }
+    }
+
+    if (was_acquiring) {
+        ResumeAcquisition();
+    }
+
+    return diff;
+}
+
+template<typename T, size_t N>
+void CAEN<T, N>::_setup_decimation() noexcept {
+    if (Family != CAENDigitizerFamilies::x740
+        and Family != CAENDigitizerFamilies::x724) {
+        return;
+    }
+
+    if(_global_config.DecimationFactor < 1) {
+        _global_config.DecimationFactor = 1;
+    } else if (_global_config.DecimationFactor > 128) {
+        _global_config.DecimationFactor = 128;
+    }
+
+    // Next lines is to round to the next power of 2
+    // as CAEN_DGTZ_SetDecimationFactor only allows
+    // powers of 2 up to 128
+    uint16_t out = std::log2(_global_config.DecimationFactor);
+    _global_config.DecimationFactor = 1 << out;
+
+    _err_code = CAEN_DGTZ_SetDecimationFactor(_caen_api_handle,
+                                              _global_config.DecimationFactor);
+    _print_if_err("CAEN_DGTZ_SetDecimationFactor", __FUNCTION__);
+}
+
+template<typename T, size_t N>
+void CAEN<T, N>::_setup_post_trigger() noexcept {
     if (Model == CAENDigitizerModel::V1740D) {
-        _print_if_err("CAEN_DGTZ_SetPostTriggerSize", __FUNCTION__);
         uint32_t posttrigval = 0.01*_global_config.PostTriggerPorcentage*_global_config.RecordLength*_global_config.DecimationFactor;
-        WriteRegister(0x8114, posttrigval);
+        _write_shadowed_register(0x8114, posttrigval);
     } else {
-        _err_code = CAEN_DGTZ_SetPostTriggerSize(handle, _global_config.PostTriggerPorcentage);
+        _err_code = CAEN_DGTZ_SetPostTriggerSize(_caen_api_handle,
+                                                 _global_config.PostTriggerPorcentage);
         _print_if_err("CAEN_DGTZ_SetPostTriggerSize", __FUNCTION__);
     }
+}
 
+template<typename T, size_t N>
+void CAEN<T, N>::_setup_trigger_modes() noexcept {
+    int& handle = _caen_api_handle;
     _err_code = CAEN_DGTZ_SetSWTriggerMode(handle, _global_config.SWTriggerMode);
     _print_if_err("CAEN_DGTZ_SetSWTriggerMode", __FUNCTION__);
 
@@ -1074,14 +1905,19 @@ void CAEN<T, N>::Setup(const CAENGlobalConfig& global_config,
 
     _err_code = CAEN_DGTZ_SetIOLevel(handle, _global_config.IOLevel);
     _print_if_err("CAEN_DGTZ_SetIOLevel", __FUNCTION__);
+}
 
-
+template<typename T, size_t N>
+void CAEN<T, N>::_setup_board_registers() noexcept {
     // Board config register
     // 0 = Trigger overlapping not allowed
     // 1 = trigger overlapping allowed
     WriteBits(0x8000, _global_config.TriggerOverlappingEn, 1);
 
     WriteBits(0x8100, _global_config.MemoryFullModeSelection, 5);
+    // The event counter counts every trigger, also those lost while the
+    // memory was full, so its gaps give the livetime
+    WriteBits(0x8100, 1, 3);
 
     // Global Trigger mask. So far seems to be applicable for digitizers
     // with and without groups, huh!
@@ -1089,138 +1925,135 @@ void CAEN<T, N>::Setup(const CAENGlobalConfig& global_config,
     WriteBits(kGlobalTriggerMaskAddr, _global_config.MajorityCoincidenceWindow, 20, 4);
     WriteBits(kGlobalTriggerMaskAddr, _global_config.MajorityLevel, 24, 3);
 
-    // Channel stuff
-    _group_configs = gr_configs;
-    if (Family == CAENDigitizerFamilies::x730) {
-        // For DT5730B, there are no groups only channels so we take
-        // each configuration as a channel
-        // First, we make the channel mask
-        uint32_t channel_mask = 0;
-        for (std::size_t ch = 0; ch < gr_configs.size(); ch++) {
-            channel_mask |= _group_configs[ch].Enabled << ch;
-        }
+    if (Family != CAENDigitizerFamilies::x740) {
+        return;
+    }
+
+    bool trg_out = false;
+    // TODO(Any): these configuration bits look like more complex than they
+    //  - are, maybe they should be expanded to be its own struct?
+    // For 740, to use TRG-IN as Gate / anti-veto
+    // TRG-IN AND internal trigger, and to serve as gate
+    WriteBits(kGlobalTriggerMaskAddr, _global_config.EXTAsGate, 27);
+    WriteBits(0x811C, _global_config.EXTAsGate, 10);  // TRG-IN as gate
+
+    if (trg_out) {
+        WriteBits(0x811C, 0, 15);  // TRG-OUT based on internal signal
+        WriteBits(0x811C, 0b00, 16, 2);  // TRG-OUT based
+        // on internal signal
+    }
+    WriteBits(0x811C, 0b01, 21, 2);
 
+    // read_register(res, 0x8110, word);
+    // word |= 1; // enable group 0 to participate in GPO
+    // write_register(res, 0x8110, word);
+}
+
+template<typename T, size_t N>
+void CAEN<T, N>::_setup_self_trigger() noexcept {
+    int& handle = _caen_api_handle;
+    if (Family == CAENDigitizerFamilies::x730) {
         uint32_t trg_mask = 0;
-        for (std::size_t ch = 0; ch < gr_configs.size(); ch++) {
+        for (std::size_t ch = 0; ch < _group_configs.size(); ch++) {
             trg_mask = _group_configs[ch].TriggerMask.get();
             bool has_trig_mask = trg_mask > 0;
             trg_mask |=  has_trig_mask << ch;
         }
 
-        // Then enable those channels
-        _err_code = CAEN_DGTZ_SetChannelEnableMask(handle, channel_mask);
-        _print_if_err("CAEN_DGTZ_SetChannelEnableMask", __FUNCTION__);
-
         // Then enable if they are part of the trigger
         _err_code = CAEN_DGTZ_SetChannelSelfTrigger(handle,
                                                     _global_config.CHTriggerMode,
                                                     trg_mask);
         _print_if_err("CAEN_DGTZ_SetChannelSelfTrigger", __FUNCTION__);
-
-        for (std::size_t ch = 0; ch < gr_configs.size(); ch++) {
-            auto ch_config = gr_configs[ch];
-
-            // Trigger stuff
-            // Self Channel trigger
-            _err_code = CAEN_DGTZ_SetChannelTriggerThreshold(handle,
-                                                             ch,
-                                                             ch_config.TriggerThreshold);
-            _print_if_err("CAEN_DGTZ_SetChannelTriggerThreshold", __FUNCTION__);
-
-            _err_code = CAEN_DGTZ_SetChannelDCOffset(handle, ch, ch_config.DCOffset);
-            _print_if_err("CAEN_DGTZ_SetChannelDCOffset", __FUNCTION__);
-
-            // Writes to the registers that holds the DC range
-            // For 5730 it is the register 0x1n28
-            WriteRegister(0x1028 | (ch & 0x0F) << 8, ch_config.DCRange & 0x0001);
-        }
-
     } else if (Family == CAENDigitizerFamilies::x740) {
         uint32_t group_mask = 0;
-        for (std::size_t grp_n = 0; grp_n < gr_configs.size(); grp_n++) {
-            group_mask |= gr_configs[grp_n].Enabled << grp_n;
+        for (std::size_t grp_n = 0; grp_n < _group_configs.size(); grp_n++) {
+            group_mask |= _group_configs[grp_n].Enabled << grp_n;
         }
 
-        _err_code = CAEN_DGTZ_SetGroupEnableMask(handle, group_mask);
-        _print_if_err("CAEN_DGTZ_SetGroupEnableMask", __FUNCTION__);
-
         _err_code = CAEN_DGTZ_SetGroupSelfTrigger(handle,
                                                   _global_config.CHTriggerMode,
                                                   group_mask);
         _print_if_err("CAEN_DGTZ_SetGroupSelfTrigger", __FUNCTION__);
 
-        for (std::size_t grp_n = 0; grp_n < gr_configs.size(); grp_n++) {
-            auto gr_config = gr_configs[grp_n];
-            // Trigger stuff
-
-            // This guy is does not work under V1740D unless in firmware
-            // version 4.17
-            _err_code = CAEN_DGTZ_SetGroupTriggerThreshold(handle,
-                                                           grp_n,
-                                                           gr_config.TriggerThreshold);
-            _print_if_err("CAEN_DGTZ_SetGroupTriggerThreshold", __FUNCTION__);
-
-            _err_code = CAEN_DGTZ_SetGroupDCOffset(handle,
-                                                   grp_n,
-                                                   gr_config.DCOffset);
-            _print_if_err("CAEN_DGTZ_SetGroupDCOffset", __FUNCTION__);
-
+        for (std::size_t grp_n = 0; grp_n < _group_configs.size(); grp_n++) {
             // Set the mask for channels enabled for self-triggering
-            auto trig_mask = gr_config.TriggerMask.get();
+            auto trig_mask = _group_configs[grp_n].TriggerMask.get();
             _err_code = CAEN_DGTZ_SetChannelGroupMask(handle,
                                                       grp_n,
                                                       trig_mask);
             _print_if_err("CAEN_DGTZ_SetChannelGroupMask", __FUNCTION__);
-
-            // Set acquisition mask
-//            auto acq_mask = gr_config.AcquisitionMask.get();
-//            WriteBits(0x10A8 | (grp_n << 8), acq_mask, 0, 8);
-
-            // DCCorrections should be of length
-            // NumberofChannels / NumberofGroups.
-            // set individual channel 8-bitDC offset
-            // on 12 bit LSB scale, same as threshold
-            uint32_t word = 0;
-            for (int ch = 0; ch < 4; ch++) {
-                word += gr_config.DCCorrections[ch] << (ch * 8);
-            }
-
-            WriteRegister(0x10C0 | (grp_n << 8), word);
-            word = 0;
-            for (int ch = 4; ch < 8; ch++) {
-                word += gr_config.DCCorrections[ch] << ((ch - 4) * 8);
-            }
-            WriteRegister(0x10C4 | (grp_n << 8), word);
         }
+    }
+}
 
-        bool trg_out = false;
-        // TODO(Any): these configuration bits look like more complex than they
-        //  - are, maybe they should be expanded to be its own struct?
-        // For 740, to use TRG-IN as Gate / anti-veto
-        if (_global_config.EXTAsGate) {
-            WriteBits(kGlobalTriggerMaskAddr, 1, 27);  // TRG-IN AND internal trigger,
-            // and to serve as gate
-            WriteBits(0x811C, 1, 10);  // TRG-IN as gate
+template<typename T, size_t N>
+void CAEN<T, N>::_setup_group(const std::size_t& grp_n) noexcept {
+    int& handle = _caen_api_handle;
+    auto gr_config = _group_configs[grp_n];
+    if (Family == CAENDigitizerFamilies::x730) {
+        // Trigger stuff
+        // Self Channel trigger
+        _err_code = CAEN_DGTZ_SetChannelTriggerThreshold(handle,
+                                                         grp_n,
+                                                         gr_config.TriggerThreshold);
+        _print_if_err("CAEN_DGTZ_SetChannelTriggerThreshold", __FUNCTION__);
+
+        _err_code = CAEN_DGTZ_SetChannelDCOffset(handle, grp_n, gr_config.DCOffset);
+        _print_if_err("CAEN_DGTZ_SetChannelDCOffset", __FUNCTION__);
+
+        // Writes to the registers that holds the DC range
+        // For 5730 it is the register 0x1n28
+        _write_shadowed_register(0x1028 | (grp_n & 0x0F) << 8,
+                                 gr_config.DCRange & 0x0001);
+    } else if (Family == CAENDigitizerFamilies::x740) {
+        // Trigger stuff
+
+        // This guy is does not work under V1740D unless in firmware
+        // version 4.17
+        _err_code = CAEN_DGTZ_SetGroupTriggerThreshold(handle,
+                                                       grp_n,
+                                                       gr_config.TriggerThreshold);
+        _print_if_err("CAEN_DGTZ_SetGroupTriggerThreshold", __FUNCTION__);
+
+        _err_code = CAEN_DGTZ_SetGroupDCOffset(handle,
+                                               grp_n,
+                                               gr_config.DCOffset);
+        _print_if_err("CAEN_DGTZ_SetGroupDCOffset", __FUNCTION__);
+
+        // Set acquisition mask
+//        auto acq_mask = gr_config.AcquisitionMask.get();
+//        WriteBits(0x10A8 | (grp_n << 8), acq_mask, 0, 8);
+
+        // DCCorrections should be of length
+        // NumberofChannels / NumberofGroups.
+        // set individual channel 8-bitDC offset
+        // on 12 bit LSB scale, same as threshold
+        uint32_t word = 0;
+        for (int ch = 0; ch < 4; ch++) {
+            word += gr_config.DCCorrections[ch] << (ch * 8);
         }
 
-        if (trg_out) {
-            WriteBits(0x811C, 0, 15);  // TRG-OUT based on internal signal
-            WriteBits(0x811C, 0b00, 16, 2);  // TRG-OUT based
-            // on internal signal
+        _write_shadowed_register(0x10C0 | (grp_n << 8), word);
+        word = 0;
+        for (int ch = 4; ch < 8; ch++) {
+            word += gr_config.DCCorrections[ch] << ((ch - 4) * 8);
         }
-        WriteBits(0x811C, 0b01, 21, 2);
-
-        // read_register(res, 0x8110, word);
-        // word |= 1; // enable group 0 to participate in GPO
-        // write_register(res, 0x8110, word);
+        _write_shadowed_register(0x10C4 | (grp_n << 8), word);
+    }
+}
 
-    } else {
-        // custom error message if not above models
-        _err_code = CAEN_DGTZ_ErrorCode::CAEN_DGTZ_BadBoardType;
-        _print_if_err("setup", __FUNCTION__,
-                      "This API does not support your model/family."
-                      " Maybe help writing the support code? :)");
+template<typename T, size_t N>
+void CAEN<T, N>::_write_shadowed_register(const uint32_t& addr,
+                                          const uint32_t& value) noexcept {
+    auto it = _register_shadow.find(addr);
+    if (it != _register_shadow.end() and it->second == value) {
+        return;
+    }
 
+    WriteRegister(addr, value);
+    if (not _has_error) {
+        _register_shadow[addr] = value;
     }
 }
 
@@ -1232,11 +2065,14 @@ void CAEN<T, N>::EnableAcquisition() noexcept {
 
     int& handle = _caen_api_handle;
 
+    StopReadoutRing();
+
     // By using reset() for CAENData and CAENEvent we release memory, too.
     // so by calling enable acquisition we also free memory and re-allocate.
 
     // We need a single data buffer to hold the incoming Data
     _caen_raw_data.reset(new CAENData{_logger, handle});
+    _current_data = _caen_raw_data.get();
     _err_code = _caen_raw_data->getError();
     _print_if_err("CAENData", __FUNCTION__);
 
@@ -1245,14 +2081,8 @@ void CAEN<T, N>::EnableAcquisition() noexcept {
         return std::make_unique<CAENEvent>(h);
     });
 
-    std::generate(_waveforms.begin(), _waveforms.end(),
-                  [constants = ModelConstants,
-                   global = _global_config,
-                   groups = _group_configs]() {
-                    return std::make_shared<CAENWaveforms<uint16_t>>(constants,
-                                                   global,
-                                                   groups);
-    });
+    _waveforms = CAENWaveformBatch<uint16_t>(ModelConstants, _global_config,
+        _group_configs, std::min<std::size_t>(N, _current_max_buffers));
 
     _err_code = CAEN_DGTZ_ClearData(handle);
     _print_if_err("CAEN_DGTZ_ClearData", __FUNCTION__);
@@ -1273,6 +2103,8 @@ void CAEN<T, N>::EnableAcquisition() noexcept {
 
 template<typename T, size_t N>
 void CAEN<T, N>::DisableAcquisition() noexcept {
+    StopReadoutRing();
+
     if (_has_error or not _is_connected or not _is_acquiring) {
         return;
     }
@@ -1285,13 +2117,41 @@ void CAEN<T, N>::DisableAcquisition() noexcept {
     }
 }
 
+template<typename T, size_t N>
+void CAEN<T, N>::ResumeAcquisition() noexcept {
+    StopReadoutRing();
+
+    if (_has_error or not _is_connected or not _caen_raw_data) {
+        return;
+    }
+
+    int& handle = _caen_api_handle;
+    if (_is_acquiring) {
+        _err_code = CAEN_DGTZ_SWStopAcquisition(handle);
+        _print_if_err("CAEN_DGTZ_SWStopAcquisition", __FUNCTION__);
+    }
+
+    _err_code = CAEN_DGTZ_ClearData(handle);
+    _print_if_err("CAEN_DGTZ_ClearData", __FUNCTION__);
+    _err_code = CAEN_DGTZ_SWStartAcquisition(handle);
+    _print_if_err("CAEN_DGTZ_SWStartAcquisition", __FUNCTION__);
+    // To avoid false positives
+    if (not _has_error) {
+        _is_acquiring = true;
+    }
+    _waveforms.resize(0);
+}
+
 template<typename T, size_t N>
 void CAEN<T, N>::WriteRegister(const uint32_t& addr, const uint32_t& value) noexcept {
     if (_has_error or not _is_connected) {
         return;
     }
 
-    _err_code = CAEN_DGTZ_WriteRegister(_caen_api_handle, addr, value);
+    {
+        std::lock_guard lock(_link_mutex);
+        _err_code = CAEN_DGTZ_WriteRegister(_caen_api_handle, addr, value);
+    }
     _print_if_err("CAEN_DGTZ_WriteRegister", __FUNCTION__, "Failed to write "
                                                            "register " +
                                                            std::to_string(addr));
@@ -1303,7 +2163,10 @@ void CAEN<T, N>::ReadRegister(const uint32_t& addr, uint32_t& value) noexcept {
         return;
     }
 
-    _err_code = CAEN_DGTZ_ReadRegister(_caen_api_handle, addr, &value);
+    {
+        std::lock_guard lock(_link_mutex);
+        _err_code = CAEN_DGTZ_ReadRegister(_caen_api_handle, addr, &value);
+    }
     _print_if_err("CAEN_DGTZ_ReadRegister", __FUNCTION__, "Failed to read "
                                                           "register " +
                                                           std::to_string(addr));
@@ -1316,6 +2179,7 @@ void CAEN<T, N>::WriteBits(const uint32_t& addr,
         return;
     }
 
+    std::lock_guard lock(_link_mutex);
     // First read the register
     uint32_t read_word = 0;
     _err_code = CAEN_DGTZ_ReadRegister(_caen_api_handle, addr, &read_word);
@@ -1341,7 +2205,10 @@ void CAEN<T, N>::SoftwareTrigger() noexcept {
         return;
     }
 
-    _err_code = CAEN_DGTZ_SendSWtrigger(_caen_api_handle);
+    {
+        std::lock_guard lock(_link_mutex);
+        _err_code = CAEN_DGTZ_SendSWtrigger(_caen_api_handle);
+    }
     _print_if_err("CAEN_DGTZ_SendSWtrigger", __FUNCTION__);
 }
 
@@ -1368,6 +2235,7 @@ void CAEN<T, N>::RetrieveData() noexcept {
         return;
     }
 
+    _current_data = _caen_raw_data.get();
     // UNSAFE CODE AHEAD
     _err_code = CAEN_DGTZ_ReadData(handle,
         CAEN_DGTZ_ReadMode_t::CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT,
@@ -1410,17 +2278,14 @@ bool CAEN<T, N>::RetrieveDataUntilNEvents(const uint32_t& n) noexcept {
 }
 
 template<typename T, size_t N>
-auto CAEN<T, N>::DecodeEvent(const uint32_t& i) noexcept {
-    if (i > _caen_raw_data->NumEvents) {
-        return _waveforms[_caen_raw_data->NumEvents - 1];
+CAENWaveformView<uint16_t> CAEN<T, N>::DecodeEvent(const uint32_t& i) noexcept {
+    if (i >= _current_data->NumEvents
+        or _has_error or not _is_connected) {
+        return GetWaveform(_current_data->NumEvents - 1);
     }
 
-    if (_has_error or not _is_connected) {
-        return _waveforms[_caen_raw_data->NumEvents - 1];
-    }
-
-    _err_code = _events[i]->getEventInfo(_caen_raw_data->Buffer,
-                                        _caen_raw_data->DataSize,
+    _err_code = _events[i]->getEventInfo(_current_data->Buffer,
+                                        _current_data->DataSize,
                                         i);
     _print_if_err("CAEN_DGTZ_GetEventInfo",
                   __FUNCTION__,
@@ -1431,7 +2296,12 @@ auto CAEN<T, N>::DecodeEvent(const uint32_t& i) noexcept {
                   __FUNCTION__,
                   "at event " + std::to_string(i));
 
-    _waveforms[i]->copy(_events[i]);
+    if (not _waveforms[i].copy(*_events[i])) {
+        _err_code = CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidEvent;
+        _print_if_err("CAENWaveformView::copy",
+                      __FUNCTION__,
+                      "record length mismatch at event " + std::to_string(i));
+    }
 
     return _waveforms[i];
 }
@@ -1442,25 +2312,182 @@ void CAEN<T, N>::DecodeEvents() noexcept {
         return;
     }
 
-    for (uint32_t i = 0; i < _caen_raw_data->NumEvents; i++) {
-        _err_code = _events[i]->getEventInfo(_caen_raw_data->Buffer,
-                                            _caen_raw_data->DataSize,
+    const uint32_t n_events = std::min<std::size_t>(_current_data->NumEvents,
+                                                    _waveforms.capacity());
+    _waveforms.resize(n_events);
+    std::pair<CAEN_DGTZ_ErrorCode, uint32_t> result
+        = {CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success, 0};
+
+    auto decode_range = &CAEN<T, N>::_decode_range;
+    if (_native_decode) {
+        decode_range = &CAEN<T, N>::_decode_range_native;
+        // Finding where the events start can only be done serially
+        _err_code = X740::index_events(_current_data->Buffer,
+                                       _current_data->DataSize,
+                                       _event_offsets);
+        if (_err_code == CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success
+            and _event_offsets.size() != n_events) {
+            _err_code = CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidEvent;
+        }
+        _print_if_err("X740::index_events", __FUNCTION__);
+        if (_has_error) {
+            return;
+        }
+    }
+
+    if (not _decode_pool) {
+        result = (this->*decode_range)(0, n_events);
+    } else {
+        // One result per worker; the first failing event is reported
+        std::vector<std::pair<CAEN_DGTZ_ErrorCode, uint32_t>> results(
+            _decode_pool->size(), result);
+        _decode_pool->for_each_chunk(n_events,
+            [&](std::size_t begin, std::size_t end, std::size_t worker) {
+                results[worker] = (this->*decode_range)(
+                    static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+        });
+
+        auto failed = std::find_if(results.begin(), results.end(),
+            [](const auto& r) {
+                return r.first != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success;
+        });
+        if (failed != results.end()) {
+            result = *failed;
+        }
+    }
+
+    _err_code = result.first;
+    _print_if_err("CAEN_DGTZ_GetEventInfo/CAEN_DGTZ_DecodeEvent",
+                  __FUNCTION__,
+                  "at event " + std::to_string(result.second));
+}
+
+template<typename T, size_t N>
+std::pair<CAEN_DGTZ_ErrorCode, uint32_t> CAEN<T, N>::_decode_range(
+        const uint32_t& begin, const uint32_t& end) noexcept {
+    CAEN_DGTZ_ErrorCode err_code = CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success;
+    for (uint32_t i = begin; i < end; i++) {
+        err_code = _events[i]->getEventInfo(_current_data->Buffer,
+                                            _current_data->DataSize,
                                             i);
-        _print_if_err("CAEN_DGTZ_GetEventInfo",
-                      __FUNCTION__,
-                      "at event " + std::to_string(i));
+        if (err_code != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+            return {err_code, i};
+        }
+
         // Cannot decode without getting event info
-        _err_code = _events[i]->decodeEvent();
-        _print_if_err("CAEN_DGTZ_DecodeEvent",
-                      __FUNCTION__,
-                      "at event " + std::to_string(i));
+        err_code = _events[i]->decodeEvent();
+        if (err_code != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+            return {err_code, i};
+        }
 
-        _waveforms[i]->copy(_events[i]);
+        // The slot could hold the waveform of a previous readout
+        if (not _waveforms[i].copy(*_events[i])) {
+            return {CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidEvent, i};
+        }
     }
+
+    return {err_code, end};
+}
+
+template<typename T, size_t N>
+std::pair<CAEN_DGTZ_ErrorCode, uint32_t> CAEN<T, N>::_decode_range_native(
+        const uint32_t& begin, const uint32_t& end) noexcept {
+    CAEN_DGTZ_EventInfo_t info;
+    for (uint32_t i = begin; i < end; i++) {
+        const uint32_t offset = _event_offsets[i];
+        auto waveform = _waveforms[i];
+        auto err_code = X740::decode_event(_current_data->Buffer + offset,
+                                           _current_data->DataSize - offset,
+                                           waveform.getEnabledChannels(),
+                                           waveform.getRecordLength(),
+                                           waveform.getData(),
+                                           info);
+        if (err_code != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+            return {err_code, i};
+        }
+
+        waveform.setInfo(info);
+    }
+
+    return {CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success, end};
+}
+
+template<typename T, size_t N>
+uint32_t CAEN<T, N>::VerifyNativeDecode() noexcept {
+    if (_has_error or not _is_connected or Family != CAENDigitizerFamilies::x740) {
+        return 0;
+    }
+
+    const uint32_t n_events = std::min<std::size_t>(_current_data->NumEvents,
+                                                    _waveforms.capacity());
+    _waveforms.resize(n_events);
+    auto result = _decode_range(0, n_events);
+    _err_code = result.first;
+    _print_if_err("CAEN_DGTZ_GetEventInfo/CAEN_DGTZ_DecodeEvent",
+                  __FUNCTION__,
+                  "at event " + std::to_string(result.second));
+    if (_has_error) {
+        return 0;
+    }
+
+    _err_code = X740::index_events(_current_data->Buffer,
+                                   _current_data->DataSize,
+                                   _event_offsets);
+    _print_if_err("X740::index_events", __FUNCTION__);
+    if (_has_error) {
+        return 0;
+    }
+
+    uint32_t mismatches = 0;
+    CAEN_DGTZ_EventInfo_t info;
+    for (uint32_t i = 0; i < std::min<std::size_t>(n_events, _event_offsets.size()); i++) {
+        auto waveform = _waveforms[i];
+        const auto& en_chs = waveform.getEnabledChannels();
+        const auto& rl = waveform.getRecordLength();
+        auto err_code = X740::decode_event(
+            _current_data->Buffer + _event_offsets[i],
+            _current_data->DataSize - _event_offsets[i],
+            en_chs, rl, waveform.getData(), info);
+
+        const auto* data = _events[i]->getData();
+        const auto& caen_info = _events[i]->getInfo();
+        bool same = err_code == CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success
+            and info.EventCounter == caen_info.EventCounter
+            and info.TriggerTimeTag == caen_info.TriggerTimeTag
+            and info.Pattern == caen_info.Pattern
+            and info.ChannelMask == caen_info.ChannelMask;
+
+        auto native = waveform.getData();
+        for (std::size_t row = 0; same and row < en_chs.size(); row++) {
+            const auto& ch = en_chs[row];
+            same = data->ChSize[ch] == rl and std::equal(
+                native.begin() + row*rl, native.begin() + (row + 1)*rl,
+                data->DataChannel[ch]);
+        }
+
+        if (not same) {
+            if (mismatches == 0) {
+                _logger->warn("Native x740 decoding differs from the CAEN "
+                              "API at event {}", i);
+            }
+            mismatches++;
+        }
+    }
+
+    if (_event_offsets.size() != n_events) {
+        _logger->warn("Native x740 decoding found {} events while the CAEN "
+                      "API found {}", _event_offsets.size(), n_events);
+        mismatches += std::max<std::size_t>(n_events, _event_offsets.size())
+            - std::min<std::size_t>(n_events, _event_offsets.size());
+    }
+
+    return mismatches;
 }
 
 template<typename T, size_t N>
 void CAEN<T, N>::ClearData() noexcept {
+    StopReadoutRing();
+
     if (_has_error or not _is_connected) {
         return;
     }
@@ -1474,6 +2501,230 @@ void CAEN<T, N>::ClearData() noexcept {
     _print_if_err("CAEN_DGTZ_SWStartAcquisition", __FUNCTION__);
 }
 
+template<typename T, size_t N>
+void CAEN<T, N>::StartReadoutRing(const CAENReadoutConfig& config) noexcept {
+    if (_has_error or not _is_connected or not _is_acquiring) {
+        return;
+    }
+
+    StopReadoutRing();
+    if (config.NumBuffers == 0) {
+        return;
+    }
+
+    _readout_config = config;
+    // Adaptive: starts at half the buffer until SetReadoutThreshold is called
+    if (_readout_config.MinEventsPerTransfer == 0) {
+        _readout_config.MinEventsPerTransfer
+            = std::max(1u, _current_max_buffers / 2);
+    }
+
+    _readout_config.MinEventsPerTransfer = std::min(
+        _readout_config.MinEventsPerTransfer, _current_max_buffers);
+
+    for (uint32_t i = 0; i < config.NumBuffers; i++) {
+        _readout_ring.push_back(std::make_unique<CAENData>(_logger,
+                                                           _caen_api_handle));
+        _err_code = _readout_ring.back()->getError();
+        _print_if_err("CAENData", __FUNCTION__);
+        _free_readout_buffers.enqueue(_readout_ring.back().get());
+    }
+
+    if (_has_error) {
+        StopReadoutRing();
+        return;
+    }
+
+    _readout_overruns = 0;
+    _readout_transfers = 0;
+    _readout_bytes = 0;
+    _readout_err_code = CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success;
+    _readout_stop = false;
+    SetReadoutThreshold(_readout_config.MinEventsPerTransfer);
+    if (config.UseInterrupts) {
+        EnableInterrupts(_readout_config.MinEventsPerTransfer);
+    }
+    _readout_thread = std::thread(&CAEN<T, N>::_readout_loop, this);
+}
+
+template<typename T, size_t N>
+void CAEN<T, N>::StopReadoutRing() noexcept {
+    if (_readout_thread.joinable()) {
+        _readout_stop = true;
+        _readout_thread.join();
+    }
+
+    DisableInterrupts();
+
+    CAENData* tmp = nullptr;
+    while (_free_readout_buffers.try_dequeue(tmp)) { }
+    while (_filled_readout_buffers.try_dequeue(tmp)) { }
+    _held_readout_buffer = nullptr;
+    _readout_ring.clear();
+    _current_data = _caen_raw_data.get();
+}
+
+template<typename T, size_t N>
+bool CAEN<T, N>::RetrieveReadoutBlock(
+        const std::chrono::milliseconds& timeout) noexcept {
+    if (_has_error or not IsReadoutRingRunning()) {
+        return false;
+    }
+
+    // The previous block is not needed anymore
+    if (_held_readout_buffer) {
+        _free_readout_buffers.enqueue(_held_readout_buffer);
+        _held_readout_buffer = nullptr;
+        _current_data = _caen_raw_data.get();
+        _current_data->NumEvents = 0;
+    }
+
+    _err_code = _readout_err_code.load();
+    if (_err_code != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+        _print_if_err("CAEN_DGTZ_ReadData", __FUNCTION__,
+                      "Error in the readout thread.");
+        return false;
+    }
+
+    if (not _filled_readout_buffers.wait_dequeue_timed(_held_readout_buffer,
+                                                       timeout)) {
+        return false;
+    }
+
+    _current_data = _held_readout_buffer;
+    return true;
+}
+
+template<typename T, size_t N>
+void CAEN<T, N>::_readout_loop() noexcept {
+    const auto max_latency = std::chrono::milliseconds(_readout_config.MaxLatency);
+    // The thread only reports errors through _readout_err_code because
+    // _err_code belongs to the other thread
+    CAEN_DGTZ_ErrorCode err_code = CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success;
+
+    CAENData* buffer = nullptr;
+    while (not _readout_stop) {
+        if (not buffer) {
+            if (not _free_readout_buffers.try_dequeue(buffer)) {
+                _readout_overruns++;
+                while (not _readout_stop and not _free_readout_buffers
+                        .wait_dequeue_timed(buffer, std::chrono::milliseconds(10))) { }
+                continue;
+            }
+        }
+
+        const uint32_t min_events = _readout_min_events;
+        if (min_events != _readout_config.MinEventsPerTransfer) {
+            _readout_config.MinEventsPerTransfer = min_events;
+            if (_event_waiter.interruptsEnabled()) {
+                std::lock_guard lock(_link_mutex);
+                err_code = _event_waiter.enableInterrupts(_caen_api_handle,
+                    static_cast<uint16_t>(std::min<uint32_t>(min_events, 0xFFFF)));
+                if (err_code != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+                    break;
+                }
+            }
+        }
+
+        // Waits up to MaxLatency for MinEventsPerTransfer events. Whatever
+        // arrived by then is read, so no event waits longer than that.
+        uint32_t events = 0;
+        err_code = _event_waiter.wait(_caen_api_handle,
+            min_events, max_latency,
+            [&](uint32_t& n) { return _read_events_in_buffer(n); }, events);
+        if (err_code != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+            break;
+        }
+
+        if (events == 0) {
+            continue;
+        }
+
+        {
+            std::lock_guard lock(_link_mutex);
+            // UNSAFE CODE AHEAD
+            err_code = CAEN_DGTZ_ReadData(_caen_api_handle,
+                CAEN_DGTZ_ReadMode_t::CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT,
+                buffer->Buffer,
+                &buffer->DataSize);
+        }
+
+        if (err_code != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+            break;
+        }
+
+        err_code = CAEN_DGTZ_GetNumEvents(_caen_api_handle,
+                                          buffer->Buffer,
+                                          buffer->DataSize,
+                                          &buffer->NumEvents);
+        // END OF UNSAFE CODE
+        if (err_code != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+            break;
+        }
+
+        if (buffer->NumEvents > 0) {
+            _readout_transfers++;
+            _readout_bytes += buffer->DataSize;
+            _filled_readout_buffers.enqueue(buffer);
+            buffer = nullptr;
+        }
+    }
+
+    // The buffer it held is not put back: only the thread that calls
+    // RetrieveReadoutBlock produces into _free_readout_buffers. It still
+    // belongs to _readout_ring, which StopReadoutRing clears.
+    _readout_err_code = err_code;
+}
+
+template<typename T, size_t N>
+void CAEN<T, N>::EnableInterrupts(const uint32_t& n_events) noexcept {
+    if (_has_error or not _is_connected) {
+        return;
+    }
+
+    // The API only takes up to 16 bits of events
+    const auto n = static_cast<uint16_t>(std::min<uint32_t>(n_events, 0xFFFF));
+    {
+        std::lock_guard lock(_link_mutex);
+        _err_code = _event_waiter.enableInterrupts(_caen_api_handle, n);
+    }
+    // Not fatal: waiting falls back to polling
+    if (_err_code != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+        _logger->warn("Failed to enable interrupts with error: {}. "
+                      "Polling the digitizer instead.",
+                      translate_caen_error_code(_err_code));
+        _err_code = CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success;
+    }
+}
+
+template<typename T, size_t N>
+void CAEN<T, N>::DisableInterrupts() noexcept {
+    if (not _is_connected or not _event_waiter.interruptsEnabled()) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(_link_mutex);
+        _err_code = _event_waiter.disableInterrupts(_caen_api_handle);
+    }
+    _print_if_err("CAEN_DGTZ_SetInterruptConfig", __FUNCTION__);
+}
+
+template<typename T, size_t N>
+bool CAEN<T, N>::WaitForEvents(const uint32_t& n,
+        const std::chrono::milliseconds& timeout) noexcept {
+    if (_has_error or not _is_connected or not _is_acquiring) {
+        return false;
+    }
+
+    uint32_t events = 0;
+    _err_code = _event_waiter.wait(_caen_api_handle, n, timeout,
+        [&](uint32_t& e) { return _read_events_in_buffer(e); }, events);
+    _print_if_err("CAEN_DGTZ_IRQWait/CAEN_DGTZ_ReadRegister", __FUNCTION__);
+
+    return not _has_error and events >= n;
+}
+
 /// End Data Acquisition functions
 //
 /// Mathematical functions
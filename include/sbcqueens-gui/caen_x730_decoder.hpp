@@ -0,0 +1,48 @@
+#ifndef CAENX730DECODER_H
+#define CAENX730DECODER_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <cstdint>
+#include <span>
+
+// C++ 3rd party includes
+#include <CAENDigitizer.h>
+
+// my includes
+
+// In-house decoder of the x730 family (DT5730B) standard event format,
+// without zero suppression. Same idea as the x740 decoder: the samples go
+// straight from the readout buffer to a channel-major array.
+//
+// The header is the same 4 words as the x740 one, with the channel mask
+// in place of the group mask (word 1 [7:0], channels 0-7), so
+// X740::parse_header and X740::index_events work for both families.
+// Then the data of every channel in the mask, in order, all of the same
+// size. Every word holds 2 consecutive 14-bit samples: the first at
+// [13:0] and the second at [29:16].
+namespace SBCQueens::X730 {
+
+constexpr uint32_t kHeaderWords = 4;
+constexpr uint32_t kMaxChannels = 8;
+constexpr uint32_t kSamplesPerWord = 2;
+
+// Decodes the event that starts at buffer. Only the channels in en_chs
+// (ascending CAEN channel numbers) are written to out, as en_chs.size()
+// rows of record_length samples.
+//
+// Returns the same as X740::decode_event: CAEN_DGTZ_InvalidEvent if the
+// event is corrupted or does not have record_length samples, and
+// CAEN_DGTZ_InvalidParam if out is too small.
+CAEN_DGTZ_ErrorCode decode_event(const char* buffer,
+                                 const uint32_t& size_in_bytes,
+                                 std::span<const std::size_t> en_chs,
+                                 const uint32_t& record_length,
+                                 std::span<uint16_t> out,
+                                 CAEN_DGTZ_EventInfo_t& info) noexcept;
+
+}  // namespace SBCQueens::X730
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef CAENX740DECODER_H
+#define CAENX740DECODER_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// C++ 3rd party includes
+#include <CAENDigitizer.h>
+
+// my includes
+
+// In-house decoder of the x740 family (DT5740D, V1740D) standard event
+// format. It reads the events straight from the readout buffer and unpacks
+// the samples into a channel-major array, the same layout as
+// CAENWaveforms, instead of CAEN_DGTZ_DecodeEvent + CAENWaveforms::copy.
+//
+// Event format (all words are 32-bit little endian):
+//  word 0: [31:28] = 0xA, [27:0] event size in words, header included
+//  word 1: [31:27] board id, [26] board fail, [23:8] pattern,
+//          [7:0] group mask
+//  word 2: [23:0] event counter
+//  word 3: trigger time tag
+// Then the data of every group in the mask, in order, all of the same size.
+// Within a group the 12-bit samples come in blocks of 3 words that hold 8
+// consecutive samples of one channel (sample k is at bits [12k + 11, 12k]
+// of the 96 bits). The blocks go CH0 S0-S7, CH1 S0-S7, ..., CH7 S0-S7,
+// CH0 S8-S15...
+namespace SBCQueens::X740 {
+
+constexpr uint32_t kHeaderWords = 4;
+constexpr uint32_t kChannelsPerGroup = 8;
+constexpr uint32_t kMaxGroups = 8;
+constexpr uint32_t kSamplesPerBlock = 8;
+constexpr uint32_t kWordsPerBlock = 3;
+
+// Instruction sets the unpacking can use. Auto picks the best the CPU
+// supports.
+enum class SIMDLevel {
+    Auto, Scalar, SSE41, AVX2
+};
+
+// Best level supported by this CPU and build.
+SIMDLevel best_simd_level() noexcept;
+
+struct EventHeader {
+    // In words, header included
+    uint32_t Size = 0;
+    uint32_t BoardId = 0;
+    bool BoardFail = false;
+    uint32_t Pattern = 0;
+    uint32_t GroupMask = 0;
+    uint32_t EventCounter = 0;
+    uint32_t TriggerTimeTag = 0;
+
+    // Same values CAEN_DGTZ_GetEventInfo returns
+    [[nodiscard]] CAEN_DGTZ_EventInfo_t toEventInfo() const noexcept;
+};
+
+// Parses the header of the event that starts at buffer. Returns
+// CAEN_DGTZ_InvalidEvent if it is not an event header or the event does
+// not fit in size_in_bytes.
+CAEN_DGTZ_ErrorCode parse_header(const char* buffer,
+                                 const uint32_t& size_in_bytes,
+                                 EventHeader& header) noexcept;
+
+// Walks the readout buffer and fills offsets with the position, in bytes,
+// of each event. It is a lot cheaper than decoding, so it is meant to be
+// done serially before the events are split between threads.
+CAEN_DGTZ_ErrorCode index_events(const char* buffer,
+                                 const uint32_t& size_in_bytes,
+                                 std::vector<uint32_t>& offsets) noexcept;
+
+// Decodes the event that starts at buffer. Only the channels in en_chs
+// (ascending CAEN channel numbers, like CAENWaveforms::getEnabledChannels)
+// are written to out, as en_chs.size() rows of record_length samples.
+//
+// Returns CAEN_DGTZ_InvalidEvent if the event is corrupted or does not
+// have record_length samples, and CAEN_DGTZ_InvalidParam if out is too
+// small. In both cases out is left as it was, so it cannot be used, but
+// info is filled if the header could be read.
+CAEN_DGTZ_ErrorCode decode_event(const char* buffer,
+                                 const uint32_t& size_in_bytes,
+                                 std::span<const std::size_t> en_chs,
+                                 const uint32_t& record_length,
+                                 std::span<uint16_t> out,
+                                 CAEN_DGTZ_EventInfo_t& info,
+                                 const SIMDLevel& level = SIMDLevel::Auto) noexcept;
+
+}  // namespace SBCQueens::X740
+
+#endif
@@ -6,6 +6,7 @@
 // C STD includes
 // C 3rd party includes
 // C++ STD includes
+#include <cstdint>
 #include <vector>
 #include <exception>
 #include <fstream>
@@ -13,6 +14,7 @@
 #include <ios>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <filesystem>
 #include <utility>
@@ -224,5 +226,42 @@ struct SaveFileInfo {
 // A simplification of DataFile for logging.
 using LogFile = DataFile<SaveFileInfo>;
 
+// Read-only memory map of a whole file. The OS pages the file in
+// as it is accessed, so files larger than RAM can be mapped.
+// Throws std::runtime_error if the file cannot be opened or mapped.
+class MemoryMappedFile {
+    std::string _file_name;
+    const char* _data = nullptr;
+    std::size_t _size = 0;
+    // Platform specific handles (file descriptor or windows HANDLEs)
+    intptr_t _file_handle = -1;
+    intptr_t _map_handle = -1;
+
+    void _unmap() noexcept;
+
+ public:
+    explicit MemoryMappedFile(std::string_view file_name);
+    ~MemoryMappedFile();
+
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+    MemoryMappedFile(MemoryMappedFile&& other) noexcept;
+    MemoryMappedFile& operator=(MemoryMappedFile&& other) noexcept;
+
+    [[nodiscard]] const char* data() const noexcept { return _data; }
+    [[nodiscard]] const std::size_t& size() const noexcept { return _size; }
+    [[nodiscard]] const std::string& name() const noexcept {
+        return _file_name;
+    }
+
+    // Tells the OS the whole mapping is going to be read sequentially
+    // so it can read ahead more aggressively. Only a hint.
+    void adviseSequential() const noexcept;
+    // Tells the OS the bytes in [offset, offset + length) are not needed
+    // anymore and their pages can be dropped. They are paged in again
+    // if accessed later. Only a hint.
+    void release(std::size_t offset, std::size_t length) const noexcept;
+};
+
 }  // namespace SBCQueens
 #endif
@@ -60,8 +60,9 @@ constexpr static auto SiPMGUIControls = std::make_tuple(
             .Size = {0, 50}
         }},
     SiPMAcquisitionControl<ControlTypes::Button, "Reset##CAEN">{"",
-        "Resets the CAEN digitizer with new values found in the "
-        "control tabs.",
+        "Applies the values found in the control tabs to the CAEN "
+        "digitizer. Only the changed settings are written, unless the "
+        "record length, events per read or enabled channels changed.",
         DrawingOptions{
             .Color = HSV(0.62f, 0.71f, 0.86f),
             .HoveredColor = HSV(0.62f, 0.80f, 0.96f),
@@ -90,13 +91,31 @@ constexpr static auto SiPMGUIControls = std::make_tuple(
                     .Size = {100, 50}
             }},
     SiPMAcquisitionControl<ControlTypes::Button, "STOP##CAEN">{"",
-            "Cancels any ongoing measurement routine.",
+            "Cancels any ongoing measurement routine and the queued runs.",
             DrawingOptions{
                    .Color = HSV(0.f, 0.8f, 0.5f),
                    .HoveredColor = HSV(0.f, 0.4, 0.7f),
                    .ActiveColor = HSV(0.f, 0.8f, 0.2f),
                    .Size = {100, 50}
             }},
+    SiPMAcquisitionControl<ControlTypes::Button, "RUN##CAEN">{"",
+            "Takes RunWaveforms waveforms (see gui_setup.toml) into "
+            "{SiPM Output File Name}_run{number}.bin and stops. Runs started "
+            "while another is going on are taken after it.",
+            DrawingOptions{
+                    .Color = HSV(118.f, 0.4f, 0.5f),
+                    .HoveredColor = HSV(118.f, 0.4, 0.7f),
+                    .ActiveColor = HSV(118.f, 0.4f, 0.2f),
+                    .Size = {100, 50}
+            }},
+    SiPMAcquisitionControl<ControlTypes::Button, "GAIN RUN##CAEN">{"",
+            "Same as RUN but takes GainWaveforms waveforms.",
+            DrawingOptions{
+                    .Color = HSV(118.f, 0.4f, 0.5f),
+                    .HoveredColor = HSV(118.f, 0.4, 0.7f),
+                    .ActiveColor = HSV(118.f, 0.4f, 0.2f),
+                    .Size = {100, 50}
+            }},
 
     // Per Group config controls
     SiPMAcquisitionControl<ControlTypes::InputUINT8, "Group to modify">{"",
@@ -53,6 +53,21 @@ constexpr static auto SiPMGUIIndicators = std::make_tuple(
     NumericalIndicator<"Max Possible Events in Buffer">("Events", ""),
 	NumericalIndicator<"Events in buffer">("Events", ""),
 	NumericalIndicator<"Trigger Rate">("Waveforms / s", ""),
+	NumericalIndicator<"Writer Queue Depth">("Batches", ""),
+	NumericalIndicator<"Writer Stall Time">("ms", ""),
+	NumericalIndicator<"Writer Rate">("MB / s", "",
+        DrawingOptions{.Format = "%.2f"}),
+	NumericalIndicator<"Readout Ring Occupancy">("Buffers", ""),
+	NumericalIndicator<"Readout Ring Overruns">("", ""),
+	NumericalIndicator<"Readout Threshold">("Events", ""),
+	NumericalIndicator<"Queued Runs">("Runs", ""),
+	NumericalIndicator<"Run Rate">("Waveforms / s", ""),
+	NumericalIndicator<"Run Livetime">("%", "",
+        DrawingOptions{.Format = "%.2f"}),
+	NumericalIndicator<"Reconfiguration Time">("ms", "",
+        DrawingOptions{.Format = "%.1f"}),
+	NumericalIndicator<"Board Rate">("Waveforms / s", ""),
+	NumericalIndicator<"Merge Backlog">("Waveforms", ""),
 	NumericalIndicator<"1SPE Gain Mean">("arb.", ""),
 
 	// CAEN model indicators
@@ -5,12 +5,19 @@
 // C STD includes
 // C 3rd party includes
 // C++ std includes
+#include <deque>
+#include <vector>
+
 // C++ 3rd party includes
 
 // my includes
 #include "sbcqueens-gui/multithreading_helpers/Pipe.hpp"
 
 #include "sbcqueens-gui/caen_helper.hpp"
+#include "sbcqueens-gui/sipm_helpers/Checksum.hpp"
+#include "sbcqueens-gui/sipm_helpers/ChunkCompression.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCRunManifest.hpp"
+#include "sbcqueens-gui/sipm_helpers/SiPMEventBuilder.hpp"
 #include "sbcqueens-gui/implot_helpers.hpp"
 
 namespace SBCQueens {
@@ -66,11 +73,39 @@ struct SiPMAcquisitionData {
     CAENDigitizerModelConstants ModelConstants;
     CAENGlobalConfig GlobalConfig;
     std::array<CAENGroupConfig, 8> GroupConfigs;
+    CAENReadoutConfig ReadoutConfig;
 
     int PortNum = 0;
     uint32_t VMEAddress = 0;
+    // Boards of the chain on PortNum, all with the same configuration.
+    // With more than one, endless acquisition merges their waveforms into
+    // a single file, see SiPMEventBuilder
+    std::vector<int> ConetNodes = {0};
+    EventBuilderOptions EventBuilder;
 
     std::string SiPMOutputName = "";
+    BinaryFormat::CompressionOptions FileCompression;
+    // Events between entries of the SiPM file index. 0 = no index
+    uint32_t FileIndexStride = 1000;
+    // When the SiPM file is split in a new segment. Disabled by default
+    BinaryFormat::RolloverOptions FileRollover;
+    BinaryFormat::ChecksumOptions FileChecksums;
+    // Endless acquisition saves the readout blocks without decoding them,
+    // see BinaryFormat::RawDumpWriter
+    bool FileRawDump = false;
+    // If not empty, this raw dump is played back instead of connecting to
+    // the digitizer, see BinaryFormat::RawDumpReplay
+    std::string ReplayFile = "";
+    // 1 = at the cadence it was recorded, 0 = as fast as possible
+    double ReplaySpeed = 0.0;
+    // Times the dump is played, 0 = until stopped
+    uint32_t ReplayLoops = 1;
+    // Waveforms of the numbered runs still to take, in order. The front
+    // one is taken during NumberedAcquisition
+    std::deque<uint32_t> NumberedRuns;
+    // Memory numbered runs hold waveforms in while they are written, in MB.
+    // Runs that fit are taken at the digitizer rate whatever the disk speed
+    uint32_t NumberedRunBufferMB = 1024;
     SiPMAcquisitionManagerStates CurrentState = SiPMAcquisitionManagerStates::Standby;
     SiPMAcquisitionStates AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
 
@@ -100,6 +135,25 @@ struct SiPMAcquisitionData {
     uint32_t MaxPossibleBuffers = 0;
     uint32_t FileStatistics = 0;
     double TriggeredRate = 0;
+    // File writer thread
+    std::size_t WriterQueueDepth = 0;
+    double WriterStallTime = 0.0;  // ms
+    double WriterBytesPerSecond = 0.0;
+    // Readout ring
+    uint32_t ReadoutRingOccupancy = 0;
+    uint64_t ReadoutRingOverruns = 0;
+    // Events waited for before a readout
+    uint32_t ReadoutThreshold = 0;
+    // Of the latest numbered run: waveforms saved per second of run and
+    // the fraction of the run the digitizer could take triggers
+    double NumberedRunRate = 0.0;
+    double NumberedRunLivetime = 0.0;
+    // Of the latest Reset, in ms
+    double ReconfigurationTime = 0.0;
+    // Waveforms per second of every board of ConetNodes and the ones
+    // waiting to be merged, when there is more than one
+    std::vector<double> BoardRates;
+    uint64_t MergeBacklog = 0;
     CAEN_DGTZ_BoardInfo_t CAENBoardInfo;
 
     // Shared plot data
@@ -8,13 +8,16 @@
 // C 3rd party includes
 // C++ std includes
 #include <array>
+#include <atomic>
 #include <vector>
 #include <tuple>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <numeric>
+#include <span>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <chrono>
 #include <random>
@@ -44,6 +47,9 @@
 #include "sbcqueens-gui/hardware_helpers/Calibration.hpp"
 
 #include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCRawDump.hpp"
+#include "sbcqueens-gui/sipm_helpers/SiPMAsyncWriter.hpp"
+#include "sbcqueens-gui/sipm_helpers/SiPMEventBuilder.hpp"
 
 // #include "sbcqueens-gui/sipm_helpers/BreakDownRoutine.hpp"
 // #include "sbcqueens-gui/sipm_helpers/AcquisitionRoutine.hpp"
@@ -68,11 +74,45 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
     using SiPMCAEN = CAEN<std::shared_ptr<spdlog::logger>>;
     using SiPMCAEN_ptr = std::unique_ptr<SiPMCAEN>;
 
-    using SiPMCAENFile_ptr = std::unique_ptr<BinaryFormat::SiPMDynamicWriter>;
+    using SiPMCAENFile_ptr = std::unique_ptr<BinaryFormat::SiPMAsyncWriter>;
     SiPMCAENFile_ptr _caen_file = nullptr;
-
-    using SiPMWaveforms_ptr = std::shared_ptr<CAENWaveforms<uint16_t>>;
-    std::vector<SiPMWaveforms_ptr> _waveforms;
+    // Used instead of _caen_file when FileRawDump is set
+    std::unique_ptr<BinaryFormat::RawDumpWriter> _raw_dump = nullptr;
+    // Events to wait for before a readout during acquisition_endless
+    CAENReadoutThreshold _readout_threshold;
+
+    // The boards of ConetNodes after the first one, which is the one the
+    // acquisition modes pass around. They take the same settings.
+    std::vector<SiPMCAEN_ptr> _chained_boards;
+    // acquisition_merged reads every board from its own thread and
+    // merges their waveforms with _event_builder
+    std::unique_ptr<SiPMEventBuilder> _event_builder;
+    std::vector<std::thread> _board_threads;
+    std::atomic<bool> _stop_boards = false;
+    // Board threads that returned
+    std::atomic<std::size_t> _finished_boards = 0;
+    // Set by a board thread whose digitizer has an error
+    std::atomic<bool> _board_error = false;
+    // Software triggers asked for, every board thread sends each of them
+    std::atomic<uint32_t> _board_software_triggers = 0;
+    // Filled by the builder, submitted once it has waveforms
+    BinaryFormat::SiPMWaveformBatch_ptr _merged_batch;
+    std::vector<uint64_t> _last_board_events;
+    std::chrono::steady_clock::time_point _board_rates_time;
+
+    // The run acquisition_numbered is taking
+    struct NumberedRun {
+        uint32_t Target = 0;
+        uint32_t Saved = 0;
+        // Triggers the digitizer had since the run started, taken or not,
+        // from its event counter
+        uint64_t Triggers = 0;
+        uint32_t LastCounter = 0;
+        std::chrono::steady_clock::time_point Start;
+        // Filled with the events of the readouts, submitted once full
+        BinaryFormat::SiPMWaveformBatch_ptr Batch;
+    };
+    std::optional<NumberedRun> _numbered_run;
 
     // Files
     std::string _run_name;
@@ -93,9 +133,6 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
     double _reset_timer = 0;
     uint16_t* _data = nullptr;
     size_t _length = 0;
-    const CAENEvent* _osc_event = nullptr;
-    // 1024 because the caen can only hold 1024 no matter what model (so far)
-    std::array<const CAENEvent*, 1024> _processing_evts = {nullptr};
 
     // Analysis
     // std::unique_ptr<BreakdownRoutine> _vbd_routine = nullptr;
@@ -333,8 +370,13 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
     }
 
     bool acquisition() {
+        if (not _doe.ReplayFile.empty()) {
+            replay();
+            return true;
+        }
+
         auto caen_res = attempt_connection();
-        if (caen_res->HasError()) {
+        if (not caen_res or caen_res->HasError()) {
             caen_res.reset();
             change_state();
             return true;
@@ -351,27 +393,30 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
             switch(_doe.AcquisitionState) {
                 case SiPMAcquisitionStates::Oscilloscope:
                     main_loop_state->ChangeWaitTime(std::chrono::milliseconds(200));
-                    if(_caen_file) {
-                        _caen_file.reset();
-                    }
-
+                    close_files(caen_res);
                     caen_res = oscilloscope(std::move(caen_res));
                     break;
 
                 case SiPMAcquisitionStates::EndlessAcquisition:
                     main_loop_state->ChangeWaitTime(std::chrono::milliseconds(1));
-                    caen_res = acquisition_endless(std::move(caen_res));
+                    if (_doe.FileRawDump) {
+                        caen_res = acquisition_raw_dump(std::move(caen_res));
+                    } else if (not _chained_boards.empty()) {
+                        caen_res = acquisition_merged(std::move(caen_res));
+                    } else {
+                        caen_res = acquisition_endless(std::move(caen_res));
+                    }
                     break;
 
                 case SiPMAcquisitionStates::NumberedAcquisition:
+                    main_loop_state->ChangeWaitTime(std::chrono::milliseconds(1));
+                    caen_res = acquisition_numbered(std::move(caen_res));
                     break;
 
                 // Resets the setup information without freeing the CAEN resource
                 case SiPMAcquisitionStates::Reset:
-                    if(_caen_file) {
-                        _caen_file.reset();
-                    }
-                    caen_res = setup_and_prepare(std::move(caen_res));
+                    close_files(caen_res);
+                    caen_res = reconfigure(std::move(caen_res));
                     break;
             }
 
@@ -384,20 +429,17 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
         }
 
         // Once we go out of scope, we release/disconnect the CAEN
+        close_files(caen_res);
         caen_res.reset();
-        _caen_file.reset();
+        _chained_boards.clear();
         return true;
     }
 
-    // Attempts a connection to the CAEN digitizer, setups the channels,
-    // starts acquisition, and moves to the oscilloscope mode
+    // Attempts a connection to the CAEN digitizers, setups the channels,
+    // starts acquisition, and moves to the oscilloscope mode. Returns the
+    // first board of ConetNodes, or nullptr if any of the others failed.
     SiPMCAEN_ptr attempt_connection() {
-        auto caen_port = std::make_unique<SiPMCAEN>(_logger,
-                                  _doe.Model,
-                                  _doe.ConnectionType,
-                                  _doe.PortNum,
-                                  0,
-                                  _doe.VMEAddress);
+        auto caen_port = make_board(_doe.ConetNodes.front());
 
         // If port resource was not created, it equals a failure!
         if (not caen_port->IsConnected()) {
@@ -405,7 +447,58 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
             return caen_port;
         }
 
-        return setup_and_prepare(std::move(caen_port));
+        caen_port = setup_and_prepare(std::move(caen_port));
+        if (caen_port->HasError()) {
+            return caen_port;
+        }
+
+        if (not connect_chained_boards()) {
+            _logger->error("Not all the boards of the chain could be set up.");
+            _chained_boards.clear();
+            switch_state(SiPMAcquisitionManagerStates::Standby);
+            return nullptr;
+        }
+
+        return caen_port;
+    }
+
+    SiPMCAEN_ptr make_board(const int& conet_node) {
+        return std::make_unique<SiPMCAEN>(_logger,
+                                          _doe.Model,
+                                          _doe.ConnectionType,
+                                          _doe.PortNum,
+                                          conet_node,
+                                          _doe.VMEAddress);
+    }
+
+    // Connects the rest of ConetNodes and sets them up as the first one,
+    // which has to be set up already. Returns false if any failed.
+    bool connect_chained_boards() {
+        _chained_boards.clear();
+        for (std::size_t b = 1; b < _doe.ConetNodes.size(); b++) {
+            auto board = make_board(_doe.ConetNodes[b]);
+            if (not board->IsConnected()) {
+                return false;
+            }
+
+            board->Setup(_doe.GlobalConfig, _doe.GroupConfigs);
+            board->EnableAcquisition();
+            if (board->HasError()) {
+                return false;
+            }
+
+            board->SetDecodeThreads(_doe.ReadoutConfig.DecodeThreads);
+            board->SetNativeDecode(_doe.ReadoutConfig.NativeDecode);
+            _chained_boards.push_back(std::move(board));
+        }
+
+        _doe.BoardRates.assign(_chained_boards.empty() ? 0
+                               : _chained_boards.size() + 1, 0.0);
+        if (not _chained_boards.empty()) {
+            _logger->info("{} boards set up on the chain.",
+                          _chained_boards.size() + 1);
+        }
+        return true;
     }
 
     SiPMCAEN_ptr setup_and_prepare(SiPMCAEN_ptr caen_port) {
@@ -421,15 +514,7 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
         _doe.GlobalConfig = caen_port->GetGlobalConfiguration();
         _doe.GroupConfigs = caen_port->GetGroupConfigurations();
 
-        // Initialize the plotting data
-        std::generate(_doe.GroupData.begin(), _doe.GroupData.end(), [&](){
-            return PlotDataBuffer<8>(_doe.GlobalConfig.RecordLength);
-        });
-
-        // Fill them up as by default they act like circular buffers
-        for(auto& data : _doe.GroupData) {
-            data.fill();
-        }
+        prepare_run();
 
         _num_chs = caen_port->ModelConstants.NumChannels;
         _acq_rate = caen_port->ModelConstants.AcquisitionRate;
@@ -442,16 +527,71 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
             return caen_port;
         }
 
-        // Given its a pointer _osc_event will always point to the first
-        // even in the buffer
-        _osc_event = caen_port->GetEvent(0);
+        caen_port->SetDecodeThreads(_doe.ReadoutConfig.DecodeThreads);
+        caen_port->SetNativeDecode(_doe.ReadoutConfig.NativeDecode);
+
+        _doe.MaxPossibleBuffers = caen_port->GetCurrentPossibleMaxBuffer();
+
+        _logger->info("CAEN Setup complete!");
+        _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+        return caen_port;
+    }
+
+    // Applies the GlobalConfig and GroupConfigs of the GUI writing only the
+    // settings that changed, see CAEN::Reconfigure. Only a change of the
+    // record length, events per read or enabled channels needs the whole
+    // setup and the memory allocated again.
+    SiPMCAEN_ptr reconfigure(SiPMCAEN_ptr caen_port) {
+        const auto start = std::chrono::steady_clock::now();
+        const auto diff = caen_port->Reconfigure(_doe.GlobalConfig,
+                                                 _doe.GroupConfigs);
+        if (caen_port->HasError()) {
+            switch_state(SiPMAcquisitionManagerStates::Standby);
+            return caen_port;
+        }
 
-        _waveforms.clear();
-        for(std::size_t i = 0; i < caen_port->GetCurrentPossibleMaxBuffer(); i++) {
-            _waveforms.push_back(caen_port->GetWaveform(i));
+        _doe.GlobalConfig = caen_port->GetGlobalConfiguration();
+        _doe.GroupConfigs = caen_port->GetGroupConfigurations();
+        for (auto& board : _chained_boards) {
+            board->Reconfigure(_doe.GlobalConfig, _doe.GroupConfigs);
+            if (board->HasError()) {
+                switch_state(SiPMAcquisitionManagerStates::Standby);
+                return caen_port;
+            }
         }
 
-        _doe.MaxPossibleBuffers = caen_port->GetCurrentPossibleMaxBuffer();
+        if (diff.NeedsReset) {
+            prepare_run();
+            _doe.CAENBoardInfo = caen_port->GetBoardInfo();
+            _doe.MaxPossibleBuffers = caen_port->GetCurrentPossibleMaxBuffer();
+        }
+
+        std::chrono::duration<double, std::milli> dt
+            = std::chrono::steady_clock::now() - start;
+        _doe.ReconfigurationTime = dt.count();
+        if (diff.NeedsReset) {
+            _logger->info("CAEN setup again in {:.1f} ms", dt.count());
+        } else {
+            _logger->info("CAEN reconfigured in {:.1f} ms ({} settings "
+                          "changed)", dt.count(), diff.size());
+        }
+
+        _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+        return caen_port;
+    }
+
+    // Makes the plots fit the current GlobalConfig and the directory of
+    // today's run
+    void prepare_run() {
+        // Initialize the plotting data
+        std::generate(_doe.GroupData.begin(), _doe.GroupData.end(), [&](){
+            return PlotDataBuffer<8>(_doe.GlobalConfig.RecordLength);
+        });
+
+        // Fill them up as by default they act like circular buffers
+        for(auto& data : _doe.GroupData) {
+            data.fill();
+        }
 
         // These lines get today's date and creates a folder under that date
         // There is a similar code in the Teensy interface file
@@ -463,10 +603,99 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
 
         std::filesystem::create_directory(_doe.RunDir
                                           + "/" + _run_name);
+    }
+
+    // Plays the raw dump ReplayFile back, instead of reading a digitizer,
+    // through the same decoding, plots and writer as acquisition_endless,
+    // until it ends or the GUI stops it. Then the throughput is logged and
+    // the manager goes back to standby.
+    void replay() {
+        BinaryFormat::RawReplayOptions options;
+        options.Speed = _doe.ReplaySpeed;
+        options.Loops = _doe.ReplayLoops;
+        options.NumThreads = _doe.ReadoutConfig.DecodeThreads;
+
+        std::unique_ptr<BinaryFormat::RawDumpReplay> source;
+        std::string file_name;
+        try {
+            source = std::make_unique<BinaryFormat::RawDumpReplay>(
+                _doe.ReplayFile, options);
+            const auto& config = source->config();
+            _doe.GlobalConfig = config.GlobalConfig;
+            _doe.GroupConfigs = config.GroupConfigs;
+            prepare_run();
+
+            // Never the file of the real acquisitions, nor an earlier replay
+            file_name = first_free_file_name("replay");
+            _caen_file = std::make_unique<BinaryFormat::SiPMAsyncWriter>(
+                    file_name,
+                    config.Family,
+                    source->modelConstants(),
+                    config.GlobalConfig,
+                    config.GroupConfigs,
+                    source->waveforms().capacity(),
+                    2,
+                    _doe.FileCompression,
+                    _doe.FileIndexStride,
+                    _doe.FileRollover,
+                    _doe.FileChecksums);
+        } catch(std::runtime_error& err) {
+            _logger->error("Replay of {} could not start with error: {}",
+                           _doe.ReplayFile, err.what());
+            _caen_file.reset();
+            switch_state(SiPMAcquisitionManagerStates::Standby);
+            return;
+        }
+
+        _logger->info("Replaying {} into {}", _doe.ReplayFile, file_name);
+        _doe.AcquisitionState = SiPMAcquisitionStates::EndlessAcquisition;
+        _doe.FileStatistics = 0;
+        const auto start = std::chrono::steady_clock::now();
+        while (not source->done()) {
+            if (_caen_file->hasError()) {
+                _logger->error("SiPM file writing failed with error: {}",
+                               _caen_file->getError());
+                break;
+            }
+
+            if (source->retrieve_block(std::chrono::milliseconds(10))
+                and source->decode()) {
+                auto n_events = source->num_events();
+                _doe.NumEventsInBuffer = n_events;
+                _doe.FileStatistics += n_events;
+                TriggeredWaveforms += n_events;
+
+                calculate_trigger_frequency();
+                if (not source->waveforms().empty()) {
+                    plot_waveform(source->waveform(0));
+                }
+
+                auto batch = _caen_file->acquire_batch();
+                source->swap_waveforms(batch->Waveforms);
+                _caen_file->submit(std::move(batch));
+            }
+
+            update_writer_statistics(_caen_file->getStatistics());
+            change_state();
+            if (_doe.CurrentState != SiPMAcquisitionManagerStates::Acquisition) {
+                break;
+            }
+        }
+
+        // Waits for the writer, so the time is until everything is saved
+        _caen_file.reset();
+        std::chrono::duration<double> dt
+            = std::chrono::steady_clock::now() - start;
+        const auto& stats = source->statistics();
+        _logger->info("Replayed {0} events ({1} blocks, {2} corrupted) in "
+                      "{3:.2f} s: {4:.0f} events/s, {5:.1f} MB/s read out. "
+                      "Latest lag {6:.3f} s.",
+                      stats.Events, stats.Blocks, stats.CorruptedBlocks,
+                      dt.count(), stats.Events / dt.count(),
+                      stats.Bytes / dt.count() / 1e6, stats.Lag);
 
-        _logger->info("CAEN Setup complete!");
         _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
-        return caen_port;
+        switch_state(SiPMAcquisitionManagerStates::Standby);
     }
 
     // While in this state it shares the data with the GUI but
@@ -500,7 +729,7 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
             // spdlog::info("Trigger Time Tag: {0}",
             //     _osc_event->Info.TriggerTimeTag);
 
-            process_data_for_gui();
+            process_data_for_gui(caen_port);
 
             // Clear events in buffer
             caen_port->ClearData();
@@ -512,49 +741,645 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
     SiPMCAEN_ptr acquisition_endless(SiPMCAEN_ptr caen_port) {
         if(not _caen_file) {
             try {
-                _caen_file = std::make_unique<BinaryFormat::SiPMDynamicWriter>(
+                _caen_file = std::make_unique<BinaryFormat::SiPMAsyncWriter>(
                         _doe.RunDir + "/" + _run_name + "/" + _doe.SiPMOutputName + ".bin",
                         caen_port->Family,
                         caen_port->ModelConstants,
                         caen_port->GetGlobalConfiguration(),
-                        caen_port->GetGroupConfigurations());
+                        caen_port->GetGroupConfigurations(),
+                        caen_port->GetWaveforms().capacity(),
+                        2,
+                        _doe.FileCompression,
+                        _doe.FileIndexStride,
+                        _doe.FileRollover,
+                        _doe.FileChecksums);
 
                 _doe.FileStatistics = 0;
+                start_readout(caen_port);
             } catch(std::runtime_error& err) {
-                if (not _caen_file->isOpen()) {
-                    _logger->error("SiPM file saving was not created with error: {}",
-                                   err.what());
-                    _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
-                    return caen_port;
-                }
+                _logger->error("SiPM file saving was not created with error: {}",
+                               err.what());
+                _caen_file.reset();
+                _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+                return caen_port;
             }
         }
 
+        if (_caen_file->hasError()) {
+            _logger->error("SiPM file writing failed with error: {}",
+                           _caen_file->getError());
+            _caen_file.reset();
+            _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+            return caen_port;
+        }
+
         software_trigger(caen_port);
 
-        if (caen_port->RetrieveDataUntilNEvents(0.5*caen_port->GetCurrentPossibleMaxBuffer())) {
+        const auto readout_start = std::chrono::steady_clock::now();
+        if (retrieve_block(caen_port)) {
             auto n_events = caen_port->GetNumberOfEvents();
             _doe.NumEventsInBuffer = n_events;
             _doe.FileStatistics += n_events;
             TriggeredWaveforms += n_events;
 
-            // This should update the values under _waveforms
+            // This should update the values under GetWaveforms()
             caen_port->DecodeEvents();
 
             // TODO(Any): here be the filtering/software threshold routine
 
-            std::for_each_n(_waveforms.begin(),
-                            n_events,
-                            [&](SiPMWaveforms_ptr& waveform) {
-                                _caen_file->save_waveform(waveform);
-                            }
-            );
-            process_data_for_gui();
+            // Before the waveforms are handed over
+            process_data_for_gui(caen_port);
+
+            // The waveforms are handed to the writer thread by swapping
+            // them with a free batch, so no copies are made.
+            // The digitizer overwrites the old ones during the next decode.
+            auto batch = _caen_file->acquire_batch();
+            caen_port->SwapWaveforms(batch->Waveforms);
+            _caen_file->submit(std::move(batch));
+            update_readout_threshold(caen_port,
+                std::chrono::steady_clock::now() - readout_start);
+        }
+
+        update_statistics(caen_port, _caen_file->getStatistics());
+        return caen_port;
+    }
+
+    // Same as acquisition_endless with the chained boards: every board is
+    // read and decoded by its own thread (read_board) and _event_builder
+    // merges their waveforms, in trigger time order, into
+    // {SiPMOutputName}.bin. The board of every waveform and where the
+    // built events start are in its trg_source, see SiPMEventBuilder.
+    SiPMCAEN_ptr acquisition_merged(SiPMCAEN_ptr caen_port) {
+        if (not _caen_file) {
+            const auto capacity = caen_port->GetWaveforms().capacity();
+            auto options = _doe.EventBuilder;
+            options.NumBatches = std::max<std::size_t>(options.NumBatches,
+                _doe.ReadoutConfig.NumBuffers);
+            try {
+                _caen_file = std::make_unique<BinaryFormat::SiPMAsyncWriter>(
+                        _doe.RunDir + "/" + _run_name + "/" + _doe.SiPMOutputName + ".bin",
+                        caen_port->Family,
+                        caen_port->ModelConstants,
+                        caen_port->GetGlobalConfiguration(),
+                        caen_port->GetGroupConfigurations(),
+                        capacity,
+                        2,
+                        _doe.FileCompression,
+                        _doe.FileIndexStride,
+                        _doe.FileRollover,
+                        _doe.FileChecksums);
+                _event_builder = std::make_unique<SiPMEventBuilder>(
+                        _chained_boards.size() + 1,
+                        caen_port->ModelConstants,
+                        caen_port->GetGlobalConfiguration(),
+                        caen_port->GetGroupConfigurations(),
+                        capacity,
+                        options);
+
+                _doe.FileStatistics = 0;
+                start_board_threads(caen_port);
+            } catch(std::runtime_error& err) {
+                _logger->error("SiPM file saving was not created with error: {}",
+                               err.what());
+                _caen_file.reset();
+                _event_builder.reset();
+                _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+                return caen_port;
+            }
+        }
+
+        if (_caen_file->hasError() or _board_error) {
+            if (_board_error) {
+                _logger->error("A digitizer of the chain failed, the "
+                               "acquisition is stopped.");
+            } else {
+                _logger->error("SiPM file writing failed with error: {}",
+                               _caen_file->getError());
+            }
+            close_files(caen_port);
+            _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+            return caen_port;
+        }
+
+        if (_doe.SoftwareTrigger) {
+            _logger->info("Sending a software trigger to every board");
+            _board_software_triggers++;
+            _doe.SoftwareTrigger = false;
+        }
+
+        if (not _merged_batch) {
+            _merged_batch = _caen_file->acquire_batch();
+        }
+
+        while (_event_builder->merge(_merged_batch->Waveforms) > 0) {
+            auto n_events = _merged_batch->Waveforms.size();
+            _doe.FileStatistics += n_events;
+            TriggeredWaveforms += n_events;
+            calculate_trigger_frequency();
+            plot_waveform(_merged_batch->Waveforms[0]);
+
+            _caen_file->submit(std::move(_merged_batch));
+            _merged_batch = _caen_file->acquire_batch();
+        }
+
+        update_merge_statistics();
+        update_writer_statistics(_caen_file->getStatistics());
+        return caen_port;
+    }
+
+    // Starts the readout ring and the thread of every board, caen_port
+    // being the first one. Their memory is cleared first, one after the
+    // other, so they start with the same backlog.
+    void start_board_threads(SiPMCAEN_ptr& caen_port) {
+        std::vector<SiPMCAEN*> boards = {caen_port.get()};
+        for (auto& board : _chained_boards) {
+            boards.push_back(board.get());
+        }
+
+        for (auto* board : boards) {
+            board->ResumeAcquisition();
+        }
+
+        // Every board needs its ring to be read by its own thread
+        auto readout_config = _doe.ReadoutConfig;
+        readout_config.NumBuffers = std::max(2u, readout_config.NumBuffers);
+        _stop_boards = false;
+        _finished_boards = 0;
+        _board_error = false;
+        _last_board_events.assign(boards.size(), 0);
+        _board_rates_time = std::chrono::steady_clock::now();
+        for (std::size_t b = 0; b < boards.size(); b++) {
+            boards[b]->StartReadoutRing(readout_config);
+            _board_threads.emplace_back(&SiPMAcquisitionManager::read_board,
+                                        this, boards[b], b);
+        }
+    }
+
+    // Thread of a board during acquisition_merged. Decodes its readouts
+    // and hands them over to _event_builder.
+    void read_board(SiPMCAEN* caen, const std::size_t board) {
+        uint32_t software_triggers = _board_software_triggers;
+        while (not _stop_boards) {
+            if (software_triggers != _board_software_triggers) {
+                software_triggers = _board_software_triggers;
+                caen->SoftwareTrigger();
+            }
+
+            if (caen->HasError()) {
+                _board_error = true;
+                break;
+            }
+
+            if (not caen->RetrieveReadoutBlock(std::chrono::milliseconds(10))) {
+                continue;
+            }
+
+            caen->DecodeEvents();
+            // Waits while the merge is behind by all its batches. Even if
+            // stopped, otherwise the readout would be lost: the merge goes
+            // on until every thread finished, see stop_board_threads.
+            BoardBatch_ptr batch;
+            while (not _event_builder->acquire_batch(board, batch,
+                    std::chrono::milliseconds(10))) { }
+
+            caen->SwapWaveforms(batch->Waveforms);
+            _event_builder->submit(board, std::move(batch));
+        }
+
+        _finished_boards++;
+    }
+
+    // Saves the waveforms the event builder can merge. With flush, all of
+    // them, once the boards stopped.
+    void save_merged(const bool& flush) {
+        while (true) {
+            if (not _merged_batch) {
+                _merged_batch = _caen_file->acquire_batch();
+            }
+
+            if (_event_builder->merge(_merged_batch->Waveforms, flush) == 0) {
+                return;
+            }
+
+            _doe.FileStatistics += _merged_batch->Waveforms.size();
+            _caen_file->submit(std::move(_merged_batch));
+        }
+    }
+
+    // Stops the board threads and saves what they had read
+    void stop_board_threads(SiPMCAEN_ptr& caen_port) {
+        _stop_boards = true;
+        // A thread can be waiting for the merge to free one of its batches
+        while (_finished_boards < _board_threads.size()) {
+            save_merged(false);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        for (auto& thread : _board_threads) {
+            thread.join();
+        }
+        _board_threads.clear();
+
+        caen_port->StopReadoutRing();
+        for (auto& board : _chained_boards) {
+            board->StopReadoutRing();
+        }
+
+        save_merged(true);
+        _merged_batch.reset();
+
+        const auto stats = _event_builder->getStatistics();
+        _logger->info("Merged {0} waveforms of {1} boards in {2} events. "
+                      "{3} waveforms without enough boards, {4} late.",
+                      stats.MergedEvents, stats.BoardEvents.size(),
+                      stats.BuiltEvents, stats.RejectedEvents,
+                      stats.LateEvents);
+        _event_builder.reset();
+        _doe.MergeBacklog = 0;
+    }
+
+    // The waveforms per second of every board, once a second, and the
+    // merge backlog
+    void update_merge_statistics() {
+        const auto stats = _event_builder->getStatistics();
+        _doe.MergeBacklog = stats.Backlog;
+
+        const auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> dt = now - _board_rates_time;
+        if (dt.count() < 1.0) {
+            return;
+        }
+
+        _doe.BoardRates.resize(stats.BoardEvents.size());
+        for (std::size_t b = 0; b < stats.BoardEvents.size(); b++) {
+            _doe.BoardRates[b] = static_cast<double>(
+                stats.BoardEvents[b] - _last_board_events[b]) / dt.count();
+            _last_board_events[b] = stats.BoardEvents[b];
+        }
+        _board_rates_time = now;
+    }
+
+    // Same as acquisition_endless but the readout blocks are saved as they
+    // come from the digitizer to {SiPMOutputName}.raw, without decoding
+    // them, for the highest rates. sbc-decode-raw turns the file into a
+    // SiPM file afterwards. Nothing is decoded so nothing is plotted.
+    SiPMCAEN_ptr acquisition_raw_dump(SiPMCAEN_ptr caen_port) {
+        if (not _raw_dump) {
+            try {
+                _raw_dump = std::make_unique<BinaryFormat::RawDumpWriter>(
+                        _doe.RunDir + "/" + _run_name + "/" + _doe.SiPMOutputName + ".raw",
+                        BinaryFormat::RawDumpConfig{caen_port->Model,
+                            caen_port->Family,
+                            caen_port->GetGlobalConfiguration(),
+                            caen_port->GetGroupConfigurations()},
+                        std::max<std::size_t>(4, _doe.ReadoutConfig.NumBuffers));
+
+                _doe.FileStatistics = 0;
+                start_readout(caen_port);
+                if (not _chained_boards.empty()) {
+                    _logger->warn("Raw dumps only take the first board of "
+                                  "the chain.");
+                }
+            } catch(std::runtime_error& err) {
+                _logger->error("SiPM raw dump was not created with error: {}",
+                               err.what());
+                _raw_dump.reset();
+                _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+                return caen_port;
+            }
+        }
+
+        if (_raw_dump->hasError()) {
+            _logger->error("SiPM raw dump writing failed with error: {}",
+                           _raw_dump->getError());
+            _raw_dump.reset();
+            _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+            return caen_port;
+        }
+
+        software_trigger(caen_port);
+
+        const auto readout_start = std::chrono::steady_clock::now();
+        if (retrieve_block(caen_port)) {
+            auto n_events = caen_port->GetNumberOfEvents();
+            _doe.NumEventsInBuffer = n_events;
+            _doe.FileStatistics += n_events;
+            TriggeredWaveforms += n_events;
+            calculate_trigger_frequency();
+
+            // Copied, as the readout buffer goes back to the digitizer
+            _raw_dump->save_block(caen_port->GetRawData(), n_events,
+                                  caen_port->GetBoardInfo());
+            update_readout_threshold(caen_port,
+                std::chrono::steady_clock::now() - readout_start);
+        }
+
+        update_statistics(caen_port, _raw_dump->getStatistics());
+        return caen_port;
+    }
+
+    // Takes exactly the waveforms at the front of NumberedRuns into
+    // {SiPMOutputName}_run{number}.bin, then the next run in the queue
+    // without reconnecting, and goes back to the oscilloscope once it is
+    // empty. The memory of the whole run (up to NumberedRunBufferMB) is
+    // allocated before it starts, so the readout does not wait for the
+    // disk, and the digitizer is stopped as soon as the last waveform is
+    // read. The events past it in the last readout are not saved.
+    SiPMCAEN_ptr acquisition_numbered(SiPMCAEN_ptr caen_port) {
+        if (not _numbered_run) {
+            start_numbered_run(caen_port);
+            return caen_port;
+        }
+
+        if (_caen_file->hasError()) {
+            _logger->error("SiPM file writing failed with error: {}",
+                           _caen_file->getError());
+            close_files(caen_port);
+            _doe.NumberedRuns.clear();
+            caen_port->ResumeAcquisition();
+            _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+            return caen_port;
+        }
+
+        software_trigger(caen_port);
+
+        const auto readout_start = std::chrono::steady_clock::now();
+        if (retrieve_block(caen_port)) {
+            auto& run = _numbered_run.value();
+            caen_port->DecodeEvents();
+            const auto& waveforms = caen_port->GetWaveforms();
+            const std::size_t n_events = std::min<std::size_t>(
+                waveforms.size(), run.Target - run.Saved);
+            count_triggers(run, waveforms.getInfos().first(n_events));
+
+            _doe.NumEventsInBuffer = caen_port->GetNumberOfEvents();
+            TriggeredWaveforms += n_events;
+            process_data_for_gui(caen_port);
+
+            std::size_t copied = 0;
+            while (copied < n_events) {
+                if (not run.Batch) {
+                    run.Batch = _caen_file->acquire_batch();
+                }
+
+                copied += run.Batch->Waveforms.append(waveforms, copied,
+                                                      n_events - copied);
+                if (run.Batch->Waveforms.size()
+                    == run.Batch->Waveforms.capacity()) {
+                    _caen_file->submit(std::move(run.Batch));
+                }
+            }
+
+            run.Saved += n_events;
+            _doe.FileStatistics = run.Saved;
+            update_readout_threshold(caen_port,
+                std::chrono::steady_clock::now() - readout_start);
         }
 
+        update_statistics(caen_port, _caen_file->getStatistics());
+        if (_numbered_run->Saved >= _numbered_run->Target) {
+            finish_numbered_run(caen_port);
+        }
         return caen_port;
     }
 
+    // The first {SiPMOutputName}_{kind}{number}.bin of the day that is not
+    // on disk, rolled over or not, so a run never appends to an earlier one
+    std::string first_free_file_name(std::string_view kind) const {
+        for (uint32_t number = 0; ; number++) {
+            auto file_name = fmt::format("{}/{}/{}_{}{:03}.bin",
+                _doe.RunDir, _run_name, _doe.SiPMOutputName, kind, number);
+            if (not std::filesystem::exists(file_name)
+                and not std::filesystem::exists(
+                    BinaryFormat::RunManifest::manifest_name(file_name))) {
+                return file_name;
+            }
+        }
+    }
+
+    // Opens the file of the run at the front of NumberedRuns and starts
+    // the digitizer with its memory cleared
+    void start_numbered_run(SiPMCAEN_ptr& caen_port) {
+        if (_doe.NumberedRuns.empty()) {
+            _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+            return;
+        }
+
+        const uint32_t target = _doe.NumberedRuns.front();
+        _doe.NumberedRuns.pop_front();
+        if (target == 0) {
+            return;
+        }
+
+        // The batches hold the whole run if it fits in NumberedRunBufferMB,
+        // otherwise they are recycled as they are written
+        const auto& waveforms = caen_port->GetWaveforms();
+        const std::size_t max_batch = std::max<std::size_t>(1,
+            std::min<std::size_t>(waveforms.capacity(), target));
+        std::size_t num_batches = (target + max_batch - 1) / max_batch;
+        const std::size_t batch_size = (target + num_batches - 1) / num_batches;
+        const double batch_mb = static_cast<double>(
+            batch_size*waveforms.getEventSize()*sizeof(uint16_t)) / 1e6;
+        const auto fitting_batches = batch_mb > 0.0
+            ? static_cast<std::size_t>(_doe.NumberedRunBufferMB / batch_mb)
+            : num_batches;
+        if (fitting_batches < num_batches) {
+            num_batches = std::max<std::size_t>(2, fitting_batches);
+            _logger->warn("A run of {} waveforms does not fit in {} MB, "
+                          "it is going to wait for the disk.", target,
+                          _doe.NumberedRunBufferMB);
+        }
+
+        const auto file_name = first_free_file_name("run");
+        try {
+            _caen_file = std::make_unique<BinaryFormat::SiPMAsyncWriter>(
+                    file_name,
+                    caen_port->Family,
+                    caen_port->ModelConstants,
+                    caen_port->GetGlobalConfiguration(),
+                    caen_port->GetGroupConfigurations(),
+                    batch_size,
+                    num_batches,
+                    _doe.FileCompression,
+                    _doe.FileIndexStride,
+                    _doe.FileRollover,
+                    _doe.FileChecksums);
+        } catch(std::runtime_error& err) {
+            _logger->error("SiPM file saving was not created with error: {}",
+                           err.what());
+            _caen_file.reset();
+            _doe.NumberedRuns.clear();
+            _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+            return;
+        }
+
+        _logger->info("Starting a run of {} waveforms into {}", target,
+                      file_name);
+        if (not _chained_boards.empty()) {
+            _logger->warn("Numbered runs only take the first board of the "
+                          "chain.");
+        }
+        _doe.FileStatistics = 0;
+        caen_port->ResumeAcquisition();
+        _numbered_run = NumberedRun{};
+        _numbered_run->Target = target;
+        _numbered_run->Start = std::chrono::steady_clock::now();
+        start_readout(caen_port);
+    }
+
+    // The event counter counts every trigger (see CAEN::Setup) so the
+    // gaps between events are the triggers lost while the memory was full
+    void count_triggers(NumberedRun& run,
+                        std::span<const CAEN_DGTZ_EventInfo_t> infos) {
+        for (const auto& info : infos) {
+            const uint32_t counter = info.EventCounter & 0x00FFFFFF;
+            // It starts at 0 with the acquisition and rolls over at 24 bits
+            run.Triggers += run.Triggers == 0 ? counter + 1
+                : (counter - run.LastCounter) & 0x00FFFFFF;
+            run.LastCounter = counter;
+        }
+    }
+
+    // Stops the digitizer, waits for the file and reports the run.
+    // Continues with the next run of the queue, if any.
+    void finish_numbered_run(SiPMCAEN_ptr& caen_port) {
+        caen_port->DisableAcquisition();
+        std::chrono::duration<double> dt
+            = std::chrono::steady_clock::now() - _numbered_run->Start;
+
+        auto& run = _numbered_run.value();
+        if (run.Batch) {
+            _caen_file->submit(std::move(run.Batch));
+        }
+        // Waits for the writer, so the run is saved when it returns
+        _caen_file.reset();
+
+        const double livetime = run.Triggers == 0 ? 1.0
+            : static_cast<double>(run.Saved) / run.Triggers;
+        _doe.NumberedRunRate = run.Saved / dt.count();
+        _doe.NumberedRunLivetime = 100.0*livetime;
+        _logger->info("Run of {0} waveforms taken in {1:.3f} s: {2:.0f} "
+                      "waveforms/s. {3} triggers, livetime {4:.3f} s "
+                      "({5:.1f}%).", run.Saved, dt.count(),
+                      _doe.NumberedRunRate, run.Triggers,
+                      livetime*dt.count(), _doe.NumberedRunLivetime);
+        _numbered_run.reset();
+
+        if (_doe.NumberedRuns.empty()) {
+            caen_port->ResumeAcquisition();
+            _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+        } else {
+            start_numbered_run(caen_port);
+        }
+    }
+
+    // Stops whichever file acquisition_endless, acquisition_merged,
+    // acquisition_raw_dump or acquisition_numbered were saving to
+    void close_files(SiPMCAEN_ptr& caen_port) {
+        if (_event_builder) {
+            stop_board_threads(caen_port);
+        }
+
+        if (_numbered_run) {
+            _logger->warn("Run stopped at {} of {} waveforms.",
+                          _numbered_run->Saved, _numbered_run->Target);
+            if (_numbered_run->Batch) {
+                _caen_file->submit(std::move(_numbered_run->Batch));
+            }
+            _numbered_run.reset();
+        }
+
+        if (_caen_file or _raw_dump) {
+            caen_port->StopReadoutRing();
+            _caen_file.reset();
+            _raw_dump.reset();
+        }
+    }
+
+    // Sets up the readout of acquisition_endless and acquisition_raw_dump
+    void start_readout(SiPMCAEN_ptr& caen_port) {
+        _readout_threshold = CAENReadoutThreshold(
+            std::chrono::milliseconds(_doe.ReadoutConfig.MaxLatency),
+            _doe.ReadoutConfig.MinBlockEvents,
+            caen_port->GetCurrentPossibleMaxBuffer());
+        // The readout thread keeps the digitizer buffer empty
+        // while the previous readout is being decoded and saved
+        caen_port->StartReadoutRing(_doe.ReadoutConfig);
+        if (not caen_port->IsReadoutRingRunning()
+            and _doe.ReadoutConfig.UseInterrupts) {
+            caen_port->EnableInterrupts(readout_threshold(caen_port));
+        }
+    }
+
+    // Returns true if there is a new readout block
+    bool retrieve_block(SiPMCAEN_ptr& caen_port) {
+        const uint32_t n = readout_threshold(caen_port);
+        if (caen_port->IsReadoutRingRunning()) {
+            return caen_port->RetrieveReadoutBlock(std::chrono::milliseconds(10));
+        }
+
+        if (caen_port->InterruptsEnabled()) {
+            // Sleeps until the digitizer has the events instead of
+            // asking for them every pass of the main loop
+            if (caen_port->WaitForEvents(n, std::chrono::milliseconds(10))
+                or _readout_threshold.isLate()) {
+                caen_port->RetrieveData();
+                return caen_port->GetNumberOfEvents() > 0;
+            }
+
+            return false;
+        }
+
+        // Past the max latency whatever is in the digitizer is read
+        return caen_port->RetrieveDataUntilNEvents(n)
+            or (_readout_threshold.isLate()
+                and caen_port->RetrieveDataUntilNEvents(1));
+    }
+
+    void update_statistics(SiPMCAEN_ptr& caen_port,
+                           const BinaryFormat::SiPMWriterStatistics& writer_stats) {
+        update_writer_statistics(writer_stats);
+
+        auto readout_stats = caen_port->GetReadoutStatistics();
+        _doe.ReadoutRingOccupancy = readout_stats.Occupancy;
+        _doe.ReadoutRingOverruns = readout_stats.Overruns;
+    }
+
+    void update_writer_statistics(
+            const BinaryFormat::SiPMWriterStatistics& writer_stats) {
+        _doe.WriterQueueDepth = writer_stats.QueueDepth;
+        _doe.WriterStallTime = writer_stats.StallTime;
+        _doe.WriterBytesPerSecond = writer_stats.BytesPerSecond;
+    }
+
+    // Fixed if ReadoutMinEvents is set, otherwise the adaptive threshold
+    uint32_t readout_threshold(SiPMCAEN_ptr& caen_port) {
+        if (_doe.ReadoutConfig.MinEventsPerTransfer > 0) {
+            return std::min(_doe.ReadoutConfig.MinEventsPerTransfer,
+                            caen_port->GetCurrentPossibleMaxBuffer());
+        }
+
+        return _readout_threshold.get();
+    }
+
+    void update_readout_threshold(SiPMCAEN_ptr& caen_port,
+                        const std::chrono::duration<double>& readout_time) {
+        _readout_threshold.update(_doe.TriggeredRate, readout_time);
+        const uint32_t old_threshold = _doe.ReadoutThreshold;
+        _doe.ReadoutThreshold = readout_threshold(caen_port);
+        if (_doe.ReadoutConfig.MinEventsPerTransfer > 0
+            or _doe.ReadoutThreshold == old_threshold) {
+            return;
+        }
+
+        // The ring and the interrupts need to know it changed
+        if (caen_port->IsReadoutRingRunning()) {
+            caen_port->SetReadoutThreshold(_doe.ReadoutThreshold);
+        } else if (caen_port->InterruptsEnabled()) {
+            caen_port->EnableInterrupts(_doe.ReadoutThreshold);
+        }
+    }
+
     void software_trigger(SiPMCAEN_ptr& caen_port) {
         if (_doe.SoftwareTrigger) {
             _logger->info("Sending a software trigger");
@@ -569,41 +1394,30 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
         return false;
     }
 
-    void rdm_extract_for_gui() {
-        static auto rdm_extract_timed = make_total_timed_event(
-            std::chrono::milliseconds(200),
-            [&]() {
-                // For the GUI
-                if (TriggeredWaveforms == 0) {
-                    return;
-                }
-                static std::default_random_engine generator;
-                std::uniform_int_distribution<uint64_t>
-                    distribution(0, TriggeredWaveforms);
-                uint64_t rdm_num = distribution(generator);
-
-                _osc_event = _processing_evts[rdm_num];
-
-                process_data_for_gui();
-        });
-
-        rdm_extract_timed();
-    }
-
-    void process_data_for_gui() {
+    // Plots the first event of the latest decoded waveforms
+    void process_data_for_gui(SiPMCAEN_ptr& caen_port) {
         calculate_trigger_frequency();
 
-        if (not _osc_event) {
+        if (caen_port->GetWaveforms().empty()) {
             return;
         }
 
-        auto size = _osc_event->getData()->ChSize[0];
-        auto all_chs = _osc_event->getData()->DataChannel;
+        plot_waveform(caen_port->GetWaveform(0));
+    }
 
-        if (size <= 0) {
-            return;
+    // Copies waveform into the plots of its groups
+    void plot_waveform(const CAENWaveformView<uint16_t>& waveform) {
+        // Samples of each CAEN channel, nullptr if not enabled
+        const auto& en_chs = waveform.getEnabledChannels();
+        std::array<const uint16_t*, 64> all_chs = {nullptr};
+        for (std::size_t row = 0; row < en_chs.size(); row++) {
+            if (en_chs[row] < all_chs.size()) {
+                all_chs[en_chs[row]] = waveform.getChannel(row).data();
+            }
         }
 
+        auto size = waveform.getRecordLength();
+
         for (std::size_t i = 0; i < size; i++) {
             for(std::size_t group = 0; group < _doe.GroupData.size(); group ++) {
                 auto offset = group*8;
@@ -0,0 +1,21 @@
+#ifndef THREADPRIORITY_H
+#define THREADPRIORITY_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+// C++ 3rd party includes
+// My includes
+
+namespace SBCQueens {
+
+// Makes the calling thread run only when the CPU would otherwise be idle
+// (SCHED_IDLE on Linux, THREAD_PRIORITY_IDLE on Windows) so background work
+// never takes time from the acquisition. Returns false if the system does
+// not allow it; the thread keeps running at its normal priority.
+bool lower_current_thread_priority() noexcept;
+
+}  // namespace SBCQueens
+
+#endif
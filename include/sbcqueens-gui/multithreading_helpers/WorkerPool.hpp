@@ -0,0 +1,145 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// C++ 3rd party includes
+// My includes
+
+namespace SBCQueens {
+
+// Fixed group of threads that split a range of indexes between them.
+//
+// for_each_chunk(n, func) cuts [0, n) into size() contiguous chunks and
+// calls func(begin, end, worker) once per chunk, with worker going from
+// 0 to size() - 1. It returns once every chunk is done. The calling thread
+// works on chunk 0, so a pool of 1 worker never starts a thread.
+//
+// func must not throw and chunks must not write to the same memory.
+// Only one thread should call for_each_chunk at a time.
+class WorkerPool {
+    using Task = std::function<void(std::size_t, std::size_t, std::size_t)>;
+
+    std::vector<std::thread> _threads;
+
+    std::mutex _mutex;
+    std::condition_variable _work_cv;
+    std::condition_variable _done_cv;
+    // All of these are protected by _mutex
+    Task _task;
+    std::size_t _n = 0;
+    uint64_t _generation = 0;
+    std::size_t _pending = 0;
+    bool _stop = false;
+
+    // Chunks differ by at most one element
+    std::pair<std::size_t, std::size_t> _chunk(const std::size_t& n,
+                                               const std::size_t& worker) const {
+        const std::size_t workers = size();
+        const std::size_t base = n / workers;
+        const std::size_t rest = n % workers;
+        const std::size_t begin = worker*base + std::min(worker, rest);
+        return {begin, begin + base + (worker < rest ? 1 : 0)};
+    }
+
+    void _loop(const std::size_t worker) {
+        uint64_t seen_generation = 0;
+        std::unique_lock lock(_mutex);
+        while (true) {
+            _work_cv.wait(lock, [&]() {
+                return _stop or _generation != seen_generation;
+            });
+
+            if (_stop) {
+                return;
+            }
+
+            seen_generation = _generation;
+            auto [begin, end] = _chunk(_n, worker);
+            lock.unlock();
+
+            // _task is not modified until _pending reaches 0
+            if (begin < end) {
+                _task(begin, end, worker);
+            }
+
+            lock.lock();
+            if (--_pending == 0) {
+                _done_cv.notify_one();
+            }
+        }
+    }
+
+ public:
+    // num_workers includes the calling thread. 0 means one per hardware
+    // thread.
+    explicit WorkerPool(std::size_t num_workers) {
+        if (num_workers == 0) {
+            num_workers = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (std::size_t i = 1; i < num_workers; i++) {
+            _threads.emplace_back(&WorkerPool::_loop, this, i);
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard lock(_mutex);
+            _stop = true;
+        }
+        _work_cv.notify_all();
+
+        for (auto& thread : _threads) {
+            thread.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return _threads.size() + 1;
+    }
+
+    template<typename Func>
+    void for_each_chunk(const std::size_t& n, Func&& func) {
+        if (_threads.empty()) {
+            func(0, n, 0);
+            return;
+        }
+
+        {
+            std::lock_guard lock(_mutex);
+            _task = std::ref(func);
+            _n = n;
+            _pending = _threads.size();
+            _generation++;
+        }
+        _work_cv.notify_all();
+
+        auto [begin, end] = _chunk(n, 0);
+        if (begin < end) {
+            func(begin, end, 0);
+        }
+
+        std::unique_lock lock(_mutex);
+        _done_cv.wait(lock, [&]() { return _pending == 0; });
+        _task = nullptr;
+    }
+};
+
+} // namespace SBCQueens
+
+#endif
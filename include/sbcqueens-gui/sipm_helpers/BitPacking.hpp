@@ -0,0 +1,53 @@
+#ifndef BITPACKING_H
+#define BITPACKING_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// C++ 3rd party includes
+// my includes
+
+// Bit packing of unsigned samples that use less than 16 bits, like the 12-bit
+// x740 and 14-bit x730 ADCs, so no padding is written to disk.
+//
+// The samples are laid out as a little endian bit stream: sample k is at
+// bits [k*bits, k*bits + bits - 1], least significant bit first, and the last
+// byte is padded with zeros. For 12 bits every 2 samples take 3 bytes, the
+// same as the x740 raw data; for 14 bits every 4 samples take 7 bytes.
+namespace SBCQueens::BinaryFormat::BitPacking {
+
+constexpr uint8_t kMaxBits = 16;
+
+// Instruction sets the kernels can use. Auto picks the best the CPU
+// supports. Only 12 and 14 bits have SIMD kernels, the rest are scalar.
+enum class SIMDLevel {
+    Auto, Scalar, SSE41
+};
+
+// Best level supported by this CPU and build.
+SIMDLevel best_simd_level() noexcept;
+
+// Bytes taken by n samples of bits each
+constexpr std::size_t packed_size(const std::size_t& n,
+                                  const uint8_t& bits) noexcept {
+    return (n*bits + 7) / 8;
+}
+
+// Packs in into out, which must have packed_size(in.size(), bits) bytes.
+// Only the lower bits of every sample are kept. bits must be in [1, 16].
+void pack(std::span<const uint16_t> in, const uint8_t& bits, char* out,
+          const SIMDLevel& level = SIMDLevel::Auto) noexcept;
+
+// Unpacks out.size() samples from in, which must have
+// packed_size(out.size(), bits) bytes. bits must be in [1, 16].
+void unpack(const char* in, const uint8_t& bits, std::span<uint16_t> out,
+            const SIMDLevel& level = SIMDLevel::Auto) noexcept;
+
+}  // namespace SBCQueens::BinaryFormat::BitPacking
+
+#endif
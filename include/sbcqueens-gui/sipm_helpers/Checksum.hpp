@@ -0,0 +1,49 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// C++ 3rd party includes
+// my includes
+
+namespace SBCQueens::BinaryFormat {
+
+// Checksums saved by a DynamicWriter besides the one of all its data in the
+// trailer, and what is done with them
+struct ChecksumOptions {
+    // Saves the CRC32C of every block of data when the file is closed (see
+    // Tools::BlockChecksums) so corruption can be narrowed down to the
+    // events it hit, and files can be checked with many threads
+    bool BlockChecksums = false;
+    // Lines per block of uncompressed files. Compressed files have a block
+    // per chunk.
+    std::size_t BlockLines = 4096;
+    // With rollover, every finished segment is checked again on a low
+    // priority thread while the acquisition continues
+    bool VerifySegments = false;
+};
+
+}  // namespace SBCQueens::BinaryFormat
+
+// CRC32C (Castagnoli) checksums of the SBC binary files. Same CRC as iSCSI,
+// ext4 and zstd frames, so it can be checked with any of their tools.
+// With SSE4.2 it runs at several GB/s, faster than the files can be read.
+namespace SBCQueens::BinaryFormat::Checksum {
+
+// True if the CPU has the SSE4.2 crc32 instruction and it is used.
+bool has_hardware_crc32c() noexcept;
+
+// CRC32C of data. crc is the CRC of the bytes before data, so a checksum can
+// be computed a piece at a time:
+//   crc32c(b, crc32c(a)) == crc32c(a followed by b)
+uint32_t crc32c(std::span<const char> data, const uint32_t& crc = 0) noexcept;
+
+}  // namespace SBCQueens::BinaryFormat::Checksum
+
+#endif
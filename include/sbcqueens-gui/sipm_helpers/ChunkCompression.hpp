@@ -0,0 +1,94 @@
+#ifndef CHUNKCOMPRESSION_H
+#define CHUNKCOMPRESSION_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+// C++ 3rd party includes
+// my includes
+
+// zstd contexts, only defined in ChunkCompression.cpp
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
+namespace SBCQueens::BinaryFormat {
+
+// How a DynamicWriter compresses its file. With Level = 0 the file is
+// written uncompressed, as always.
+//
+// Otherwise the events are grouped in chunks of ChunkEvents events that are
+// compressed with zstd, NumThreads chunks at a time. SiPM waveforms are
+// mostly flat baseline so, if DeltaFilter is true, the rows of the uint16
+// columns (the samples of each channel) are saved as the difference between
+// consecutive samples before compressing, which makes them compress better.
+struct CompressionOptions {
+    // zstd level: 1 (fastest) to 22 (smallest). 0 = not compressed.
+    int Level = 0;
+    // Threads that compress. 0 = one per hardware thread.
+    std::size_t NumThreads = 1;
+    // Events per chunk. Random access has to decompress a full chunk.
+    std::size_t ChunkEvents = 256;
+    bool DeltaFilter = true;
+
+    [[nodiscard]] bool enabled() const noexcept { return Level > 0; }
+};
+
+namespace ChunkCompression {
+
+// Replaces every sample of the row by its difference with the previous
+// sample, modulo 2^16 and zigzag encoded (0, -1, 1, -2... -> 0, 1, 2, 3...).
+// The first sample is kept. row does not have to be aligned to uint16.
+void delta_encode(char* row, const std::size_t& num_samples) noexcept;
+
+// Inverse of delta_encode
+void delta_decode(char* row, const std::size_t& num_samples) noexcept;
+
+// Max size the compressed output of size bytes can take
+std::size_t compress_bound(const std::size_t& size) noexcept;
+
+// Compresses with a reusable zstd context. A Compressor must only be used
+// by one thread at a time.
+class Compressor {
+    struct _deleter {
+        void operator()(ZSTD_CCtx_s* ctx) const noexcept;
+    };
+
+    std::unique_ptr<ZSTD_CCtx_s, _deleter> _ctx;
+    int _level = 1;
+
+ public:
+    // level is clamped to the range zstd supports
+    explicit Compressor(const int& level);
+
+    // Compresses in into out, which should have compress_bound(in.size())
+    // bytes. Returns the compressed size, or 0 if it failed.
+    std::size_t compress(std::span<const char> in,
+                         std::span<char> out) noexcept;
+};
+
+class Decompressor {
+    struct _deleter {
+        void operator()(ZSTD_DCtx_s* ctx) const noexcept;
+    };
+
+    std::unique_ptr<ZSTD_DCtx_s, _deleter> _ctx;
+
+ public:
+    Decompressor();
+
+    // Decompresses in into out. Returns the decompressed size, or 0 if it
+    // failed or out is too small.
+    std::size_t decompress(std::span<const char> in,
+                           std::span<char> out) noexcept;
+};
+
+}  // namespace ChunkCompression
+}  // namespace SBCQueens::BinaryFormat
+
+#endif
@@ -13,13 +13,31 @@
 // C 3rd party includes
 // C++ STD includes
 #include <bit>
+#include <charconv>
+#include <chrono>
 #include <cinttypes>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <numeric>
+#include <optional>
 #include <fstream>
+#include <future>
+#include <iterator>
+#include <limits>
 #include <type_traits>
 #include <filesystem>
 #include <algorithm>
 #include <array>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 // C++ 3rd party includes
 #include <concurrentqueue.h>
@@ -28,6 +46,13 @@
 // my includes
 #include "sbcqueens-gui/file_helpers.hpp"
 #include "sbcqueens-gui/caen_helper.hpp"
+#include "sbcqueens-gui/multithreading_helpers/ThreadPriority.hpp"
+#include "sbcqueens-gui/multithreading_helpers/WorkerPool.hpp"
+#include "sbcqueens-gui/sipm_helpers/BitPacking.hpp"
+#include "sbcqueens-gui/sipm_helpers/Checksum.hpp"
+#include "sbcqueens-gui/sipm_helpers/ChunkCompression.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCEventIndex.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCRunManifest.hpp"
 
 namespace SBCQueens::BinaryFormat {
 namespace Tools {
@@ -81,10 +106,467 @@ namespace Tools {
         // TODO(All): maybe the default should be uint32? or no default?
     }
 
+    // Bit packed uint16 columns (see BitPacking.hpp) are saved with the
+    // type "upack{bits}", ex: "upack12". They are not a C++ type so they
+    // do not go through type_to_string<T>().
+    constexpr std::string_view kPackedTypePrefix = "upack";
+
+    inline std::string packed_type_to_string(const uint8_t& bits) {
+        return std::string(kPackedTypePrefix) + std::to_string(bits);
+    }
+
+    // Bits of a packed type string, 0 if it is not a packed type.
+    inline uint8_t packed_type_bits(std::string_view type) {
+        if (not type.starts_with(kPackedTypePrefix)) {
+            return 0;
+        }
+
+        type.remove_prefix(kPackedTypePrefix.size());
+        unsigned int bits = 0;
+        auto [ptr, ec] = std::from_chars(type.data(), type.data() + type.size(),
+                                         bits);
+        if (ec != std::errc() or type.empty() or ptr != type.data() + type.size()
+            or bits == 0 or bits >= BitPacking::kMaxBits) {
+            return 0;
+        }
+
+        return static_cast<uint8_t>(bits);
+    }
+
+    // The word every file starts with. It is written in the native
+    // endianness of the machine that wrote the file.
+    constexpr uint32_t endianness_word() {
+        if constexpr (std::endian::native == std::endian::big) {
+            return 0x04030201;
+        } else {
+            return 0x01020304;
+        }
+    }
+
+    // v2 files start with these 3 characters followed by the version
+    // byte. v1 files start with the endianness word whose first byte is
+    // either 0x01 or 0x04, so they can never be confused.
+    constexpr std::string_view kFileMagic = "SBC";
+    constexpr uint8_t kFileVersion = 2;
+
+    // v2 header flags.
+    // The lines are saved in zstd compressed chunks (see CompressionOptions)
+    constexpr uint32_t kFlagCompressed = 1u << 0;
+    // The uint16 rows were delta encoded before being compressed
+    constexpr uint32_t kFlagDeltaFilter = 1u << 1;
+    // The writer saves a trailer (see RunSummary) when it is closed, so a
+    // file with this flag but no trailer was not closed properly.
+    constexpr uint32_t kFlagTrailer = 1u << 2;
+    // The trailer is preceded by the checksums of every block of data, see
+    // BlockChecksums. Only set with kFlagTrailer.
+    constexpr uint32_t kFlagBlockChecksums = 1u << 3;
+    constexpr uint32_t kKnownFlags = kFlagCompressed | kFlagDeltaFilter
+        | kFlagTrailer | kFlagBlockChecksums;
+
+    // Compressed files: after the header, every chunk is saved as
+    //   uint32 number of events | uint32 compressed size | compressed lines
+    // and when the writer is closed the chunk index is appended:
+    //   {uint64 chunk offset, uint64 first event} per chunk |
+    //   uint64 number of chunks | uint64 number of events | "SBCINDEX"
+    constexpr std::size_t kChunkHeaderSize = 2*sizeof(uint32_t);
+    constexpr std::string_view kChunkIndexMagic = "SBCINDEX";
+    constexpr std::size_t kChunkIndexTrailerSize = 2*sizeof(uint64_t)
+        + kChunkIndexMagic.size();
+
+    struct ChunkIndexEntry {
+        // Where the chunk header starts, in bytes
+        uint64_t Offset = 0;
+        uint64_t FirstEvent = 0;
+    };
+    static_assert(sizeof(ChunkIndexEntry) == 2*sizeof(uint64_t));
+
+    struct ChunkIndex {
+        std::vector<ChunkIndexEntry> Chunks;
+        uint64_t NumEvents = 0;
+        // Where the last complete chunk ends, in bytes
+        std::size_t DataEnd = 0;
+    };
+
+    // {number of events, compressed size} of the chunk that starts at data
+    inline std::pair<uint32_t, uint32_t> chunk_header(const char* data) {
+        std::pair<uint32_t, uint32_t> out;
+        std::memcpy(&out.first, data, sizeof(uint32_t));
+        std::memcpy(&out.second, data + sizeof(uint32_t), sizeof(uint32_t));
+        return out;
+    }
+
+    // Reads the chunk index at the end of a compressed file whose header
+    // is header_size long. If the index is not there or does not match the
+    // chunks (file still being written or not closed properly) it is
+    // rebuilt by walking the chunk headers, and an incomplete chunk at the
+    // end is ignored.
+    inline ChunkIndex read_chunk_index(const char* data, const std::size_t& size,
+                                       const std::size_t& header_size) {
+        ChunkIndex index;
+        if (size >= header_size + kChunkIndexTrailerSize
+            and std::string_view(data + size - kChunkIndexMagic.size(),
+                                 kChunkIndexMagic.size()) == kChunkIndexMagic) {
+            const char* trailer = data + size - kChunkIndexTrailerSize;
+            uint64_t num_chunks = 0;
+            std::memcpy(&num_chunks, trailer, sizeof(uint64_t));
+            std::memcpy(&index.NumEvents, trailer + sizeof(uint64_t),
+                        sizeof(uint64_t));
+
+            const std::size_t max_chunks = (size - header_size
+                - kChunkIndexTrailerSize) / sizeof(ChunkIndexEntry);
+            if (num_chunks <= max_chunks) {
+                index.DataEnd = size - kChunkIndexTrailerSize
+                    - num_chunks*sizeof(ChunkIndexEntry);
+                index.Chunks.resize(num_chunks);
+                std::memcpy(index.Chunks.data(), data + index.DataEnd,
+                            num_chunks*sizeof(ChunkIndexEntry));
+
+                // The chunks have to start right after the header and the
+                // last one has to end where the index starts
+                bool valid = index.Chunks.empty()
+                    ? index.DataEnd == header_size and index.NumEvents == 0
+                    : index.Chunks.front().Offset == header_size;
+                if (valid and not index.Chunks.empty()) {
+                    const auto& last = index.Chunks.back();
+                    valid = last.Offset + kChunkHeaderSize <= index.DataEnd;
+                    if (valid) {
+                        auto [n, compressed_size] = chunk_header(data + last.Offset);
+                        valid = last.Offset + kChunkHeaderSize + compressed_size
+                                == index.DataEnd
+                            and last.FirstEvent + n == index.NumEvents;
+                    }
+                }
+
+                if (valid) {
+                    return index;
+                }
+            }
+        }
+
+        index = ChunkIndex{};
+        std::size_t pos = header_size;
+        while (pos + kChunkHeaderSize <= size) {
+            auto [n, compressed_size] = chunk_header(data + pos);
+            if (n == 0 or compressed_size == 0
+                or compressed_size > size - pos - kChunkHeaderSize) {
+                break;
+            }
+
+            index.Chunks.push_back({pos, index.NumEvents});
+            index.NumEvents += n;
+            pos += kChunkHeaderSize + compressed_size;
+        }
+        index.DataEnd = pos;
+
+        return index;
+    }
+
+    inline void write_chunk_index(std::ostream& out,
+                                  std::span<const ChunkIndexEntry> chunks,
+                                  const uint64_t& num_events) {
+        out.write(reinterpret_cast<const char*>(chunks.data()),
+                  static_cast<std::streamsize>(chunks.size_bytes()));
+        const uint64_t num_chunks = chunks.size();
+        out.write(reinterpret_cast<const char*>(&num_chunks), sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(&num_events), sizeof(uint64_t));
+        out.write(kChunkIndexMagic.data(),
+                  static_cast<std::streamsize>(kChunkIndexMagic.size()));
+    }
+
+    // Files with kFlagTrailer end, once closed, with
+    //   RunSummary | "SBCTRAIL"
+    // after the lines, or after the chunk index of compressed files.
+    constexpr std::string_view kTrailerMagic = "SBCTRAIL";
+
+    struct RunSummary {
+        uint64_t NumEvents = 0;
+        // Bytes of lines (or compressed chunks) after the header. The chunk
+        // index is not included.
+        uint64_t DataBytes = 0;
+        // CRC32C of those bytes, see Checksum.hpp
+        uint32_t Checksum = 0;
+        // Times the file was opened for writing, and times recover_file(...)
+        // had to fix it
+        uint32_t Sessions = 0;
+        uint32_t Recoveries = 0;
+        uint32_t Reserved = 0;
+        // Host time when the file was created and when it was last closed,
+        // in ns since the epoch of std::chrono::system_clock. 0 if unknown.
+        int64_t FirstOpened = 0;
+        int64_t LastClosed = 0;
+    };
+    static_assert(sizeof(RunSummary) == 6*sizeof(uint64_t));
+    constexpr std::size_t kTrailerSize = sizeof(RunSummary)
+        + kTrailerMagic.size();
+
+    // Trailer of a file of size bytes whose header is header_size long, if
+    // it has one.
+    inline std::optional<RunSummary> read_trailer(const char* data,
+                                                  const std::size_t& size,
+                                                  const std::size_t& header_size) {
+        if (size < header_size + kTrailerSize
+            or std::string_view(data + size - kTrailerMagic.size(),
+                                kTrailerMagic.size()) != kTrailerMagic) {
+            return std::nullopt;
+        }
+
+        RunSummary summary;
+        std::memcpy(&summary, data + size - kTrailerSize, sizeof(RunSummary));
+        if (summary.DataBytes > size - header_size - kTrailerSize) {
+            return std::nullopt;
+        }
+
+        return summary;
+    }
+
+    inline void write_trailer(std::ostream& out, const RunSummary& summary) {
+        out.write(reinterpret_cast<const char*>(&summary), sizeof(RunSummary));
+        out.write(kTrailerMagic.data(),
+                  static_cast<std::streamsize>(kTrailerMagic.size()));
+    }
+
+    // Files with kFlagBlockChecksums have, once closed, the CRC32C of every
+    // block of their data right before the trailer:
+    //   uint32 CRC per block | uint64 lines per block |
+    //   uint64 number of blocks | "SBCBLOCK"
+    // A block is a chunk in compressed files, whose lines per block is 0,
+    // and lines per block lines in the others; their last block can be
+    // shorter. They let a corrupted file be narrowed down to the events that
+    // were hit, and be checked with many threads.
+    constexpr std::string_view kBlockChecksumsMagic = "SBCBLOCK";
+    constexpr std::size_t kBlockChecksumsTrailerSize = 2*sizeof(uint64_t)
+        + kBlockChecksumsMagic.size();
+
+    struct BlockChecksums {
+        std::vector<uint32_t> Checksums;
+        uint64_t BlockLines = 0;
+        // Bytes they take in the file
+        std::size_t ByteSize = 0;
+    };
+
+    // Block checksums that end at size, if there are
+    inline std::optional<BlockChecksums> read_block_checksums(
+            const char* data, const std::size_t& size,
+            const std::size_t& header_size) {
+        if (size < header_size + kBlockChecksumsTrailerSize
+            or std::string_view(data + size - kBlockChecksumsMagic.size(),
+                                kBlockChecksumsMagic.size())
+                != kBlockChecksumsMagic) {
+            return std::nullopt;
+        }
+
+        BlockChecksums checksums;
+        uint64_t num_blocks = 0;
+        const char* trailer = data + size - kBlockChecksumsTrailerSize;
+        std::memcpy(&checksums.BlockLines, trailer, sizeof(uint64_t));
+        std::memcpy(&num_blocks, trailer + sizeof(uint64_t), sizeof(uint64_t));
+        if (num_blocks > (size - header_size - kBlockChecksumsTrailerSize)
+                / sizeof(uint32_t)) {
+            return std::nullopt;
+        }
+
+        checksums.Checksums.resize(num_blocks);
+        checksums.ByteSize = kBlockChecksumsTrailerSize
+            + num_blocks*sizeof(uint32_t);
+        std::memcpy(checksums.Checksums.data(), data + size - checksums.ByteSize,
+                    num_blocks*sizeof(uint32_t));
+        return checksums;
+    }
+
+    inline void write_block_checksums(std::ostream& out,
+                                      std::span<const uint32_t> checksums,
+                                      const uint64_t& block_lines) {
+        out.write(reinterpret_cast<const char*>(checksums.data()),
+                  static_cast<std::streamsize>(checksums.size_bytes()));
+        const uint64_t num_blocks = checksums.size();
+        out.write(reinterpret_cast<const char*>(&block_lines), sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(&num_blocks), sizeof(uint64_t));
+        out.write(kBlockChecksumsMagic.data(),
+                  static_cast<std::streamsize>(kBlockChecksumsMagic.size()));
+    }
+
+    // Byte ranges [begin, end) of the blocks of the data that goes from
+    // header_size to data_end: one per chunk if block_bytes is 0, otherwise
+    // every block_bytes.
+    inline std::vector<std::pair<std::size_t, std::size_t>> block_ranges(
+            const std::size_t& header_size, const std::size_t& data_end,
+            const std::size_t& block_bytes,
+            std::span<const ChunkIndexEntry> chunks) {
+        std::vector<std::pair<std::size_t, std::size_t>> ranges;
+        if (block_bytes == 0) {
+            for (std::size_t c = 0; c < chunks.size(); c++) {
+                ranges.emplace_back(chunks[c].Offset, c + 1 < chunks.size()
+                    ? chunks[c + 1].Offset : data_end);
+            }
+            return ranges;
+        }
+
+        for (auto begin = header_size; begin < data_end; begin += block_bytes) {
+            ranges.emplace_back(begin, std::min(begin + block_bytes, data_end));
+        }
+        return ranges;
+    }
+
+    inline std::vector<uint32_t> compute_block_checksums(const char* data,
+            std::span<const std::pair<std::size_t, std::size_t>> ranges) {
+        std::vector<uint32_t> checksums;
+        checksums.reserve(ranges.size());
+        for (const auto& [begin, end] : ranges) {
+            checksums.push_back(Checksum::crc32c({data + begin, end - begin}));
+        }
+        return checksums;
+    }
+
+    // Value of the number of lines field for num_lines lines. Files with more
+    // lines than an int32 can hold save 0 (indefinitely long).
+    constexpr int32_t num_lines_field(const uint64_t& num_lines) noexcept {
+        return num_lines > static_cast<uint64_t>(std::numeric_limits<int32_t>::max())
+            ? 0 : static_cast<int32_t>(num_lines);
+    }
+
+    // Overwrites the number of lines field, the last 4 bytes of the header,
+    // of a file open for writing
+    inline void write_num_lines(std::ostream& file, const std::size_t& header_size,
+                                const uint64_t& num_lines) {
+        const int32_t field = num_lines_field(num_lines);
+        file.seekp(static_cast<std::streamoff>(header_size - sizeof(int32_t)));
+        file.write(reinterpret_cast<const char*>(&field), sizeof(int32_t));
+        file.flush();
+    }
+
+    // NumRows rows of RowLength uint16 that start at Offset inside a line.
+    // In compressed files, these are delta filtered.
+    struct DeltaRows {
+        std::size_t Offset = 0;
+        std::size_t RowLength = 0;
+        std::size_t NumRows = 0;
+    };
+
+    // Delta encodes (or decodes) the rows of num_lines lines
+    inline void delta_filter_lines(char* lines, const std::size_t& num_lines,
+                                   const std::size_t& line_size,
+                                   std::span<const DeltaRows> rows,
+                                   const bool& encode) noexcept {
+        for (std::size_t i = 0; i < num_lines; i++) {
+            char* line = lines + i*line_size;
+            for (const auto& row : rows) {
+                for (std::size_t r = 0; r < row.NumRows; r++) {
+                    char* start = line + row.Offset
+                        + r*row.RowLength*sizeof(uint16_t);
+                    if (encode) {
+                        ChunkCompression::delta_encode(start, row.RowLength);
+                    } else {
+                        ChunkCompression::delta_decode(start, row.RowLength);
+                    }
+                }
+            }
+        }
+    }
+
+    // Column description as found in the header:
+    // "{name};{type};{size1},{size2}...;"
+    inline std::string column_header(std::string_view name,
+                                     std::string_view type,
+                                     std::span<const std::size_t> sizes) {
+        std::string out;
+        out += name;
+        out += ';';
+        out += type;
+        out += ';';
+        for (std::size_t j = 0; j < sizes.size(); j++) {
+            out += std::to_string(sizes[j]);
+            if (j != sizes.size() - 1) {
+                out += ',';
+            }
+        }
+        out += ';';
+        return out;
+    }
+
+    // Growable byte buffer whose storage is aligned to Alignment bytes.
+    // It is meant to be reused: reserve(...) only reallocates when the
+    // requested size is bigger than what it already holds, and the
+    // old contents are not preserved when it does.
+    template<std::size_t Alignment = 64>
+    class AlignedBuffer {
+        struct _deleter {
+            void operator()(char* ptr) const noexcept {
+                ::operator delete[](ptr, std::align_val_t{Alignment});
+            }
+        };
+
+        std::unique_ptr<char[], _deleter> _data = nullptr;
+        std::size_t _capacity = 0;
+
+     public:
+        AlignedBuffer() = default;
+        explicit AlignedBuffer(const std::size_t& size) { reserve(size); }
+
+        void reserve(const std::size_t& size) {
+            if (size <= _capacity) {
+                return;
+            }
+
+            _data.reset(static_cast<char*>(
+                ::operator new[](size, std::align_val_t{Alignment})));
+            _capacity = size;
+        }
+
+        [[nodiscard]] char* data() noexcept { return _data.get(); }
+        [[nodiscard]] const char* data() const noexcept { return _data.get(); }
+        [[nodiscard]] const std::size_t& capacity() const noexcept {
+            return _capacity;
+        }
+    };
+
 } // namespace Tools
 
+// Values that do not change during a run (digitizer settings, sample
+// rate...). When given to a DynamicWriter, they are saved once in the
+// header (v2) instead of with every event.
+class RunConstants {
+    std::string _header;
+    std::string _payload;
+
+ public:
+    template<typename T>
+    requires std::is_arithmetic_v<T>
+    RunConstants& add(std::string_view name, std::span<const T> values) {
+        const std::array<std::size_t, 1> sizes = {values.size()};
+        _header += Tools::column_header(name, Tools::type_to_string<T>(), sizes);
+        _payload.append(reinterpret_cast<const char*>(values.data()),
+                        values.size_bytes());
+        return *this;
+    }
+
+    template<typename T>
+    requires std::is_arithmetic_v<T>
+    RunConstants& add(std::string_view name, const std::vector<T>& values) {
+        return add(name, std::span<const T>(values));
+    }
+
+    template<typename T>
+    requires std::is_arithmetic_v<T>
+    RunConstants& add(std::string_view name, const T& value) {
+        return add(name, std::span<const T>(&value, 1));
+    }
+
+    [[nodiscard]] bool empty() const noexcept { return _header.empty(); }
+    // Constants header: same format as the data header
+    [[nodiscard]] const std::string& header() const noexcept { return _header; }
+    // The values, one after the other in the order they were added
+    [[nodiscard]] const std::string& payload() const noexcept { return _payload; }
+};
+
+// Thrown by DynamicWriter when the file it would append to has the same
+// columns but other run constants: its events are laid out the same way
+// but were taken with other settings.
+struct RunConstantsChanged : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
 /*  SBC Binary Header description:
- * Header of a binary format is divided in 4 parts:
+ * v1 header of a binary format is divided in 4 parts:
  * 1.- Edianess            - always 4 bits long (uint32_t)
  * 2.- Data Header size    - always 2 bits long (uint16_t)
  * and is the length of the next bit of data
@@ -94,280 +576,2310 @@ namespace Tools {
  * Cannot be longer than 65536 bytes.
  * 4.- Number of lines     - always 4 bits long (int32_t)
  * Number of lines in the file. If 0, it is indefinitely long.
+ * The DynamicWriter updates it in place every kHeaderUpdatePeriod, on
+ * flush() and when closed, so after a crash it holds the lines that made it
+ * to the file.
+ *
+ * v2 (written when RunConstants are given) adds a constants section:
+ * 1.- Magic               - "SBC" + version byte (2)
+ * 2.- Edianess            - uint32_t
+ * 3.- Flags               - uint32_t, see Tools::kKnownFlags.
+ * 4.- Constants Header size - uint16_t
+ * 5.- Constants Header    - same format as the data header. All the
+ * columns are rank 1.
+ * 6.- Constants           - the values, laid out like a single line.
+ * 7.- Data Header size, 8.- Data Header and 9.- Number of lines,
+ * same as 2, 3 and 4 of v1.
+ *
+ * Compressed files (see CompressionOptions) are always v2 and set the
+ * compressed flag. Their lines are saved in chunks followed by a chunk
+ * index, see Tools::kChunkHeaderSize.
+ *
+ * v2 files also set the trailer flag: the writer appends a run summary
+ * with the checksum of the data when it is closed, see Tools::RunSummary.
+ * With ChecksumOptions::BlockChecksums the checksum of every block of data
+ * is saved before it, see Tools::BlockChecksums.
 */
+
+// A DynamicWriter column with N elements per event, known at compile time.
+// Ex: DynamicWriter<FixedColumn<uint32_t, 1>, uint16_t> has a single
+// uint32 per event followed by a uint16 column with the shape given when
+// the writer is constructed. Fixed columns are copied with a fixed size
+// memcpy and, if all the columns before them are fixed too, at a fixed
+// offset of the line. They cannot be bit packed.
+template<typename T, std::size_t N>
+requires (N != std::dynamic_extent)
+struct FixedColumn {
+    using type = T;
+    constexpr static std::size_t extent = N;
+};
+
+namespace Tools {
+    // Element type and number of elements of a DynamicWriter column
+    template<typename T>
+    struct column_traits {
+        using type = T;
+        constexpr static std::size_t extent = std::dynamic_extent;
+    };
+
+    template<typename T, std::size_t N>
+    struct column_traits<FixedColumn<T, N>> {
+        using type = T;
+        constexpr static std::size_t extent = N;
+    };
+
+    template<typename T>
+    using column_type_t = typename column_traits<T>::type;
+} // namespace Tools
+
+// Description of a single column as found in the header of a file.
+struct ColumnDescription {
+    std::string Name;
+    std::string Type;
+    std::vector<std::size_t> Sizes;
+    // Size in bytes of a single element of Type. For packed types, the
+    // size once unpacked.
+    std::size_t TypeSize = 0;
+    // Number of elements (product of Sizes)
+    std::size_t NumElements = 0;
+    // Where the column starts inside a line, in bytes
+    std::size_t Offset = 0;
+    // TypeSize*NumElements, or the packed size for packed types
+    std::size_t ByteSize = 0;
+    // Bits per element of packed types, 0 if not packed
+    uint8_t PackedBits = 0;
+};
+
+// Everything that can be learned from the header of a file.
+struct FileHeader {
+    uint8_t Version = 1;
+    // v2 only, see Tools::kKnownFlags
+    uint32_t Flags = 0;
+    // Run constants (v2 only). Their Offset is relative to ConstantsOffset.
+    std::vector<ColumnDescription> Constants;
+    // Where the constants values start, in bytes
+    std::size_t ConstantsOffset = 0;
+    std::vector<ColumnDescription> Columns;
+    // As saved in the file. 0 means it is indefinitely long.
+    int32_t NumLines = 0;
+    // Where the first line starts, in bytes
+    std::size_t HeaderByteSize = 0;
+    std::size_t LineByteSize = 0;
+};
+
+namespace Tools {
+
+    // Size in bytes of the type strings found in the header.
+    // Same table as test/ReadBinary.py. Returns 0 if unknown.
+    // Packed types return the size of an unpacked element (uint16).
+    inline std::size_t type_string_size(std::string_view type) {
+        if (packed_type_bits(type) > 0) {
+            return sizeof(uint16_t);
+        } else if (type == "char" or type == "int8" or type == "uint8") {
+            return 1;
+        } else if (type == "int16" or type == "uint16") {
+            return 2;
+        } else if (type == "int32" or type == "uint32" or type == "single"
+                   or type == "float32") {
+            return 4;
+        } else if (type == "int64" or type == "uint64" or type == "double"
+                   or type == "float64") {
+            return 8;
+        } else if (type == "float128") {
+            return 16;
+        }
+
+        return 0;
+    }
+
+    // True if the type string in a file is the type T.
+    // float32 and float64 are accepted as aliases of single and double, and
+    // packed types as uint16.
+    template<typename T>
+    bool is_type_string_of(std::string_view type) {
+        const auto expected = type_to_string<T>();
+        if (type == expected) {
+            return true;
+        }
+
+        if (packed_type_bits(type) > 0) {
+            return expected == "uint16";
+        }
+
+        return (type == "float32" and expected == "single")
+            or (type == "float64" and expected == "double");
+    }
+
+    // Parses a header string "{name};{type};{size1},{size2}...;..." into
+    // its columns. line_size is set to the total size of the columns.
+    // Throws std::runtime_error if the header is malformed.
+    inline std::vector<ColumnDescription> parse_columns(
+            std::string_view header_str, std::size_t& line_size) {
+        auto next_token = [&]() -> std::string_view {
+            const auto end = header_str.find(';');
+            if (end == std::string_view::npos) {
+                throw std::runtime_error("File header is malformed.");
+            }
+
+            auto token = header_str.substr(0, end);
+            header_str.remove_prefix(end + 1);
+            return token;
+        };
+
+        std::vector<ColumnDescription> columns;
+        line_size = 0;
+        while (not header_str.empty()) {
+            ColumnDescription column;
+            column.Name = next_token();
+            column.Type = next_token();
+            column.TypeSize = type_string_size(column.Type);
+            if (column.TypeSize == 0) {
+                throw std::runtime_error("File header has an unknown type: "
+                                         + column.Type);
+            }
+
+            auto sizes_str = next_token();
+            column.NumElements = 1;
+            while (true) {
+                const auto comma = sizes_str.find(',');
+                auto size_str = sizes_str.substr(0, comma);
+
+                std::size_t col_size = 0;
+                auto [ptr, ec] = std::from_chars(size_str.data(),
+                    size_str.data() + size_str.size(), col_size);
+                if (ec != std::errc() or size_str.empty()
+                    or ptr != size_str.data() + size_str.size()) {
+                    throw std::runtime_error("File header has an invalid "
+                                             "size for column " + column.Name);
+                }
+
+                column.Sizes.push_back(col_size);
+                column.NumElements *= col_size;
+                if (comma == std::string_view::npos) {
+                    break;
+                }
+                sizes_str.remove_prefix(comma + 1);
+            }
+
+            column.Offset = line_size;
+            column.PackedBits = packed_type_bits(column.Type);
+            column.ByteSize = column.PackedBits > 0
+                ? BitPacking::packed_size(column.NumElements, column.PackedBits)
+                : column.TypeSize*column.NumElements;
+            line_size += column.ByteSize;
+            columns.push_back(std::move(column));
+        }
+
+        return columns;
+    }
+
+    // Parses the header (v1 or v2) at the start of data. Throws
+    // std::runtime_error if the header is malformed, is from an unknown
+    // version, or was written with a different endianness (the lines cannot
+    // be read without a copy in that case).
+    inline FileHeader parse_header(const char* data, const std::size_t& size) {
+        std::size_t pos = 0;
+        // Returns where the next n bytes start and moves past them
+        auto take = [&](const std::size_t& n) -> const char* {
+            if (data == nullptr or pos + n > size) {
+                throw std::runtime_error("File is too small to contain an "
+                                         "SBC binary header.");
+            }
+
+            const char* out = data + pos;
+            pos += n;
+            return out;
+        };
+
+        auto take_number = [&]<typename T>(T& num) {
+            std::memcpy(&num, take(sizeof(T)), sizeof(T));
+        };
+
+        FileHeader header;
+        if (size >= kFileMagic.size() + 1
+            and std::string_view(data, kFileMagic.size()) == kFileMagic) {
+            take(kFileMagic.size());
+            header.Version = static_cast<uint8_t>(*take(1));
+            if (header.Version != kFileVersion) {
+                throw std::runtime_error("File has an unsupported SBC binary "
+                                         "version: "
+                                         + std::to_string(header.Version));
+            }
+        }
+
+        uint32_t endianness = 0;
+        take_number(endianness);
+        if (endianness != endianness_word()) {
+            throw std::runtime_error("File was written with a different "
+                                     "endianness or is not an SBC binary "
+                                     "file.");
+        }
+
+        if (header.Version >= 2) {
+            take_number(header.Flags);
+            if ((header.Flags & ~kKnownFlags) != 0) {
+                throw std::runtime_error("File uses unsupported features.");
+            }
+
+            uint16_t constants_str_size = 0;
+            take_number(constants_str_size);
+            std::size_t constants_size = 0;
+            header.Constants = parse_columns(
+                std::string_view(take(constants_str_size), constants_str_size),
+                constants_size);
+            header.ConstantsOffset = pos;
+            take(constants_size);
+        }
+
+        uint16_t header_str_size = 0;
+        take_number(header_str_size);
+        header.Columns = parse_columns(
+            std::string_view(take(header_str_size), header_str_size),
+            header.LineByteSize);
+        take_number(header.NumLines);
+        header.HeaderByteSize = pos;
+
+        return header;
+    }
+
+} // namespace Tools
+
 template<typename... DataTypes>
-requires Tools::is_arithmetic_ptr_unpack<DataTypes...>
+requires Tools::is_arithmetic_ptr_unpack<Tools::column_type_t<DataTypes>...>
 struct DynamicWriter {
     //TODO(Any): make it possible to take both normal arithmetic types
     //  - and their corresponding array types Ex: int and int[]
     //  - that is to assume that if int is passed, it mean we want a scalar
     //  - and int[] would mean an array.
-    using tuple_type = std::tuple<std::span<DataTypes>...>;
+    using tuple_type = std::tuple<std::span<Tools::column_type_t<DataTypes>>...>;
     constexpr static std::size_t n_cols = sizeof...(DataTypes);
-    constexpr static std::array<std::size_t, n_cols> size_of_types = { sizeof(DataTypes)... };
-    constexpr static std::array<std::string_view, n_cols> parameters_types_str = { Tools::type_to_string<DataTypes>()... };
+    constexpr static std::array<std::size_t, n_cols> size_of_types = { sizeof(Tools::column_type_t<DataTypes>)... };
+    constexpr static std::array<std::string_view, n_cols> parameters_types_str = { Tools::type_to_string<Tools::column_type_t<DataTypes>>()... };
+    // Elements of each FixedColumn, std::dynamic_extent for the others
+    constexpr static std::array<std::size_t, n_cols> fixed_extents = { Tools::column_traits<DataTypes>::extent... };
+    // Where each column starts inside a line if only fixed columns are
+    // before it, std::dynamic_extent if it is only known at run time.
+    constexpr static std::array<std::size_t, n_cols> fixed_offsets = []() {
+        std::array<std::size_t, n_cols> offsets = {};
+        std::size_t offset = 0;
+        for (std::size_t i = 0; i < n_cols; i++) {
+            offsets[i] = offset;
+            if (offset == std::dynamic_extent
+                or fixed_extents[i] == std::dynamic_extent) {
+                offset = std::dynamic_extent;
+            } else {
+                offset += fixed_extents[i]*size_of_types[i];
+            }
+        }
+        return offsets;
+    }();
+    // Max bytes save_batch(...) lays out before writing them to the file.
+    // Small enough for the lines to still be in L2 when they are written:
+    // with 4 MB, events of 32 or 64 channels of 1000 samples were written
+    // slower than with save(...). A line bigger than this is written alone.
+    constexpr static std::size_t kMaxBatchBytes = 256*1024;
+    // How often the number of lines of the header is updated while saving
+    constexpr static std::chrono::seconds kHeaderUpdatePeriod{1};
+
+ private:
+    const std::string _file_name;
+    const std::array<std::string, n_cols> _names;
+    const std::array<std::size_t, n_cols> _ranks;
+    const std::vector<std::size_t> _sizes;
+    const RunConstants _run_constants;
+    // Bits each column is packed to, 0 = not packed
+    const std::array<uint8_t, n_cols> _packed_bits;
+    const CompressionOptions _compression;
+    const ChecksumOptions _checksum_options;
+
+    std::size_t total_ranks = 0;
+    bool _open = false;
+    std::fstream _stream;
+    // Writes the number of lines in place. _stream only appends.
+    std::fstream _header_stream;
+    std::chrono::steady_clock::time_point _last_header_update;
+
+    // Layout of a line. These never change after construction so they
+    // are calculated once and used for every event.
+    // Number of elements of each column (product of its sizes)
+    std::array<std::size_t, n_cols> _col_num_elements = {};
+    // Where each column starts inside a line, in bytes
+    std::array<std::size_t, n_cols> _col_offsets = {};
+    std::size_t _line_byte_size = 0;
+
+    // Single event buffer used by save(...)
+    Tools::AlignedBuffer<> _line_buffer;
+    // Multiple events buffer used by save_batch(...). Reused between calls.
+    Tools::AlignedBuffer<> _batch_buffer;
+
+    // Only used by compressed files
+    std::unique_ptr<WorkerPool> _pool;
+    // One per worker
+    std::vector<ChunkCompression::Compressor> _compressors;
+    // Lines waiting to be compressed: one chunk per worker
+    Tools::AlignedBuffer<> _chunks_buffer;
+    std::size_t _chunks_buffer_events = 0;
+    std::size_t _chunks_buffer_capacity = 0;
+    std::vector<std::vector<char>> _compressed_chunks;
+    std::vector<std::size_t> _compressed_sizes;
+    std::vector<Tools::DeltaRows> _delta_rows;
+    std::vector<Tools::ChunkIndexEntry> _chunk_index;
+
+    // Events in the file, including the ones that were there before
+    // it was opened and the ones waiting to be compressed.
+    uint64_t _num_events = 0;
+    // Events and bytes already handed to the stream
+    uint64_t _num_events_written = 0;
+    std::size_t _file_size = 0;
+    std::size_t _header_size = 0;
+
+    // Only kept for files with a trailer. The checksum covers everything
+    // written after the header, except the chunk index.
+    Tools::RunSummary _summary;
+    uint32_t _checksum = 0;
+    // Only with block checksums: the ones of the finished blocks, and the
+    // checksum and bytes of the block being written
+    std::vector<uint32_t> _block_checksums;
+    uint32_t _block_checksum = 0;
+    std::size_t _block_fill = 0;
+
+    // Calculates the number of elements and byte offset of each column
+    void _compute_layout() {
+        std::size_t total_ranks_so_far = 0;
+        for (std::size_t i = 0; i < n_cols; i++) {
+            const auto column_rank = _ranks[i];
+            if (total_ranks_so_far + column_rank > _sizes.size()) {
+                throw std::invalid_argument("The number of column sizes "
+                                            "does not match the column ranks.");
+            }
+
+            std::size_t num_elements = 1;
+            for (std::size_t j = 0; j < column_rank; j++) {
+                num_elements *= _sizes[total_ranks_so_far + j];
+            }
+
+            if (fixed_extents[i] != std::dynamic_extent
+                and fixed_extents[i] != num_elements) {
+                throw std::invalid_argument("Column " + _names[i] + " is fixed "
+                    "to " + std::to_string(fixed_extents[i]) + " elements but "
+                    "its sizes give " + std::to_string(num_elements) + ".");
+            }
+
+            _col_num_elements[i] = num_elements;
+            _col_offsets[i] = _line_byte_size;
+            if (parameters_types_str[i] == "uint16" and _packed_bits[i] == 0
+                and column_rank > 0) {
+                const auto row_length = _sizes[total_ranks_so_far + column_rank - 1];
+                if (row_length > 1) {
+                    _delta_rows.push_back({_line_byte_size, row_length,
+                                           num_elements / row_length});
+                }
+            }
+            if (_packed_bits[i] > 0) {
+                _line_byte_size += BitPacking::packed_size(num_elements,
+                                                           _packed_bits[i]);
+            } else {
+                _line_byte_size += size_of_types[i]*num_elements;
+            }
+            total_ranks_so_far += column_rank;
+        }
+
+        _line_buffer.reserve(_line_byte_size);
+    }
+
+    template<typename T>
+    void _append_number(const T& num, std::string& buffer) {
+        buffer.append(reinterpret_cast<const char*>(&num), sizeof(T));
+    }
+
+    [[nodiscard]] bool _is_v2() const noexcept {
+        return not _run_constants.empty() or _compression.enabled()
+            or _checksum_options.BlockChecksums;
+    }
+
+    [[nodiscard]] uint32_t _flags() const noexcept {
+        if (not _is_v2()) {
+            return 0;
+        }
+
+        uint32_t flags = Tools::kFlagTrailer
+            | (_checksum_options.BlockChecksums ? Tools::kFlagBlockChecksums : 0);
+        if (_compression.enabled()) {
+            flags |= Tools::kFlagCompressed
+                | (_compression.DeltaFilter ? Tools::kFlagDeltaFilter : 0);
+        }
+        return flags;
+    }
+
+    [[nodiscard]] bool _has_trailer() const noexcept {
+        return (_flags() & Tools::kFlagTrailer) != 0;
+    }
+
+    // Every byte after the header goes through here
+    void _write_data(const char* data, const std::size_t& size) {
+        _stream.write(data, static_cast<std::streamsize>(size));
+        if (_has_trailer()) {
+            _checksum = Checksum::crc32c({data, size}, _checksum);
+        }
+
+        if (_checksum_options.BlockChecksums) {
+            _checksum_blocks(data, size);
+        }
+    }
+
+    // Bytes of a block, 0 for compressed files where every chunk is a block
+    [[nodiscard]] std::size_t _block_bytes() const noexcept {
+        return _compression.enabled() ? 0
+            : _checksum_options.BlockLines*_line_byte_size;
+    }
+
+    // Compressed files end their block after every chunk, see _write_chunks
+    void _checksum_blocks(const char* data, std::size_t size) {
+        const auto block_bytes = _block_bytes();
+        while (size > 0) {
+            const auto n = block_bytes == 0 ? size
+                : std::min(size, block_bytes - _block_fill);
+            _block_checksum = Checksum::crc32c({data, n}, _block_checksum);
+            _block_fill += n;
+            data += n;
+            size -= n;
+            if (_block_fill == block_bytes) {
+                _end_block();
+            }
+        }
+    }
+
+    void _end_block() {
+        if (_block_fill == 0) {
+            return;
+        }
+
+        _block_checksums.push_back(_block_checksum);
+        _block_checksum = 0;
+        _block_fill = 0;
+    }
+
+    // Flushes the lines first so the count never includes lines that are
+    // not in the file yet.
+    void _update_header() {
+        _stream.flush();
+        Tools::write_num_lines(_header_stream, _header_size, _num_events_written);
+        _last_header_update = std::chrono::steady_clock::now();
+    }
+
+    void _update_header_if_due() {
+        if (std::chrono::steady_clock::now() - _last_header_update
+            >= kHeaderUpdatePeriod) {
+            _update_header();
+        }
+    }
+
+    void _write_trailer() {
+        _summary.NumEvents = _num_events_written;
+        _summary.DataBytes = _file_size - _header_size;
+        _summary.Checksum = _checksum;
+        _summary.LastClosed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        Tools::write_trailer(_stream, _summary);
+    }
+
+    // Parts 2 and 3 of the header: the layout of the lines
+    std::string _build_data_header() {
+        std::string data_header;
+        std::size_t total_ranks_so_far = 0;
+        for (std::size_t i = 0; i < n_cols; i++) {
+            auto column_rank = _ranks[i];
+            const std::string type = _packed_bits[i] > 0
+                ? Tools::packed_type_to_string(_packed_bits[i])
+                : std::string(parameters_types_str[i]);
+            data_header += Tools::column_header(_names[i], type,
+                std::span(_sizes).subspan(total_ranks_so_far, column_rank));
+            total_ranks_so_far += column_rank;
+        }
+
+        std::string buffer;
+        _append_number(static_cast<uint16_t>(data_header.length()), buffer);
+        return buffer + data_header;
+    }
+
+    std::string _build_header() {
+        std::string buffer;
+        if (not _is_v2()) {
+            _append_number(Tools::endianness_word(), buffer); // 1.
+        } else {
+            buffer += Tools::kFileMagic; // v2 1.
+            buffer += static_cast<char>(Tools::kFileVersion);
+            _append_number(Tools::endianness_word(), buffer); // v2 2.
+            _append_number(_flags(), buffer); // v2 3.
+            // has to be uint16_t because we are saving it to the file later
+            _append_number(static_cast<uint16_t>(_run_constants.header().length()),
+                           buffer); // v2 4.
+            buffer += _run_constants.header(); // v2 5.
+            buffer += _run_constants.payload(); // v2 6.
+        }
+
+        buffer += _build_data_header(); // 2. and 3.
+        // For dynamic files, this is always 0!
+        _append_number(int32_t{0}, buffer); // 4.
+        // Done!
+        return buffer;
+    }
+
+    // Save item from tuple in position i to the line that starts at line
+    template<std::size_t i>
+    void _save_item(const tuple_type& items, char* line) {
+        const auto& item = std::get<i>(items);
+
+        using T = std::remove_cv_t<typename std::tuple_element_t<i,
+                                                                 tuple_type>::element_type>;
+        char* column = line;
+        if constexpr (fixed_offsets[i] != std::dynamic_extent) {
+            column += fixed_offsets[i];
+        } else {
+            column += _col_offsets[i];
+        }
+
+        // Fixed columns are never packed and their size is a constant
+        if constexpr (fixed_extents[i] != std::dynamic_extent) {
+            if (item.size() != fixed_extents[i]) {
+                throw std::out_of_range("memory is out of range");
+            }
+
+            std::memcpy(column, item.data(), fixed_extents[i]*sizeof(T));
+            return;
+        }
+
+        if (_col_num_elements[i] != item.size()) {
+            throw std::out_of_range("memory is out of range");
+        }
+
+        if constexpr (std::is_same_v<T, uint16_t>) {
+            if (_packed_bits[i] > 0) {
+                BitPacking::pack(item, _packed_bits[i], column);
+                return;
+            }
+        }
+
+        std::memcpy(column, item.data(), item.size_bytes());
+    }
+
+    // Only uint16 columns that are not fixed can be packed, and to less
+    // than 16 bits
+    template<std::size_t... I>
+    void _check_packed_bits(std::index_sequence<I...>) const {
+        const std::array<bool, n_cols> packable = {
+            (std::is_same_v<std::remove_cv_t<Tools::column_type_t<DataTypes>>,
+                            uint16_t>
+             and fixed_extents[I] == std::dynamic_extent)...};
+        for (std::size_t i = 0; i < n_cols; i++) {
+            if (_packed_bits[i] > 0 and (not packable[i]
+                or _packed_bits[i] >= BitPacking::kMaxBits)) {
+                throw std::invalid_argument("Column " + _names[i] + " cannot "
+                    "be packed to " + std::to_string(_packed_bits[i])
+                    + " bits.");
+            }
+        }
+    }
+
+    // Think of t his function as a wrapper between _save_item
+    // and _save_data
+    template<std::size_t... I>
+    void _save_item_helper(const tuple_type& data, char* line,
+                           std::index_sequence<I...>) {
+        (_save_item<I>(data, line),...);
+    }
+
+    // Lays out all the columns of an event starting at line.
+    // line must have at least _line_byte_size bytes.
+    void _serialize_event(const tuple_type& data, char* line) {
+        _save_item_helper(data, line, std::make_index_sequence<n_cols>{});
+    }
+
+    void _save_event(const tuple_type& data) {
+        if (_compression.enabled()) {
+            _buffer_event(data);
+            return;
+        }
+
+        _serialize_event(data, _line_buffer.data());
+        _write_data(_line_buffer.data(), _line_byte_size);
+        _file_size += _line_byte_size;
+        _num_events++;
+        _num_events_written++;
+    }
+
+    void _setup_compression() {
+        if (not _compression.enabled()) {
+            return;
+        }
+
+        if (_compression.ChunkEvents == 0) {
+            throw std::invalid_argument("Compressed chunks cannot have 0 "
+                                        "events.");
+        }
+
+        if (not _compression.DeltaFilter) {
+            _delta_rows.clear();
+        }
+
+        _pool = std::make_unique<WorkerPool>(_compression.NumThreads);
+        const std::size_t chunk_bytes = _compression.ChunkEvents*_line_byte_size;
+        for (std::size_t i = 0; i < _pool->size(); i++) {
+            _compressors.emplace_back(_compression.Level);
+        }
+        _compressed_chunks.resize(_pool->size(),
+            std::vector<char>(ChunkCompression::compress_bound(chunk_bytes)));
+        _compressed_sizes.resize(_pool->size());
+        _chunks_buffer_capacity = _pool->size()*_compression.ChunkEvents;
+        _chunks_buffer.reserve(_chunks_buffer_capacity*_line_byte_size);
+    }
+
+    // Where the data of the file being appended to ends, found by
+    // data_end(size of the file without its trailer and block checksums).
+    // The run summary and checksums are kept if they match that data,
+    // otherwise they are computed again from the file.
+    template<typename DataEnd>
+    std::size_t _resume_data(const MemoryMappedFile& file, DataEnd data_end) {
+        std::size_t size = file.size();
+        std::optional<Tools::RunSummary> trailer;
+        std::optional<Tools::BlockChecksums> blocks;
+        if (_has_trailer()) {
+            trailer = Tools::read_trailer(file.data(), size, _header_size);
+            if (trailer) {
+                size -= Tools::kTrailerSize;
+            }
+        }
+
+        if (trailer and _checksum_options.BlockChecksums) {
+            blocks = Tools::read_block_checksums(file.data(), size, _header_size);
+            if (blocks) {
+                size -= blocks->ByteSize;
+            }
+        }
+
+        const std::size_t end = data_end(size);
+        const bool trailer_matches = trailer
+            and trailer->DataBytes == end - _header_size;
+        if (trailer_matches) {
+            _summary = *trailer;
+            _checksum = trailer->Checksum;
+        } else if (_has_trailer()) {
+            _checksum = Checksum::crc32c({file.data() + _header_size,
+                                         end - _header_size});
+        }
+
+        if (_checksum_options.BlockChecksums) {
+            _resume_blocks(file, end, trailer_matches ? blocks : std::nullopt);
+        }
+
+        return end;
+    }
+
+    // The block being written when the file was closed is continued
+    void _resume_blocks(const MemoryMappedFile& file, const std::size_t& end,
+                        const std::optional<Tools::BlockChecksums>& blocks) {
+        const auto block_bytes = _block_bytes();
+        const auto ranges = Tools::block_ranges(_header_size, end, block_bytes,
+                                                _chunk_index);
+        if (blocks and blocks->Checksums.size() == ranges.size()
+            and blocks->BlockLines == (block_bytes == 0 ? 0
+                                       : _checksum_options.BlockLines)) {
+            _block_checksums = blocks->Checksums;
+        } else {
+            _block_checksums = Tools::compute_block_checksums(file.data(),
+                                                              ranges);
+        }
+
+        if (block_bytes > 0 and not ranges.empty()
+            and ranges.back().second - ranges.back().first < block_bytes) {
+            _block_checksum = _block_checksums.back();
+            _block_fill = ranges.back().second - ranges.back().first;
+            _block_checksums.pop_back();
+        }
+    }
+
+    // Appending to a compressed file: the old index is read so the new one
+    // also has the old chunks. The index and trailer (or an incomplete
+    // chunk left by a crash) are cut from the file before anything else is
+    // written.
+    void _resume_compressed_file() {
+        {
+            MemoryMappedFile file(_file_name);
+            _file_size = _resume_data(file, [&](const std::size_t& size) {
+                auto index = Tools::read_chunk_index(file.data(), size,
+                                                     _header_size);
+                _chunk_index = std::move(index.Chunks);
+                _num_events = index.NumEvents;
+                return index.DataEnd;
+            });
+            _num_events_written = _num_events;
+        }
+
+        std::filesystem::resize_file(_file_name, _file_size);
+    }
+
+    // Appending needs the header of the file to be header, but for the
+    // number of lines. Throws RunConstantsChanged if only the run constants
+    // are different and std::runtime_error if anything else is.
+    void _check_file_header(const std::string& header) {
+        const auto incompatible = std::runtime_error("File being written to "
+            "has an incompatible header format. Details:\n\t File = "
+            + _file_name);
+        FileHeader current;
+        std::string current_header;
+        try {
+            MemoryMappedFile file(_file_name);
+            current = Tools::parse_header(file.data(), file.size());
+            current_header.assign(file.data(),
+                                  current.HeaderByteSize - sizeof(int32_t));
+        } catch (std::runtime_error&) {
+            throw incompatible;
+        }
+
+        const auto fixed_size = header.length() - sizeof(int32_t);
+        if (current_header == std::string_view(header).substr(0, fixed_size)) {
+            return;
+        }
+
+        const uint8_t version = _is_v2() ? Tools::kFileVersion : 1;
+        if (current.Version == version and current.Flags == _flags()
+            and current_header.ends_with(_build_data_header())) {
+            throw RunConstantsChanged("File being written to was taken with "
+                "other run constants. Details:\n\t File = " + _file_name);
+        }
+
+        throw incompatible;
+    }
+
+    // Appending to an uncompressed file: the trailer, or an incomplete line
+    // left by a crash, is cut so the new lines start where they should.
+    void _resume_file() {
+        {
+            MemoryMappedFile file(_file_name);
+            _file_size = _resume_data(file, [&](const std::size_t& size) {
+                _num_events = (size - _header_size) / _line_byte_size;
+                return _header_size + _num_events*_line_byte_size;
+            });
+            _num_events_written = _num_events;
+        }
+
+        std::filesystem::resize_file(_file_name, _file_size);
+    }
+
+    void _buffer_event(const tuple_type& data) {
+        _serialize_event(data, _chunks_buffer.data()
+                               + _chunks_buffer_events*_line_byte_size);
+        _num_events++;
+        if (++_chunks_buffer_events == _chunks_buffer_capacity) {
+            _write_chunks();
+        }
+    }
+
+    // Compresses the buffered events, one chunk per worker, and writes the
+    // chunks in order. Throws std::runtime_error if a chunk could not be
+    // compressed.
+    void _write_chunks() {
+        if (_chunks_buffer_events == 0) {
+            return;
+        }
+
+        const auto chunk_events = _compression.ChunkEvents;
+        const auto num_chunks = (_chunks_buffer_events + chunk_events - 1)
+            / chunk_events;
+        _pool->for_each_chunk(num_chunks, [&](std::size_t begin, std::size_t end,
+                                              std::size_t worker) {
+            for (std::size_t c = begin; c < end; c++) {
+                const auto first = c*chunk_events;
+                const auto n = std::min(chunk_events, _chunks_buffer_events - first);
+                char* lines = _chunks_buffer.data() + first*_line_byte_size;
+                Tools::delta_filter_lines(lines, n, _line_byte_size, _delta_rows,
+                                          true);
+                _compressed_sizes[c] = _compressors[worker].compress(
+                    {lines, n*_line_byte_size}, _compressed_chunks[c]);
+            }
+        });
+
+        for (std::size_t c = 0; c < num_chunks; c++) {
+            if (_compressed_sizes[c] == 0) {
+                _chunks_buffer_events = 0;
+                throw std::runtime_error("Failed to compress a chunk of "
+                                         + _file_name);
+            }
+
+            const auto n = static_cast<uint32_t>(std::min(chunk_events,
+                _chunks_buffer_events - c*chunk_events));
+            const auto compressed_size = static_cast<uint32_t>(_compressed_sizes[c]);
+            std::array<char, Tools::kChunkHeaderSize> chunk_header;
+            std::memcpy(chunk_header.data(), &n, sizeof(uint32_t));
+            std::memcpy(chunk_header.data() + sizeof(uint32_t), &compressed_size,
+                        sizeof(uint32_t));
+            _write_data(chunk_header.data(), chunk_header.size());
+            _write_data(_compressed_chunks[c].data(), compressed_size);
+            if (_checksum_options.BlockChecksums) {
+                _end_block();
+            }
+
+            _chunk_index.push_back({_file_size, _num_events_written});
+            _num_events_written += n;
+            _file_size += Tools::kChunkHeaderSize + compressed_size;
+        }
+
+        _chunks_buffer_events = 0;
+    }
+
+ public:
+    // If run_constants is not empty, the file is written in the v2 format
+    // with the constants in its header.
+    // packed_bits[i] > 0 bit packs column i to that many bits per element
+    // (see BitPacking.hpp). Only uint16 columns can be packed, and to less
+    // than 16 bits, otherwise it throws std::invalid_argument.
+    // If compression is enabled, the events are buffered and written in
+    // compressed chunks (see CompressionOptions); the last ones are only
+    // written by flush() or the destructor.
+    // If checksums.BlockChecksums is set, the file is v2 and the checksum
+    // of every block of data is saved when it is closed.
+    // An existing file is appended to if its header matches, whatever its
+    // number of lines.
+    DynamicWriter(std::string_view file_name,
+                  const std::array<std::string, n_cols>& columns_names,
+                  const std::array<std::size_t, n_cols>& columns_ranks,
+                  const std::vector<std::size_t>& columns_sizes,
+                  const RunConstants& run_constants = {},
+                  const std::array<uint8_t, n_cols>& packed_bits = {},
+                  const CompressionOptions& compression = {},
+                  const ChecksumOptions& checksums = {}) :
+        _file_name{file_name},
+        _names{columns_names},
+        _ranks{columns_ranks},
+        _sizes{columns_sizes},
+        _run_constants{run_constants},
+        _packed_bits{packed_bits},
+        _compression{compression},
+        _checksum_options{checksums}
+    {
+        total_ranks = std::accumulate(columns_ranks.begin(),
+                                      columns_ranks.end(), 0);
+        _check_packed_bits(std::make_index_sequence<n_cols>{});
+        _compute_layout();
+        if (_checksum_options.BlockChecksums and not _compression.enabled()
+            and _checksum_options.BlockLines == 0) {
+            throw std::invalid_argument("Checksum blocks cannot have 0 lines.");
+        }
+
+        _setup_compression();
+
+        const std::string header = _build_header();
+        _header_size = header.length();
+        _file_size = header.length();
+        bool created = false;
+        if (std::filesystem::exists(file_name)) {
+            if (std::filesystem::is_empty(file_name)) {
+                // If file is empty or does not exist, then we
+                // open it and write to it.
+                _stream.open(_file_name, std::ios::app | std::ofstream::binary);
+                if (_stream.is_open()) {
+                    _open = true;
+                    created = true;
+                    _stream << header;
+                }
+            } else {
+                _check_file_header(header);
+                if (_compression.enabled()) {
+                    _resume_compressed_file();
+                } else {
+                    _resume_file();
+                }
+
+                // We do not write anything.
+                _stream.open(_file_name, std::ios::app | std::ofstream::binary);
+                _open = _stream.is_open();
+
+            }
+        } else {
+            _stream.open(_file_name, std::ios::app | std::ofstream::binary);
+            if (_stream.is_open()) {
+                _open = true;
+                created = true;
+                _stream << header;
+            }
+        }
+
+        if (_open) {
+            _stream.flush();
+            _header_stream.open(_file_name, std::ios::in | std::ios::out
+                                | std::ios::binary);
+            _open = _header_stream.is_open();
+            _last_header_update = std::chrono::steady_clock::now();
+        }
+
+        _summary.Sessions++;
+        if (created) {
+            _summary.FirstOpened = std::chrono::duration_cast<
+                std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    bool isOpen() { return _open; }
+
+    ~DynamicWriter() {
+        if (_open) {
+            // Destructors cannot throw. If the chunks or the trailer cannot
+            // be written, the lines already in the file can still be read
+            // and recover_file(...) can finish closing it.
+            try {
+                if (_compression.enabled()) {
+                    _write_chunks();
+                    Tools::write_chunk_index(_stream, _chunk_index,
+                                             _num_events_written);
+                }
+
+                if (_checksum_options.BlockChecksums) {
+                    _end_block();
+                    Tools::write_block_checksums(_stream, _block_checksums,
+                        _compression.enabled() ? 0 : _checksum_options.BlockLines);
+                }
+
+                if (_has_trailer()) {
+                    _write_trailer();
+                }
+
+                _update_header();
+            } catch (std::exception& err) {
+                spdlog::error("Failed to close {0}: {1}", _file_name, err.what());
+            }
+        }
+
+        _open = false;
+        _stream.flush();
+        _stream.close();
+    }
+
+    // Writes the events buffered for compression, even if their chunk is
+    // not full yet, flushes the file and updates its number of lines.
+    void flush() {
+        if (not _open) {
+            return;
+        }
+
+        if (_compression.enabled()) {
+            _write_chunks();
+        }
+        _update_header();
+    }
+
+    // Size in bytes of a single event (line) in the file. For compressed
+    // files, before being compressed.
+    [[nodiscard]] const std::size_t& getLineByteSize() const noexcept {
+        return _line_byte_size;
+    }
+
+    // Bytes handed to the file so far, header included. Compressed events
+    // only count once their chunk is written.
+    [[nodiscard]] const std::size_t& getFileSize() const noexcept {
+        return _file_size;
+    }
+
+    [[nodiscard]] const std::size_t& getHeaderByteSize() const noexcept {
+        return _header_size;
+    }
+
+    // Events saved to the file, including the ones it had when opened.
+    // Also counts compressed events that were not written yet.
+    [[nodiscard]] const uint64_t& getNumEvents() const noexcept {
+        return _num_events;
+    }
+
+    [[nodiscard]] bool isCompressed() const noexcept {
+        return _compression.enabled();
+    }
+
+    void save(std::span<Tools::column_type_t<DataTypes>>... data) {
+        if(_open) {
+            _save_event(std::make_tuple(data...));
+            _update_header_if_due();
+        }
+    }
+
+    // Saves all the events in one go. The events are laid out one after
+    // the other in a single reusable buffer and written with one write
+    // call per kMaxBatchBytes, which is much cheaper than calling save(...)
+    // per event. The buffer is capped so it stays in cache, see
+    // kMaxBatchBytes.
+    // Same as save(...), throws std::out_of_range if any of the columns
+    // does not have the expected size.
+    void save_batch(std::span<const tuple_type> events) {
+        if (not _open or events.empty()) {
+            return;
+        }
+
+        // Already laid out one after the other in the chunks buffer
+        if (_compression.enabled()) {
+            for (const auto& event : events) {
+                _buffer_event(event);
+            }
+            _update_header_if_due();
+            return;
+        }
+
+        const std::size_t events_per_write = std::clamp<std::size_t>(
+            kMaxBatchBytes / _line_byte_size, 1, events.size());
+        _batch_buffer.reserve(_line_byte_size*events_per_write);
+
+        while (not events.empty()) {
+            const auto n = std::min(events_per_write, events.size());
+            char* line = _batch_buffer.data();
+            for (const auto& event : events.first(n)) {
+                _serialize_event(event, line);
+                line += _line_byte_size;
+            }
+
+            _write_data(_batch_buffer.data(), _line_byte_size*n);
+            _file_size += _line_byte_size*n;
+            _num_events += n;
+            _num_events_written += n;
+            events = events.subspan(n);
+        }
+
+        _update_header_if_due();
+    }
+};
+
+// Random access reader for files written by DynamicWriter, v1 or v2.
+//
+// The file is memory mapped so nothing is read until it is accessed and
+// every column is returned as a std::span that points directly into the
+// mapping: no copies. The spans are valid as long as the Reader is alive.
+//
+// If DataTypes is given, the columns of the file are checked against them
+// and get<c>(i) / event(i) return typed spans. Reader<> skips that check
+// and only gives access to the raw bytes of each column.
+//
+// Note: the header length is not padded, so the columns are in general not
+// aligned to their types. Unaligned loads are fine in x86-64 and ARMv8.
+//
+// Bit packed columns cannot be returned as spans into the mapping: get<c>(i),
+// event(i) and stream() throw std::runtime_error for them. Use unpack(...),
+// which also works for uint16 columns that are not packed.
+//
+// Compressed files are read one chunk at a time: accessing an event
+// decompresses its whole chunk into a cache, and the spans point into that
+// cache instead of the mapping. They are only valid until an event of
+// another chunk is accessed, and a Reader of a compressed file cannot be
+// shared between threads.
+//
+// Throws std::runtime_error if the file cannot be mapped, or its header is
+// malformed or does not match DataTypes.
+template<typename... DataTypes>
+requires Tools::is_arithmetic_ptr_unpack<DataTypes...>
+class Reader {
+ public:
+    constexpr static std::size_t n_cols = sizeof...(DataTypes);
+    constexpr static bool is_typed = n_cols > 0;
+    using event_type = std::tuple<std::span<const DataTypes>...>;
+    // Bytes behind a stream iterator that are kept mapped before being
+    // released back to the OS.
+    constexpr static std::size_t kDefaultStreamWindow = 64*1024*1024;
+
+ private:
+    MemoryMappedFile _file;
+    FileHeader _header;
+    std::size_t _num_events = 0;
+    // Only files that were closed properly have it
+    std::optional<Tools::RunSummary> _summary;
+    std::optional<Tools::BlockChecksums> _block_checksums;
+
+    // Only used by compressed files
+    std::vector<Tools::ChunkIndexEntry> _chunks;
+    std::size_t _data_end = 0;
+    std::vector<Tools::DeltaRows> _delta_rows;
+    mutable std::optional<ChunkCompression::Decompressor> _decompressor;
+    mutable Tools::AlignedBuffer<> _chunk_cache;
+    mutable std::size_t _cached_chunk = std::numeric_limits<std::size_t>::max();
+    mutable std::size_t _cached_chunk_events = 0;
+
+    // Sidecar index, loaded the first time it is needed
+    mutable std::optional<EventIndex> _event_index;
+
+    template<std::size_t... I>
+    void _check_types(std::index_sequence<I...>) const {
+        if (not (Tools::is_type_string_of<DataTypes>(_header.Columns[I].Type)
+                 and ...)) {
+            throw std::runtime_error("File " + _file.name() + " columns "
+                                     "types do not match the Reader types.");
+        }
+    }
+
+    [[nodiscard]] bool _is_compressed() const noexcept {
+        return (_header.Flags & Tools::kFlagCompressed) != 0;
+    }
+
+    const char* _line(const std::size_t& i) const {
+        if (_is_compressed()) {
+            return _chunk_line(i);
+        }
+
+        return _file.data() + _header.HeaderByteSize
+            + i*_header.LineByteSize;
+    }
+
+    // Where event i is found in the file, in bytes
+    [[nodiscard]] std::size_t _file_offset(const std::size_t& i) const {
+        if (not _is_compressed()) {
+            return _header.HeaderByteSize + i*_header.LineByteSize;
+        }
+
+        if (i >= _num_events) {
+            return _data_end;
+        }
+
+        return _find_chunk(i)->Offset;
+    }
+
+    auto _find_chunk(const std::size_t& i) const {
+        return std::prev(std::upper_bound(_chunks.begin(), _chunks.end(), i,
+            [](const std::size_t& event, const Tools::ChunkIndexEntry& chunk) {
+                return event < chunk.FirstEvent;
+            }));
+    }
+
+    const char* _chunk_line(const std::size_t& i) const {
+        const auto chunk = _find_chunk(i);
+        const auto chunk_num = static_cast<std::size_t>(chunk - _chunks.begin());
+        if (chunk_num != _cached_chunk) {
+            _load_chunk(*chunk);
+            _cached_chunk = chunk_num;
+        }
+
+        const auto line_num = i - chunk->FirstEvent;
+        if (line_num >= _cached_chunk_events) {
+            throw std::runtime_error("File " + _file.name() + " chunk index "
+                                     "does not match its chunks.");
+        }
+
+        return _chunk_cache.data() + line_num*_header.LineByteSize;
+    }
+
+    void _load_chunk(const Tools::ChunkIndexEntry& chunk) const {
+        // Nothing valid is left in the cache if this fails
+        _cached_chunk = std::numeric_limits<std::size_t>::max();
+        _cached_chunk_events = 0;
+
+        auto [n, compressed_size] = Tools::chunk_header(_file.data() + chunk.Offset);
+        const std::size_t size = n*_header.LineByteSize;
+        _chunk_cache.reserve(size);
+        const auto decompressed = _decompressor->decompress(
+            {_file.data() + chunk.Offset + Tools::kChunkHeaderSize, compressed_size},
+            {_chunk_cache.data(), size});
+        if (decompressed != size) {
+            throw std::runtime_error("File " + _file.name() + " has a "
+                                     "corrupted chunk at byte "
+                                     + std::to_string(chunk.Offset));
+        }
+
+        Tools::delta_filter_lines(_chunk_cache.data(), n, _header.LineByteSize,
+                                  _delta_rows, false);
+        _cached_chunk_events = n;
+    }
+
+    // Same rows the DynamicWriter delta encoded
+    void _setup_compression(const std::size_t& data_size) {
+        const auto index = Tools::read_chunk_index(_file.data(), data_size,
+                                                   _header.HeaderByteSize);
+        _chunks = index.Chunks;
+        _num_events = index.NumEvents;
+        _data_end = index.DataEnd;
+        _decompressor.emplace();
+
+        if ((_header.Flags & Tools::kFlagDeltaFilter) == 0) {
+            return;
+        }
+
+        for (const auto& column : _header.Columns) {
+            if (column.Type != "uint16" or column.Sizes.empty()) {
+                continue;
+            }
+
+            const auto row_length = column.Sizes.back();
+            if (row_length > 1) {
+                _delta_rows.push_back({column.Offset, row_length,
+                                       column.NumElements / row_length});
+            }
+        }
+    }
+
+    std::pair<const ColumnDescription*, std::span<const char>>
+    _find_constant(std::string_view name) const {
+        for (const auto& constant : _header.Constants) {
+            if (constant.Name == name) {
+                return {&constant, {_file.data() + _header.ConstantsOffset
+                                    + constant.Offset, constant.ByteSize}};
+            }
+        }
+
+        // v1 files
+        if (_num_events > 0) {
+            for (const auto& column : _header.Columns) {
+                if (column.Name == name) {
+                    return {&column, {_line(0) + column.Offset,
+                                      column.ByteSize}};
+                }
+            }
+        }
+
+        throw std::out_of_range("Constant " + std::string(name)
+                                + " not found in file.");
+    }
+
+    template<std::size_t... I>
+    event_type _event(const std::size_t& i, std::index_sequence<I...>) const {
+        return std::make_tuple(get<I>(i)...);
+    }
+
+ public:
+    explicit Reader(std::string_view file_name) :
+        _file{file_name},
+        _header{Tools::parse_header(_file.data(), _file.size())}
+    {
+        if constexpr (is_typed) {
+            if (_header.Columns.size() != n_cols) {
+                throw std::runtime_error("File " + _file.name() + " does not "
+                                         "have the same number of columns "
+                                         "as the Reader.");
+            }
+
+            _check_types(std::make_index_sequence<n_cols>{});
+        }
+
+        std::size_t data_size = _file.size();
+        if ((_header.Flags & Tools::kFlagTrailer) != 0) {
+            _summary = Tools::read_trailer(_file.data(), data_size,
+                                           _header.HeaderByteSize);
+            if (_summary) {
+                data_size -= Tools::kTrailerSize;
+            }
+        }
+
+        if (_summary and (_header.Flags & Tools::kFlagBlockChecksums) != 0) {
+            _block_checksums = Tools::read_block_checksums(_file.data(),
+                data_size, _header.HeaderByteSize);
+            if (_block_checksums) {
+                data_size -= _block_checksums->ByteSize;
+            }
+        }
+
+        // Number of events comes from the file size so files that are being
+        // written or were not closed properly can be read. An incomplete
+        // line at the end is ignored. It is capped by the number of lines
+        // of the header, which the writer only updates once the lines are
+        // in the file.
+        if (_is_compressed()) {
+            _setup_compression(data_size);
+        } else if (_header.LineByteSize > 0) {
+            _num_events = (data_size - _header.HeaderByteSize)
+                / _header.LineByteSize;
+        }
+
+        if (_header.NumLines > 0) {
+            _num_events = std::min(_num_events,
+                                   static_cast<std::size_t>(_header.NumLines));
+        }
+    }
+
+    [[nodiscard]] const FileHeader& header() const noexcept { return _header; }
+    [[nodiscard]] const std::size_t& size() const noexcept { return _num_events; }
+    [[nodiscard]] bool empty() const noexcept { return _num_events == 0; }
+    [[nodiscard]] const std::string& name() const noexcept { return _file.name(); }
+
+    // Run summary saved by the writer when it closed the file. Empty for v1
+    // files and files that were not closed properly, see recover_file(...).
+    [[nodiscard]] const std::optional<Tools::RunSummary>& summary() const noexcept {
+        return _summary;
+    }
+
+    // True if the checksum of the run summary matches the data. Reads the
+    // whole file. False if the file does not have a run summary.
+    [[nodiscard]] bool verify_checksum() const {
+        if (not _summary) {
+            return false;
+        }
+
+        return Checksum::crc32c({_file.data() + _header.HeaderByteSize,
+                                 _summary->DataBytes}) == _summary->Checksum;
+    }
+
+    // Checksums of every block of data saved when the file was closed.
+    // Empty if the file does not have them, see ChecksumOptions.
+    [[nodiscard]] const std::optional<Tools::BlockChecksums>&
+    block_checksums() const noexcept {
+        return _block_checksums;
+    }
+
+    // Events [first, last) of the blocks whose checksum does not match their
+    // data. The blocks are split between num_threads threads (0 = one per
+    // hardware thread). Throws std::runtime_error if the file does not have
+    // block checksums or they do not match its blocks.
+    [[nodiscard]] std::vector<std::pair<uint64_t, uint64_t>>
+    find_corrupted_blocks(const std::size_t& num_threads = 1) const {
+        if (not _block_checksums) {
+            throw std::runtime_error("File " + _file.name() + " does not "
+                                     "have block checksums.");
+        }
+
+        const auto& checksums = _block_checksums->Checksums;
+        const uint64_t block_lines = _block_checksums->BlockLines;
+        const auto ranges = Tools::block_ranges(_header.HeaderByteSize,
+            _header.HeaderByteSize + _summary->DataBytes,
+            block_lines*_header.LineByteSize, _chunks);
+        if (ranges.size() != checksums.size()) {
+            throw std::runtime_error("File " + _file.name() + " block "
+                                     "checksums do not match its blocks.");
+        }
+
+        // Not std::vector<bool>: every worker writes its own elements
+        std::vector<uint8_t> corrupted(ranges.size(), 0);
+        WorkerPool pool(num_threads);
+        pool.for_each_chunk(ranges.size(), [&](std::size_t begin,
+                                               std::size_t end, std::size_t) {
+            for (auto b = begin; b < end; b++) {
+                const auto& [first_byte, last_byte] = ranges[b];
+                corrupted[b] = Checksum::crc32c({_file.data() + first_byte,
+                    last_byte - first_byte}) != checksums[b];
+            }
+        });
+
+        std::vector<std::pair<uint64_t, uint64_t>> out;
+        for (std::size_t b = 0; b < ranges.size(); b++) {
+            if (not corrupted[b]) {
+                continue;
+            }
+
+            if (block_lines == 0) {
+                out.emplace_back(_chunks[b].FirstEvent, b + 1 < _chunks.size()
+                    ? _chunks[b + 1].FirstEvent : _num_events);
+            } else {
+                out.emplace_back(b*block_lines,
+                    std::min<uint64_t>((b + 1)*block_lines, _num_events));
+            }
+        }
+
+        return out;
+    }
+
+    // Where the line of event i starts in the file. For compressed files,
+    // where its chunk starts.
+    [[nodiscard]] std::size_t file_offset(const std::size_t& i) const {
+        return _file_offset(i);
+    }
+
+    // First event of every chunk of a compressed file, in order. Empty if
+    // the file is not compressed.
+    [[nodiscard]] std::vector<uint64_t> chunk_first_events() const {
+        std::vector<uint64_t> out;
+        out.reserve(_chunks.size());
+        for (const auto& chunk : _chunks) {
+            out.push_back(chunk.FirstEvent);
+        }
+
+        return out;
+    }
+
+    // Position of the column with name. Throws std::out_of_range if the
+    // file does not have it.
+    [[nodiscard]] std::size_t column_index(std::string_view name) const {
+        for (std::size_t c = 0; c < _header.Columns.size(); c++) {
+            if (_header.Columns[c].Name == name) {
+                return c;
+            }
+        }
+
+        throw std::out_of_range("Column " + std::string(name)
+                                + " not found in file.");
+    }
+
+    // Sidecar index of the file (see EventIndex), loaded the first time it
+    // is needed. Throws std::runtime_error if the file does not have one,
+    // see rebuild_event_index(...).
+    // Events are already found by number in O(1), or O(log n) through
+    // the chunk index for compressed files, so the index is only needed to
+    // find them by time.
+    [[nodiscard]] const EventIndex& event_index() const {
+        if (not _event_index) {
+            _event_index.emplace(EventIndex::sidecar_name(_file.name()));
+        }
+
+        return *_event_index;
+    }
+
+    // First event whose trigger time, with its roll overs counted (see
+    // TriggerTimeUnwrapper), is at or after trigger_time. The index finds
+    // the event at most stride events before it and the "time_stamp"
+    // column is read from there. Returns size() if there is none.
+    [[nodiscard]] std::size_t find_trigger_time(const uint64_t& trigger_time) const {
+        const auto& index = event_index();
+        const auto column = column_index("time_stamp");
+        if (index.empty() or trigger_time < index.entries().front().TriggerTime) {
+            return 0;
+        }
+
+        const auto& entry = index.find_trigger_time(trigger_time);
+        TriggerTimeUnwrapper unwrap(entry.TriggerTime);
+        for (std::size_t i = entry.EventNumber; i < _num_events; i++) {
+            uint32_t time_stamp = 0;
+            std::memcpy(&time_stamp, get_raw(i, column).data(), sizeof(uint32_t));
+            if (unwrap(time_stamp) >= trigger_time) {
+                return i;
+            }
+        }
+
+        return _num_events;
+    }
+
+    // First event of the indexed block that was saved at or before time, at
+    // most stride events before the first event saved after it. 0 if time
+    // is before the first event.
+    [[nodiscard]] std::size_t find_wall_time(
+            const std::chrono::system_clock::time_point& time) const {
+        const auto& index = event_index();
+        try {
+            return index.find_wall_time(time).EventNumber;
+        } catch (std::out_of_range&) {
+            return 0;
+        }
+    }
+
+    // Raw bytes of the run constant with name. For v1 files, where the
+    // constants were saved with every event, the column of the first
+    // event is returned instead. Throws std::out_of_range if not found.
+    [[nodiscard]] std::span<const char> constant_raw(std::string_view name) const {
+        return _find_constant(name).second;
+    }
+
+    // Run constant with name as T. Throws std::out_of_range if not found
+    // and std::runtime_error if it is not of type T.
+    template<typename T>
+    requires std::is_arithmetic_v<T>
+    [[nodiscard]] std::span<const T> constant(std::string_view name) const {
+        auto [column, bytes] = _find_constant(name);
+        if (not Tools::is_type_string_of<T>(column->Type)) {
+            throw std::runtime_error("Constant " + column->Name + " is of "
+                                     "type " + column->Type);
+        }
+
+        return {reinterpret_cast<const T*>(bytes.data()), column->NumElements};
+    }
+
+    // Raw bytes of column c of event i
+    [[nodiscard]] std::span<const char> get_raw(const std::size_t& i,
+                                                const std::size_t& c) const {
+        if (i >= _num_events or c >= _header.Columns.size()) {
+            throw std::out_of_range("Event or column out of range.");
+        }
+
+        const auto& column = _header.Columns[c];
+        return {_line(i) + column.Offset, column.ByteSize};
+    }
 
- private:
-    const std::string _file_name;
-    const std::array<std::string, n_cols> _names;
-    const std::array<std::size_t, n_cols> _ranks;
-    const std::vector<std::size_t> _sizes;
+    // Raw bytes of the full line of event i
+    [[nodiscard]] std::span<const char> line(const std::size_t& i) const {
+        if (i >= _num_events) {
+            throw std::out_of_range("Event out of range.");
+        }
 
-    std::size_t total_ranks = 0;
-    bool _open = false;
-    std::fstream _stream;
+        return {_line(i), _header.LineByteSize};
+    }
 
-    std::size_t _line_byte_size = 0;
-    std::size_t _line_param_order = 0;
-    std::size_t _line_buffer_loc = 0;
-    std::string _line_buffer;
+    // Column c of event i
+    template<std::size_t c>
+    requires is_typed and (c < n_cols)
+    [[nodiscard]] auto get(const std::size_t& i) const {
+        using T = std::tuple_element_t<c, std::tuple<DataTypes...>>;
+        if (i >= _num_events) {
+            throw std::out_of_range("Event out of range.");
+        }
 
-    template<typename T>
-    void _copy_number_to_buff(const T& num,
-                              std::string& buffer,
-                              std::size_t& loc,
-                              const std::size_t& size = sizeof(T)) {
-        const char* tmpstr = reinterpret_cast<const char*>(&num);
-        for(std::size_t i = 0; i < size; i++) {
-            buffer[i + loc] = tmpstr[i];
+        const auto& column = _header.Columns[c];
+        if (column.PackedBits > 0) {
+            throw std::runtime_error("Column " + column.Name + " is bit "
+                                     "packed, use unpack(...).");
         }
 
-        loc += size;
+        return std::span<const T>(
+            reinterpret_cast<const T*>(_line(i) + column.Offset),
+            column.NumElements);
     }
 
-    void _copy_str_to_buff(std::string_view source,
-                           std::string& buffer,
-                           std::size_t& loc) {
-        source.copy(&buffer[loc], source.length(), 0);
-        loc += source.length();
+    [[nodiscard]] bool is_packed(const std::size_t& c) const {
+        return c < _header.Columns.size() and _header.Columns[c].PackedBits > 0;
     }
 
-    std::string _build_header() {
-        // Edianess first
-        uint32_t endianess = 0x01020304;
-        if constexpr (std::endian::native == std::endian::big) {
-            endianess = 0x04030201;
-        } else {
-            endianess = 0x01020304;
+    // Copies column c of event i into out, unpacking it if it is bit
+    // packed. The column has to be packed or uint16, and out the size of
+    // the column, otherwise it throws std::runtime_error.
+    void unpack(const std::size_t& i, const std::size_t& c,
+                std::span<uint16_t> out) const {
+        auto raw = get_raw(i, c);
+        const auto& column = _header.Columns[c];
+        if (out.size() != column.NumElements) {
+            throw std::runtime_error("Output does not have the size of "
+                                     "column " + column.Name);
         }
 
-        // calculates
-        std::size_t total_header_size = 0;
-        // has to be uint16_t because we are saving it to the file later
+        if (column.PackedBits > 0) {
+            BitPacking::unpack(raw.data(), column.PackedBits, out);
+        } else if (Tools::is_type_string_of<uint16_t>(column.Type)) {
+            std::memcpy(out.data(), raw.data(), raw.size());
+        } else {
+            throw std::runtime_error("Column " + column.Name + " is of type "
+                                     + column.Type);
+        }
+    }
 
-        uint16_t binary_header_size = 0;
-        std::size_t total_ranks_so_far = 0;
-        for (std::size_t i = 0; i < n_cols; i++) {
-            auto column_rank = _ranks[i];
-            // + 1 for the ; character
-            binary_header_size += _names[i].length() + 1;
-            // + 1 for the ; character
-            binary_header_size += parameters_types_str[i].length() + 1;
+    // All the columns of event i
+    [[nodiscard]] event_type event(const std::size_t& i) const
+    requires is_typed {
+        return _event(i, std::make_index_sequence<n_cols>{});
+    }
 
-            std::size_t total_rank_size = 1;
-            for(std::size_t j = 0; j < column_rank; j ++) {
-                auto size = _sizes[total_ranks_so_far + j];
-                total_rank_size *= size;
-                // It is always + 1 because there is either a ',' or a ';'
-                binary_header_size += std::to_string(size).length() + 1;
+    // Forward iterator over the events meant for files larger than RAM.
+    // As it moves forward, the pages more than window bytes behind it are
+    // released so the resident memory stays bounded. Dereferences to
+    // event_type, or to the raw line for Reader<>.
+    class StreamIterator {
+        const Reader* _reader = nullptr;
+        std::size_t _index = 0;
+        std::size_t _window = 0;
+        // Everything before this file offset was already released
+        std::size_t _released = 0;
+
+        void _release_behind() {
+            const std::size_t current = _reader->_file_offset(_index);
+            if (current - _released >= 2*_window) {
+                const std::size_t until = current - _window;
+                _reader->_file.release(_released, until - _released);
+                _released = until;
             }
+        }
 
-            total_ranks_so_far += column_rank;
-            _line_byte_size += size_of_types[i]*total_rank_size;
-        }
-
-        // We also calculate the line size very useful when we start data saving
-        total_header_size += sizeof(uint32_t); // 1.
-        total_header_size += sizeof(uint16_t); // 2.
-        total_header_size += binary_header_size; // 3.
-        total_header_size += sizeof(int32_t); // 4.
-
-        // Now we allocate the memory!
-        std::size_t buffer_loc = 0;
-        auto buffer = std::string(total_header_size, 'A');
-        _line_buffer = std::string(_line_byte_size, 'A');
-
-        // Now we fill buffer.
-        total_ranks_so_far = 0;
-        _copy_number_to_buff(endianess, buffer, buffer_loc); // 1.
-        _copy_number_to_buff(binary_header_size, buffer, buffer_loc); // 2.
-        for (std::size_t i = 0; i < n_cols; i++) { // 3.
-            auto column_name = _names[i];
-            auto column_type = parameters_types_str[i];
-            auto column_rank = _ranks[i];
+     public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = std::conditional_t<is_typed, event_type,
+                                              std::span<const char>>;
 
-            _copy_str_to_buff(column_name, buffer, buffer_loc);
-            _copy_str_to_buff(";", buffer, buffer_loc);
-            _copy_str_to_buff(column_type, buffer, buffer_loc);
-            _copy_str_to_buff(";", buffer, buffer_loc);
-            for(std::size_t size_j = 0; size_j < column_rank; size_j++) {
-                _copy_str_to_buff(std::to_string(_sizes[total_ranks_so_far + size_j]),
-                                  buffer, buffer_loc);
+        StreamIterator() = default;
+        StreamIterator(const Reader* reader, std::size_t index,
+                       std::size_t window) :
+            _reader{reader}, _index{index}, _window{window} { }
 
-                if(size_j != column_rank - 1) {
-                    _copy_str_to_buff(",", buffer, buffer_loc);
-                }
+        value_type operator*() const {
+            if constexpr (is_typed) {
+                return _reader->event(_index);
+            } else {
+                return _reader->line(_index);
             }
+        }
 
-            _copy_str_to_buff(";", buffer, buffer_loc);
-            total_ranks_so_far += column_rank;
+        StreamIterator& operator++() {
+            _index++;
+            _release_behind();
+            return *this;
         }
 
-        // For dynamic files, this is always 0!
-        const int32_t num_lines = 0x00000000;
-        _copy_number_to_buff(num_lines, buffer, buffer_loc); // 4.
-        // Done!
-        return buffer;
+        StreamIterator operator++(int) {
+            auto tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        [[nodiscard]] const std::size_t& index() const noexcept {
+            return _index;
+        }
+
+        bool operator==(const StreamIterator& other) const noexcept {
+            return _index == other._index;
+        }
+    };
+
+    struct StreamRange {
+        StreamIterator Begin;
+        StreamIterator End;
+
+        StreamIterator begin() const { return Begin; }
+        StreamIterator end() const { return End; }
+    };
+
+    // Events [first, size()) read sequentially. Only window bytes behind the
+    // current event are kept in memory.
+    [[nodiscard]] StreamRange stream(const std::size_t& first = 0,
+                     const std::size_t& window = kDefaultStreamWindow) const {
+        _file.adviseSequential();
+        const auto start = std::min(first, _num_events);
+        return {StreamIterator(this, start, window),
+                StreamIterator(this, _num_events, window)};
     }
+};
 
-    // Save item from tuple in position i
-    template<std::size_t i>
-    void _save_item(const tuple_type& items, std::size_t& loc) {
-        auto item = std::get<i>(items);
+// What recover_file(...) found and did
+struct RecoveryReport {
+    uint64_t NumEvents = 0;
+    // Cut from the end of the file: an incomplete line or chunk, and the old
+    // chunk index and trailer if they did not match the data
+    uint64_t BytesRemoved = 0;
+    // The file was closed properly and was not touched
+    bool WasClosed = false;
+};
 
-        auto rank = _ranks[i];
-        auto total_rank_up_to_i = std::accumulate(_ranks.begin(),
-                                                  &_ranks[i],
-                                                  0);
+// Finishes closing a file whose writer did not (crash, power cut...): the
+// incomplete line or chunk left at its end is cut, and the number of lines,
+// chunk index, block checksums and trailer are written as the DynamicWriter
+// would have. Only the end of the file is rewritten; the data is read once
+// to compute the checksums. Block checksums that were lost use the default
+// ChecksumOptions::BlockLines.
+// Throws std::runtime_error if the file cannot be read or written.
+inline RecoveryReport recover_file(std::string_view file_name) {
+    RecoveryReport report;
+    FileHeader header;
+    std::size_t size = 0;
+    std::size_t data_end = 0;
+    std::vector<Tools::ChunkIndexEntry> chunks;
+    Tools::RunSummary summary;
+    std::vector<uint32_t> block_checksums;
+    uint64_t block_lines = 0;
+    {
+        MemoryMappedFile file(file_name);
+        size = file.size();
+        header = Tools::parse_header(file.data(), size);
+        const bool has_trailer = (header.Flags & Tools::kFlagTrailer) != 0;
+
+        std::size_t data_size = size;
+        std::optional<Tools::RunSummary> trailer;
+        if (has_trailer) {
+            trailer = Tools::read_trailer(file.data(), size,
+                                          header.HeaderByteSize);
+            if (trailer) {
+                data_size -= Tools::kTrailerSize;
+                summary = *trailer;
+            }
+        }
 
-        const auto& size_index_start = total_rank_up_to_i;
-        const std::size_t expected_size = std::accumulate(&_sizes[size_index_start],
-                                                 &_sizes[size_index_start + rank],
-                                                 1,
-                                                std::multiplies<std::size_t>());
+        const bool has_blocks = (header.Flags & Tools::kFlagBlockChecksums) != 0;
+        std::optional<Tools::BlockChecksums> blocks;
+        if (trailer and has_blocks) {
+            blocks = Tools::read_block_checksums(file.data(), data_size,
+                                                 header.HeaderByteSize);
+            if (blocks) {
+                data_size -= blocks->ByteSize;
+            }
+        }
 
-        if (expected_size != item.size()) {
-            throw std::out_of_range("memory is out of range");
+        // Where the file should end if it was closed properly
+        std::size_t closed_size = 0;
+        if ((header.Flags & Tools::kFlagCompressed) != 0) {
+            auto index = Tools::read_chunk_index(file.data(), data_size,
+                                                 header.HeaderByteSize);
+            chunks = std::move(index.Chunks);
+            report.NumEvents = index.NumEvents;
+            data_end = index.DataEnd;
+            closed_size = data_end + chunks.size()*sizeof(Tools::ChunkIndexEntry)
+                + Tools::kChunkIndexTrailerSize;
+        } else {
+            report.NumEvents = header.LineByteSize == 0 ? 0
+                : (data_size - header.HeaderByteSize) / header.LineByteSize;
+            data_end = header.HeaderByteSize
+                + report.NumEvents*header.LineByteSize;
+            closed_size = data_end;
+        }
+
+        const auto data_bytes = data_end - header.HeaderByteSize;
+        const bool compressed = (header.Flags & Tools::kFlagCompressed) != 0;
+        std::vector<std::pair<std::size_t, std::size_t>> block_ranges;
+        if (has_blocks) {
+            block_lines = compressed ? 0
+                : blocks ? blocks->BlockLines : ChecksumOptions{}.BlockLines;
+            block_ranges = Tools::block_ranges(header.HeaderByteSize, data_end,
+                block_lines*header.LineByteSize, chunks);
+        }
+
+        report.WasClosed = closed_size == data_size
+            and header.NumLines == Tools::num_lines_field(report.NumEvents)
+            and (not has_trailer
+                 or (trailer and trailer->NumEvents == report.NumEvents
+                     and trailer->DataBytes == data_bytes))
+            and (not has_blocks
+                 or (blocks and blocks->Checksums.size() == block_ranges.size()));
+        if (report.WasClosed) {
+            return report;
+        }
+
+        if (has_blocks) {
+            block_checksums = Tools::compute_block_checksums(file.data(),
+                                                             block_ranges);
         }
 
-//        std::memcpy(&_line_buffer[loc], item.data(), item.size_bytes());
-        auto item_bytes =  std::as_bytes(item);
-        for(std::size_t byte = 0; byte < item.size_bytes(); byte++) {
-            _line_buffer.at(loc + byte) = static_cast<char>(item_bytes[byte]);
+        if (has_trailer) {
+            summary.Checksum = Checksum::crc32c(
+                {file.data() + header.HeaderByteSize, data_bytes});
+            summary.NumEvents = report.NumEvents;
+            summary.DataBytes = data_bytes;
+            summary.Recoveries++;
+            summary.LastClosed = std::chrono::duration_cast<
+                std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
         }
-        loc += item.size_bytes();
     }
 
-    // Think of t his function as a wrapper between _save_item
-    // and _save_data
-    template<std::size_t... I>
-    void _save_item_helper(const tuple_type& data, std::index_sequence<I...>) {
-        (_save_item<I>(data, _line_buffer_loc),...);
+    std::filesystem::resize_file(file_name, data_end);
+    report.BytesRemoved = size - data_end;
+
+    std::fstream out(std::string(file_name), std::ios::in | std::ios::out
+                     | std::ios::binary);
+    out.seekp(0, std::ios::end);
+    if ((header.Flags & Tools::kFlagCompressed) != 0) {
+        Tools::write_chunk_index(out, chunks, report.NumEvents);
     }
 
-    void _save_event(const tuple_type& data) {
-        _line_buffer_loc = 0;
-        _save_item_helper(data, std::make_index_sequence<n_cols>{});
-        _stream << _line_buffer;
+    if ((header.Flags & Tools::kFlagBlockChecksums) != 0) {
+        Tools::write_block_checksums(out, block_checksums, block_lines);
     }
 
- public:
-    DynamicWriter(std::string_view file_name,
-                  const std::array<std::string, n_cols>& columns_names,
-                  const std::array<std::size_t, n_cols>& columns_ranks,
-                  const std::vector<std::size_t>& columns_sizes) :
-        _file_name{file_name},
-        _names{columns_names},
-        _ranks{columns_ranks},
-        _sizes{columns_sizes}
-    {
-        total_ranks = std::accumulate(columns_ranks.begin(),
-                                      columns_ranks.end(), 0);
+    if ((header.Flags & Tools::kFlagTrailer) != 0) {
+        Tools::write_trailer(out, summary);
+    }
 
-        if (std::filesystem::exists(file_name)) {
-            if (std::filesystem::is_empty(file_name)) {
-                // If file is empty or does not exist, then we
-                // open it and write to it.
-                _stream.open(_file_name, std::ios::app | std::ofstream::binary);
-                if (_stream.is_open()) {
-                    _open = true;
-                    _stream << _build_header();
-                }
-            } else {
-                std::ifstream peeker(_file_name, std::ofstream::binary);
+    Tools::write_num_lines(out, header.HeaderByteSize, report.NumEvents);
+    if (not out) {
+        throw std::runtime_error("Could not recover " + std::string(file_name));
+    }
+
+    return report;
+}
+
+// Builds the sidecar index of a file written without one (older runs) by
+// scanning its "time_stamp" column with num_threads threads (0 = one per
+// hardware thread). Every thread scans its own range of events with its own
+// Reader and the trigger time roll overs are added up at the end. The wall
+// times are unknown and saved as 0. Overwrites the index the file had.
+// Throws std::runtime_error if the file cannot be read, and
+// std::out_of_range if it does not have a time_stamp column.
+inline EventIndex rebuild_event_index(std::string_view file_name,
+                                      const uint32_t& stride,
+                                      const std::size_t& num_threads = 0) {
+    if (stride == 0) {
+        throw std::invalid_argument("Event index stride cannot be 0.");
+    }
 
-                std::string header = _build_header();
-                std::string current_file_header(header.length(), '\0');
-                peeker.seekg(0);
-                peeker.read(&current_file_header[0], header.length());
+    const Reader<> reader(file_name);
+    const auto column = reader.column_index("time_stamp");
+    const auto n = reader.size();
+
+    struct Part {
+        std::vector<EventIndexEntry> Entries;
+        uint64_t RollOvers = 0;
+        std::string Error;
+    };
+
+    WorkerPool pool(num_threads);
+    std::vector<Part> parts(pool.size());
+    pool.for_each_chunk(n, [&](std::size_t begin, std::size_t end,
+                               std::size_t worker) {
+        auto& part = parts[worker];
+        try {
+            const Reader<> local(file_name);
+            auto time_stamp = [&](const std::size_t& i) {
+                uint32_t out = 0;
+                std::memcpy(&out, local.get_raw(i, column).data(), sizeof(uint32_t));
+                return out;
+            };
+
+            TriggerTimeUnwrapper unwrap;
+            // A roll over between the previous range and this one is counted
+            // here
+            if (begin > 0) {
+                unwrap(time_stamp(begin - 1));
+            }
 
-                if (current_file_header != header) {
-                    throw std::runtime_error("File being written to has an "
-                                             "incompatible header format. "
-                                             "Details:\n\t File = " + _file_name);
+            const bool compressed = (local.header().Flags
+                                     & Tools::kFlagCompressed) != 0;
+            for (std::size_t i = begin; i < end; i++) {
+                const auto trigger_time = unwrap(time_stamp(i));
+                if (i % stride == 0) {
+                    part.Entries.push_back({i,
+                        compressed ? 0 : local.file_offset(i), trigger_time, 0});
                 }
+            }
+            part.RollOvers = unwrap.rollOvers();
+        } catch (std::exception& err) {
+            part.Error = err.what();
+        }
+    });
 
-                // We do not write anything.
-                _stream.open(_file_name, std::ios::app | std::ofstream::binary);
-                _open = _stream.is_open();
+    std::vector<EventIndexEntry> entries;
+    uint64_t roll_overs = 0;
+    for (auto& part : parts) {
+        if (not part.Error.empty()) {
+            throw std::runtime_error(part.Error);
+        }
+
+        for (auto entry : part.Entries) {
+            entry.TriggerTime += roll_overs*TriggerTimeUnwrapper::kPeriod;
+            entries.push_back(entry);
+        }
+        roll_overs += part.RollOvers;
+    }
+
+    EventIndex index(stride, std::move(entries));
+    index.save(EventIndex::sidecar_name(file_name));
+    return index;
+}
+
+// What verify_file(...) found
+struct VerifyReport {
+    uint64_t NumEvents = 0;
+    // Blocks checked one by one. 0 if the file does not have block checksums
+    // and its data was checked as a whole against the run summary.
+    uint64_t NumBlocks = 0;
+    // Events [first, last) of the blocks that do not match their checksums
+    std::vector<std::pair<uint64_t, uint64_t>> CorruptedEvents;
+    bool Ok = false;
+};
+
+// Checks the data of a closed file against the checksums its writer saved:
+// block by block with num_threads threads (0 = one per hardware thread) if
+// it has block checksums, otherwise all of it against its run summary.
+// Throws std::runtime_error if the file cannot be read or has nothing to
+// check against: v1 files and files that were not closed properly (see
+// recover_file(...)).
+inline VerifyReport verify_file(std::string_view file_name,
+                                const std::size_t& num_threads = 1) {
+    const Reader<> reader(file_name);
+    if (not reader.summary()) {
+        throw std::runtime_error("File " + reader.name() + " does not have "
+                                 "checksums.");
+    }
+
+    VerifyReport report;
+    report.NumEvents = reader.size();
+    if (reader.block_checksums()) {
+        report.NumBlocks = reader.block_checksums()->Checksums.size();
+        report.CorruptedEvents = reader.find_corrupted_blocks(num_threads);
+        report.Ok = report.CorruptedEvents.empty();
+    } else {
+        report.Ok = reader.verify_checksum();
+    }
+
+    return report;
+}
 
+// Checks finished files with verify_file(...) one at a time on its own
+// thread, which only runs when the CPU would otherwise be idle so it never
+// slows the acquisition down. Errors are logged and kept in the results.
+class BackgroundVerifier {
+ public:
+    struct Result {
+        std::string FileName;
+        VerifyReport Report;
+        // Why the file could not be checked, empty if it was
+        std::string Error;
+    };
+
+ private:
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    // All of these are protected by _mutex
+    std::deque<std::string> _queue;
+    std::vector<Result> _results;
+    bool _stop = false;
+    // Started last, once everything it uses exists
+    std::thread _thread;
+
+    void _loop() {
+        lower_current_thread_priority();
+        std::unique_lock lock(_mutex);
+        while (true) {
+            _cv.wait(lock, [&]() { return _stop or not _queue.empty(); });
+            if (_queue.empty()) {
+                return;
             }
-        } else {
-            _stream.open(_file_name, std::ios::app | std::ofstream::binary);
-            if (_stream.is_open()) {
-                _open = true;
-                _stream << _build_header();
+
+            Result result;
+            result.FileName = std::move(_queue.front());
+            _queue.pop_front();
+            lock.unlock();
+
+            try {
+                result.Report = verify_file(result.FileName);
+                if (not result.Report.Ok) {
+                    spdlog::error("{0} is corrupted: {1} of {2} blocks do not "
+                                  "match their checksums.", result.FileName,
+                                  result.Report.CorruptedEvents.size(),
+                                  result.Report.NumBlocks);
+                }
+            } catch (std::exception& err) {
+                result.Error = err.what();
+                spdlog::error("Could not verify {0}: {1}", result.FileName,
+                              result.Error);
             }
+
+            lock.lock();
+            _results.push_back(std::move(result));
         }
     }
 
-    bool isOpen() { return _open; }
+ public:
+    BackgroundVerifier() : _thread{[this]() { _loop(); }} {}
 
-    ~DynamicWriter() {
-        _open = false;
-        _stream.flush();
-        _stream.close();
+    BackgroundVerifier(const BackgroundVerifier&) = delete;
+    BackgroundVerifier& operator=(const BackgroundVerifier&) = delete;
+
+    ~BackgroundVerifier() {
+        static_cast<void>(finish());
     }
 
-    void save(std::span<DataTypes>... data) {
-        if(_open) {
-            _save_event(std::make_tuple(data...));
+    void submit(std::string file_name) {
+        {
+            std::scoped_lock lock(_mutex);
+            _queue.push_back(std::move(file_name));
         }
+        _cv.notify_one();
     }
-};
-
-// TODO(Hector): we need this!
-template<typename... DataTypes>
-struct Reader {
 
+    // Results of the files checked since the last call
+    std::vector<Result> take_results() {
+        std::scoped_lock lock(_mutex);
+        return std::exchange(_results, {});
+    }
 
+    // Checks the files still queued and stops. Files submitted after this
+    // are never checked.
+    std::vector<Result> finish() {
+        {
+            std::scoped_lock lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_one();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
 
- private:
+        return take_results();
+    }
 };
 
 class SiPMDynamicWriter {
-    using SiPMDW = DynamicWriter<   double,    // sample rate
-                                    uint8_t,   // Enabled Channels
-                                    uint64_t,  // Trigger Mask
-                                    uint16_t,  // Thresholds
-                                    uint16_t,  // DC Offsets
-                                    uint8_t,   // DC Corrections
-                                    float,     // DC Range
-                                    uint32_t,  // Time stamp
-                                    uint32_t,  // Trigger source
-                                    uint16_t>; // Waveforms
-
-    constexpr static std::size_t num_cols = 10;
-    constexpr static std::array<std::size_t, num_cols> sipm_ranks =
-                                    {1, 1, 1, 1, 1, 1, 1, 1, 1, 2};
-    const inline static std::array<std::string, num_cols> column_names =
-            {"sample_rate", "en_chs", "trg_mask", "thresholds", "dc_offsets",
-             "dc_corrections", "dc_range", "time_stamp", "trg_source", "sipm_traces"};
+    // Only the shape of the waveforms depends on the configuration
+    using SiPMDW = DynamicWriter<   FixedColumn<uint32_t, 1>,  // Time stamp
+                                    FixedColumn<uint32_t, 1>,  // Trigger source
+                                    uint16_t>;                 // Waveforms
 
+    constexpr static std::size_t num_cols = 3;
+    constexpr static std::array<std::size_t, num_cols> sipm_ranks = {1, 1, 2};
+    const inline static std::array<std::string, num_cols> column_names =
+            {"time_stamp", "trg_source", "sipm_traces"};
 
-    double _sample_rate[1] = {0.0};
+    // Set in _get_en_chs
+    uint64_t _trigger_mask = 0;
     std::vector<std::uint8_t> _en_chs;
-    uint64_t _trigger_mask[1] = {0};
-    std::vector<uint16_t> _thresholds;
-    std::vector<uint16_t> _dc_offsets;
-    std::vector<uint8_t> _dc_corrections;
-    std::vector<float> _dc_ranges;
 
     uint32_t _trigger_tag[1] = {0};
     uint32_t _trigger_source[1] = {0};
 
+    // Per event storage used by save_waveforms(...). Every event needs its
+    // own time stamp and trigger source as the whole batch is laid out
+    // before anything is written.
+    std::vector<uint32_t> _batch_trigger_tags;
+    std::vector<uint32_t> _batch_trigger_sources;
+    std::vector<SiPMDW::tuple_type> _batch_events;
+
     uint32_t _record_length;
-    SiPMDW _streamer;
+
+    // What every segment is opened with
+    const std::string _file_name;
+    const std::vector<std::size_t> _sizes;
+    const RunConstants _run_constants;
+    const uint8_t _bits;
+    const CompressionOptions _compression;
+    const uint32_t _index_stride;
+    const RolloverOptions _rollover;
+    const ChecksumOptions _checksums;
+
+    // The file, or the segment, being written
+    std::unique_ptr<SiPMDW> _streamer;
+    // Only if the index stride is not 0
+    std::unique_ptr<EventIndexWriter> _index;
+    // Carries on over the segments
+    TriggerTimeUnwrapper _trigger_time;
+
+    // Only if rollover is enabled
+    struct Segment {
+        std::unique_ptr<SiPMDW> Streamer;
+        std::unique_ptr<EventIndexWriter> Index;
+    };
+
+    std::optional<RunManifest> _manifest;
+    std::size_t _next_segment = 0;
+    std::string _next_name;
+    // The next segment is opened while the current one is written and the
+    // last one is closed after the switch, so neither stalls the writes
+    std::future<Segment> _next;
+    std::future<void> _closing;
+    std::size_t _closing_segment = 0;
+    std::chrono::steady_clock::time_point _segment_start;
+    uint64_t _closed_bytes = 0;
+    // Only if the segments are verified
+    std::unique_ptr<BackgroundVerifier> _verifier;
+
+    static int64_t _now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    void _open_index(std::string_view file_name, const uint32_t& stride) {
+        const auto index_file = EventIndex::sidecar_name(file_name);
+        const uint64_t num_events = _streamer->getNumEvents();
+        if (num_events > 0) {
+            // Appending to a file written without an index, with another
+            // stride or whose index got ahead of it in a crash
+            bool usable = false;
+            try {
+                const EventIndex old(index_file);
+                usable = old.stride() == stride
+                    and (old.empty()
+                         or old.entries().back().EventNumber < num_events);
+            } catch (std::runtime_error&) {
+                usable = false;
+            }
+
+            if (not usable) {
+                rebuild_event_index(file_name, stride, 1);
+            }
+        }
+
+        _index = std::make_unique<EventIndexWriter>(index_file, stride,
+                                                    num_events > 0);
+        const auto* last = _index->last();
+        if (not last) {
+            return;
+        }
+
+        // Keep counting the roll overs from the last indexed event,
+        // including the events saved after it
+        _trigger_time = TriggerTimeUnwrapper(last->TriggerTime);
+        if (last->EventNumber + 1 < num_events) {
+            const Reader<> reader(file_name);
+            const auto column = reader.column_index("time_stamp");
+            for (auto i = last->EventNumber + 1; i < num_events; i++) {
+                uint32_t time_stamp = 0;
+                std::memcpy(&time_stamp, reader.get_raw(i, column).data(),
+                            sizeof(uint32_t));
+                _trigger_time(time_stamp);
+            }
+        }
+    }
+
+    // Indexes the events [first, first + trigger_tags.size()) that were just
+    // saved and adds them to the manifest. Their wall time is now.
+    void _index_events(const uint64_t& first,
+                       std::span<const uint32_t> trigger_tags) {
+        if (not _index and not _manifest) {
+            return;
+        }
+
+        const int64_t now = _now_ns();
+        const uint64_t stride = _index ? _index->stride() : 0;
+        uint64_t trigger_time = 0;
+        for (std::size_t i = 0; i < trigger_tags.size(); i++) {
+            trigger_time = _trigger_time(trigger_tags[i]);
+            const uint64_t event = first + i;
+            if (_manifest and event == 0) {
+                _manifest->segments().back().FirstTriggerTime = trigger_time;
+            }
+
+            if (stride == 0 or event % stride != 0) {
+                continue;
+            }
+
+            const uint64_t offset = _streamer->isCompressed() ? 0
+                : _streamer->getHeaderByteSize() + event*_streamer->getLineByteSize();
+            _index->add({event, offset, trigger_time, now});
+        }
+
+        if (_index) {
+            _index->flush();
+        }
+
+        if (_manifest and not trigger_tags.empty()) {
+            auto& segment = _manifest->segments().back();
+            segment.NumEvents = _streamer->getNumEvents();
+            segment.LastTriggerTime = trigger_time;
+        }
+    }
+
+    // Runs in the background: the segment starts empty with a new index
+    Segment _open_segment(const std::string& file_name) const {
+        Segment segment;
+        segment.Streamer = std::make_unique<SiPMDW>(file_name, column_names,
+            sipm_ranks, _sizes, _run_constants,
+            std::array<uint8_t, num_cols>{0, 0, _bits}, _compression, _checksums);
+        if (_index_stride > 0) {
+            segment.Index = std::make_unique<EventIndexWriter>(
+                EventIndex::sidecar_name(file_name), _index_stride, false);
+        }
+
+        return segment;
+    }
+
+    // Appends to _file_name or, if it was taken with other run constants
+    // (thresholds, offsets...), to the first of "{stem}_0001.bin",
+    // "{stem}_0002.bin"... that was taken with these or does not exist.
+    // Returns the name of the file.
+    std::string _open_file() {
+        std::string name = _file_name;
+        for (std::size_t number = 1; not _streamer; number++) {
+            try {
+                _streamer = std::make_unique<SiPMDW>(name, column_names,
+                    sipm_ranks, _sizes, _run_constants,
+                    std::array<uint8_t, num_cols>{0, 0, _bits}, _compression,
+                    _checksums);
+            } catch (RunConstantsChanged&) {
+                name = RunManifest::segment_name(_file_name, number);
+            }
+        }
+
+        if (name != _file_name) {
+            spdlog::info("{0} was taken with other settings, saving to {1} "
+                         "instead.", _file_name, name);
+        }
+
+        return name;
+    }
+
+    // Never overwrites a file: files the manifest does not know about are
+    // left from a writer that crashed before adding them
+    std::string _take_segment_name() {
+        auto name = RunManifest::segment_name(_file_name, _next_segment++);
+        while (std::filesystem::exists(name)) {
+            name = RunManifest::segment_name(_file_name, _next_segment++);
+        }
+
+        return name;
+    }
+
+    void _start_segment(Segment segment, const std::string& file_name) {
+        _streamer = std::move(segment.Streamer);
+        _index = std::move(segment.Index);
+        _segment_start = std::chrono::steady_clock::now();
+
+        RunSegment entry;
+        entry.FileName = std::filesystem::path(file_name).filename().string();
+        entry.FirstEvent = _manifest->next_event();
+        entry.StartTime = _now_ns();
+        _manifest->segments().push_back(entry);
+        _manifest->save();
+
+        _next_name = _take_segment_name();
+        _next = std::async(std::launch::async,
+            [this, name = _next_name]() { return _open_segment(name); });
+    }
+
+    // Segments left open by a writer that crashed are closed as it would
+    // have, and their event counts are taken from the files.
+    void _recover_segments() {
+        bool changed = false;
+        uint64_t first_event = 0;
+        for (auto& segment : _manifest->segments()) {
+            if (segment.FirstEvent != first_event) {
+                segment.FirstEvent = first_event;
+                changed = true;
+            }
+
+            if (not segment.Closed) {
+                const auto path = _manifest->path(segment);
+                if (std::filesystem::exists(path)) {
+                    const auto report = recover_file(path);
+                    segment.NumEvents = report.NumEvents;
+                    segment.Bytes = std::filesystem::file_size(path);
+                    spdlog::warn("Segment {0} was not closed. Recovered {1} "
+                                 "events.", path, report.NumEvents);
+                }
+
+                segment.Closed = true;
+                changed = true;
+            }
+
+            first_event += segment.NumEvents;
+        }
+
+        if (changed) {
+            _manifest->save();
+        }
+    }
+
+    void _rollover_if_due() {
+        if (not _manifest or _streamer->getNumEvents() == 0) {
+            return;
+        }
+
+        const bool full = _rollover.MaxBytes > 0
+            and _streamer->getFileSize() >= _rollover.MaxBytes;
+        const bool old = _rollover.MaxDuration.count() > 0
+            and std::chrono::steady_clock::now() - _segment_start
+                >= _rollover.MaxDuration;
+        if (not full and not old) {
+            return;
+        }
+
+        _wait_closing();
+        // If the next segment could not be opened, keep on with this one
+        auto next = _next.get();
+        auto& current = _manifest->segments().back();
+        current.EndTime = _now_ns();
+        current.Bytes = _streamer->getFileSize();
+        _closed_bytes += current.Bytes;
+
+        // Closing a compressed file compresses its last events, which would
+        // stall the writes as much as opening a new one
+        _closing_segment = _manifest->segments().size() - 1;
+        _closing = std::async(std::launch::async,
+            [streamer = std::move(_streamer), index = std::move(_index)]()
+                mutable {
+                    streamer.reset();
+                    index.reset();
+                });
+
+        if (_verifier) {
+            _save_verifications(_verifier->take_results());
+        }
+
+        _start_segment(std::move(next), _next_name);
+    }
+
+    void _wait_closing() {
+        if (not _closing.valid()) {
+            return;
+        }
+
+        _closing.get();
+        auto& segment = _manifest->segments().at(_closing_segment);
+        segment.Closed = true;
+        segment.Bytes = std::filesystem::file_size(_manifest->path(segment));
+        if (_verifier) {
+            _verifier->submit(_manifest->path(segment));
+        }
+    }
+
+    void _save_verifications(
+            const std::vector<BackgroundVerifier::Result>& results) {
+        for (const auto& result : results) {
+            const auto file = std::filesystem::path(result.FileName).filename();
+            for (auto& segment : _manifest->segments()) {
+                if (segment.FileName == file.string()) {
+                    segment.Verified = result.Error.empty()
+                        and result.Report.Ok;
+                }
+            }
+        }
+    }
  public:
     /* Details of each parameters:
     Name          | type      | length (in Bytes) | is a constant?|
@@ -381,75 +2893,259 @@ class SiPMDynamicWriter {
     dc_range      | single    | 4*ch_size         | Y
     time_stamp    | uint32    | 4                 | N
     trg_source    | uint32    | 4                 | N
-    data          | uint16    | 2*rl*ch_size      | N
+    data          | upack{b}  | b*rl*ch_size/8    | N
     ---------------------------------------------------------------
     rl -> record length of the waveforms
     ch_size -> number of enabled channels
     en_chs  -> the channels # that were enabled
-
-    Total length = 24 + ch_size*(10 + 2*record_length)
+    b -> ADC resolution of the model. The waveforms are bit packed to it
+         (upack12 for x740, upack14 for x730), or uint16 if it is 8 or 16
+
+    Files are v2: the constants are saved once in the header and
+    each line only has the non-constant columns.
+    Line length = 8 + ceil(b*ch_size*record_length/8)
+
+    If compression is enabled the waveforms are not bit packed, they are
+    saved as uint16 so the delta filter can work on them, and the lines are
+    saved in compressed chunks.
+
+    If index_stride is not 0, every index_stride events an entry is added
+    to the sidecar index "{file_name}.idx" (see EventIndex) so events can be
+    found by time without scanning the file.
+
+    If file_name exists and was taken with other run constants, for example
+    other thresholds, it is not appended to: the events go to the first of
+    "{stem}_0001.bin", "{stem}_0002.bin"... taken with the same constants,
+    or that does not exist yet.
+
+    If rollover is enabled, file_name is never written: the events go to
+    segments "{stem}_0000.bin", "{stem}_0001.bin"... and a new one is started
+    once the current one reaches rollover.MaxBytes or rollover.MaxDuration.
+    Events are not split between segments: the check is done before each
+    save. The segments are listed in "{stem}.manifest.json" (see RunManifest)
+    and each one has its own index. Writing to the same run again continues
+    after the last segment of the manifest. With checksums.VerifySegments,
+    every finished segment is checked again in the background (see
+    BackgroundVerifier) and the result is saved in the manifest.
     */
 
     SiPMDynamicWriter(std::string_view file_name,
                       const CAENDigitizerFamilies& fam,
                       const CAENDigitizerModelConstants& model_consts,
                       const CAENGlobalConfig& global_config,
-                      const std::array<CAENGroupConfig, 8>& group_configs) :
-        _sample_rate{model_consts.AcquisitionRate},
+                      const std::array<CAENGroupConfig, 8>& group_configs,
+                      const CompressionOptions& compression = {},
+                      const uint32_t& index_stride = 0,
+                      const RolloverOptions& rollover = {},
+                      const ChecksumOptions& checksums = {}) :
         _en_chs{_get_en_chs(model_consts, group_configs)},
         _record_length{global_config.RecordLength},
-        _streamer{file_name, column_names,  sipm_ranks, _form_sizes(global_config)}
+        _file_name{file_name},
+        _sizes{_form_sizes(global_config)},
+        _run_constants{_form_run_constants(fam, model_consts, global_config,
+                                           group_configs)},
+        _bits{_packed_bits(model_consts, compression)},
+        _compression{compression},
+        _index_stride{index_stride},
+        _rollover{rollover},
+        _checksums{checksums}
     {
+        if (not _rollover.enabled()) {
+            const auto name = _open_file();
+            if (_index_stride > 0) {
+                _open_index(name, _index_stride);
+            }
+
+            return;
+        }
+
+        _manifest.emplace(RunManifest::manifest_name(file_name));
+        _recover_segments();
+        if (_checksums.VerifySegments) {
+            _verifier = std::make_unique<BackgroundVerifier>();
+        }
+
+        _next_segment = _manifest->segments().size();
+        const auto name = _take_segment_name();
+        _start_segment(_open_segment(name), name);
+    }
+
+    ~SiPMDynamicWriter() {
+        if (not _manifest) {
+            return;
+        }
+
+        try {
+            auto& current = _manifest->segments().back();
+            const auto current_path = _manifest->path(current);
+            current.EndTime = _now_ns();
+            _streamer.reset();
+            _index.reset();
+            current.Bytes = std::filesystem::file_size(current_path);
+            current.Closed = true;
+            // Nothing was saved to it
+            if (current.NumEvents == 0) {
+                _manifest->segments().pop_back();
+                std::filesystem::remove(current_path);
+                std::filesystem::remove(EventIndex::sidecar_name(current_path));
+            } else if (_verifier) {
+                _verifier->submit(current_path);
+            }
+
+            _wait_closing();
+            if (_verifier) {
+                _save_verifications(_verifier->finish());
+            }
+
+            _manifest->save();
+        } catch (std::exception& err) {
+            spdlog::error("Could not close the run {0}: {1}", _file_name,
+                          err.what());
+        }
+
+        // The pre-opened segment was never used
+        try {
+            if (_next.valid()) {
+                _next.get();
+            }
+        } catch (std::exception&) {}
+
+        std::error_code ec;
+        std::filesystem::remove(_next_name, ec);
+        std::filesystem::remove(EventIndex::sidecar_name(_next_name), ec);
+    }
+
+    bool isOpen() { return _streamer->isOpen(); }
+
+    // Size in bytes of a single event in the file.
+    [[nodiscard]] const std::size_t& getLineByteSize() const noexcept {
+        return _streamer->getLineByteSize();
+    }
+
+    // Bytes written so far, over all the segments of this writer
+    [[nodiscard]] uint64_t getFileSize() const noexcept {
+        return _closed_bytes + _streamer->getFileSize();
+    }
+
+    // Empty if rollover is disabled
+    [[nodiscard]] const std::optional<RunManifest>& manifest() const noexcept {
+        return _manifest;
+    }
+
+    void save_waveform(const std::shared_ptr<CAENWaveforms<uint16_t>>& waveform) {
+        _rollover_if_due();
+        const auto first = _streamer->getNumEvents();
+        _trigger_tag[0] = waveform->getInfo().TriggerTimeTag;
+        _trigger_source[0] = waveform->getInfo().Pattern;
+        _streamer->save(_trigger_tag,
+                        _trigger_source,
+                        waveform->getData());
+        _index_events(first, _trigger_tag);
+    }
+
+    // Saves all the waveforms with a single write. Preferred over
+    // save_waveform(...) when a full readout block is available.
+    void save_waveforms(
+            std::span<const std::shared_ptr<CAENWaveforms<uint16_t>>> waveforms) {
+        const auto n = waveforms.size();
+        _batch_trigger_tags.resize(n);
+        _batch_trigger_sources.resize(n);
+        _batch_events.clear();
+        _batch_events.reserve(n);
+
+        for (std::size_t i = 0; i < n; i++) {
+            const auto& waveform = waveforms[i];
+            _batch_trigger_tags[i] = waveform->getInfo().TriggerTimeTag;
+            _batch_trigger_sources[i] = waveform->getInfo().Pattern;
+            _batch_events.emplace_back(std::span<uint32_t>(&_batch_trigger_tags[i], 1),
+                                       std::span<uint32_t>(&_batch_trigger_sources[i], 1),
+                                       waveform->getData());
+        }
+
+        _rollover_if_due();
+        const auto first = _streamer->getNumEvents();
+        _streamer->save_batch(_batch_events);
+        _index_events(first, _batch_trigger_tags);
+    }
+
+    // Saves the valid events of the batch with a single write.
+    void save_waveforms(CAENWaveformBatch<uint16_t>& waveforms) {
+        const auto n = waveforms.size();
+        _batch_trigger_tags.resize(n);
+        _batch_trigger_sources.resize(n);
+        _batch_events.clear();
+        _batch_events.reserve(n);
+
+        for (std::size_t i = 0; i < n; i++) {
+            _batch_trigger_tags[i] = waveforms.getInfo(i).TriggerTimeTag;
+            _batch_trigger_sources[i] = waveforms.getInfo(i).Pattern;
+            _batch_events.emplace_back(std::span<uint32_t>(&_batch_trigger_tags[i], 1),
+                                       std::span<uint32_t>(&_batch_trigger_sources[i], 1),
+                                       waveforms[i].getData());
+        }
+
+        _rollover_if_due();
+        const auto first = _streamer->getNumEvents();
+        _streamer->save_batch(_batch_events);
+        _index_events(first, _batch_trigger_tags);
+    }
+
+ private:
+    RunConstants _form_run_constants(
+            const CAENDigitizerFamilies& fam,
+            const CAENDigitizerModelConstants& model_consts,
+            const CAENGlobalConfig& global_config,
+            const std::array<CAENGroupConfig, 8>& group_configs) {
+        double sample_rate = model_consts.AcquisitionRate;
         // Only for these families there is a decimation factor
         if (fam == CAENDigitizerFamilies::x740 or fam == CAENDigitizerFamilies::x724) {
-            _sample_rate[0] /= global_config.DecimationFactor;
+            sample_rate /= global_config.DecimationFactor;
         }
 
+        std::vector<uint16_t> thresholds;
+        std::vector<uint16_t> dc_offsets;
+        std::vector<uint8_t> dc_corrections;
+        std::vector<float> dc_ranges;
         for(auto ch : _en_chs) {
             CAENGroupConfig group;
             if (model_consts.NumberOfGroups == 0) {
                 group = group_configs[ch];
-                _dc_corrections.push_back(group.DCCorrections[0]);
+                dc_corrections.push_back(group.DCCorrections[0]);
             } else {
                 group = group_configs[ch % 8];
-                _dc_corrections.push_back(group.DCCorrections[ch % 8]);
+                dc_corrections.push_back(group.DCCorrections[ch % 8]);
             }
 
-            _thresholds.push_back(group.TriggerThreshold);
-            _dc_offsets.push_back(group.DCOffset);
-            _dc_ranges.push_back(static_cast<float>(
+            thresholds.push_back(group.TriggerThreshold);
+            dc_offsets.push_back(group.DCOffset);
+            dc_ranges.push_back(static_cast<float>(
                     model_consts.VoltageRanges.at(group.DCRange)));
         }
-        // _trigger_mask[0] is set in _get_en_chs
-    }
-
-    ~SiPMDynamicWriter() = default;
 
-    bool isOpen() { return _streamer.isOpen(); }
-
-    void save_waveform(const std::shared_ptr<CAENWaveforms<uint16_t>>& waveform) {
-        _trigger_tag[0] = waveform->getInfo().TriggerTimeTag;
-        _trigger_source[0] = waveform->getInfo().Pattern;
-        _streamer.save(_sample_rate,
-                       _en_chs,
-                       _trigger_mask,
-                       _thresholds,
-                       _dc_offsets,
-                       _dc_corrections,
-                       _dc_ranges,
-                       _trigger_tag,
-                       _trigger_source,
-                       waveform->getData());
+        RunConstants constants;
+        constants.add("sample_rate", sample_rate)
+                 .add("en_chs", _en_chs)
+                 .add("trg_mask", _trigger_mask)
+                 .add("thresholds", thresholds)
+                 .add("dc_offsets", dc_offsets)
+                 .add("dc_corrections", dc_corrections)
+                 .add("dc_range", dc_ranges);
+        return constants;
     }
 
- private:
+    // Waveforms are only packed if it saves space. Packed samples do not
+    // line up with bytes, which compresses worse than delta filtered uint16.
+    static uint8_t _packed_bits(const CAENDigitizerModelConstants& model_consts,
+                                const CompressionOptions& compression) {
+        const auto& bits = model_consts.ADCResolution;
+        return bits > 8 and bits < BitPacking::kMaxBits
+            and not compression.enabled() ? static_cast<uint8_t>(bits) : 0;
+    }
 
     std::vector<std::size_t> _form_sizes(
         const CAENGlobalConfig& caen_global_config) {
 
-        auto num_en_chs = _en_chs.size();
-        return {1, num_en_chs, 1, num_en_chs, num_en_chs, num_en_chs, num_en_chs,
-                1, 1, num_en_chs, caen_global_config.RecordLength};
+        return {1, 1, _en_chs.size(), caen_global_config.RecordLength};
     }
 
     std::vector<std::uint8_t> _get_en_chs(
@@ -479,7 +3175,7 @@ class SiPMDynamicWriter {
                 // However, only trg mask ones are saved to _trigger_mask duh
                 if (group.TriggerMask.at(ch)) {
                     auto g_ch = ch + model_constants.NumChannelsPerGroup * group_num;
-                    _trigger_mask[0] |= (1 << g_ch);
+                    _trigger_mask |= (uint64_t{1} << g_ch);
                 }
             }
         }
@@ -0,0 +1,272 @@
+#ifndef SBCEVENTINDEX_H
+#define SBCEVENTINDEX_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// C++ 3rd party includes
+// my includes
+
+namespace SBCQueens::BinaryFormat {
+
+// One every Stride events of an SBC binary file.
+struct EventIndexEntry {
+    uint64_t EventNumber = 0;
+    // Where the event line starts in the file. Compressed files do not have
+    // per event offsets and save 0: the Reader finds the chunk by itself.
+    uint64_t ByteOffset = 0;
+    // Trigger time tag with its roll overs counted, see TriggerTimeUnwrapper
+    uint64_t TriggerTime = 0;
+    // Host time when the event was saved, in ns since the epoch of
+    // std::chrono::system_clock. 0 if unknown (rebuilt indexes).
+    int64_t WallTime = 0;
+};
+static_assert(sizeof(EventIndexEntry) == 4*sizeof(uint64_t));
+
+// Counts the roll overs of the 31-bit CAEN trigger time tag (bit 31 is the
+// roll over flag) so the time of events far apart can be compared.
+class TriggerTimeUnwrapper {
+    uint64_t _roll_overs = 0;
+    uint32_t _last = 0;
+    bool _first = true;
+
+ public:
+    constexpr static uint32_t kMask = 0x7FFFFFFF;
+    constexpr static uint64_t kPeriod = uint64_t{1} << 31;
+
+    TriggerTimeUnwrapper() = default;
+    // Continues from an already extended time
+    explicit TriggerTimeUnwrapper(const uint64_t& extended) :
+        _roll_overs{extended / kPeriod},
+        _last{static_cast<uint32_t>(extended % kPeriod)},
+        _first{false} { }
+
+    uint64_t operator()(const uint32_t& trigger_time_tag) noexcept {
+        const uint32_t ttt = trigger_time_tag & kMask;
+        if (not _first and ttt < _last) {
+            _roll_overs++;
+        }
+
+        _first = false;
+        _last = ttt;
+        return _roll_overs*kPeriod + ttt;
+    }
+
+    [[nodiscard]] const uint64_t& rollOvers() const noexcept {
+        return _roll_overs;
+    }
+};
+
+// Sidecar index of an SBC binary file, saved next to it as
+// "{file name}.idx", so an event can be found by number or time without
+// scanning the file. The index file is:
+//   "SBCEIDX" | version byte | uint32 endianness word | uint32 stride |
+//   EventIndexEntry...
+// An incomplete entry at the end (crash while writing) is ignored.
+class EventIndex {
+    uint32_t _stride = 0;
+    std::vector<EventIndexEntry> _entries;
+
+    // Last entry whose field is <= value. Throws std::out_of_range if there
+    // is none.
+    template<typename T>
+    const EventIndexEntry& _find(const T& value,
+                                 T EventIndexEntry::* field) const {
+        auto it = std::upper_bound(_entries.begin(), _entries.end(), value,
+            [&](const T& v, const EventIndexEntry& entry) {
+                return v < entry.*field;
+            });
+        if (it == _entries.begin()) {
+            throw std::out_of_range("Value is before the first indexed "
+                                    "event.");
+        }
+
+        return *std::prev(it);
+    }
+
+ public:
+    constexpr static std::string_view kMagic = "SBCEIDX";
+    constexpr static uint8_t kVersion = 1;
+    constexpr static std::size_t kHeaderSize = kMagic.size() + 1
+        + 2*sizeof(uint32_t);
+
+    static std::string sidecar_name(std::string_view data_file) {
+        return std::string(data_file) + ".idx";
+    }
+
+    EventIndex() = default;
+    EventIndex(const uint32_t& stride, std::vector<EventIndexEntry> entries) :
+        _stride{stride}, _entries{std::move(entries)} { }
+
+    // Loads an index file. Throws std::runtime_error if it cannot be read
+    // or is not an index file.
+    explicit EventIndex(std::string_view file_name) {
+        std::ifstream in(std::string(file_name), std::ios::binary);
+        if (not in.is_open()) {
+            throw std::runtime_error("Could not open index "
+                                     + std::string(file_name));
+        }
+
+        std::string header(kHeaderSize, '\0');
+        in.read(header.data(), static_cast<std::streamsize>(kHeaderSize));
+        uint32_t endianness = 0;
+        std::memcpy(&endianness, header.data() + kMagic.size() + 1,
+                    sizeof(uint32_t));
+        if (in.gcount() != static_cast<std::streamsize>(kHeaderSize)
+            or std::string_view(header).substr(0, kMagic.size()) != kMagic
+            or static_cast<uint8_t>(header[kMagic.size()]) != kVersion
+            or endianness != 0x01020304) {
+            throw std::runtime_error(std::string(file_name) + " is not an "
+                                     "SBC event index or is from another "
+                                     "version or endianness.");
+        }
+        std::memcpy(&_stride, header.data() + kMagic.size() + 1
+                    + sizeof(uint32_t), sizeof(uint32_t));
+
+        const auto size = std::filesystem::file_size(file_name);
+        _entries.resize((size - kHeaderSize) / sizeof(EventIndexEntry));
+        in.read(reinterpret_cast<char*>(_entries.data()),
+                static_cast<std::streamsize>(_entries.size()
+                                             *sizeof(EventIndexEntry)));
+    }
+
+    // Index header for a new index file
+    static std::string header(const uint32_t& stride) {
+        std::string out(kMagic);
+        out += static_cast<char>(kVersion);
+        const uint32_t endianness = 0x01020304;
+        out.append(reinterpret_cast<const char*>(&endianness), sizeof(uint32_t));
+        out.append(reinterpret_cast<const char*>(&stride), sizeof(uint32_t));
+        return out;
+    }
+
+    // Overwrites file_name with this index
+    void save(std::string_view file_name) const {
+        std::ofstream out(std::string(file_name),
+                          std::ios::binary | std::ios::trunc);
+        if (not out.is_open()) {
+            throw std::runtime_error("Could not open index "
+                                     + std::string(file_name));
+        }
+
+        out << header(_stride);
+        out.write(reinterpret_cast<const char*>(_entries.data()),
+                  static_cast<std::streamsize>(_entries.size()
+                                               *sizeof(EventIndexEntry)));
+    }
+
+    [[nodiscard]] const uint32_t& stride() const noexcept { return _stride; }
+    [[nodiscard]] std::span<const EventIndexEntry> entries() const noexcept {
+        return _entries;
+    }
+    [[nodiscard]] std::size_t size() const noexcept { return _entries.size(); }
+    [[nodiscard]] bool empty() const noexcept { return _entries.empty(); }
+
+    // Last indexed entry at or before each of these. The target is at most
+    // stride() events after it. Throw std::out_of_range if the value is
+    // before the first entry.
+    [[nodiscard]] const EventIndexEntry& find_event(
+            const uint64_t& event) const {
+        return _find(event, &EventIndexEntry::EventNumber);
+    }
+
+    [[nodiscard]] const EventIndexEntry& find_trigger_time(
+            const uint64_t& trigger_time) const {
+        return _find(trigger_time, &EventIndexEntry::TriggerTime);
+    }
+
+    // The wall time is only as good as the host clock: if it jumped back
+    // during the run, the result is one of the matching entries.
+    [[nodiscard]] const EventIndexEntry& find_wall_time(
+            const std::chrono::system_clock::time_point& time) const {
+        const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            time.time_since_epoch()).count();
+        return _find(ns, &EventIndexEntry::WallTime);
+    }
+};
+
+// Appends the index of a file while it is being written.
+class EventIndexWriter {
+    std::string _file_name;
+    uint32_t _stride = 0;
+    std::ofstream _stream;
+    // Last entry already in the index when it was opened, if any
+    bool _has_last = false;
+    EventIndexEntry _last;
+
+ public:
+    // If append is true and the index already exists with the same stride,
+    // it is appended to after dropping an incomplete entry at its end.
+    // Otherwise it is started again.
+    EventIndexWriter(std::string_view file_name, const uint32_t& stride,
+                     const bool& append_if_exists = true) :
+        _file_name{file_name}, _stride{stride}
+    {
+        if (stride == 0) {
+            throw std::invalid_argument("Event index stride cannot be 0.");
+        }
+
+        bool append = false;
+        if (append_if_exists and std::filesystem::exists(_file_name)) {
+            try {
+                EventIndex old(_file_name);
+                if (old.stride() == stride) {
+                    append = true;
+                    std::filesystem::resize_file(_file_name,
+                        EventIndex::kHeaderSize
+                        + old.size()*sizeof(EventIndexEntry));
+                    if (not old.empty()) {
+                        _has_last = true;
+                        _last = old.entries().back();
+                    }
+                }
+            } catch (std::runtime_error&) {
+                append = false;
+            }
+        }
+
+        _stream.open(_file_name, std::ios::binary
+                     | (append ? std::ios::app : std::ios::trunc));
+        if (not _stream.is_open()) {
+            throw std::runtime_error("Could not open index " + _file_name);
+        }
+
+        if (not append) {
+            _stream << EventIndex::header(stride);
+        }
+    }
+
+    ~EventIndexWriter() {
+        _stream.flush();
+    }
+
+    [[nodiscard]] const uint32_t& stride() const noexcept { return _stride; }
+    // Last entry of the index it is appending to, nullptr if none.
+    [[nodiscard]] const EventIndexEntry* last() const noexcept {
+        return _has_last ? &_last : nullptr;
+    }
+
+    void add(const EventIndexEntry& entry) {
+        _stream.write(reinterpret_cast<const char*>(&entry),
+                      sizeof(EventIndexEntry));
+    }
+
+    void flush() { _stream.flush(); }
+};
+
+}  // namespace SBCQueens::BinaryFormat
+
+#endif
@@ -0,0 +1,363 @@
+#ifndef SBCRAWDUMP_H
+#define SBCRAWDUMP_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+// C++ 3rd party includes
+#include <CAENDigitizer.h>
+#include <readerwriterqueue.h>
+
+// my includes
+#include "sbcqueens-gui/caen_helper.hpp"
+#include "sbcqueens-gui/file_helpers.hpp"
+#include "sbcqueens-gui/multithreading_helpers/WorkerPool.hpp"
+#include "sbcqueens-gui/sipm_helpers/Checksum.hpp"
+#include "sbcqueens-gui/sipm_helpers/ChunkCompression.hpp"
+#include "sbcqueens-gui/sipm_helpers/SiPMAsyncWriter.hpp"
+
+// Raw dumps: the readout blocks of the digitizer saved as they come out of
+// CAEN_DGTZ_ReadData, without decoding them. It is the cheapest way to save
+// the data on the DAQ host; decode_raw_dump(...) (or sbc-decode-raw) turns
+// them into SBC binary files later, with all the cores.
+//
+// Format (numbers in the byte order of the host; the readout buffer is
+// always little endian):
+//  magic "SBCRAW01"
+//  records, each starting with u32 type and u32 size of the rest:
+//   config (type 1): u32 hash, then the model, family and every field of
+//                    CAENGlobalConfig and the 8 CAENGroupConfig. The hash is
+//                    the CRC32C of what follows it.
+//   block (type 2):  i64 host time (ns since unix epoch), u32 hash of the
+//                    config it was taken with, u32 board serial number,
+//                    char[12] board model name, u32 number of events, then
+//                    the readout buffer.
+// A config record always comes before the blocks that use it, and is saved
+// again every time the dump is resumed. A dump cut by a crash ends in an
+// incomplete record, which is ignored when read.
+namespace SBCQueens::BinaryFormat {
+
+constexpr std::array<char, 8> kRawDumpMagic
+    = {'S', 'B', 'C', 'R', 'A', 'W', '0', '1'};
+
+enum class RawRecordType : uint32_t {
+    Config = 1,
+    Block = 2
+};
+
+// Everything needed to decode the blocks and write them as a SiPM file
+struct RawDumpConfig {
+    CAENDigitizerModel Model;
+    CAENDigitizerFamilies Family;
+    CAENGlobalConfig GlobalConfig;
+    std::array<CAENGroupConfig, 8> GroupConfigs;
+};
+
+struct RawBlockHeader {
+    int64_t HostTime = 0;
+    uint32_t ConfigHash = 0;
+    uint32_t BoardSerial = 0;
+    std::array<char, 12> BoardModel = {};
+    uint32_t NumEvents = 0;
+    // Not saved: it is the size of the record minus the header
+    uint32_t DataSize = 0;
+};
+
+namespace RawDump {
+
+// Bytes of the u32 type and u32 size of every record
+constexpr std::size_t kRecordHeaderSize = 2*sizeof(uint32_t);
+// Bytes of a block record before its data
+constexpr std::size_t kBlockHeaderSize = sizeof(int64_t) + 3*sizeof(uint32_t)
+    + std::tuple_size_v<decltype(RawBlockHeader::BoardModel)>;
+
+// Fields of the config in the order they are saved, without the hash
+std::vector<char> serialize(const RawDumpConfig& config);
+// Throws std::runtime_error if data is too short
+RawDumpConfig deserialize(std::span<const char> data);
+
+// CRC32C of serialize(config). Configs that give the same hash record the
+// digitizer the same way.
+uint32_t config_hash(const RawDumpConfig& config);
+
+// Header of a block taken now, from board info
+RawBlockHeader block_header(const CAEN_DGTZ_BoardInfo_t& board_info,
+                            const uint32_t& config_hash,
+                            const uint32_t& num_events,
+                            const uint32_t& data_size);
+
+}  // namespace RawDump
+
+// A readout block that travels from the acquisition thread to the writer
+// thread. Data keeps its capacity so it is not reallocated once it is as
+// big as the readout buffer.
+struct RawDumpBlock {
+    RawBlockHeader Header;
+    std::vector<char> Data;
+};
+
+using RawDumpBlock_ptr = std::unique_ptr<RawDumpBlock>;
+
+// Saves the readout blocks to a raw dump in its own thread, the same way
+// SiPMAsyncWriter saves waveforms.
+//
+// The acquisition thread copies every block in with save_block(...), which
+// only blocks (counted as stall time) if the writer is behind by the whole
+// pool. The copy is needed because the readout buffer goes back to the
+// digitizer, but it is a lot cheaper than decoding.
+//
+// The file is created, with the config record, in the constructor: it
+// throws std::runtime_error if it cannot be. If it already is a dump, the
+// blocks are appended to it (like SiPMDynamicWriter does) after cutting
+// what a crash could have left incomplete. Errors while writing stop the
+// writing and are reported by hasError().
+class RawDumpWriter {
+    std::ofstream _stream;
+    std::string _file_name;
+    uint32_t _config_hash = 0;
+
+    moodycamel::BlockingReaderWriterQueue<RawDumpBlock_ptr> _filled_blocks;
+    moodycamel::BlockingReaderWriterQueue<RawDumpBlock_ptr> _free_blocks;
+
+    // Only touched by the acquisition thread
+    double _stall_time = 0.0;
+
+    std::atomic<uint64_t> _bytes_written = 0;
+    std::atomic<double> _bytes_per_second = 0.0;
+    std::atomic<bool> _has_error = false;
+    // Written once by the writer thread before _has_error is set
+    std::string _error_msg;
+
+    std::atomic<bool> _stop = false;
+    std::thread _writer_thread;
+
+    void _write_record(const RawRecordType& type, std::span<const char> header,
+                       std::span<const char> data);
+    void _write_loop();
+
+ public:
+    RawDumpWriter(std::string_view file_name, const RawDumpConfig& config,
+                  const std::size_t& num_blocks = 4);
+    // Waits until all the saved blocks are written
+    ~RawDumpWriter();
+
+    RawDumpWriter(const RawDumpWriter&) = delete;
+    RawDumpWriter& operator=(const RawDumpWriter&) = delete;
+
+    [[nodiscard]] bool hasError() const noexcept { return _has_error; }
+    // Only valid if hasError() is true
+    [[nodiscard]] const std::string& getError() const noexcept {
+        return _error_msg;
+    }
+    [[nodiscard]] const uint32_t& getConfigHash() const noexcept {
+        return _config_hash;
+    }
+
+    // Copies the readout buffer, with num_events events, and hands it to
+    // the writer thread. Blocks if all the blocks are waiting to be written.
+    void save_block(std::span<const char> data, const uint32_t& num_events,
+                    const CAEN_DGTZ_BoardInfo_t& board_info);
+
+    // Should be called from the same thread that calls save_block()
+    [[nodiscard]] SiPMWriterStatistics getStatistics() const {
+        return {_filled_blocks.size_approx(),
+                _stall_time,
+                _bytes_per_second.load(),
+                _bytes_written.load()};
+    }
+};
+
+// A block of a dump, pointing into the memory mapped file
+struct RawDumpEntry {
+    RawBlockHeader Header;
+    // Position in RawDumpReader::configs() of the config it was taken with
+    std::size_t Config = 0;
+    std::span<const char> Data;
+};
+
+// Memory maps a raw dump and lists its configs, without repeats, and blocks.
+// Throws std::runtime_error if the file cannot be read, is not a raw dump
+// or a block comes before its config.
+class RawDumpReader {
+    MemoryMappedFile _file;
+    std::vector<RawDumpConfig> _configs;
+    std::vector<uint32_t> _config_hashes;
+    std::vector<RawDumpEntry> _blocks;
+    std::size_t _size = 0;
+    bool _truncated = false;
+
+ public:
+    explicit RawDumpReader(std::string_view file_name);
+
+    [[nodiscard]] const std::string& name() const noexcept {
+        return _file.name();
+    }
+    [[nodiscard]] const std::vector<RawDumpConfig>& configs() const noexcept {
+        return _configs;
+    }
+    [[nodiscard]] const std::vector<RawDumpEntry>& blocks() const noexcept {
+        return _blocks;
+    }
+    // True if the file ends in an incomplete record, which was ignored
+    [[nodiscard]] const bool& truncated() const noexcept { return _truncated; }
+    // Bytes up to the end of the last complete record
+    [[nodiscard]] const std::size_t& size() const noexcept { return _size; }
+};
+
+struct RawDecodeOptions {
+    // Threads that decode the events of a block. 0 = one per hardware thread
+    std::size_t NumThreads = 0;
+    CompressionOptions Compression;
+    uint32_t IndexStride = 0;
+    ChecksumOptions Checksums;
+};
+
+struct RawDecodeReport {
+    uint64_t NumBlocks = 0;
+    uint64_t NumEvents = 0;
+    // Blocks skipped because their events could not be decoded
+    uint64_t CorruptedBlocks = 0;
+    // See RawDumpReader::truncated()
+    bool Truncated = false;
+};
+
+// Decodes the blocks of a raw dump, in order, into a SiPM file out_name
+// (same as SiPMDynamicWriter would save during the acquisition). The events
+// of every block are decoded with options.NumThreads threads while the
+// previous block is written.
+//
+// Only the x730 and x740 families can be decoded. Blocks that are
+// corrupted are skipped and counted. Throws std::runtime_error if out_name
+// already exists, the dump cannot be read, its family is not supported or
+// it has more than one config, as a SiPM file can only have one.
+RawDecodeReport decode_raw_dump(std::string_view dump_name,
+                                std::string_view out_name,
+                                const RawDecodeOptions& options = {});
+
+struct RawReplayOptions {
+    // 1 = at the cadence the blocks were read out with, 2 = twice as
+    // fast... 0 = as fast as possible
+    double Speed = 0.0;
+    // Times the dump is played. 0 = until the replay is destroyed
+    uint32_t Loops = 1;
+    // Threads that decode the events of a block. 0 = one per hardware thread
+    std::size_t NumThreads = 1;
+};
+
+struct RawReplayStatistics {
+    uint64_t Blocks = 0;
+    uint64_t Events = 0;
+    uint64_t Bytes = 0;
+    // Blocks that could not be decoded
+    uint64_t CorruptedBlocks = 0;
+    // How late, in s, the latest block was played compared to the original
+    // cadence. It grows if what is fed the blocks cannot keep up with the
+    // acquisition they were recorded in. Always 0 as fast as possible.
+    double Lag = 0.0;
+};
+
+// Plays the blocks of a raw dump back as if they were coming out of the
+// digitizer, so the same data can be pushed through the decoding, the
+// analysis and the writers again and again, and benchmarked. It is used
+// like the readout ring of CAEN<>: retrieve_block(...), decode() and
+// swap_waveforms(...) take the place of RetrieveReadoutBlock(...),
+// DecodeEvents() and SwapWaveforms(...).
+//
+// The blocks are played in order, either as fast as possible or at the
+// cadence of their host time (see RawReplayOptions::Speed). They are
+// decoded with the in-house decoders, so no digitizer is needed.
+//
+// Throws std::runtime_error if the dump cannot be read, its family cannot
+// be decoded or it has more than one config.
+class RawDumpReplay {
+    using clock = std::chrono::steady_clock;
+
+    RawDumpReader _dump;
+    RawReplayOptions _options;
+    CAENDigitizerModelConstants _model_constants;
+    WorkerPool _pool;
+    CAENWaveformBatch<uint16_t> _waveforms;
+    std::vector<uint32_t> _offsets;
+
+    // Block being played
+    const RawDumpEntry* _current = nullptr;
+    std::size_t _next = 0;
+    uint32_t _loop = 0;
+    // When the first block of the current loop was played
+    clock::time_point _loop_start;
+    RawReplayStatistics _stats;
+
+ public:
+    explicit RawDumpReplay(std::string_view file_name,
+                           const RawReplayOptions& options = {});
+
+    RawDumpReplay(const RawDumpReplay&) = delete;
+    RawDumpReplay& operator=(const RawDumpReplay&) = delete;
+
+    [[nodiscard]] const RawDumpConfig& config() const noexcept {
+        return _dump.configs().front();
+    }
+    [[nodiscard]] const CAENDigitizerModelConstants&
+    modelConstants() const noexcept {
+        return _model_constants;
+    }
+    // True once every loop has been played
+    [[nodiscard]] bool done() const noexcept;
+
+    // Moves to the next block. At the original cadence it first waits, up
+    // to timeout, for the block to be due. Returns true if there is a new
+    // block; false if it is not due yet or the replay is done.
+    bool retrieve_block(const std::chrono::milliseconds& timeout);
+
+    // Of the latest retrieved block, empty if there is none
+    [[nodiscard]] std::span<const char> raw_data() const noexcept {
+        return _current == nullptr ? std::span<const char>{} : _current->Data;
+    }
+    [[nodiscard]] uint32_t num_events() const noexcept {
+        return _current == nullptr ? 0 : _current->Header.NumEvents;
+    }
+
+    // Decodes the latest retrieved block into waveforms(). Returns false,
+    // and counts it, if the block is corrupted.
+    bool decode();
+    [[nodiscard]] const CAENWaveformBatch<uint16_t>& waveforms() const noexcept {
+        return _waveforms;
+    }
+    // Same as CAEN::GetWaveform
+    CAENWaveformView<uint16_t> waveform(const std::size_t& i) noexcept {
+        return _waveforms[std::min(i, _waveforms.capacity() - 1)];
+    }
+    // Same as CAEN::SwapWaveforms
+    bool swap_waveforms(CAENWaveformBatch<uint16_t>& other) noexcept {
+        if (not _waveforms.hasSameLayout(other)) {
+            return false;
+        }
+
+        _waveforms.swap(other);
+        _waveforms.resize(0);
+        return true;
+    }
+
+    [[nodiscard]] const RawReplayStatistics& statistics() const noexcept {
+        return _stats;
+    }
+};
+
+}  // namespace SBCQueens::BinaryFormat
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef SBCRUNMANIFEST_H
+#define SBCRUNMANIFEST_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// C++ 3rd party includes
+// my includes
+
+namespace SBCQueens::BinaryFormat {
+
+// When a SiPMDynamicWriter closes its file and continues in a new one
+// (segment). With both at 0 everything goes to a single file.
+struct RolloverOptions {
+    // Bytes after which a new segment is started. 0 = no limit
+    uint64_t MaxBytes = 0;
+    // Time after which a new segment is started. 0 = no limit
+    std::chrono::seconds MaxDuration{0};
+
+    [[nodiscard]] bool enabled() const noexcept {
+        return MaxBytes > 0 or MaxDuration.count() > 0;
+    }
+};
+
+// One file of a run that was split in segments
+struct RunSegment {
+    // Relative to the manifest directory
+    std::string FileName;
+    // Event number of its first event counting from the start of the run
+    uint64_t FirstEvent = 0;
+    uint64_t NumEvents = 0;
+    // Trigger time tags of its first and last events with their roll overs
+    // counted (see TriggerTimeUnwrapper). They start again from 0 when the
+    // acquisition is restarted.
+    uint64_t FirstTriggerTime = 0;
+    uint64_t LastTriggerTime = 0;
+    // Host time when it was opened and closed, in ns since the epoch of
+    // std::chrono::system_clock. EndTime is 0 if it was never closed.
+    int64_t StartTime = 0;
+    int64_t EndTime = 0;
+    uint64_t Bytes = 0;
+    // False while it is being written, or if the writer crashed before
+    // closing it.
+    bool Closed = false;
+    // If it matched its checksums when it was checked after being closed.
+    // Empty if it was not checked.
+    std::optional<bool> Verified;
+};
+
+// List of the segments of a run, saved as JSON next to them so the
+// segments can be processed in parallel (one per core) without opening
+// each one first:
+//   {"version": 1, "segments": [{"file": "SiPM_0000.bin",
+//     "first_event": 0, "num_events": ..., ...}, ...]}
+class RunManifest {
+    std::string _file_name;
+    std::vector<RunSegment> _segments;
+
+ public:
+    constexpr static int kVersion = 1;
+
+    // "dir/SiPM.bin" -> "dir/SiPM.manifest.json"
+    static std::string manifest_name(std::string_view base_file);
+    // "dir/SiPM.bin", 3 -> "dir/SiPM_0003.bin"
+    static std::string segment_name(std::string_view base_file,
+                                     const std::size_t& number);
+
+    // Loads the manifest if it exists, otherwise it starts empty.
+    // Throws std::runtime_error if it exists but cannot be parsed.
+    explicit RunManifest(std::string_view file_name);
+
+    // Replaces the manifest file in one step (written to a temporary file
+    // and renamed) so it is never seen half written.
+    // Throws std::runtime_error if it cannot be written.
+    void save() const;
+
+    [[nodiscard]] const std::string& name() const noexcept { return _file_name; }
+    [[nodiscard]] std::vector<RunSegment>& segments() noexcept { return _segments; }
+    [[nodiscard]] const std::vector<RunSegment>& segments() const noexcept {
+        return _segments;
+    }
+
+    // Full path of a segment
+    [[nodiscard]] std::string path(const RunSegment& segment) const;
+    // First event number of the next segment
+    [[nodiscard]] uint64_t next_event() const noexcept;
+};
+
+}  // namespace SBCQueens::BinaryFormat
+
+#endif
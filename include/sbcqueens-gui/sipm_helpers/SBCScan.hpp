@@ -0,0 +1,275 @@
+#ifndef SBCSCAN_H
+#define SBCSCAN_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// C++ 3rd party includes
+// my includes
+#include "sbcqueens-gui/multithreading_helpers/WorkerPool.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCRunManifest.hpp"
+
+namespace SBCQueens::BinaryFormat {
+
+struct ScanOptions {
+    // 0 = one per hardware thread
+    std::size_t NumThreads = 0;
+    // The files are cut in tasks of about this many events that the threads
+    // take one at a time, so a slow file does not hold up the others.
+    // Compressed files are cut at their chunks.
+    std::size_t TaskEvents = 16384;
+};
+
+// Columns of an event that are read before deciding if it is scanned. In
+// SiPM files they sit at the start of the line, so the waveforms of the
+// events that do not pass the predicate are never read.
+struct ScanKeys {
+    // Position of its file in the list of files
+    std::size_t File = 0;
+    // Event number in its file
+    std::size_t Event = 0;
+    // "time_stamp" column: trigger time tag with its roll over bit
+    uint32_t TimeStamp = 0;
+    // "trg_source" column
+    uint32_t TriggerSource = 0;
+};
+
+// Event that passed the predicate. Its other columns are read through the
+// Reader of the thread, which is only valid during the call.
+class ScanEvent {
+    const Reader<>& _reader;
+    ScanKeys _keys;
+
+ public:
+    ScanEvent(const Reader<>& reader, const ScanKeys& keys) :
+        _reader{reader}, _keys{keys} {}
+
+    [[nodiscard]] const ScanKeys& keys() const noexcept { return _keys; }
+    [[nodiscard]] const Reader<>& reader() const noexcept { return _reader; }
+
+    // Raw bytes of column c
+    [[nodiscard]] std::span<const char> raw(const std::size_t& c) const {
+        return _reader.get_raw(_keys.Event, c);
+    }
+
+    // See Reader::unpack(...)
+    void unpack(const std::size_t& c, std::span<uint16_t> out) const {
+        _reader.unpack(_keys.Event, c, out);
+    }
+};
+
+template<typename Accumulator>
+struct ScanResult {
+    Accumulator Value;
+    // Events read and events that passed the predicate
+    uint64_t NumEvents = 0;
+    uint64_t NumMatched = 0;
+};
+
+// Events [First, Last) of file File
+struct ScanTask {
+    std::size_t File = 0;
+    std::size_t First = 0;
+    std::size_t Last = 0;
+};
+
+namespace Tools {
+
+// Cuts files of num_events events in tasks of at least task_events events
+// (the last of every file can be shorter). For compressed files,
+// chunk_first_events has the first event of their chunks and the tasks end
+// at a chunk so no chunk is decompressed twice.
+inline std::vector<ScanTask> scan_tasks(
+        const std::vector<std::size_t>& num_events,
+        const std::vector<std::vector<uint64_t>>& chunk_first_events,
+        const std::size_t& task_events) {
+    std::vector<ScanTask> tasks;
+    for (std::size_t f = 0; f < num_events.size(); f++) {
+        const auto n = num_events[f];
+        const auto& chunks = chunk_first_events[f];
+        std::size_t first = 0;
+        std::size_t next_chunk = 0;
+        while (first < n) {
+            std::size_t last = std::min(n, first + task_events);
+            if (not chunks.empty()) {
+                while (next_chunk < chunks.size() and chunks[next_chunk] < last) {
+                    next_chunk++;
+                }
+                last = next_chunk < chunks.size() ? chunks[next_chunk] : n;
+            }
+
+            tasks.push_back({f, first, last});
+            first = last;
+        }
+    }
+
+    return tasks;
+}
+
+}  // namespace Tools
+
+// Runs func(accumulator, event) over the events of files that pass
+// predicate(keys), split between options.NumThreads threads.
+//
+// Every thread starts from a copy of init, opens its own Readers and works
+// on its own accumulator, so func needs no locks. At the end, the
+// accumulators are folded into the first with merge(into, std::move(other)).
+// The events each thread gets change from run to run, so merge should not
+// depend on the order (floating point sums can differ in the last bits).
+//
+// predicate gets a const ScanKeys& and func a const ScanEvent&. Neither may
+// keep references to the event after returning.
+//
+// Throws std::runtime_error, with the file name, if a file cannot be read
+// or does not have the time_stamp and trg_source columns, and rethrows
+// the first exception thrown by predicate or func. The remaining tasks are
+// skipped in both cases.
+template<typename Accumulator, typename Predicate, typename Func,
+         typename Merge>
+ScanResult<Accumulator> scan_files(const std::vector<std::string>& file_names,
+                                   const Accumulator& init,
+                                   Predicate&& predicate, Func&& func,
+                                   Merge&& merge,
+                                   const ScanOptions& options = {}) {
+    if (options.TaskEvents == 0) {
+        throw std::invalid_argument("Scan task events cannot be 0.");
+    }
+
+    WorkerPool pool(options.NumThreads);
+
+    // Every file is opened once first to learn how to cut it
+    std::vector<std::size_t> num_events(file_names.size(), 0);
+    std::vector<std::vector<uint64_t>> chunks(file_names.size());
+    std::vector<std::string> errors(file_names.size());
+    pool.for_each_chunk(file_names.size(), [&](std::size_t begin,
+                                               std::size_t end, std::size_t) {
+        for (auto f = begin; f < end; f++) {
+            try {
+                const Reader<> reader(file_names[f]);
+                static_cast<void>(reader.column_index("time_stamp"));
+                static_cast<void>(reader.column_index("trg_source"));
+                num_events[f] = reader.size();
+                chunks[f] = reader.chunk_first_events();
+            } catch (std::exception& err) {
+                errors[f] = err.what();
+            }
+        }
+    });
+
+    for (std::size_t f = 0; f < file_names.size(); f++) {
+        if (not errors[f].empty()) {
+            throw std::runtime_error("Could not scan " + file_names[f] + ": "
+                                     + errors[f]);
+        }
+    }
+
+    const auto tasks = Tools::scan_tasks(num_events, chunks,
+                                         options.TaskEvents);
+
+    struct Worker {
+        Accumulator Value;
+        uint64_t NumEvents = 0;
+        uint64_t NumMatched = 0;
+        std::exception_ptr Error;
+    };
+
+    std::vector<Worker> workers(pool.size(), Worker{init, 0, 0, nullptr});
+    std::atomic<std::size_t> next_task{0};
+    std::atomic<bool> failed{false};
+    // One chunk per worker; the tasks are taken from next_task as they go
+    pool.for_each_chunk(pool.size(), [&](std::size_t, std::size_t,
+                                         std::size_t w) {
+        auto& worker = workers[w];
+        std::optional<Reader<>> reader;
+        std::size_t open_file = std::numeric_limits<std::size_t>::max();
+        std::size_t time_stamp_column = 0;
+        std::size_t trg_source_column = 0;
+        auto read_u32 = [&](const std::size_t& i, const std::size_t& c) {
+            uint32_t out = 0;
+            std::memcpy(&out, reader->get_raw(i, c).data(), sizeof(uint32_t));
+            return out;
+        };
+
+        try {
+            while (not failed.load(std::memory_order_relaxed)) {
+                const auto t = next_task.fetch_add(1, std::memory_order_relaxed);
+                if (t >= tasks.size()) {
+                    return;
+                }
+
+                const auto& task = tasks[t];
+                if (task.File != open_file) {
+                    reader.emplace(file_names[task.File]);
+                    time_stamp_column = reader->column_index("time_stamp");
+                    trg_source_column = reader->column_index("trg_source");
+                    open_file = task.File;
+                }
+
+                for (auto i = task.First; i < task.Last; i++) {
+                    const ScanKeys keys{task.File, i,
+                                        read_u32(i, time_stamp_column),
+                                        read_u32(i, trg_source_column)};
+                    worker.NumEvents++;
+                    if (not predicate(keys)) {
+                        continue;
+                    }
+
+                    worker.NumMatched++;
+                    func(worker.Value, ScanEvent(*reader, keys));
+                }
+            }
+        } catch (...) {
+            worker.Error = std::current_exception();
+            failed = true;
+        }
+    });
+
+    for (auto& worker : workers) {
+        if (worker.Error) {
+            std::rethrow_exception(worker.Error);
+        }
+    }
+
+    ScanResult<Accumulator> result{std::move(workers.front().Value),
+                                   workers.front().NumEvents,
+                                   workers.front().NumMatched};
+    for (std::size_t w = 1; w < workers.size(); w++) {
+        merge(result.Value, std::move(workers[w].Value));
+        result.NumEvents += workers[w].NumEvents;
+        result.NumMatched += workers[w].NumMatched;
+    }
+
+    return result;
+}
+
+// Full paths of the segments of a run in order, to scan the whole run with
+// scan_files(...). The event number in the run of an event is
+// manifest.segments()[keys.File].FirstEvent + keys.Event.
+inline std::vector<std::string> segment_files(const RunManifest& manifest) {
+    std::vector<std::string> out;
+    out.reserve(manifest.segments().size());
+    for (const auto& segment : manifest.segments()) {
+        out.push_back(manifest.path(segment));
+    }
+
+    return out;
+}
+
+}  // namespace SBCQueens::BinaryFormat
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef SIPMASYNCWRITER_H
+#define SIPMASYNCWRITER_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+// C++ 3rd party includes
+#include <readerwriterqueue.h>
+
+// my includes
+#include "sbcqueens-gui/caen_helper.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+
+namespace SBCQueens::BinaryFormat {
+
+// A group of waveforms that travels between the acquisition thread
+// and the writer thread. Only the first Waveforms.size() are valid.
+struct SiPMWaveformBatch {
+    CAENWaveformBatch<uint16_t> Waveforms;
+};
+
+using SiPMWaveformBatch_ptr = std::unique_ptr<SiPMWaveformBatch>;
+
+struct SiPMWriterStatistics {
+    // Batches waiting to be written
+    std::size_t QueueDepth = 0;
+    // Total time the acquisition thread waited for a free batch, in ms
+    double StallTime = 0.0;
+    // Bytes written to the file in the last second
+    double BytesPerSecond = 0.0;
+    uint64_t BytesWritten = 0;
+};
+
+// Writes SiPM waveforms to a file in its own thread so disk stalls do not
+// delay the digitizer readout.
+//
+// The acquisition thread takes a free batch with acquire_batch(), fills it
+// (CAEN::SwapWaveforms is the cheapest way) and hands it to the writer
+// with submit(...). The writer saves it and puts it back in the pool. With
+// the default of 2 batches one can be filled while the other is written.
+// If the writer falls behind by the whole pool, acquire_batch() blocks and
+// that time is counted as stall time.
+//
+// The file is created in the constructor: it throws the same as
+// SiPMDynamicWriter. Errors while writing stop the writing (batches are
+// still recycled) and are reported by hasError().
+class SiPMAsyncWriter {
+    SiPMDynamicWriter _file;
+
+    moodycamel::BlockingReaderWriterQueue<SiPMWaveformBatch_ptr> _filled_batches;
+    moodycamel::BlockingReaderWriterQueue<SiPMWaveformBatch_ptr> _free_batches;
+
+    // Only touched by the acquisition thread
+    double _stall_time = 0.0;
+
+    std::atomic<uint64_t> _bytes_written = 0;
+    std::atomic<double> _bytes_per_second = 0.0;
+    std::atomic<bool> _has_error = false;
+    // Written once by the writer thread before _has_error is set
+    std::string _error_msg;
+
+    std::atomic<bool> _stop = false;
+    std::thread _writer_thread;
+
+    void _write_loop() {
+        using clock = std::chrono::steady_clock;
+        auto window_start = clock::now();
+        uint64_t window_bytes = 0;
+
+        SiPMWaveformBatch_ptr batch;
+        while (true) {
+            if (_filled_batches.wait_dequeue_timed(batch,
+                                                   std::chrono::milliseconds(100))) {
+                if (not _has_error.load(std::memory_order_relaxed)) {
+                    try {
+                        // Compressed files only grow once a chunk is full
+                        const auto file_size = _file.getFileSize();
+                        _file.save_waveforms(batch->Waveforms);
+                        const uint64_t bytes = _file.getFileSize() - file_size;
+                        window_bytes += bytes;
+                        _bytes_written += bytes;
+                    } catch (std::exception& err) {
+                        _error_msg = err.what();
+                        _has_error = true;
+                    }
+                }
+
+                batch->Waveforms.resize(0);
+                _free_batches.enqueue(std::move(batch));
+            } else if (_stop) {
+                // Only stops once everything submitted has been written
+                break;
+            }
+
+            std::chrono::duration<double> dt = clock::now() - window_start;
+            if (dt.count() >= 1.0) {
+                _bytes_per_second = static_cast<double>(window_bytes) / dt.count();
+                window_bytes = 0;
+                window_start = clock::now();
+            }
+        }
+    }
+
+ public:
+    // batch_size should be the max number of events a single readout
+    // can return, so the batches can be swapped with the digitizer
+    // waveforms. The memory used is num_batches times that of the
+    // digitizer waveforms.
+    // With compression, the chunks are compressed from the writer thread
+    // (with compression.NumThreads threads) so it never delays the
+    // acquisition thread.
+    // If index_stride is not 0 the file gets a sidecar event index, with
+    // rollover the file is split in segments, and checksums sets the
+    // checksums saved and checked, see SiPMDynamicWriter.
+    SiPMAsyncWriter(std::string_view file_name,
+                    const CAENDigitizerFamilies& fam,
+                    const CAENDigitizerModelConstants& model_consts,
+                    const CAENGlobalConfig& global_config,
+                    const std::array<CAENGroupConfig, 8>& group_configs,
+                    const std::size_t& batch_size,
+                    const std::size_t& num_batches = 2,
+                    const CompressionOptions& compression = {},
+                    const uint32_t& index_stride = 0,
+                    const RolloverOptions& rollover = {},
+                    const ChecksumOptions& checksums = {}) :
+        _file{file_name, fam, model_consts, global_config, group_configs,
+              compression, index_stride, rollover, checksums},
+        _filled_batches(num_batches),
+        _free_batches(num_batches)
+    {
+        for (std::size_t i = 0; i < num_batches; i++) {
+            auto batch = std::make_unique<SiPMWaveformBatch>();
+            batch->Waveforms = CAENWaveformBatch<uint16_t>(model_consts,
+                global_config, group_configs, batch_size);
+            _free_batches.enqueue(std::move(batch));
+        }
+
+        _writer_thread = std::thread(&SiPMAsyncWriter::_write_loop, this);
+    }
+
+    // Waits until all the submitted batches are written
+    ~SiPMAsyncWriter() {
+        _stop = true;
+        if (_writer_thread.joinable()) {
+            _writer_thread.join();
+        }
+    }
+
+    SiPMAsyncWriter(const SiPMAsyncWriter&) = delete;
+    SiPMAsyncWriter& operator=(const SiPMAsyncWriter&) = delete;
+
+    bool isOpen() { return _file.isOpen(); }
+    [[nodiscard]] bool hasError() const noexcept { return _has_error; }
+    // Only valid if hasError() is true
+    [[nodiscard]] const std::string& getError() const noexcept {
+        return _error_msg;
+    }
+
+    // Returns an empty batch. Blocks if all of them are waiting to be
+    // written.
+    SiPMWaveformBatch_ptr acquire_batch() {
+        SiPMWaveformBatch_ptr batch;
+        if (_free_batches.try_dequeue(batch)) {
+            return batch;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        _free_batches.wait_dequeue(batch);
+        std::chrono::duration<double, std::milli> dt
+            = std::chrono::steady_clock::now() - start;
+        _stall_time += dt.count();
+        return batch;
+    }
+
+    // Hands the batch to the writer thread. Its valid waveforms are
+    // going to be saved.
+    void submit(SiPMWaveformBatch_ptr batch) {
+        _filled_batches.enqueue(std::move(batch));
+    }
+
+    // Should be called from the same thread that calls acquire_batch()
+    [[nodiscard]] SiPMWriterStatistics getStatistics() const {
+        return {_filled_batches.size_approx(),
+                _stall_time,
+                _bytes_per_second.load(),
+                _bytes_written.load()};
+    }
+};
+
+} // namespace SBCQueens::BinaryFormat
+
+#endif //SIPMASYNCWRITER_H
@@ -0,0 +1,329 @@
+#ifndef SIPMEVENTBUILDER_H
+#define SIPMEVENTBUILDER_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// C++ 3rd party includes
+#include <readerwriterqueue.h>
+
+// my includes
+#include "sbcqueens-gui/caen_helper.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCEventIndex.hpp"
+
+namespace SBCQueens {
+
+// The trigger time tag of the x740 and x730 counts every 8 ns
+constexpr double kTriggerTimeTagTick = 8.0;
+
+// The trg_source column of a file with more than one board holds, besides
+// the trigger pattern of the digitizer (bits 0-15), the board the waveform
+// came from (bits 16-23, its position in ConetNodes) and whether it is the
+// first waveform of a built event (bit 24).
+constexpr uint32_t kMergedPatternMask = 0x0000FFFF;
+constexpr uint32_t kMergedBoardShift = 16;
+constexpr uint32_t kMergedBoardMask = 0x00FF0000;
+constexpr uint32_t kMergedEventStart = 0x01000000;
+constexpr std::size_t kMaxMergedBoards = 256;
+
+inline uint32_t merged_board(const uint32_t& trg_source) noexcept {
+    return (trg_source & kMergedBoardMask) >> kMergedBoardShift;
+}
+
+inline bool is_built_event_start(const uint32_t& trg_source) noexcept {
+    return trg_source & kMergedEventStart;
+}
+
+// The waveforms of a readout of a single board
+struct BoardBatch {
+    CAENWaveformBatch<uint16_t> Waveforms;
+    // Extended trigger time of every valid waveform, set by the builder
+    std::vector<uint64_t> Times;
+};
+
+using BoardBatch_ptr = std::unique_ptr<BoardBatch>;
+
+struct EventBuilderOptions {
+    // In ns. Waveforms up to this long after the first one of a built
+    // event are part of it.
+    double CoincidenceWindow = 0.0;
+    // Built events with waveforms of fewer boards are not kept.
+    // 1 keeps all of them: the output is every waveform in time order.
+    uint32_t MinBoards = 1;
+    // A board that did not send anything for this long does not hold
+    // back the merge. Should be longer than the readout max latency.
+    std::chrono::milliseconds Timeout{1000};
+    // Readouts each board can have waiting to be merged
+    std::size_t NumBatches = 4;
+};
+
+struct EventBuilderStatistics {
+    // Waveforms received from every board
+    std::vector<uint64_t> BoardEvents;
+    // Waveforms received but not merged yet
+    uint64_t Backlog = 0;
+    uint64_t BuiltEvents = 0;
+    // Waveforms of the built events that were kept
+    uint64_t MergedEvents = 0;
+    // Waveforms of built events with fewer than MinBoards boards
+    uint64_t RejectedEvents = 0;
+    // Waveforms that came after later ones were already merged, because
+    // their board timed out. They are still merged.
+    uint64_t LateEvents = 0;
+};
+
+// Merges the waveforms of several digitizers into a single stream ordered
+// by their extended trigger time tag, and groups them into built events:
+// the waveforms within CoincidenceWindow of the first one.
+//
+// Every board is read by its own thread, which takes a free batch with
+// acquire_batch(board, ...), fills it (CAEN::SwapWaveforms) and hands it
+// over with submit(board, ...). Another thread calls merge(...), which
+// only merges a waveform once every board sent a later one, or timed out,
+// so an earlier one cannot show up afterwards. The boards should share
+// the clock and start (CAENGlobalConfig::AcqMode) for their trigger time
+// tags to be comparable.
+class SiPMEventBuilder {
+    using clock_type = std::chrono::steady_clock;
+
+    struct Board {
+        moodycamel::BlockingReaderWriterQueue<BoardBatch_ptr> Filled;
+        moodycamel::BlockingReaderWriterQueue<BoardBatch_ptr> Free;
+
+        // Only touched by merge()
+        std::deque<BoardBatch_ptr> Pending;
+        // First waveform of Pending.front() that was not merged
+        std::size_t Next = 0;
+        BinaryFormat::TriggerTimeUnwrapper TriggerTime;
+        clock_type::time_point LastArrival;
+
+        explicit Board(const std::size_t& num_batches) :
+            Filled(num_batches), Free(num_batches),
+            LastArrival{clock_type::now()} { }
+    };
+
+    // Not movable because of the queues
+    std::vector<std::unique_ptr<Board>> _boards;
+    const EventBuilderOptions _options;
+    // In trigger time tag ticks
+    const uint64_t _window;
+
+    // The built event being put together
+    CAENWaveformBatch<uint16_t> _event;
+    uint64_t _event_start = 0;
+    std::vector<bool> _event_has_board;
+    uint32_t _event_boards = 0;
+
+    uint64_t _last_time = 0;
+    EventBuilderStatistics _stats;
+
+    // Takes the batches the board threads submitted
+    void _collect() {
+        const auto now = clock_type::now();
+        for (std::size_t b = 0; b < _boards.size(); b++) {
+            auto& board = *_boards[b];
+            BoardBatch_ptr batch;
+            while (board.Filled.try_dequeue(batch)) {
+                board.LastArrival = now;
+                const auto n = batch->Waveforms.size();
+                if (n == 0) {
+                    board.Free.enqueue(std::move(batch));
+                    continue;
+                }
+
+                batch->Times.resize(n);
+                for (std::size_t i = 0; i < n; i++) {
+                    batch->Times[i] = board.TriggerTime(
+                        batch->Waveforms.getInfo(i).TriggerTimeTag);
+                }
+
+                _stats.BoardEvents[b] += n;
+                _stats.Backlog += n;
+                board.Pending.push_back(std::move(batch));
+            }
+        }
+    }
+
+    // Adds the built event to out if it has enough boards. Returns false,
+    // and keeps it, if it does not fit in out.
+    bool _close_event(CAENWaveformBatch<uint16_t>& out) {
+        const auto n = _event.size();
+        if (_event_boards >= _options.MinBoards) {
+            if (not out.empty() and out.capacity() - out.size() < n) {
+                return false;
+            }
+
+            _stats.MergedEvents += out.append(_event, 0, n);
+            _stats.BuiltEvents++;
+        } else {
+            _stats.RejectedEvents += n;
+        }
+
+        _event.resize(0);
+        std::fill(_event_has_board.begin(), _event_has_board.end(), false);
+        _event_boards = 0;
+        return true;
+    }
+
+ public:
+    // batch_size has to be the max number of events a single readout can
+    // return, the capacity of CAEN::GetWaveforms(), so the batches can be
+    // swapped with the digitizer waveforms. All the boards share the
+    // configuration. Throws std::runtime_error if there are no boards or
+    // more than kMaxMergedBoards.
+    SiPMEventBuilder(const std::size_t& num_boards,
+                     const CAENDigitizerModelConstants& model_consts,
+                     const CAENGlobalConfig& global_config,
+                     const std::array<CAENGroupConfig, 8>& group_configs,
+                     const std::size_t& batch_size,
+                     const EventBuilderOptions& options = {}) :
+        _options{options},
+        _window{static_cast<uint64_t>(std::llround(
+            std::max(0.0, options.CoincidenceWindow) / kTriggerTimeTagTick))},
+        _event(model_consts, global_config, group_configs, batch_size),
+        _event_has_board(num_boards, false)
+    {
+        if (num_boards == 0 or num_boards > kMaxMergedBoards) {
+            throw std::runtime_error("The event builder takes from 1 to 256 "
+                                     "boards.");
+        }
+
+        const auto num_batches = std::max<std::size_t>(1, options.NumBatches);
+        _stats.BoardEvents.resize(num_boards, 0);
+        for (std::size_t b = 0; b < num_boards; b++) {
+            _boards.push_back(std::make_unique<Board>(num_batches));
+            for (std::size_t i = 0; i < num_batches; i++) {
+                auto batch = std::make_unique<BoardBatch>();
+                batch->Waveforms = CAENWaveformBatch<uint16_t>(model_consts,
+                    global_config, group_configs, batch_size);
+                batch->Times.reserve(batch_size);
+                _boards.back()->Free.enqueue(std::move(batch));
+            }
+        }
+    }
+
+    SiPMEventBuilder(const SiPMEventBuilder&) = delete;
+    SiPMEventBuilder& operator=(const SiPMEventBuilder&) = delete;
+
+    [[nodiscard]] std::size_t numBoards() const noexcept {
+        return _boards.size();
+    }
+
+    // From the thread of board. Waits up to timeout for an empty batch,
+    // there are none while all of them wait to be merged. Returns true if
+    // batch is one.
+    bool acquire_batch(const std::size_t& board, BoardBatch_ptr& batch,
+                       const std::chrono::milliseconds& timeout) {
+        return _boards[board]->Free.wait_dequeue_timed(batch, timeout);
+    }
+
+    // From the thread of board. Hands over the batch to be merged.
+    void submit(const std::size_t& board, BoardBatch_ptr batch) {
+        _boards[board]->Filled.enqueue(std::move(batch));
+    }
+
+    // Adds the built events that are complete after out.size(), until out
+    // is full. Returns the number of waveforms added. With flush, it does
+    // not wait for the boards anymore: everything received is merged, so
+    // call it until it returns 0 once the boards stopped.
+    std::size_t merge(CAENWaveformBatch<uint16_t>& out,
+                      const bool& flush = false) {
+        _collect();
+        const auto first = out.size();
+        const auto now = clock_type::now();
+        while (true) {
+            // Board with the earliest waveform
+            std::size_t next = _boards.size();
+            uint64_t time = 0;
+            bool waiting = false;
+            for (std::size_t b = 0; b < _boards.size(); b++) {
+                const auto& board = *_boards[b];
+                if (board.Pending.empty()) {
+                    // It could still send an earlier one
+                    waiting |= not flush
+                        and now - board.LastArrival < _options.Timeout;
+                    continue;
+                }
+
+                const auto t = board.Pending.front()->Times[board.Next];
+                if (next == _boards.size() or t < time) {
+                    next = b;
+                    time = t;
+                }
+            }
+
+            if (next == _boards.size() or waiting) {
+                break;
+            }
+
+            if (not _event.empty() and (time - _event_start > _window
+                    or _event.size() == _event.capacity())) {
+                if (not _close_event(out)) {
+                    return out.size() - first;
+                }
+            }
+
+            auto& board = *_boards[next];
+            auto& batch = *board.Pending.front();
+            const bool event_start = _event.empty();
+            if (event_start) {
+                _event_start = time;
+            }
+
+            if (time < _last_time) {
+                _stats.LateEvents++;
+            }
+            _last_time = std::max(_last_time, time);
+
+            _event.append(batch.Waveforms, board.Next, 1);
+            auto waveform = _event[_event.size() - 1];
+            auto info = waveform.getInfo();
+            info.Pattern = (info.Pattern & kMergedPatternMask)
+                | (static_cast<uint32_t>(next) << kMergedBoardShift)
+                | (event_start ? kMergedEventStart : 0);
+            waveform.setInfo(info);
+            if (not _event_has_board[next]) {
+                _event_has_board[next] = true;
+                _event_boards++;
+            }
+
+            _stats.Backlog--;
+            if (++board.Next == batch.Waveforms.size()) {
+                auto done = std::move(board.Pending.front());
+                board.Pending.pop_front();
+                board.Next = 0;
+                done->Waveforms.resize(0);
+                board.Free.enqueue(std::move(done));
+            }
+        }
+
+        if (flush and not _event.empty()) {
+            _close_event(out);
+        }
+
+        return out.size() - first;
+    }
+
+    // Should be called from the same thread that calls merge(...)
+    [[nodiscard]] EventBuilderStatistics getStatistics() const {
+        auto stats = _stats;
+        // The built event being put together is still waiting
+        stats.Backlog += _event.size();
+        return stats;
+    }
+};
+
+}  // namespace SBCQueens
+
+#endif //SIPMEVENTBUILDER_H
@@ -0,0 +1,89 @@
+#include "sbcqueens-gui/caen_x730_decoder.hpp"
+
+// C STD includes
+#include <cstring>
+// C 3rd party includes
+// C++ STD includes
+#include <bit>
+
+// C++ 3rd party includes
+// my includes
+#include "sbcqueens-gui/caen_x740_decoder.hpp"
+
+namespace SBCQueens::X730 {
+
+namespace {
+
+uint32_t read_word(const char* ptr) noexcept {
+    uint32_t word = 0;
+    std::memcpy(&word, ptr, sizeof(word));
+    if constexpr (std::endian::native == std::endian::big) {
+        word = ((word & 0x000000FFu) << 24) | ((word & 0x0000FF00u) << 8)
+             | ((word & 0x00FF0000u) >> 8) | ((word & 0xFF000000u) >> 24);
+    }
+    return word;
+}
+
+}  // namespace
+
+CAEN_DGTZ_ErrorCode decode_event(const char* buffer,
+                                 const uint32_t& size_in_bytes,
+                                 std::span<const std::size_t> en_chs,
+                                 const uint32_t& record_length,
+                                 std::span<uint16_t> out,
+                                 CAEN_DGTZ_EventInfo_t& info) noexcept {
+    X740::EventHeader header;
+    auto err = X740::parse_header(buffer, size_in_bytes, header);
+    if (err != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+        return err;
+    }
+
+    info = header.toEventInfo();
+
+    const uint32_t num_channels = std::popcount(header.GroupMask);
+    const uint32_t data_words = header.Size - kHeaderWords;
+    if (num_channels == 0) {
+        return data_words == 0 ? CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success
+                               : CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidEvent;
+    }
+
+    const uint32_t channel_words = data_words / num_channels;
+    if (channel_words*num_channels != data_words) {
+        return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidEvent;
+    }
+
+    if (channel_words*kSamplesPerWord != record_length) {
+        return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidEvent;
+    }
+
+    if (out.size() < en_chs.size()*record_length) {
+        return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidParam;
+    }
+
+    const char* channel = buffer + kHeaderWords*sizeof(uint32_t);
+    std::size_t row = 0;
+    for (uint32_t ch = 0; ch < kMaxChannels; ch++) {
+        if (not ((header.GroupMask >> ch) & 0x1)) {
+            continue;
+        }
+
+        while (row < en_chs.size() and en_chs[row] < ch) {
+            row++;
+        }
+
+        if (row < en_chs.size() and en_chs[row] == ch) {
+            uint16_t* dst = out.data() + row*record_length;
+            for (uint32_t j = 0; j < channel_words; j++) {
+                const uint32_t word = read_word(channel + j*sizeof(uint32_t));
+                dst[2*j] = static_cast<uint16_t>(word & 0x3FFF);
+                dst[2*j + 1] = static_cast<uint16_t>((word >> 16) & 0x3FFF);
+            }
+        }
+
+        channel += channel_words*sizeof(uint32_t);
+    }
+
+    return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success;
+}
+
+}  // namespace SBCQueens::X730
@@ -0,0 +1,323 @@
+#include "sbcqueens-gui/caen_x740_decoder.hpp"
+
+// C STD includes
+#include <cstring>
+// C 3rd party includes
+// C++ STD includes
+#include <array>
+#include <bit>
+
+// SIMD is only compiled for x86 with GCC or Clang, where it can be enabled
+// per function and chosen at run time.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SBCQUEENS_X740_SIMD 1
+#include <immintrin.h>
+#endif
+
+// C++ 3rd party includes
+// my includes
+
+namespace SBCQueens::X740 {
+
+namespace {
+
+uint32_t read_word(const char* ptr) noexcept {
+    uint32_t word = 0;
+    std::memcpy(&word, ptr, sizeof(word));
+    if constexpr (std::endian::native == std::endian::big) {
+        word = ((word & 0x000000FFu) << 24) | ((word & 0x0000FF00u) << 8)
+             | ((word & 0x00FF0000u) >> 8) | ((word & 0xFF000000u) >> 24);
+    }
+    return word;
+}
+
+// Unpacks 8 samples of one channel (3 words) into out.
+void unpack_block_scalar(const char* block, uint16_t* out) noexcept {
+    const uint32_t w0 = read_word(block);
+    const uint32_t w1 = read_word(block + 4);
+    const uint32_t w2 = read_word(block + 8);
+
+    out[0] = static_cast<uint16_t>(w0 & 0xFFF);
+    out[1] = static_cast<uint16_t>((w0 >> 12) & 0xFFF);
+    out[2] = static_cast<uint16_t>((w0 >> 24) | ((w1 & 0xF) << 8));
+    out[3] = static_cast<uint16_t>((w1 >> 4) & 0xFFF);
+    out[4] = static_cast<uint16_t>((w1 >> 16) & 0xFFF);
+    out[5] = static_cast<uint16_t>((w1 >> 28) | ((w2 & 0xFF) << 4));
+    out[6] = static_cast<uint16_t>((w2 >> 8) & 0xFFF);
+    out[7] = static_cast<uint16_t>(w2 >> 20);
+}
+
+// Rows of the output where each channel of a group goes, -1 if the
+// channel is not enabled.
+using ChannelRows = std::array<int32_t, kChannelsPerGroup>;
+
+// Unpacks every block of a group. SIMD versions load 16 bytes for a 12
+// byte block so the last blocks, which could read past end, are always
+// done by the scalar version.
+template<typename Unpack>
+void unpack_group(Unpack&& unpack, const char* group, const char* end,
+                  const uint32_t& num_samples, const ChannelRows& rows,
+                  uint16_t* out, const uint32_t& record_length) noexcept {
+    const uint32_t num_blocks = num_samples / kSamplesPerBlock;
+    const char* block = group;
+    for (uint32_t j = 0; j < num_blocks; j++) {
+        for (uint32_t ch = 0; ch < kChannelsPerGroup; ch++) {
+            if (rows[ch] >= 0) {
+                uint16_t* dst = out + static_cast<std::size_t>(rows[ch])*record_length
+                    + j*kSamplesPerBlock;
+                if (block + 16 <= end) {
+                    unpack(block, dst);
+                } else {
+                    unpack_block_scalar(block, dst);
+                }
+            }
+            block += kWordsPerBlock*sizeof(uint32_t);
+        }
+    }
+}
+
+#ifdef SBCQUEENS_X740_SIMD
+// Sample k is in bytes [3k/2, 3k/2 + 1]. Even samples are the lower 12 bits
+// of those 2 bytes, odd samples the upper 12.
+__attribute__((target("sse4.1")))
+inline __m128i unpack_128(const __m128i& raw) noexcept {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5,
+                                          6, 7, 7, 8, 9, 10, 10, 11);
+    const __m128i pairs = _mm_shuffle_epi8(raw, shuffle);
+    const __m128i even = _mm_and_si128(pairs, _mm_set1_epi16(0x0FFF));
+    const __m128i odd = _mm_srli_epi16(pairs, 4);
+    return _mm_blend_epi16(even, odd, 0xAA);
+}
+
+__attribute__((target("sse4.1")))
+void unpack_block_sse41(const char* block, uint16_t* out) noexcept {
+    const __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), unpack_128(raw));
+}
+
+__attribute__((target("sse4.1")))
+void unpack_group_sse41(const char* group, const char* end,
+                        const uint32_t& num_samples, const ChannelRows& rows,
+                        uint16_t* out, const uint32_t& record_length) noexcept {
+    unpack_group(unpack_block_sse41, group, end, num_samples, rows, out,
+                 record_length);
+}
+
+// Same as the SSE4.1 version but unpacks two channels per instruction.
+// Only worth it when both channels are enabled, which is the usual case.
+__attribute__((target("avx2")))
+void unpack_group_avx2(const char* group, const char* end,
+                       const uint32_t& num_samples, const ChannelRows& rows,
+                       uint16_t* out, const uint32_t& record_length) noexcept {
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5,
+                                             6, 7, 7, 8, 9, 10, 10, 11,
+                                             0, 1, 1, 2, 3, 4, 4, 5,
+                                             6, 7, 7, 8, 9, 10, 10, 11);
+    const __m256i mask = _mm256_set1_epi16(0x0FFF);
+    constexpr std::size_t kBlockBytes = kWordsPerBlock*sizeof(uint32_t);
+
+    const uint32_t num_blocks = num_samples / kSamplesPerBlock;
+    const char* block = group;
+    for (uint32_t j = 0; j < num_blocks; j++) {
+        for (uint32_t ch = 0; ch < kChannelsPerGroup; ch += 2) {
+            const char* next = block + kBlockBytes;
+            if (rows[ch] >= 0 and rows[ch + 1] >= 0 and next + 16 <= end) {
+                const __m256i raw = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(block))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(next)), 1);
+                const __m256i pairs = _mm256_shuffle_epi8(raw, shuffle);
+                const __m256i samples = _mm256_blend_epi16(
+                    _mm256_and_si256(pairs, mask),
+                    _mm256_srli_epi16(pairs, 4), 0xAA);
+
+                const std::size_t offset = j*kSamplesPerBlock;
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(
+                    out + static_cast<std::size_t>(rows[ch])*record_length + offset),
+                    _mm256_castsi256_si128(samples));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(
+                    out + static_cast<std::size_t>(rows[ch + 1])*record_length + offset),
+                    _mm256_extracti128_si256(samples, 1));
+            } else {
+                for (uint32_t k = 0; k < 2; k++) {
+                    const char* b = block + k*kBlockBytes;
+                    if (rows[ch + k] < 0) {
+                        continue;
+                    }
+
+                    uint16_t* dst = out
+                        + static_cast<std::size_t>(rows[ch + k])*record_length
+                        + j*kSamplesPerBlock;
+                    if (b + 16 <= end) {
+                        unpack_block_sse41(b, dst);
+                    } else {
+                        unpack_block_scalar(b, dst);
+                    }
+                }
+            }
+            block += 2*kBlockBytes;
+        }
+    }
+}
+#endif
+
+}  // namespace
+
+SIMDLevel best_simd_level() noexcept {
+#ifdef SBCQUEENS_X740_SIMD
+    static const SIMDLevel level = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return SIMDLevel::AVX2;
+        }
+
+        if (__builtin_cpu_supports("sse4.1")) {
+            return SIMDLevel::SSE41;
+        }
+
+        return SIMDLevel::Scalar;
+    }();
+    return level;
+#else
+    return SIMDLevel::Scalar;
+#endif
+}
+
+CAEN_DGTZ_EventInfo_t EventHeader::toEventInfo() const noexcept {
+    CAEN_DGTZ_EventInfo_t info{};
+    info.EventSize = Size*sizeof(uint32_t);
+    info.BoardId = BoardId;
+    info.Pattern = Pattern;
+    info.ChannelMask = GroupMask;
+    info.EventCounter = EventCounter;
+    info.TriggerTimeTag = TriggerTimeTag;
+    return info;
+}
+
+CAEN_DGTZ_ErrorCode parse_header(const char* buffer,
+                                 const uint32_t& size_in_bytes,
+                                 EventHeader& header) noexcept {
+    if (size_in_bytes < kHeaderWords*sizeof(uint32_t)) {
+        return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidEvent;
+    }
+
+    const uint32_t w0 = read_word(buffer);
+    const uint32_t w1 = read_word(buffer + 4);
+    if ((w0 >> 28) != 0xA) {
+        return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidEvent;
+    }
+
+    header.Size = w0 & 0x0FFFFFFF;
+    header.BoardId = w1 >> 27;
+    header.BoardFail = (w1 >> 26) & 0x1;
+    header.Pattern = (w1 >> 8) & 0xFFFF;
+    header.GroupMask = w1 & 0xFF;
+    header.EventCounter = read_word(buffer + 8) & 0x00FFFFFF;
+    header.TriggerTimeTag = read_word(buffer + 12);
+
+    if (header.Size < kHeaderWords
+        or header.Size > size_in_bytes / sizeof(uint32_t)) {
+        return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidEvent;
+    }
+
+    return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode index_events(const char* buffer,
+                                 const uint32_t& size_in_bytes,
+                                 std::vector<uint32_t>& offsets) noexcept {
+    offsets.clear();
+    uint32_t offset = 0;
+    EventHeader header;
+    while (offset + kHeaderWords*sizeof(uint32_t) <= size_in_bytes) {
+        auto err = parse_header(buffer + offset, size_in_bytes - offset, header);
+        if (err != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+            return err;
+        }
+
+        offsets.push_back(offset);
+        offset += header.Size*sizeof(uint32_t);
+    }
+
+    return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success;
+}
+
+CAEN_DGTZ_ErrorCode decode_event(const char* buffer,
+                                 const uint32_t& size_in_bytes,
+                                 std::span<const std::size_t> en_chs,
+                                 const uint32_t& record_length,
+                                 std::span<uint16_t> out,
+                                 CAEN_DGTZ_EventInfo_t& info,
+                                 const SIMDLevel& level) noexcept {
+    EventHeader header;
+    auto err = parse_header(buffer, size_in_bytes, header);
+    if (err != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+        return err;
+    }
+
+    info = header.toEventInfo();
+
+    const uint32_t num_groups = std::popcount(header.GroupMask);
+    const uint32_t data_words = header.Size - kHeaderWords;
+    if (num_groups == 0) {
+        return data_words == 0 ? CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success
+                               : CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidEvent;
+    }
+
+    const uint32_t group_words = data_words / num_groups;
+    constexpr uint32_t kWordsPerSampleBlock = kWordsPerBlock*kChannelsPerGroup;
+    if (group_words*num_groups != data_words
+        or group_words % kWordsPerSampleBlock != 0) {
+        return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidEvent;
+    }
+
+    const uint32_t num_samples = group_words / kWordsPerSampleBlock
+        * kSamplesPerBlock;
+    if (num_samples != record_length) {
+        return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidEvent;
+    }
+
+    if (out.size() < en_chs.size()*record_length) {
+        return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_InvalidParam;
+    }
+
+    const SIMDLevel used_level = level == SIMDLevel::Auto ? best_simd_level()
+                                                          : level;
+    const char* end = buffer + header.Size*sizeof(uint32_t);
+    const char* group = buffer + kHeaderWords*sizeof(uint32_t);
+    for (uint32_t gr = 0; gr < kMaxGroups; gr++) {
+        if (not ((header.GroupMask >> gr) & 0x1)) {
+            continue;
+        }
+
+        ChannelRows rows;
+        rows.fill(-1);
+        for (std::size_t row = 0; row < en_chs.size(); row++) {
+            if (en_chs[row] / kChannelsPerGroup == gr) {
+                rows[en_chs[row] % kChannelsPerGroup] = static_cast<int32_t>(row);
+            }
+        }
+
+        switch (used_level) {
+#ifdef SBCQUEENS_X740_SIMD
+        case SIMDLevel::AVX2:
+            unpack_group_avx2(group, end, num_samples, rows, out.data(),
+                              record_length);
+            break;
+        case SIMDLevel::SSE41:
+            unpack_group_sse41(group, end, num_samples, rows, out.data(),
+                               record_length);
+            break;
+#endif
+        default:
+            unpack_group(unpack_block_scalar, group, end, num_samples, rows,
+                         out.data(), record_length);
+        }
+
+        group += group_words*sizeof(uint32_t);
+    }
+
+    return CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success;
+}
+
+}  // namespace SBCQueens::X740
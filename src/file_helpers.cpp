@@ -0,0 +1,181 @@
+#include "sbcqueens-gui/file_helpers.hpp"
+
+// C STD includes
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+// C++ 3rd party includes
+// my includes
+
+namespace SBCQueens {
+
+#ifdef _WIN32
+MemoryMappedFile::MemoryMappedFile(std::string_view file_name) :
+    _file_name{file_name} {
+    HANDLE file = CreateFileA(_file_name.c_str(), GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Could not open file " + _file_name);
+    }
+    _file_handle = reinterpret_cast<intptr_t>(file);
+
+    LARGE_INTEGER size;
+    if (not GetFileSizeEx(file, &size)) {
+        _unmap();
+        throw std::runtime_error("Could not get the size of " + _file_name);
+    }
+    _size = static_cast<std::size_t>(size.QuadPart);
+
+    // Windows does not allow to map empty files
+    if (_size == 0) {
+        return;
+    }
+
+    HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (map == nullptr) {
+        _unmap();
+        throw std::runtime_error("Could not map file " + _file_name);
+    }
+    _map_handle = reinterpret_cast<intptr_t>(map);
+
+    _data = static_cast<const char*>(MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0));
+    if (_data == nullptr) {
+        _unmap();
+        throw std::runtime_error("Could not map file " + _file_name);
+    }
+}
+
+void MemoryMappedFile::_unmap() noexcept {
+    if (_data != nullptr) {
+        UnmapViewOfFile(_data);
+    }
+
+    if (_map_handle != -1) {
+        CloseHandle(reinterpret_cast<HANDLE>(_map_handle));
+    }
+
+    if (_file_handle != -1) {
+        CloseHandle(reinterpret_cast<HANDLE>(_file_handle));
+    }
+
+    _data = nullptr;
+    _size = 0;
+    _map_handle = -1;
+    _file_handle = -1;
+}
+
+// There is no madvise in windows, PrefetchVirtualMemory is the closest
+// but the OS read ahead is good enough for sequential access.
+void MemoryMappedFile::adviseSequential() const noexcept { }
+
+void MemoryMappedFile::release(std::size_t, std::size_t) const noexcept { }
+#else
+MemoryMappedFile::MemoryMappedFile(std::string_view file_name) :
+    _file_name{file_name} {
+    const int fd = ::open(_file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file " + _file_name);
+    }
+    _file_handle = fd;
+
+    struct stat file_stat = {};
+    if (::fstat(fd, &file_stat) != 0) {
+        _unmap();
+        throw std::runtime_error("Could not get the size of " + _file_name);
+    }
+    _size = static_cast<std::size_t>(file_stat.st_size);
+
+    // mmap does not allow to map empty files
+    if (_size == 0) {
+        return;
+    }
+
+    void* ptr = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        _unmap();
+        throw std::runtime_error("Could not map file " + _file_name);
+    }
+    _data = static_cast<const char*>(ptr);
+}
+
+void MemoryMappedFile::_unmap() noexcept {
+    if (_data != nullptr) {
+        ::munmap(const_cast<char*>(_data), _size);
+    }
+
+    if (_file_handle != -1) {
+        ::close(static_cast<int>(_file_handle));
+    }
+
+    _data = nullptr;
+    _size = 0;
+    _file_handle = -1;
+}
+
+void MemoryMappedFile::adviseSequential() const noexcept {
+    if (_data != nullptr) {
+        ::madvise(const_cast<char*>(_data), _size, MADV_SEQUENTIAL);
+    }
+}
+
+void MemoryMappedFile::release(std::size_t offset,
+                               std::size_t length) const noexcept {
+    if (_data == nullptr or offset >= _size) {
+        return;
+    }
+
+    // madvise only works with whole pages, so we shrink the range to the
+    // pages that are completely inside of it.
+    const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    const std::size_t end = std::min(offset + length, _size);
+    const std::size_t page_start = (offset + page_size - 1) / page_size * page_size;
+    const std::size_t page_end = end / page_size * page_size;
+    if (page_end <= page_start) {
+        return;
+    }
+
+    ::madvise(const_cast<char*>(_data) + page_start, page_end - page_start,
+              MADV_DONTNEED);
+}
+#endif
+
+MemoryMappedFile::~MemoryMappedFile() {
+    _unmap();
+}
+
+MemoryMappedFile::MemoryMappedFile(MemoryMappedFile&& other) noexcept :
+    _file_name{std::move(other._file_name)},
+    _data{std::exchange(other._data, nullptr)},
+    _size{std::exchange(other._size, 0)},
+    _file_handle{std::exchange(other._file_handle, -1)},
+    _map_handle{std::exchange(other._map_handle, -1)} { }
+
+MemoryMappedFile& MemoryMappedFile::operator=(MemoryMappedFile&& other) noexcept {
+    if (this != &other) {
+        _unmap();
+        _file_name = std::move(other._file_name);
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+        _file_handle = std::exchange(other._file_handle, -1);
+        _map_handle = std::exchange(other._map_handle, -1);
+    }
+
+    return *this;
+}
+
+}  // namespace SBCQueens
@@ -33,6 +33,21 @@ void CAENGeneralConfigTab::init_tab(const toml::table& tb) {
         = static_cast<CAEN_DGTZ_TriggerPolarity_t>(CAEN_conf["Polarity"].value_or(0L));
     _sipm_doe.GlobalConfig.IOLevel
         = static_cast<CAEN_DGTZ_IOLevel_t>(CAEN_conf["IOLevel"].value_or(0));
+
+    _sipm_doe.ReadoutConfig.NumBuffers
+        = CAEN_conf["ReadoutBuffers"].value_or(4u);
+    _sipm_doe.ReadoutConfig.MinEventsPerTransfer
+        = CAEN_conf["ReadoutMinEvents"].value_or(0u);
+    _sipm_doe.ReadoutConfig.MaxLatency
+        = CAEN_conf["ReadoutMaxLatency"].value_or(100u);
+    _sipm_doe.ReadoutConfig.MinBlockEvents
+        = CAEN_conf["ReadoutMinBlockEvents"].value_or(16u);
+    _sipm_doe.ReadoutConfig.DecodeThreads
+        = CAEN_conf["DecodeThreads"].value_or(1u);
+    _sipm_doe.ReadoutConfig.NativeDecode
+        = CAEN_conf["NativeDecode"].value_or(false);
+    _sipm_doe.ReadoutConfig.UseInterrupts
+        = CAEN_conf["UseInterrupts"].value_or(false);
 }
 
 void CAENGeneralConfigTab::draw() {
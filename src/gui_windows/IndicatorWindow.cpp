@@ -31,6 +31,70 @@ void IndicatorWindow::draw() {
                     "Events in buffer">(SiPMGUIIndicators);
             draw_indicator(event_in_buff_ind, _sipm_doe.NumEventsInBuffer);
 
+            ImGui::Separator();
+            constexpr auto writer_queue_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Writer Queue Depth">(SiPMGUIIndicators);
+            draw_indicator(writer_queue_ind, _sipm_doe.WriterQueueDepth);
+
+            constexpr auto writer_stall_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Writer Stall Time">(SiPMGUIIndicators);
+            draw_indicator(writer_stall_ind, _sipm_doe.WriterStallTime);
+
+            constexpr auto writer_rate_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Writer Rate">(SiPMGUIIndicators);
+            double writer_mbytes_per_second = _sipm_doe.WriterBytesPerSecond / 1e6;
+            draw_indicator(writer_rate_ind, writer_mbytes_per_second);
+
+            ImGui::Separator();
+            constexpr auto ring_occupancy_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Readout Ring Occupancy">(SiPMGUIIndicators);
+            draw_indicator(ring_occupancy_ind, _sipm_doe.ReadoutRingOccupancy);
+
+            constexpr auto ring_overruns_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Readout Ring Overruns">(SiPMGUIIndicators);
+            draw_indicator(ring_overruns_ind, _sipm_doe.ReadoutRingOverruns);
+
+            constexpr auto threshold_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Readout Threshold">(SiPMGUIIndicators);
+            draw_indicator(threshold_ind, _sipm_doe.ReadoutThreshold);
+
+            ImGui::Separator();
+            constexpr auto queued_runs_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Queued Runs">(SiPMGUIIndicators);
+            std::size_t queued_runs = _sipm_doe.NumberedRuns.size();
+            draw_indicator(queued_runs_ind, queued_runs);
+
+            constexpr auto run_rate_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Run Rate">(SiPMGUIIndicators);
+            draw_indicator(run_rate_ind, _sipm_doe.NumberedRunRate);
+
+            constexpr auto run_livetime_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Run Livetime">(SiPMGUIIndicators);
+            draw_indicator(run_livetime_ind, _sipm_doe.NumberedRunLivetime);
+
+            ImGui::Separator();
+            constexpr auto reconfiguration_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Reconfiguration Time">(SiPMGUIIndicators);
+            draw_indicator(reconfiguration_ind, _sipm_doe.ReconfigurationTime);
+
+            // Only with more than one board
+            if (_sipm_doe.BoardRates.size() > 1) {
+                ImGui::Separator();
+                constexpr auto board_rate_ind = get_indicator<IndicatorTypes::Numerical,
+                        "Board Rate">(SiPMGUIIndicators);
+                for (std::size_t b = 0; b < _sipm_doe.BoardRates.size(); b++) {
+                    ImGui::PushID(static_cast<int>(b));
+                    ImGui::Text("Board %zu", b);
+                    ImGui::SameLine();
+                    draw_indicator(board_rate_ind, _sipm_doe.BoardRates[b]);
+                    ImGui::PopID();
+                }
+
+                constexpr auto backlog_ind = get_indicator<IndicatorTypes::Numerical,
+                        "Merge Backlog">(SiPMGUIIndicators);
+                draw_indicator(backlog_ind, _sipm_doe.MergeBacklog);
+            }
+
             ImGui::EndTabItem();
         }
 
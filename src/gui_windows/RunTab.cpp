@@ -3,6 +3,7 @@
 // C STD includes
 // C 3rd party includes
 // C++ STD includes
+#include <chrono>
 #include <unordered_map>
 
 // C++ 3rd party includes
@@ -49,6 +50,23 @@ void RunTab::init_tab(const toml::table& cfg) {
       = connection_type_map[CAEN_conf["ConnectionType"].value_or("USB")];
     _sipm_doe.VMEAddress
         = CAEN_conf["VMEAddress"].value_or(0u);
+    if (const toml::array* arr = CAEN_conf["ConetNodes"].as_array()) {
+        _sipm_doe.ConetNodes.clear();
+        arr->for_each([&](auto&& elem) {
+            _sipm_doe.ConetNodes.push_back(elem.value_or(0));
+        });
+    }
+
+    if (_sipm_doe.ConetNodes.empty()) {
+        _sipm_doe.ConetNodes = {0};
+    }
+
+    _sipm_doe.EventBuilder.CoincidenceWindow
+        = CAEN_conf["CoincidenceWindow"].value_or(0.0);
+    _sipm_doe.EventBuilder.MinBoards
+        = CAEN_conf["CoincidenceBoards"].value_or(1u);
+    _sipm_doe.EventBuilder.Timeout = std::chrono::milliseconds(
+        CAEN_conf["MergeTimeout"].value_or(1000u));
 
     // Other/slow daq stuff
     _slowdaq_doe.PFEIFFERPort
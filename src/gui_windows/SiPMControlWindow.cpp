@@ -26,6 +26,37 @@ void SiPMControlWindow::init_window(const toml::table& tb) {
         = file_conf["RunWaveforms"].value_or(1000000ull);
     _sipm_data.VBDData.SPEEstimationTotalPulses
         = file_conf["GainWaveforms"].value_or(10000ull);
+    _sipm_data.NumberedRunBufferMB
+        = file_conf["RunBufferMB"].value_or(1024u);
+
+    _sipm_data.FileCompression.Level
+        = file_conf["CompressionLevel"].value_or(0);
+    _sipm_data.FileCompression.NumThreads
+        = file_conf["CompressionThreads"].value_or(2ull);
+    _sipm_data.FileCompression.ChunkEvents
+        = file_conf["CompressionChunkEvents"].value_or(256ull);
+    _sipm_data.FileCompression.DeltaFilter
+        = file_conf["CompressionDeltaFilter"].value_or(true);
+    _sipm_data.FileIndexStride
+        = file_conf["IndexStride"].value_or(1000u);
+    _sipm_data.FileRollover.MaxBytes = static_cast<uint64_t>(
+        file_conf["RolloverSizeGB"].value_or(0.0)*1e9);
+    _sipm_data.FileRollover.MaxDuration = std::chrono::minutes(
+        file_conf["RolloverMinutes"].value_or(0u));
+    _sipm_data.FileChecksums.BlockChecksums
+        = file_conf["BlockChecksums"].value_or(true);
+    _sipm_data.FileChecksums.BlockLines
+        = file_conf["ChecksumBlockLines"].value_or(4096ull);
+    _sipm_data.FileChecksums.VerifySegments
+        = file_conf["VerifySegments"].value_or(true);
+    _sipm_data.FileRawDump
+        = file_conf["RawDump"].value_or(false);
+    _sipm_data.ReplayFile
+        = file_conf["ReplayFile"].value_or("");
+    _sipm_data.ReplaySpeed
+        = file_conf["ReplaySpeed"].value_or(0.0);
+    _sipm_data.ReplayLoops
+        = file_conf["ReplayLoops"].value_or(1u);
 }
 
 void SiPMControlWindow::draw()  {
@@ -61,11 +92,49 @@ void SiPMControlWindow::draw()  {
                  tmp, [&](){ return tmp; },
             // Callback when IsItemEdited !
                  [](SiPMAcquisitionData& doe_twin) {
-                     if (doe_twin.AcquisitionState == SiPMAcquisitionStates::EndlessAcquisition) {
+                     doe_twin.NumberedRuns.clear();
+                     if (doe_twin.AcquisitionState == SiPMAcquisitionStates::EndlessAcquisition
+                         or doe_twin.AcquisitionState == SiPMAcquisitionStates::NumberedAcquisition) {
                          doe_twin.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
                      }
                  }
     );
+
+    // Numbered runs are queued, so several can be taken one after the other
+    auto queue_run = [](SiPMAcquisitionData& doe_twin, const uint32_t& waveforms) {
+        if (doe_twin.CurrentState != SiPMAcquisitionManagerStates::Acquisition) {
+            return;
+        }
+
+        if (doe_twin.AcquisitionState == SiPMAcquisitionStates::Oscilloscope) {
+            doe_twin.AcquisitionState = SiPMAcquisitionStates::NumberedAcquisition;
+        } else if (doe_twin.AcquisitionState != SiPMAcquisitionStates::NumberedAcquisition) {
+            return;
+        }
+
+        doe_twin.NumberedRuns.push_back(waveforms);
+    };
+
+    constexpr auto run_btn = get_control<ControlTypes::Button,
+            "RUN##CAEN">(SiPMGUIControls);
+    draw_control(run_btn, _sipm_data,
+                 tmp, [&](){ return tmp; },
+            // Callback when IsItemEdited !
+                 [queue_run, waveforms = _sipm_data.VBDData.DataPulses](SiPMAcquisitionData& doe_twin) {
+                     queue_run(doe_twin, waveforms);
+                 }
+    );
+
+    ImGui::SameLine();
+    constexpr auto gain_run_btn = get_control<ControlTypes::Button,
+            "GAIN RUN##CAEN">(SiPMGUIControls);
+    draw_control(gain_run_btn, _sipm_data,
+                 tmp, [&](){ return tmp; },
+            // Callback when IsItemEdited !
+                 [queue_run, waveforms = _sipm_data.VBDData.SPEEstimationTotalPulses](SiPMAcquisitionData& doe_twin) {
+                     queue_run(doe_twin, waveforms);
+                 }
+    );
     ImGui::Separator();
     ImGui::PushItemWidth(120);
 
@@ -0,0 +1,32 @@
+#include "sbcqueens-gui/multithreading_helpers/ThreadPriority.hpp"
+
+// C STD includes
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// C 3rd party includes
+// C++ STD includes
+// C++ 3rd party includes
+// My includes
+
+namespace SBCQueens {
+
+bool lower_current_thread_priority() noexcept {
+#ifdef _WIN32
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE) != 0;
+#elif defined(__linux__)
+    sched_param param{};
+    param.sched_priority = 0;
+    return pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) == 0;
+#else
+    return false;
+#endif
+}
+
+}  // namespace SBCQueens
@@ -0,0 +1,247 @@
+#include "sbcqueens-gui/sipm_helpers/BitPacking.hpp"
+
+// C STD includes
+#include <cstring>
+// C 3rd party includes
+// C++ STD includes
+
+// Same as the x740 decoder: SIMD is only compiled for x86 with GCC or Clang,
+// where it can be enabled per function and chosen at run time.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SBCQUEENS_BITPACKING_SIMD 1
+#include <immintrin.h>
+#endif
+
+// C++ 3rd party includes
+// my includes
+
+namespace SBCQueens::BinaryFormat::BitPacking {
+
+namespace {
+
+// Samples done per SIMD iteration
+constexpr std::size_t kSamplesPerVector = 8;
+
+void pack_scalar(std::span<const uint16_t> in, const uint8_t& bits,
+                 char* out) noexcept {
+    const uint32_t mask = (1u << bits) - 1;
+    uint64_t acc = 0;
+    uint32_t acc_bits = 0;
+    for (const auto& sample : in) {
+        acc |= static_cast<uint64_t>(sample & mask) << acc_bits;
+        acc_bits += bits;
+        while (acc_bits >= 8) {
+            *out++ = static_cast<char>(acc & 0xFF);
+            acc >>= 8;
+            acc_bits -= 8;
+        }
+    }
+
+    if (acc_bits > 0) {
+        *out = static_cast<char>(acc & 0xFF);
+    }
+}
+
+void unpack_scalar(const char* in, const uint8_t& bits,
+                   std::span<uint16_t> out) noexcept {
+    const uint32_t mask = (1u << bits) - 1;
+    uint64_t acc = 0;
+    uint32_t acc_bits = 0;
+    for (auto& sample : out) {
+        while (acc_bits < bits) {
+            acc |= static_cast<uint64_t>(static_cast<uint8_t>(*in++)) << acc_bits;
+            acc_bits += 8;
+        }
+
+        sample = static_cast<uint16_t>(acc & mask);
+        acc >>= bits;
+        acc_bits -= bits;
+    }
+}
+
+#ifdef SBCQUEENS_BITPACKING_SIMD
+// 8 samples <-> 12 bytes. As 32-bit lanes every pair is (b << 16) | a and
+// has to become (b << 12) | a, then the empty 4th byte of every lane is
+// dropped.
+__attribute__((target("sse4.1")))
+void pack_12_sse41(std::span<const uint16_t> in, char* out) noexcept {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9,
+                                          10, 12, 13, 14, -1, -1, -1, -1);
+    const __m128i low = _mm_set1_epi32(0x00000FFF);
+    const __m128i high = _mm_set1_epi32(0x00FFF000);
+    constexpr std::size_t kBytes = packed_size(kSamplesPerVector, 12);
+
+    alignas(16) char tmp[16];
+    const std::size_t n = in.size() / kSamplesPerVector;
+    for (std::size_t i = 0; i < n; i++) {
+        const __m128i x = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(in.data() + i*kSamplesPerVector));
+        const __m128i y = _mm_or_si128(_mm_and_si128(x, low),
+            _mm_and_si128(_mm_srli_epi32(x, 4), high));
+        _mm_store_si128(reinterpret_cast<__m128i*>(tmp),
+                        _mm_shuffle_epi8(y, shuffle));
+        std::memcpy(out + i*kBytes, tmp, kBytes);
+    }
+
+    pack_scalar(in.subspan(n*kSamplesPerVector), 12, out + n*kBytes);
+}
+
+// Sample k is in bytes [3k/2, 3k/2 + 1]. Even samples are the lower 12 bits
+// of those 2 bytes, odd samples the upper 12.
+__attribute__((target("sse4.1")))
+void unpack_12_sse41(const char* in, std::span<uint16_t> out) noexcept {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5,
+                                          6, 7, 7, 8, 9, 10, 10, 11);
+    const __m128i mask = _mm_set1_epi16(0x0FFF);
+    constexpr std::size_t kBytes = packed_size(kSamplesPerVector, 12);
+
+    // 16 bytes are loaded for 12, so the last vector is done scalar
+    const std::size_t n = out.size() / kSamplesPerVector;
+    const std::size_t simd_n = n > 0 ? n - 1 : 0;
+    for (std::size_t i = 0; i < simd_n; i++) {
+        const __m128i raw = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(in + i*kBytes));
+        const __m128i pairs = _mm_shuffle_epi8(raw, shuffle);
+        const __m128i samples = _mm_blend_epi16(_mm_and_si128(pairs, mask),
+                                                _mm_srli_epi16(pairs, 4), 0xAA);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(
+            out.data() + i*kSamplesPerVector), samples);
+    }
+
+    unpack_scalar(in + simd_n*kBytes, 12, out.subspan(simd_n*kSamplesPerVector));
+}
+
+// 8 samples <-> 14 bytes. As 64-bit lanes every 4 samples
+// (d << 48) | (c << 32) | (b << 16) | a have to become
+// (d << 42) | (c << 28) | (b << 14) | a, then the empty 8th byte of every
+// lane is dropped.
+__attribute__((target("sse4.1")))
+void pack_14_sse41(std::span<const uint16_t> in, char* out) noexcept {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 8,
+                                          9, 10, 11, 12, 13, 14, -1, -1);
+    const __m128i m0 = _mm_set1_epi64x(0x3FFFll);
+    const __m128i m1 = _mm_set1_epi64x(0x3FFFll << 14);
+    const __m128i m2 = _mm_set1_epi64x(0x3FFFll << 28);
+    const __m128i m3 = _mm_set1_epi64x(0x3FFFll << 42);
+    constexpr std::size_t kBytes = packed_size(kSamplesPerVector, 14);
+
+    alignas(16) char tmp[16];
+    const std::size_t n = in.size() / kSamplesPerVector;
+    for (std::size_t i = 0; i < n; i++) {
+        const __m128i x = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(in.data() + i*kSamplesPerVector));
+        const __m128i y = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(x, m0),
+                         _mm_and_si128(_mm_srli_epi64(x, 2), m1)),
+            _mm_or_si128(_mm_and_si128(_mm_srli_epi64(x, 4), m2),
+                         _mm_and_si128(_mm_srli_epi64(x, 6), m3)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(tmp),
+                        _mm_shuffle_epi8(y, shuffle));
+        std::memcpy(out + i*kBytes, tmp, kBytes);
+    }
+
+    pack_scalar(in.subspan(n*kSamplesPerVector), 14, out + n*kBytes);
+}
+
+__attribute__((target("sse4.1")))
+void unpack_14_sse41(const char* in, std::span<uint16_t> out) noexcept {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, -1,
+                                          7, 8, 9, 10, 11, 12, 13, -1);
+    const __m128i m0 = _mm_set1_epi64x(0x3FFFll);
+    const __m128i m1 = _mm_set1_epi64x(0x3FFFll << 16);
+    const __m128i m2 = _mm_set1_epi64x(0x3FFFll << 32);
+    const __m128i m3 = _mm_set1_epi64x(0x3FFFll << 48);
+    constexpr std::size_t kBytes = packed_size(kSamplesPerVector, 14);
+
+    // 16 bytes are loaded for 14, so the last vector is done scalar
+    const std::size_t n = out.size() / kSamplesPerVector;
+    const std::size_t simd_n = n > 0 ? n - 1 : 0;
+    for (std::size_t i = 0; i < simd_n; i++) {
+        const __m128i raw = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(in + i*kBytes));
+        const __m128i y = _mm_shuffle_epi8(raw, shuffle);
+        const __m128i samples = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(y, m0),
+                         _mm_and_si128(_mm_slli_epi64(y, 2), m1)),
+            _mm_or_si128(_mm_and_si128(_mm_slli_epi64(y, 4), m2),
+                         _mm_and_si128(_mm_slli_epi64(y, 6), m3)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(
+            out.data() + i*kSamplesPerVector), samples);
+    }
+
+    unpack_scalar(in + simd_n*kBytes, 14, out.subspan(simd_n*kSamplesPerVector));
+}
+#endif
+
+}  // namespace
+
+SIMDLevel best_simd_level() noexcept {
+#ifdef SBCQUEENS_BITPACKING_SIMD
+    static const SIMDLevel level = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.1") ? SIMDLevel::SSE41
+                                                : SIMDLevel::Scalar;
+    }();
+    return level;
+#else
+    return SIMDLevel::Scalar;
+#endif
+}
+
+void pack(std::span<const uint16_t> in, const uint8_t& bits, char* out,
+          const SIMDLevel& level) noexcept {
+    if (bits == kMaxBits) {
+        std::memcpy(out, in.data(), in.size_bytes());
+        return;
+    }
+
+#ifdef SBCQUEENS_BITPACKING_SIMD
+    const SIMDLevel used_level = level == SIMDLevel::Auto ? best_simd_level()
+                                                          : level;
+    if (used_level == SIMDLevel::SSE41) {
+        if (bits == 12) {
+            pack_12_sse41(in, out);
+            return;
+        }
+
+        if (bits == 14) {
+            pack_14_sse41(in, out);
+            return;
+        }
+    }
+#else
+    (void)level;
+#endif
+
+    pack_scalar(in, bits, out);
+}
+
+void unpack(const char* in, const uint8_t& bits, std::span<uint16_t> out,
+            const SIMDLevel& level) noexcept {
+    if (bits == kMaxBits) {
+        std::memcpy(out.data(), in, out.size_bytes());
+        return;
+    }
+
+#ifdef SBCQUEENS_BITPACKING_SIMD
+    const SIMDLevel used_level = level == SIMDLevel::Auto ? best_simd_level()
+                                                          : level;
+    if (used_level == SIMDLevel::SSE41) {
+        if (bits == 12) {
+            unpack_12_sse41(in, out);
+            return;
+        }
+
+        if (bits == 14) {
+            unpack_14_sse41(in, out);
+            return;
+        }
+    }
+#else
+    (void)level;
+#endif
+
+    unpack_scalar(in, bits, out);
+}
+
+}  // namespace SBCQueens::BinaryFormat::BitPacking
@@ -0,0 +1,118 @@
+#include "sbcqueens-gui/sipm_helpers/Checksum.hpp"
+
+// C STD includes
+#include <cstring>
+// C 3rd party includes
+// C++ STD includes
+#include <array>
+
+// Same as BitPacking: the hardware CRC is only compiled for x86-64 with GCC
+// or Clang, where it can be enabled per function and chosen at run time.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SBCQUEENS_CHECKSUM_SIMD 1
+#include <immintrin.h>
+#endif
+
+// C++ 3rd party includes
+// my includes
+
+namespace SBCQueens::BinaryFormat::Checksum {
+
+namespace {
+
+// Reflected Castagnoli polynomial
+constexpr uint32_t kPolynomial = 0x82F63B78;
+
+// Slicing-by-8 tables: kTables[k][b] is the CRC of byte b followed by k
+// zero bytes.
+constexpr auto kTables = []() {
+    std::array<std::array<uint32_t, 256>, 8> tables{};
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+        }
+        tables[0][b] = crc;
+    }
+
+    for (std::size_t k = 1; k < tables.size(); k++) {
+        for (uint32_t b = 0; b < 256; b++) {
+            const auto previous = tables[k - 1][b];
+            tables[k][b] = (previous >> 8) ^ tables[0][previous & 0xFF];
+        }
+    }
+
+    return tables;
+}();
+
+uint32_t crc32c_scalar(const char* data, std::size_t size,
+                       uint32_t crc) noexcept {
+    auto byte = [&](const std::size_t& i) -> uint32_t {
+        return static_cast<uint8_t>(data[i]);
+    };
+
+    while (size >= 8) {
+        const uint32_t low = crc ^ (byte(0) | (byte(1) << 8)
+            | (byte(2) << 16) | (byte(3) << 24));
+        crc = kTables[7][low & 0xFF] ^ kTables[6][(low >> 8) & 0xFF]
+            ^ kTables[5][(low >> 16) & 0xFF] ^ kTables[4][low >> 24]
+            ^ kTables[3][byte(4)] ^ kTables[2][byte(5)]
+            ^ kTables[1][byte(6)] ^ kTables[0][byte(7)];
+        data += 8;
+        size -= 8;
+    }
+
+    for (std::size_t i = 0; i < size; i++) {
+        crc = (crc >> 8) ^ kTables[0][(crc ^ byte(i)) & 0xFF];
+    }
+
+    return crc;
+}
+
+#ifdef SBCQUEENS_CHECKSUM_SIMD
+__attribute__((target("sse4.2")))
+uint32_t crc32c_sse42(const char* data, std::size_t size,
+                      uint32_t crc) noexcept {
+    uint64_t crc64 = crc;
+    while (size >= 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, data, sizeof(uint64_t));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        size -= 8;
+    }
+
+    crc = static_cast<uint32_t>(crc64);
+    for (std::size_t i = 0; i < size; i++) {
+        crc = _mm_crc32_u8(crc, static_cast<uint8_t>(data[i]));
+    }
+
+    return crc;
+}
+#endif
+
+}  // namespace
+
+bool has_hardware_crc32c() noexcept {
+#ifdef SBCQUEENS_CHECKSUM_SIMD
+    static const bool supported = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2") != 0;
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+uint32_t crc32c(std::span<const char> data, const uint32_t& crc) noexcept {
+#ifdef SBCQUEENS_CHECKSUM_SIMD
+    if (has_hardware_crc32c()) {
+        return ~crc32c_sse42(data.data(), data.size(), ~crc);
+    }
+#endif
+
+    return ~crc32c_scalar(data.data(), data.size(), ~crc);
+}
+
+}  // namespace SBCQueens::BinaryFormat::Checksum
@@ -0,0 +1,110 @@
+#include "sbcqueens-gui/sipm_helpers/ChunkCompression.hpp"
+
+// C STD includes
+#include <cstring>
+
+// C 3rd party includes
+#include <zstd.h>
+
+// C++ STD includes
+#include <algorithm>
+#include <new>
+
+// C++ 3rd party includes
+// my includes
+
+namespace SBCQueens::BinaryFormat::ChunkCompression {
+
+namespace {
+
+uint16_t load(const char* ptr) noexcept {
+    uint16_t out;
+    std::memcpy(&out, ptr, sizeof(uint16_t));
+    return out;
+}
+
+void store(char* ptr, const uint16_t& value) noexcept {
+    std::memcpy(ptr, &value, sizeof(uint16_t));
+}
+
+// Small negative differences become small positive numbers, so the upper
+// byte of most samples is 0 instead of flipping between 0x00 and 0xFF.
+uint16_t zigzag(const uint16_t& x) noexcept {
+    return static_cast<uint16_t>((x << 1) ^ (x & 0x8000 ? 0xFFFF : 0x0000));
+}
+
+uint16_t unzigzag(const uint16_t& x) noexcept {
+    return static_cast<uint16_t>((x >> 1) ^ (x & 1 ? 0xFFFF : 0x0000));
+}
+
+}  // namespace
+
+void delta_encode(char* row, const std::size_t& num_samples) noexcept {
+    if (num_samples < 2) {
+        return;
+    }
+
+    // Backwards so every sample is still the original when it is
+    // subtracted
+    for (std::size_t k = num_samples - 1; k > 0; k--) {
+        char* sample = row + k*sizeof(uint16_t);
+        store(sample, zigzag(static_cast<uint16_t>(load(sample)
+            - load(sample - sizeof(uint16_t)))));
+    }
+}
+
+void delta_decode(char* row, const std::size_t& num_samples) noexcept {
+    if (num_samples < 2) {
+        return;
+    }
+
+    uint16_t previous = load(row);
+    for (std::size_t k = 1; k < num_samples; k++) {
+        char* sample = row + k*sizeof(uint16_t);
+        previous = static_cast<uint16_t>(previous + unzigzag(load(sample)));
+        store(sample, previous);
+    }
+}
+
+std::size_t compress_bound(const std::size_t& size) noexcept {
+    return ZSTD_compressBound(size);
+}
+
+void Compressor::_deleter::operator()(ZSTD_CCtx_s* ctx) const noexcept {
+    ZSTD_freeCCtx(ctx);
+}
+
+Compressor::Compressor(const int& level) :
+    _ctx{ZSTD_createCCtx()},
+    _level{std::clamp(level, 1, ZSTD_maxCLevel())}
+{
+    if (not _ctx) {
+        throw std::bad_alloc();
+    }
+}
+
+std::size_t Compressor::compress(std::span<const char> in,
+                                 std::span<char> out) noexcept {
+    const auto size = ZSTD_compressCCtx(_ctx.get(), out.data(), out.size(),
+                                        in.data(), in.size(), _level);
+    return ZSTD_isError(size) ? 0 : size;
+}
+
+void Decompressor::_deleter::operator()(ZSTD_DCtx_s* ctx) const noexcept {
+    ZSTD_freeDCtx(ctx);
+}
+
+Decompressor::Decompressor() : _ctx{ZSTD_createDCtx()} {
+    if (not _ctx) {
+        throw std::bad_alloc();
+    }
+}
+
+std::size_t Decompressor::decompress(std::span<const char> in,
+                                     std::span<char> out) noexcept {
+    const auto size = ZSTD_decompressDCtx(_ctx.get(), out.data(), out.size(),
+                                          in.data(), in.size());
+    return ZSTD_isError(size) ? 0 : size;
+}
+
+}  // namespace SBCQueens::BinaryFormat::ChunkCompression
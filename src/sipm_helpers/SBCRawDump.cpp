@@ -0,0 +1,596 @@
+#include "sbcqueens-gui/sipm_helpers/SBCRawDump.hpp"
+
+// C STD includes
+#include <cstring>
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+// C++ 3rd party includes
+#include <spdlog/spdlog.h>
+
+// my includes
+#include "sbcqueens-gui/caen_x730_decoder.hpp"
+#include "sbcqueens-gui/caen_x740_decoder.hpp"
+#include "sbcqueens-gui/multithreading_helpers/WorkerPool.hpp"
+
+namespace SBCQueens::BinaryFormat {
+
+namespace {
+
+template<typename T>
+void append(std::vector<char>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+T take(std::span<const char> data, std::size_t& pos) {
+    if (data.size() - pos < sizeof(T)) {
+        throw std::runtime_error("Raw dump record is too short.");
+    }
+
+    T value;
+    std::memcpy(&value, data.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+}
+
+// Every field is saved as a u32, so the config does not depend on the
+// padding or sizes of the structs
+struct ConfigSaver {
+    std::vector<char>& Out;
+
+    template<typename T>
+    void operator()(const T& value) {
+        append(Out, static_cast<uint32_t>(value));
+    }
+
+    void operator()(const ChannelsMask& mask) {
+        uint32_t bits = 0;
+        for (std::size_t i = 0; i < mask.CH.size(); i++) {
+            bits |= static_cast<uint32_t>(mask.CH[i]) << i;
+        }
+        append(Out, bits);
+    }
+};
+
+struct ConfigLoader {
+    std::span<const char> Data;
+    std::size_t Pos = 0;
+
+    template<typename T>
+    void operator()(T& value) {
+        value = static_cast<T>(take<uint32_t>(Data, Pos));
+    }
+
+    void operator()(ChannelsMask& mask) {
+        const auto bits = take<uint32_t>(Data, Pos);
+        for (std::size_t i = 0; i < mask.CH.size(); i++) {
+            mask.CH[i] = (bits >> i) & 0x1;
+        }
+    }
+};
+
+// Goes over the saved fields in order. New fields go at the end, and need
+// a new magic.
+template<typename Visitor, typename Config>
+void visit_config(Visitor& visit, Config& config) {
+    visit(config.Model);
+    visit(config.Family);
+
+    auto& global = config.GlobalConfig;
+    visit(global.MaxEventsPerRead);
+    visit(global.RecordLength);
+    visit(global.PostTriggerPorcentage);
+    visit(global.EXTAsGate);
+    visit(global.EXTTriggerMode);
+    visit(global.SWTriggerMode);
+    visit(global.CHTriggerMode);
+    visit(global.AcqMode);
+    visit(global.IOLevel);
+    visit(global.TriggerOverlappingEn);
+    visit(global.MemoryFullModeSelection);
+    visit(global.TriggerPolarity);
+    visit(global.DecimationFactor);
+    visit(global.MajorityLevel);
+    visit(global.MajorityCoincidenceWindow);
+
+    for (auto& group : config.GroupConfigs) {
+        visit(group.Enabled);
+        visit(group.TriggerMask);
+        visit(group.AcquisitionMask);
+        visit(group.DCOffset);
+        for (auto& correction : group.DCCorrections) {
+            visit(correction);
+        }
+        visit(group.DCRange);
+        visit(group.TriggerThreshold);
+    }
+}
+
+std::array<char, RawDump::kBlockHeaderSize> save_block_header(
+        const RawBlockHeader& header) {
+    std::array<char, RawDump::kBlockHeaderSize> out{};
+    char* ptr = out.data();
+    auto put = [&ptr](const auto& value) {
+        std::memcpy(ptr, &value, sizeof(value));
+        ptr += sizeof(value);
+    };
+
+    put(header.HostTime);
+    put(header.ConfigHash);
+    put(header.BoardSerial);
+    put(header.BoardModel);
+    put(header.NumEvents);
+    return out;
+}
+
+RawBlockHeader load_block_header(std::span<const char> record) {
+    RawBlockHeader header;
+    std::size_t pos = 0;
+    header.HostTime = take<int64_t>(record, pos);
+    header.ConfigHash = take<uint32_t>(record, pos);
+    header.BoardSerial = take<uint32_t>(record, pos);
+    header.BoardModel = take<decltype(header.BoardModel)>(record, pos);
+    header.NumEvents = take<uint32_t>(record, pos);
+    header.DataSize = static_cast<uint32_t>(record.size() - pos);
+    return header;
+}
+
+// Model of the only config of dump, if its events can be decoded
+const CAENDigitizerModelConstants& decodable_model(const RawDumpReader& dump) {
+    if (dump.configs().size() != 1) {
+        throw std::runtime_error("Raw dump " + dump.name() + " has "
+            + std::to_string(dump.configs().size()) + " configs, it can only "
+            "be decoded if it has one.");
+    }
+
+    const auto& config = dump.configs().front();
+    if (config.Family != CAENDigitizerFamilies::x740
+        and config.Family != CAENDigitizerFamilies::x730) {
+        throw std::runtime_error("Raw dump " + dump.name() + " is from a "
+                                 "digitizer family that cannot be decoded.");
+    }
+
+    const auto model = CAENDigitizerModelsConstantsMap.find(config.Model);
+    if (model == CAENDigitizerModelsConstantsMap.end()) {
+        throw std::runtime_error("Raw dump " + dump.name() + " is from an "
+                                 "unknown digitizer model.");
+    }
+
+    return model->second;
+}
+
+// Most events in a block of dump, at least 1
+uint32_t max_block_events(const RawDumpReader& dump) {
+    uint32_t max_events = 1;
+    for (const auto& block : dump.blocks()) {
+        max_events = std::max(max_events, block.Header.NumEvents);
+    }
+    return max_events;
+}
+
+// Decodes the events of block into batch, split between the workers of
+// pool. Returns false if the block is corrupted.
+bool decode_block(const CAENDigitizerFamilies& family,
+                  const RawDumpEntry& block, WorkerPool& pool,
+                  std::vector<uint32_t>& offsets,
+                  CAENWaveformBatch<uint16_t>& batch) {
+    auto decode_event = [&family](const char* buffer, const uint32_t& size,
+                                  std::span<const std::size_t> en_chs,
+                                  const uint32_t& record_length,
+                                  std::span<uint16_t> out,
+                                  CAEN_DGTZ_EventInfo_t& info) {
+        if (family == CAENDigitizerFamilies::x730) {
+            return X730::decode_event(buffer, size, en_chs, record_length, out,
+                                      info);
+        }
+        return X740::decode_event(buffer, size, en_chs, record_length, out,
+                                  info);
+    };
+
+    // Finding where the events start can only be done serially. Both
+    // families have the same event header.
+    auto err = X740::index_events(block.Data.data(), block.Header.DataSize,
+                                  offsets);
+    if (err != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success
+        or offsets.size() != block.Header.NumEvents
+        or offsets.size() > batch.capacity()) {
+        return false;
+    }
+
+    batch.resize(offsets.size());
+    std::vector<uint8_t> failed(pool.size(), 0);
+    pool.for_each_chunk(offsets.size(), [&](std::size_t begin,
+                                            std::size_t end,
+                                            std::size_t worker) {
+        CAEN_DGTZ_EventInfo_t info{};
+        for (auto i = begin; i < end; i++) {
+            const auto waveform = batch[i];
+            const auto decoded = decode_event(
+                block.Data.data() + offsets[i],
+                block.Header.DataSize - offsets[i],
+                waveform.getEnabledChannels(), waveform.getRecordLength(),
+                waveform.getData(), info);
+            if (decoded != CAEN_DGTZ_ErrorCode::CAEN_DGTZ_Success) {
+                failed[worker] = 1;
+                return;
+            }
+            waveform.setInfo(info);
+        }
+    });
+
+    return std::find(failed.begin(), failed.end(), 1) == failed.end();
+}
+
+}  // namespace
+
+namespace RawDump {
+
+std::vector<char> serialize(const RawDumpConfig& config) {
+    std::vector<char> out;
+    ConfigSaver saver{out};
+    visit_config(saver, config);
+    return out;
+}
+
+RawDumpConfig deserialize(std::span<const char> data) {
+    RawDumpConfig config{};
+    ConfigLoader loader{data};
+    visit_config(loader, config);
+    return config;
+}
+
+uint32_t config_hash(const RawDumpConfig& config) {
+    return Checksum::crc32c(serialize(config));
+}
+
+RawBlockHeader block_header(const CAEN_DGTZ_BoardInfo_t& board_info,
+                            const uint32_t& config_hash,
+                            const uint32_t& num_events,
+                            const uint32_t& data_size) {
+    RawBlockHeader header;
+    header.HostTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    header.ConfigHash = config_hash;
+    header.BoardSerial = board_info.SerialNumber;
+    std::memcpy(header.BoardModel.data(), board_info.ModelName,
+                std::min(header.BoardModel.size(), sizeof(board_info.ModelName)));
+    header.NumEvents = num_events;
+    header.DataSize = data_size;
+    return header;
+}
+
+}  // namespace RawDump
+
+RawDumpWriter::RawDumpWriter(std::string_view file_name,
+                             const RawDumpConfig& config,
+                             const std::size_t& num_blocks) :
+    _file_name{file_name},
+    _filled_blocks(num_blocks),
+    _free_blocks(num_blocks) {
+    const bool resume = std::filesystem::exists(_file_name)
+        and not std::filesystem::is_empty(_file_name);
+    if (resume) {
+        // Whatever a crash left half written goes, or the new records would
+        // be read as part of it
+        std::size_t valid_size = 0;
+        {
+            const RawDumpReader existing(_file_name);
+            valid_size = existing.size();
+        }
+        std::filesystem::resize_file(_file_name, valid_size);
+    }
+
+    _stream.open(_file_name, std::ios::app | std::ofstream::binary);
+    if (not _stream.is_open()) {
+        throw std::runtime_error("Could not create the raw dump " + _file_name);
+    }
+
+    const auto body = RawDump::serialize(config);
+    _config_hash = Checksum::crc32c(body);
+    std::vector<char> header;
+    append(header, _config_hash);
+
+    if (not resume) {
+        _stream.write(kRawDumpMagic.data(), kRawDumpMagic.size());
+    }
+    _write_record(RawRecordType::Config, header, body);
+    _stream.flush();
+    if (_stream.fail()) {
+        throw std::runtime_error("Could not write to the raw dump " + _file_name);
+    }
+
+    for (std::size_t i = 0; i < num_blocks; i++) {
+        _free_blocks.enqueue(std::make_unique<RawDumpBlock>());
+    }
+
+    _writer_thread = std::thread(&RawDumpWriter::_write_loop, this);
+}
+
+RawDumpWriter::~RawDumpWriter() {
+    _stop = true;
+    if (_writer_thread.joinable()) {
+        _writer_thread.join();
+    }
+}
+
+void RawDumpWriter::_write_record(const RawRecordType& type,
+                                  std::span<const char> header,
+                                  std::span<const char> data) {
+    const auto size = static_cast<uint32_t>(header.size() + data.size());
+    _stream.write(reinterpret_cast<const char*>(&type), sizeof(type));
+    _stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    _stream.write(header.data(), static_cast<std::streamsize>(header.size()));
+    _stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+void RawDumpWriter::_write_loop() {
+    using clock = std::chrono::steady_clock;
+    auto window_start = clock::now();
+    uint64_t window_bytes = 0;
+
+    RawDumpBlock_ptr block;
+    while (true) {
+        if (_filled_blocks.wait_dequeue_timed(block,
+                                              std::chrono::milliseconds(100))) {
+            if (not _has_error.load(std::memory_order_relaxed)) {
+                const auto header = save_block_header(block->Header);
+                _write_record(RawRecordType::Block, header, block->Data);
+                if (_stream.fail()) {
+                    _error_msg = "Could not write to the raw dump " + _file_name;
+                    _has_error = true;
+                } else {
+                    const uint64_t bytes = RawDump::kRecordHeaderSize
+                        + header.size() + block->Data.size();
+                    window_bytes += bytes;
+                    _bytes_written += bytes;
+                }
+            }
+
+            _free_blocks.enqueue(std::move(block));
+        } else if (_stop) {
+            // Only stops once everything saved has been written
+            break;
+        }
+
+        std::chrono::duration<double> dt = clock::now() - window_start;
+        if (dt.count() >= 1.0) {
+            _bytes_per_second = static_cast<double>(window_bytes) / dt.count();
+            window_bytes = 0;
+            window_start = clock::now();
+        }
+    }
+
+    _stream.flush();
+}
+
+void RawDumpWriter::save_block(std::span<const char> data,
+                               const uint32_t& num_events,
+                               const CAEN_DGTZ_BoardInfo_t& board_info) {
+    RawDumpBlock_ptr block;
+    if (not _free_blocks.try_dequeue(block)) {
+        auto start = std::chrono::steady_clock::now();
+        _free_blocks.wait_dequeue(block);
+        std::chrono::duration<double, std::milli> dt
+            = std::chrono::steady_clock::now() - start;
+        _stall_time += dt.count();
+    }
+
+    block->Header = RawDump::block_header(board_info, _config_hash, num_events,
+                                          static_cast<uint32_t>(data.size()));
+    block->Data.assign(data.begin(), data.end());
+    _filled_blocks.enqueue(std::move(block));
+}
+
+RawDumpReader::RawDumpReader(std::string_view file_name) : _file{file_name} {
+    const std::span<const char> file(_file.data(), _file.size());
+    if (file.size() < kRawDumpMagic.size()
+        or not std::equal(kRawDumpMagic.begin(), kRawDumpMagic.end(),
+                          file.begin())) {
+        throw std::runtime_error("File " + name() + " is not a raw dump.");
+    }
+
+    std::size_t pos = kRawDumpMagic.size();
+    _size = pos;
+    while (pos < file.size()) {
+        if (file.size() - pos < RawDump::kRecordHeaderSize) {
+            _truncated = true;
+            break;
+        }
+
+        const auto type = take<uint32_t>(file, pos);
+        const auto size = take<uint32_t>(file, pos);
+        if (file.size() - pos < size) {
+            _truncated = true;
+            break;
+        }
+
+        const auto record = file.subspan(pos, size);
+        pos += size;
+        // Unknown records are skipped
+        if (type == static_cast<uint32_t>(RawRecordType::Config)) {
+            std::size_t body = 0;
+            const auto hash = take<uint32_t>(record, body);
+            if (Checksum::crc32c(record.subspan(body)) != hash) {
+                throw std::runtime_error("Raw dump " + name() + " has a "
+                                         "corrupted config.");
+            }
+
+            // Every time a dump is resumed its config is saved again
+            if (std::find(_config_hashes.begin(), _config_hashes.end(), hash)
+                == _config_hashes.end()) {
+                _configs.push_back(RawDump::deserialize(record.subspan(body)));
+                _config_hashes.push_back(hash);
+            }
+        } else if (type == static_cast<uint32_t>(RawRecordType::Block)) {
+            RawDumpEntry entry;
+            entry.Header = load_block_header(record);
+            entry.Data = record.subspan(RawDump::kBlockHeaderSize);
+
+            // Usually the last one
+            auto config = std::find(_config_hashes.rbegin(),
+                                    _config_hashes.rend(),
+                                    entry.Header.ConfigHash);
+            if (config == _config_hashes.rend()) {
+                throw std::runtime_error("Raw dump " + name() + " has a block "
+                                         "before its config.");
+            }
+
+            entry.Config = static_cast<std::size_t>(
+                std::distance(config, _config_hashes.rend()) - 1);
+            _blocks.push_back(entry);
+        }
+
+        _size = pos;
+    }
+}
+
+RawDecodeReport decode_raw_dump(std::string_view dump_name,
+                                std::string_view out_name,
+                                const RawDecodeOptions& options) {
+    // A SiPM file that exists is appended to, so it would end up with the
+    // events twice
+    if (std::filesystem::exists(out_name)) {
+        throw std::runtime_error("File " + std::string(out_name)
+                                 + " already exists.");
+    }
+
+    const RawDumpReader dump(dump_name);
+    const auto& model_constants = decodable_model(dump);
+    const auto& config = dump.configs().front();
+    const uint32_t max_events = max_block_events(dump);
+
+    RawDecodeReport report;
+    report.Truncated = dump.truncated();
+
+    SiPMDynamicWriter file(out_name, config.Family, model_constants,
+                           config.GlobalConfig, config.GroupConfigs,
+                           options.Compression, options.IndexStride, {},
+                           options.Checksums);
+    // One batch is decoded while the other is written
+    std::array<CAENWaveformBatch<uint16_t>, 2> batches;
+    for (auto& batch : batches) {
+        batch = CAENWaveformBatch<uint16_t>(model_constants,
+                                            config.GlobalConfig,
+                                            config.GroupConfigs, max_events);
+    }
+
+    WorkerPool pool(options.NumThreads);
+    std::vector<uint32_t> offsets;
+    std::future<void> writing;
+    std::size_t next_batch = 0;
+    for (std::size_t b = 0; b < dump.blocks().size(); b++) {
+        const auto& block = dump.blocks()[b];
+        report.NumBlocks++;
+
+        auto& batch = batches[next_batch];
+        if (not decode_block(config.Family, block, pool, offsets, batch)) {
+            spdlog::warn("Block {0} of {1} is corrupted, skipped.", b,
+                         dump.name());
+            report.CorruptedBlocks++;
+            continue;
+        }
+
+        // The other batch has to be written before it is decoded into
+        if (writing.valid()) {
+            writing.get();
+        }
+
+        report.NumEvents += batch.size();
+        writing = std::async(std::launch::async, [&file, &batch]() {
+            file.save_waveforms(batch);
+        });
+        next_batch = 1 - next_batch;
+    }
+
+    if (writing.valid()) {
+        writing.get();
+    }
+
+    return report;
+}
+
+RawDumpReplay::RawDumpReplay(std::string_view file_name,
+                             const RawReplayOptions& options) :
+    _dump{file_name},
+    _options{options},
+    _model_constants{decodable_model(_dump)},
+    _pool{options.NumThreads},
+    _waveforms{_model_constants, config().GlobalConfig, config().GroupConfigs,
+               max_block_events(_dump)} {}
+
+bool RawDumpReplay::done() const noexcept {
+    if (_dump.blocks().empty()) {
+        return true;
+    }
+
+    return _options.Loops != 0 and _loop >= _options.Loops;
+}
+
+bool RawDumpReplay::retrieve_block(const std::chrono::milliseconds& timeout) {
+    if (done()) {
+        return false;
+    }
+
+    const auto& blocks = _dump.blocks();
+    const auto& block = blocks[_next];
+    if (_next == 0) {
+        _loop_start = clock::now();
+    }
+
+    if (_options.Speed > 0.0) {
+        // When the block was read out, from the start of the dump
+        const std::chrono::duration<double, std::nano> host_time(
+            static_cast<double>(block.Header.HostTime
+                                - blocks.front().Header.HostTime));
+        const auto due = _loop_start
+            + std::chrono::duration_cast<clock::duration>(
+                host_time / _options.Speed);
+        const auto now = clock::now();
+        if (due > now + timeout) {
+            std::this_thread::sleep_for(timeout);
+            return false;
+        }
+
+        std::this_thread::sleep_until(due);
+        const std::chrono::duration<double> lag = clock::now() - due;
+        _stats.Lag = std::max(0.0, lag.count());
+    }
+
+    _current = &block;
+    _stats.Blocks++;
+    _stats.Events += block.Header.NumEvents;
+    _stats.Bytes += block.Header.DataSize;
+    if (++_next == blocks.size()) {
+        _next = 0;
+        _loop++;
+    }
+
+    return true;
+}
+
+bool RawDumpReplay::decode() {
+    if (_current == nullptr) {
+        return false;
+    }
+
+    if (not decode_block(config().Family, *_current, _pool, _offsets,
+                         _waveforms)) {
+        _waveforms.resize(0);
+        _stats.CorruptedBlocks++;
+        return false;
+    }
+
+    return true;
+}
+
+}  // namespace SBCQueens::BinaryFormat
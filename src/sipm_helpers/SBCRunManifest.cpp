@@ -0,0 +1,109 @@
+#include "sbcqueens-gui/sipm_helpers/SBCRunManifest.hpp"
+
+// C STD includes
+#include <cstdio>
+// C 3rd party includes
+// C++ STD includes
+#include <filesystem>
+#include <fstream>
+
+// C++ 3rd party includes
+#include <nlohmann/json.hpp>
+#include <spdlog/fmt/fmt.h>
+
+// my includes
+
+namespace SBCQueens::BinaryFormat {
+
+using json = nlohmann::json;
+
+void to_json(json& j, const RunSegment& s) {
+    j = json{{"file", s.FileName},
+             {"first_event", s.FirstEvent},
+             {"num_events", s.NumEvents},
+             {"first_trigger_time", s.FirstTriggerTime},
+             {"last_trigger_time", s.LastTriggerTime},
+             {"start_time", s.StartTime},
+             {"end_time", s.EndTime},
+             {"bytes", s.Bytes},
+             {"closed", s.Closed},
+             {"verified", s.Verified ? json(*s.Verified) : json(nullptr)}};
+}
+
+void from_json(const json& j, RunSegment& s) {
+    j.at("file").get_to(s.FileName);
+    j.at("first_event").get_to(s.FirstEvent);
+    j.at("num_events").get_to(s.NumEvents);
+    j.at("first_trigger_time").get_to(s.FirstTriggerTime);
+    j.at("last_trigger_time").get_to(s.LastTriggerTime);
+    j.at("start_time").get_to(s.StartTime);
+    j.at("end_time").get_to(s.EndTime);
+    j.at("bytes").get_to(s.Bytes);
+    j.at("closed").get_to(s.Closed);
+    if (j.contains("verified") and not j.at("verified").is_null()) {
+        s.Verified = j.at("verified").get<bool>();
+    }
+}
+
+std::string RunManifest::manifest_name(std::string_view base_file) {
+    std::filesystem::path path(base_file);
+    path.replace_extension(".manifest.json");
+    return path.string();
+}
+
+std::string RunManifest::segment_name(std::string_view base_file,
+                                      const std::size_t& number) {
+    const std::filesystem::path path(base_file);
+    const auto name = fmt::format("{0}_{1:04d}{2}", path.stem().string(),
+                                  number, path.extension().string());
+    return (path.parent_path() / name).string();
+}
+
+RunManifest::RunManifest(std::string_view file_name) : _file_name{file_name} {
+    if (not std::filesystem::exists(_file_name)) {
+        return;
+    }
+
+    std::ifstream in(_file_name);
+    try {
+        const auto manifest = json::parse(in);
+        if (manifest.at("version").get<int>() != kVersion) {
+            throw std::runtime_error("unsupported version");
+        }
+
+        manifest.at("segments").get_to(_segments);
+    } catch (std::exception& err) {
+        throw std::runtime_error("Could not read run manifest " + _file_name
+                                 + ": " + err.what());
+    }
+}
+
+void RunManifest::save() const {
+    const json manifest = {{"version", kVersion}, {"segments", _segments}};
+    const std::string tmp_name = _file_name + ".tmp";
+    {
+        std::ofstream out(tmp_name, std::ios::trunc);
+        out << manifest.dump(2) << '\n';
+        if (not out) {
+            throw std::runtime_error("Could not write run manifest "
+                                     + _file_name);
+        }
+    }
+
+    std::filesystem::rename(tmp_name, _file_name);
+}
+
+std::string RunManifest::path(const RunSegment& segment) const {
+    return (std::filesystem::path(_file_name).parent_path()
+            / segment.FileName).string();
+}
+
+uint64_t RunManifest::next_event() const noexcept {
+    if (_segments.empty()) {
+        return 0;
+    }
+
+    return _segments.back().FirstEvent + _segments.back().NumEvents;
+}
+
+}  // namespace SBCQueens::BinaryFormat
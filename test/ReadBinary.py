@@ -15,6 +15,17 @@ file_endianness = 'little'
 
 #np.set_printoptions(threshold=np.nan)
 
+# Bit packed unsigned columns are saved as 'upack' + bits, e.g. upack12
+packed_type_prefix = 'upack'
+
+# v2 files closed properly end with a run summary (6 uint64) + 'SBCTRAIL'
+trailer_magic = b'SBCTRAIL'
+trailer_size = 48 + len(trailer_magic)
+# and, if they have block checksums, the trailer is preceded by
+# uint32 CRC per block + uint64 lines per block + uint64 blocks + 'SBCBLOCK'
+block_checksums_magic = b'SBCBLOCK'
+block_checksums_trailer_size = 16 + len(block_checksums_magic)
+
 
 def ReadBlock(file_name, max_file_size = 2000):
     '''
@@ -22,6 +33,8 @@ def ReadBlock(file_name, max_file_size = 2000):
     then recasts each variable
     to the proper data type, and stores it in a dictionary to be returned.
     If the size of the file is greater than max_file_size (in MB), then it will not open/load.
+    For v2 files, the run constants saved in the header are also returned,
+    without the num_lines dimension.
     '''
     variables_dict = OrderedDict()
     possible_data_types = {'char': 8, 'int8': 8,
@@ -42,6 +55,18 @@ def ReadBlock(file_name, max_file_size = 2000):
                           format(file_name, file_size, max_file_size))
 
     with open(file_name, "rb") as read_in:
+        # v2 files start with "SBC" + version byte
+        magic = read_in.read(4)
+        version = 1
+        flags = 0
+        if magic[:3] == b'SBC':
+            version = magic[3]
+            if version != 2:
+                raise IOError("File {} has an unsupported version: {}".\
+                              format(file_name, version))
+        else:
+            read_in.seek(0, 0)
+
         # Check the Endianness flag of the block
         endianness = np.fromfile(read_in, dtype=np.uint32, count=1)
         # 0x01020304 = 16909060 in base 10
@@ -49,6 +74,24 @@ def ReadBlock(file_name, max_file_size = 2000):
             file_endianness = 'big'
             print('File Endianness Changed')
 
+        if version == 2:
+            # Flags: 1 = compressed chunks, 2 = delta filtered uint16 rows,
+            # 4 = has a trailer once closed, 8 = has block checksums
+            flags = int(np.fromfile(read_in, dtype=np.uint32, count=1)[0])
+            if flags & ~15:
+                raise IOError("File {} uses unsupported features: {}".\
+                              format(file_name, flags))
+            constants_len = np.fromfile(read_in, dtype=np.uint16, count=1)[0]
+            constants_str = read_in.read(constants_len).decode('ascii')
+            constants_components = constants_str.split(';')
+            for variable in range(0, len(constants_components) - 1, 3):
+                name = constants_components[variable]
+                data_type = constants_components[variable + 1]
+                size = int(constants_components[variable + 2])
+                width = ColumnWidth(possible_data_types, data_type, size)
+                raw = np.frombuffer(read_in.read(width), dtype=np.uint8)
+                variables_dict[name] = Cast(data_type, raw.copy(), size)
+
         # Check the length of the header string
         header_len = np.fromfile(read_in, dtype=np.uint16, count=1)
 
@@ -76,44 +119,61 @@ def ReadBlock(file_name, max_file_size = 2000):
             if len(meta_data[key][1].split(',')) == 1:
                 if len(meta_data[key][1]) == 0:
                     meta_data[key][1] = '1'
-                bytes_per_line += (possible_data_types[meta_data[key][0]] *
-                                   int(meta_data[key][1]) / 8)
+                bytes_per_line += ColumnWidth(possible_data_types,
+                                              meta_data[key][0],
+                                              int(meta_data[key][1]))
             else:
                 temp_size = 1
                 sizes = meta_data[key][1].split(',')
                 for ele in sizes:
                     temp_size *= int(ele)
-                bytes_per_line += (possible_data_types[meta_data[key][0]] *
-                                   temp_size / 8)
+                bytes_per_line += ColumnWidth(possible_data_types,
+                                              meta_data[key][0], temp_size)
 
-        if True or num_lines <= 0:
+        data_keys = []
+        for variable in range(0, len(header_components), 3):
+            if header_components[variable]:
+                data_keys.append(header_components[variable])
+
+        if flags & 1:
+            uint8_buffer = ReadChunks(read_in, int(bytes_per_line),
+                                      DeltaRows(possible_data_types,
+                                                meta_data, flags & 2),
+                                      flags & 4, flags & 8)
+            # Capped by the number of lines, like the C++ Reader
+            if 0 < num_lines < uint8_buffer.shape[0]:
+                uint8_buffer = uint8_buffer[:num_lines]
+            num_lines = uint8_buffer.shape[0]
+        else:
             start_of_data = read_in.tell()
-            read_in.seek(0, 2)
-            end_of_data = read_in.tell()
+            end_of_data = DataEnd(read_in, flags & 4, flags & 8)
             read_in.seek(start_of_data, 0)
             blocksize = end_of_data - start_of_data
-            num_lines = int(blocksize / bytes_per_line)
+            lines_in_file = int(blocksize / bytes_per_line)
 
-        if (num_lines * int(bytes_per_line)) < blocksize:
-            print("Warning: file " + file_name +
-                  " not closed properly, will pad last line with 0s")
-            num_lines = num_lines + 1
-
-        for variable in range(0, len(header_components), 3):
-            if header_components[variable]:
-                variables_dict[header_components[variable]] = None
-
-        uint8_buffer = np.zeros(num_lines * int(bytes_per_line),
-                                dtype=np.uint8)
-        uint8_buffer[:blocksize] = np.fromfile(read_in,
-                                               dtype=np.uint8, count=-1)
-        # uint8_buffer = np.fromfile(read_in, dtype=np.uint8,
-        #                            count=num_lines * int(bytes_per_line))
-        uint8_buffer = np.reshape(uint8_buffer,
-                                  (num_lines, int(bytes_per_line)), order='C')
+            # The writer updates the number of lines once they are in the
+            # file, so the buffer can be allocated in one go
+            if 0 < num_lines <= lines_in_file:
+                blocksize = num_lines * int(bytes_per_line)
+            else:
+                num_lines = lines_in_file
+                if (num_lines * int(bytes_per_line)) < blocksize:
+                    print("Warning: file " + file_name +
+                          " not closed properly, will pad last line with 0s")
+                    num_lines = num_lines + 1
+
+            uint8_buffer = np.zeros(num_lines * int(bytes_per_line),
+                                    dtype=np.uint8)
+            uint8_buffer[:blocksize] = np.fromfile(read_in,
+                                                   dtype=np.uint8,
+                                                   count=blocksize)
+            # uint8_buffer = np.fromfile(read_in, dtype=np.uint8,
+            #                            count=num_lines * int(bytes_per_line))
+            uint8_buffer = np.reshape(uint8_buffer,
+                                      (num_lines, int(bytes_per_line)), order='C')
 
         start = 0
-        for key in variables_dict:
+        for key in data_keys:
             # If data shape is simple, the width is read directly
             if len(meta_data[key][1].split(',')) == 1:
                 width = int(meta_data[key][1])
@@ -132,11 +192,12 @@ def ReadBlock(file_name, max_file_size = 2000):
                 sizes.append(num_lines)
                 sizes.reverse()
                 sizes = tuple(sizes)
-            width *= possible_data_types[meta_data[key][0]] / 8
+            count = width
+            width = ColumnWidth(possible_data_types, meta_data[key][0], count)
 
             temp = np.zeros((num_lines, int(width)), dtype=np.uint8, order='C')
             temp[:, :] = uint8_buffer[::, int(start):int(start + width)]
-            variables_dict[key] = Cast(meta_data[key][0], temp)
+            variables_dict[key] = Cast(meta_data[key][0], temp, count)
             # Uncomment this line to save all data as a double type
             # variables_dict[key] =\
             #     variables_dict[key].astype(np.float64, copy = False)
@@ -148,7 +209,157 @@ def ReadBlock(file_name, max_file_size = 2000):
     return variables_dict
 
 
-def Cast(variable_name, data):
+def ReadManifest(manifest_name):
+    '''
+    Returns the segments of a run split by rollover ({file}.manifest.json),
+    in order, as dictionaries with the full path of each segment in 'path'.
+    Each segment is a complete file that can be read with ReadBlock, so
+    they can be read in parallel.
+    '''
+    import json
+
+    with open(manifest_name, 'r') as manifest_file:
+        manifest = json.load(manifest_file)
+
+    if manifest['version'] != 1:
+        raise ValueError('Unsupported manifest version %s' % manifest['version'])
+
+    folder = os.path.dirname(manifest_name)
+    segments = manifest['segments']
+    for segment in segments:
+        segment['path'] = os.path.join(folder, segment['file'])
+
+    return segments
+
+
+def DeltaRows(possible_data_types, meta_data, delta_filtered):
+    '''
+    Returns the (offset, row length, number of rows) of the uint16 rows of
+    a line that were delta filtered before being compressed.
+    '''
+    delta_rows = []
+    offset = 0
+    for key in meta_data:
+        data_type = meta_data[key][0]
+        sizes = [int(size) for size in meta_data[key][1].split(',')]
+        count = int(np.prod(sizes))
+        if delta_filtered and data_type == 'uint16' and sizes[-1] > 1:
+            delta_rows.append((offset, sizes[-1], count // sizes[-1]))
+        offset += ColumnWidth(possible_data_types, data_type, count)
+
+    return delta_rows
+
+
+def DataEnd(read_in, has_trailer, has_block_checksums=False):
+    '''
+    Returns where the data of the file ends: its size, minus the trailer and
+    block checksums if it has them.
+    '''
+    read_in.seek(0, 2)
+    end = read_in.tell()
+    if not has_trailer or end < trailer_size:
+        return end
+
+    read_in.seek(end - len(trailer_magic), 0)
+    if read_in.read(len(trailer_magic)) != trailer_magic:
+        return end
+
+    end -= trailer_size
+    if has_block_checksums and end >= block_checksums_trailer_size:
+        read_in.seek(end - block_checksums_trailer_size, 0)
+        trailer = read_in.read(block_checksums_trailer_size)
+        if trailer.endswith(block_checksums_magic):
+            num_blocks = int(np.frombuffer(trailer, dtype=np.uint64, count=1,
+                                           offset=8)[0])
+            end -= block_checksums_trailer_size + 4*num_blocks
+
+    return end
+
+
+def ReadChunks(read_in, bytes_per_line, delta_rows, has_trailer=False,
+               has_block_checksums=False):
+    '''
+    Reads the zstd compressed chunks of a compressed file (see
+    CompressionOptions in SBCBinaryFormat.hpp) and returns its lines as a
+    (num_lines, bytes_per_line) uint8 array. An incomplete chunk at the end
+    is ignored. Requires the zstandard package.
+    '''
+    import zstandard
+
+    start_of_data = read_in.tell()
+    end_of_data = DataEnd(read_in, has_trailer, has_block_checksums)
+    read_in.seek(start_of_data, 0)
+    data = read_in.read(end_of_data - start_of_data)
+    # Chunk index written when the file is closed
+    index_magic = b'SBCINDEX'
+    if data.endswith(index_magic) and len(data) >= 24:
+        num_chunks = int(np.frombuffer(data, dtype=np.uint64, count=1,
+                                       offset=len(data) - 24)[0])
+        index_start = len(data) - 24 - 16 * num_chunks
+        if index_start >= 0:
+            data = data[:index_start]
+
+    decompressor = zstandard.ZstdDecompressor()
+    chunks = []
+    pos = 0
+    while pos + 8 <= len(data):
+        num_events, compressed_size = [int(x) for x in np.frombuffer(
+            data, dtype=np.uint32, count=2, offset=pos)]
+        if num_events == 0 or compressed_size == 0 or \
+                pos + 8 + compressed_size > len(data):
+            break
+
+        raw = decompressor.decompress(
+            data[pos + 8:pos + 8 + compressed_size],
+            max_output_size=num_events * bytes_per_line)
+        chunks.append(np.frombuffer(raw, dtype=np.uint8).reshape(
+            num_events, bytes_per_line))
+        pos += 8 + compressed_size
+
+    if not chunks:
+        return np.zeros((0, bytes_per_line), dtype=np.uint8)
+
+    lines = np.concatenate(chunks)
+    for offset, row_length, num_rows in delta_rows:
+        width = 2 * row_length * num_rows
+        rows = lines[:, offset:offset + width].copy().view(np.uint16)
+        rows = rows.reshape(lines.shape[0], num_rows, row_length)
+        # Undo the zigzag encoding and the differences
+        diffs = (rows[:, :, 1:] >> 1) ^ (0 - (rows[:, :, 1:] & 1))
+        rows[:, :, 1:] = diffs.astype(np.uint16)
+        rows = np.cumsum(rows, axis=2, dtype=np.uint16)
+        lines[:, offset:offset + width] = \
+            rows.reshape(lines.shape[0], -1).view(np.uint8)
+
+    return lines
+
+
+def ColumnWidth(possible_data_types, data_type, size):
+    '''
+    Returns the bytes taken by size elements of data_type.
+    Packed types take ceil(bits * size / 8) bytes.
+    '''
+    if data_type.startswith(packed_type_prefix):
+        bits = int(data_type[len(packed_type_prefix):])
+        return (bits * size + 7) // 8
+
+    return possible_data_types[data_type] * size // 8
+
+
+def Unpack(bits, data, count):
+    '''
+    Unpacks count samples from every row of data, saved as a little endian
+    bit stream of bits per sample, into uint16.
+    '''
+    num_rows = data.shape[0] if data.ndim > 1 else 1
+    data = np.reshape(data, (num_rows, -1))
+    stream = np.unpackbits(data, axis=1, bitorder='little')
+    stream = np.reshape(stream[:, :count * bits], (num_rows, count, bits))
+    weights = (1 << np.arange(bits)).astype(np.uint16)
+    return (stream.astype(np.uint16) * weights).sum(axis=2, dtype=np.uint16)
+
+
+def Cast(variable_name, data, count=None):
     '''
     This function takes in the type to be cast to,
     as well as the data to be cast,
@@ -192,5 +403,9 @@ def Cast(variable_name, data):
     if variable_name == 'float128':
         return data.view(np.float128)
 
+    if variable_name.startswith(packed_type_prefix):
+        return Unpack(int(variable_name[len(packed_type_prefix):]), data,
+                      count)
+
     else:
         return None
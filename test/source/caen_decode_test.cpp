@@ -0,0 +1,843 @@
+// C STD includes
+// C 3rd party includes
+// C++ STD include
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// C++ 3rd party includes
+#include <doctest/doctest.h>
+#include <spdlog/fmt/fmt.h>
+
+// my includes
+#include "sbcqueens-gui/caen_helper.hpp"
+#include "sbcqueens-gui/caen_x730_decoder.hpp"
+#include "sbcqueens-gui/caen_x740_decoder.hpp"
+#include "sbcqueens-gui/multithreading_helpers/WorkerPool.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCRawDump.hpp"
+#include "sbcqueens-gui/sipm_helpers/SiPMEventBuilder.hpp"
+#include "sbcqueens-gui/sipm_helpers/SiPMAsyncWriter.hpp"
+
+namespace {
+
+using namespace SBCQueens;
+
+// Stand in for a readout block: every event has its samples interleaved
+// between channels, so decoding one is a transpose into CAENWaveforms like
+// CAEN_DGTZ_DecodeEvent + CAENWaveforms::copy do.
+struct FakeReadoutBlock {
+    std::size_t NumChannels;
+    std::size_t RecordLength;
+    std::vector<uint16_t> Raw;
+
+    FakeReadoutBlock(std::size_t n_events, std::size_t n_chs, std::size_t rl) :
+        NumChannels{n_chs}, RecordLength{rl}, Raw(n_events*n_chs*rl) {
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<uint16_t> distribution(0, 0x0FFF);
+        std::generate(Raw.begin(), Raw.end(), [&]() { return distribution(gen); });
+    }
+
+    void decode(const std::size_t& i,
+                const CAENWaveformView<uint16_t>& waveform) const {
+        const uint16_t* event = Raw.data() + i*NumChannels*RecordLength;
+        auto data = waveform.getData();
+        for (std::size_t ch = 0; ch < NumChannels; ch++) {
+            for (std::size_t s = 0; s < RecordLength; s++) {
+                data[ch*RecordLength + s] = event[s*NumChannels + ch];
+            }
+        }
+    }
+};
+
+// V1740D with all 64 channels enabled
+CAENWaveformBatch<uint16_t> make_waveforms(const std::size_t& n_events,
+                                           const uint32_t& rl) {
+    const auto model_consts = CAENDigitizerModelsConstantsMap.at(
+        CAENDigitizerModel::V1740D);
+    CAENGlobalConfig global_config;
+    global_config.RecordLength = rl;
+    std::array<CAENGroupConfig, 8> group_configs;
+    for (auto& group : group_configs) {
+        group.Enabled = true;
+        group.AcquisitionMask.CH.fill(true);
+    }
+
+    CAENWaveformBatch<uint16_t> out(model_consts, global_config,
+                                    group_configs, n_events);
+    out.resize(n_events);
+    return out;
+}
+
+// Packs waveforms (64 channels x rl samples, channel-major) into a x740
+// event as the digitizer would, see caen_x740_decoder.hpp.
+std::vector<char> pack_x740_event(const std::vector<uint16_t>& samples,
+                                  const uint32_t& rl,
+                                  const uint32_t& group_mask,
+                                  const uint32_t& counter) {
+    std::vector<uint32_t> words = {0, (group_mask & 0xFF) | (0x00AB << 8),
+                                   counter, 10*counter};
+    for (uint32_t gr = 0; gr < X740::kMaxGroups; gr++) {
+        if (not ((group_mask >> gr) & 0x1)) {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < rl / X740::kSamplesPerBlock; j++) {
+            for (uint32_t ch = 0; ch < X740::kChannelsPerGroup; ch++) {
+                std::array<uint32_t, 8> s;
+                std::copy_n(samples.begin() + (gr*8 + ch)*rl + j*8, 8, s.begin());
+                words.push_back(s[0] | (s[1] << 12) | (s[2] << 24));
+                words.push_back((s[2] >> 8) | (s[3] << 4) | (s[4] << 16)
+                                | (s[5] << 28));
+                words.push_back((s[5] >> 4) | (s[6] << 8) | (s[7] << 20));
+            }
+        }
+    }
+    words[0] = (0xAu << 28) | static_cast<uint32_t>(words.size());
+
+    std::vector<char> out(words.size()*sizeof(uint32_t));
+    std::memcpy(out.data(), words.data(), out.size());
+    return out;
+}
+
+// Same as pack_x740_event for a x730 event of 8 channels
+std::vector<char> pack_x730_event(const std::vector<uint16_t>& samples,
+                                  const uint32_t& rl,
+                                  const uint32_t& channel_mask,
+                                  const uint32_t& counter) {
+    std::vector<uint32_t> words = {0, (channel_mask & 0xFF) | (0x00AB << 8),
+                                   counter, 10*counter};
+    for (uint32_t ch = 0; ch < X730::kMaxChannels; ch++) {
+        if (not ((channel_mask >> ch) & 0x1)) {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < rl; j += 2) {
+            words.push_back(samples[ch*rl + j]
+                            | (static_cast<uint32_t>(samples[ch*rl + j + 1]) << 16));
+        }
+    }
+    words[0] = (0xAu << 28) | static_cast<uint32_t>(words.size());
+
+    std::vector<char> out(words.size()*sizeof(uint32_t));
+    std::memcpy(out.data(), words.data(), out.size());
+    return out;
+}
+
+// V1740D with all 64 channels enabled, as make_waveforms
+SiPMEventBuilder make_event_builder(const std::size_t& num_boards,
+                                    const std::size_t& batch_size,
+                                    const uint32_t& rl,
+                                    const EventBuilderOptions& options) {
+    CAENGlobalConfig global_config;
+    global_config.RecordLength = rl;
+    std::array<CAENGroupConfig, 8> group_configs;
+    for (auto& group : group_configs) {
+        group.Enabled = true;
+        group.AcquisitionMask.CH.fill(true);
+    }
+
+    return {num_boards,
+            CAENDigitizerModelsConstantsMap.at(CAENDigitizerModel::V1740D),
+            global_config, group_configs, batch_size, options};
+}
+
+// Submits a readout of board with these trigger time tags. The first
+// sample of every waveform is board*100 + its position.
+void submit_readout(SiPMEventBuilder& builder, const std::size_t& board,
+                    const std::vector<uint32_t>& trigger_time_tags) {
+    BoardBatch_ptr batch;
+    REQUIRE(builder.acquire_batch(board, batch, std::chrono::milliseconds(0)));
+    batch->Waveforms.resize(trigger_time_tags.size());
+    for (std::size_t i = 0; i < trigger_time_tags.size(); i++) {
+        auto waveform = batch->Waveforms[i];
+        CAEN_DGTZ_EventInfo_t info{};
+        info.TriggerTimeTag = trigger_time_tags[i];
+        info.Pattern = 0xAB;
+        waveform.setInfo(info);
+        waveform.getData()[0] = static_cast<uint16_t>(board*100 + i);
+    }
+    builder.submit(board, std::move(batch));
+}
+
+void decode_block(WorkerPool& pool, const FakeReadoutBlock& block,
+                  CAENWaveformBatch<uint16_t>& waveforms) {
+    pool.for_each_chunk(waveforms.size(),
+        [&](std::size_t begin, std::size_t end, std::size_t) {
+            for (std::size_t i = begin; i < end; i++) {
+                block.decode(i, waveforms[i]);
+            }
+    });
+}
+
+}  // namespace
+
+TEST_CASE("WORKER_POOL_COVERS_RANGE_ONCE") {
+    for (std::size_t n_workers : {1ul, 2ul, 3ul, 8ul}) {
+        WorkerPool pool(n_workers);
+        CHECK(pool.size() == n_workers);
+        // Less, equal and more elements than workers
+        for (std::size_t n : {0ul, 1ul, 5ul, 8ul, 1001ul}) {
+            std::vector<int> hits(n, 0);
+            pool.for_each_chunk(n, [&](std::size_t begin, std::size_t end,
+                                       std::size_t worker) {
+                CHECK(worker < pool.size());
+                for (std::size_t i = begin; i < end; i++) {
+                    hits[i]++;
+                }
+            });
+            CHECK(std::all_of(hits.begin(), hits.end(),
+                              [](int h) { return h == 1; }));
+        }
+    }
+}
+
+TEST_CASE("CAEN_PARALLEL_DECODE_MATCHES_SERIAL") {
+    constexpr std::size_t kEvents = 257;
+    constexpr uint32_t kRL = 64;
+    FakeReadoutBlock block(kEvents, 64, kRL);
+
+    WorkerPool serial_pool(1);
+    auto serial = make_waveforms(kEvents, kRL);
+    decode_block(serial_pool, block, serial);
+
+    WorkerPool parallel_pool(4);
+    auto parallel = make_waveforms(kEvents, kRL);
+    decode_block(parallel_pool, block, parallel);
+
+    auto a = serial.getData();
+    auto b = parallel.getData();
+    REQUIRE(std::equal(a.begin(), a.end(), b.begin(), b.end()));
+}
+
+TEST_CASE("CAEN_WAVEFORM_BATCH_LAYOUT") {
+    constexpr std::size_t kEvents = 5;
+    constexpr uint32_t kRL = 16;
+    auto batch = make_waveforms(kEvents, kRL);
+    CHECK(batch.capacity() == kEvents);
+    CHECK(batch.getNumEnabledChannels() == 64);
+    CHECK(batch.getEventSize() == 64*kRL);
+
+    // Views write straight into one [event][channel][sample] block
+    for (std::size_t i = 0; i < kEvents; i++) {
+        auto waveform = batch[i];
+        CAEN_DGTZ_EventInfo_t info{};
+        info.EventCounter = static_cast<uint32_t>(i);
+        waveform.setInfo(info);
+        for (std::size_t row = 0; row < waveform.getNumEnabledChannels(); row++) {
+            auto channel = waveform.getChannel(row);
+            std::fill(channel.begin(), channel.end(),
+                      static_cast<uint16_t>(i*100 + row));
+        }
+    }
+
+    batch.resize(3);
+    auto data = batch.getData();
+    REQUIRE(data.size() == 3*64*kRL);
+    for (std::size_t k = 0; k < data.size(); k++) {
+        const std::size_t event = k / (64*kRL);
+        const std::size_t row = (k / kRL) % 64;
+        REQUIRE(data[k] == event*100 + row);
+    }
+    CHECK(batch.getInfos().size() == 3);
+    CHECK(batch.getInfo(2).EventCounter == 2);
+
+    // Swapping hands the memory over without copying
+    auto other = make_waveforms(kEvents, kRL);
+    other.resize(0);
+    REQUIRE(other.hasSameLayout(batch));
+    const uint16_t* memory = batch.getData().data();
+    batch.swap(other);
+    CHECK(batch.empty());
+    CHECK(other.size() == 3);
+    CHECK(other.getData().data() == memory);
+    CHECK(not other.hasSameLayout(make_waveforms(kEvents + 1, kRL)));
+
+    // Appending copies events up to the capacity, whatever it is
+    auto run = make_waveforms(4, kRL);
+    run.resize(0);
+    CHECK(run.append(other, 1, 10) == 2);
+    CHECK(run.append(other, 0, 10) == 2);
+    CHECK(run.append(other, 0, 10) == 0);
+    REQUIRE(run.size() == 4);
+    CHECK(run.getInfo(0).EventCounter == 1);
+    CHECK(run.getInfo(3).EventCounter == 1);
+    CHECK(run.getData(1)[kRL] == 2*100 + 1);
+    CHECK(run.append(make_waveforms(kEvents, kRL + 1), 0, 1) == 0);
+}
+
+TEST_CASE("CAEN_CONFIG_DIFF") {
+    CAENGlobalConfig global_config;
+    std::array<CAENGroupConfig, 8> group_configs;
+    group_configs[0].Enabled = true;
+
+    CHECK(diff_configs(global_config, group_configs,
+                       global_config, group_configs).empty());
+
+    // A threshold scan step only touches its group
+    auto new_groups = group_configs;
+    new_groups[3].TriggerThreshold = 100;
+    auto diff = diff_configs(global_config, group_configs,
+                             global_config, new_groups);
+    CHECK(diff.size() == 1);
+    CHECK(diff.Groups[3]);
+    CHECK_FALSE(diff.NeedsReset);
+
+    new_groups[0].DCCorrections[7] = 1;
+    new_groups[1].TriggerMask[0] = true;
+    diff = diff_configs(global_config, group_configs,
+                        global_config, new_groups);
+    CHECK(diff.size() == 3);
+    CHECK(diff.Groups[0]);
+    CHECK(diff.TriggerMasks);
+
+    auto new_global = global_config;
+    new_global.DecimationFactor = 4;
+    new_global.EXTAsGate = true;
+    diff = diff_configs(global_config, group_configs,
+                        new_global, group_configs);
+    CHECK(diff.Decimation);
+    CHECK(diff.PostTrigger);
+    CHECK(diff.BoardRegisters);
+    CHECK_FALSE(diff.TriggerModes);
+
+    // The memory layout changes
+    new_global = global_config;
+    new_global.RecordLength++;
+    CHECK(diff_configs(global_config, group_configs,
+                       new_global, group_configs).NeedsReset);
+    new_groups = group_configs;
+    new_groups[0].AcquisitionMask[2] = true;
+    CHECK(diff_configs(global_config, group_configs,
+                       global_config, new_groups).NeedsReset);
+}
+
+TEST_CASE("SIPM_EVENT_BUILDER") {
+    constexpr uint32_t kRL = 16;
+    EventBuilderOptions options;
+    // 13 ticks
+    options.CoincidenceWindow = 100.0;
+    options.MinBoards = 2;
+    // A builder cannot be moved, so it is made in place
+    auto builder = make_event_builder(2, 4, kRL, options);
+
+    // The first coincidence is across the trigger time tag roll over
+    submit_readout(builder, 0, {0x7FFFFFF0, 1000, 5000});
+    submit_readout(builder, 1, {0x7FFFFFF8, 3000, 5010});
+
+    auto out = make_waveforms(8, kRL);
+    out.resize(0);
+    // 5010 may still have company from board 0
+    CHECK(builder.merge(out) == 2);
+    auto stats = builder.getStatistics();
+    CHECK(stats.BuiltEvents == 1);
+    CHECK(stats.RejectedEvents == 2);
+    CHECK(stats.Backlog == 2);
+
+    CHECK(builder.merge(out, true) == 2);
+    REQUIRE(out.size() == 4);
+    const std::array<uint32_t, 4> boards = {0, 1, 0, 1};
+    const std::array<uint16_t, 4> first_samples = {0, 100, 2, 102};
+    for (std::size_t i = 0; i < out.size(); i++) {
+        const auto& pattern = out.getInfo(i).Pattern;
+        CHECK(merged_board(pattern) == boards[i]);
+        CHECK(is_built_event_start(pattern) == (i % 2 == 0));
+        CHECK((pattern & kMergedPatternMask) == 0xAB);
+        CHECK(out.getData(i)[0] == first_samples[i]);
+    }
+
+    stats = builder.getStatistics();
+    CHECK(stats.BoardEvents == std::vector<uint64_t>({3, 3}));
+    CHECK(stats.BuiltEvents == 2);
+    CHECK(stats.MergedEvents == 4);
+    CHECK(stats.Backlog == 0);
+    CHECK(stats.LateEvents == 0);
+
+    // Without a timeout, a board that did not send anything does not
+    // hold back the others, and what it sends later is late
+    options.CoincidenceWindow = 0.0;
+    options.MinBoards = 1;
+    options.Timeout = std::chrono::milliseconds(0);
+    auto no_wait = make_event_builder(2, 4, kRL, options);
+    submit_readout(no_wait, 0, {100, 200});
+    out.resize(0);
+    CHECK(no_wait.merge(out) == 1);
+    submit_readout(no_wait, 1, {150});
+    CHECK(no_wait.merge(out, true) == 2);
+    CHECK(no_wait.getStatistics().LateEvents == 1);
+    CHECK(out.getInfo(2).TriggerTimeTag == 150);
+}
+
+TEST_CASE("CAEN_PARALLEL_DECODE_THROUGHPUT") {
+    using clock = std::chrono::steady_clock;
+    // Half of the V1740D buffer, which is what acquisition_endless waits for
+    constexpr std::size_t kEventsPerBlock = 512;
+    constexpr std::size_t kBlocks = 8;
+    const std::size_t max_threads
+        = std::max(1u, std::thread::hardware_concurrency());
+
+    for (uint32_t rl : {100u, 350u, 1000u}) {
+        FakeReadoutBlock block(kEventsPerBlock, 64, rl);
+        auto waveforms = make_waveforms(kEventsPerBlock, rl);
+
+        double serial_s = 0.0;
+        for (std::size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+            WorkerPool pool(n_threads);
+            auto start = clock::now();
+            for (std::size_t b = 0; b < kBlocks; b++) {
+                decode_block(pool, block, waveforms);
+            }
+            std::chrono::duration<double> dt = clock::now() - start;
+            if (n_threads == 1) {
+                serial_s = dt.count();
+            }
+
+            const double n_events = kEventsPerBlock*kBlocks;
+            MESSAGE(fmt::format("rl = {:5} threads = {:3} | {:9.0f} evt/s "
+                                "| speed up: {:.2f}x",
+                                rl, n_threads, n_events / dt.count(),
+                                serial_s / dt.count()));
+        }
+    }
+}
+
+TEST_CASE("CAEN_X740_NATIVE_DECODE") {
+    constexpr uint32_t kRL = 48;
+    constexpr uint32_t kGroupMask = 0b10100101;
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<uint16_t> distribution(0, 0x0FFF);
+    std::vector<uint16_t> samples(64*kRL);
+    std::generate(samples.begin(), samples.end(),
+                  [&]() { return distribution(gen); });
+
+    // Two events back to back, like in a readout buffer
+    auto buffer = pack_x740_event(samples, kRL, kGroupMask, 1);
+    auto second = pack_x740_event(samples, kRL, kGroupMask, 2);
+    buffer.insert(buffer.end(), second.begin(), second.end());
+
+    std::vector<uint32_t> offsets;
+    REQUIRE(X740::index_events(buffer.data(), buffer.size(), offsets)
+            == CAEN_DGTZ_Success);
+    REQUIRE(offsets.size() == 2);
+    CHECK(offsets[1] == second.size());
+
+    // Some channels of the enabled groups are not saved
+    std::vector<std::size_t> en_chs;
+    for (std::size_t ch = 0; ch < 64; ch++) {
+        if (((kGroupMask >> (ch / 8)) & 0x1) and ch % 3 != 0) {
+            en_chs.push_back(ch);
+        }
+    }
+
+    for (auto level : {X740::SIMDLevel::Scalar, X740::SIMDLevel::SSE41,
+                       X740::SIMDLevel::AVX2}) {
+        if (level > X740::best_simd_level()) {
+            continue;
+        }
+
+        std::vector<uint16_t> out(en_chs.size()*kRL);
+        CAEN_DGTZ_EventInfo_t info;
+        REQUIRE(X740::decode_event(buffer.data() + offsets[1],
+                                   buffer.size() - offsets[1],
+                                   en_chs, kRL, out, info, level)
+                == CAEN_DGTZ_Success);
+        CHECK(info.EventCounter == 2);
+        CHECK(info.TriggerTimeTag == 20);
+        CHECK(info.Pattern == 0xAB);
+        CHECK(info.ChannelMask == kGroupMask);
+        CHECK(info.EventSize == second.size());
+
+        for (std::size_t row = 0; row < en_chs.size(); row++) {
+            CHECK(std::equal(out.begin() + row*kRL, out.begin() + (row + 1)*kRL,
+                             samples.begin() + en_chs[row]*kRL));
+        }
+    }
+
+    // Truncated and corrupted events
+    CAEN_DGTZ_EventInfo_t info;
+    std::vector<uint16_t> out(en_chs.size()*kRL);
+    CHECK(X740::decode_event(buffer.data(), 40, en_chs, kRL, out, info)
+          == CAEN_DGTZ_InvalidEvent);
+    buffer[3] = 0;
+    CHECK(X740::index_events(buffer.data(), buffer.size(), offsets)
+          == CAEN_DGTZ_InvalidEvent);
+}
+
+TEST_CASE("CAEN_X740_NATIVE_DECODE_SHORT_EVENT") {
+    constexpr uint32_t kRL = 48;
+    std::vector<uint16_t> samples(64*kRL);
+    std::iota(samples.begin(), samples.end(), 0);
+    std::transform(samples.begin(), samples.end(), samples.begin(),
+                   [](uint16_t x) { return x & 0x0FFF; });
+
+    // The slot of a batch that is reused holds the previous readout
+    auto waveforms = make_waveforms(1, kRL);
+    auto slot = waveforms[0];
+    const auto full = pack_x740_event(samples, kRL, 0xFF, 1);
+    CAEN_DGTZ_EventInfo_t info;
+    REQUIRE(X740::decode_event(full.data(), full.size(),
+                               slot.getEnabledChannels(), kRL, slot.getData(),
+                               info) == CAEN_DGTZ_Success);
+
+    // Groups shorter than the record length cannot be decoded into it
+    const auto half = pack_x740_event(samples, kRL / 2, 0xFF, 2);
+    CHECK(X740::decode_event(half.data(), half.size(),
+                             slot.getEnabledChannels(), kRL, slot.getData(),
+                             info) == CAEN_DGTZ_InvalidEvent);
+    CHECK(info.EventCounter == 2);
+}
+
+TEST_CASE("CAEN_X740_NATIVE_DECODE_THROUGHPUT") {
+    using clock = std::chrono::steady_clock;
+    constexpr std::size_t kEvents = 512;
+    constexpr uint32_t kRL = 1000;
+
+    std::vector<uint16_t> samples(64*kRL);
+    std::iota(samples.begin(), samples.end(), 0);
+    std::transform(samples.begin(), samples.end(), samples.begin(),
+                   [](uint16_t x) { return x & 0x0FFF; });
+
+    const auto event = pack_x740_event(samples, kRL, 0xFF, 0);
+    std::vector<char> buffer;
+    for (std::size_t i = 0; i < kEvents; i++) {
+        buffer.insert(buffer.end(), event.begin(), event.end());
+    }
+
+    std::vector<std::size_t> en_chs(64);
+    std::iota(en_chs.begin(), en_chs.end(), 0);
+    std::vector<uint16_t> out(en_chs.size()*kRL);
+
+    for (auto level : {X740::SIMDLevel::Scalar, X740::SIMDLevel::SSE41,
+                       X740::SIMDLevel::AVX2}) {
+        if (level > X740::best_simd_level()) {
+            continue;
+        }
+
+        std::vector<uint32_t> offsets;
+        CAEN_DGTZ_EventInfo_t info;
+        auto start = clock::now();
+        X740::index_events(buffer.data(), buffer.size(), offsets);
+        for (const auto& offset : offsets) {
+            X740::decode_event(buffer.data() + offset, buffer.size() - offset,
+                               en_chs, kRL, out, info, level);
+        }
+        std::chrono::duration<double> dt = clock::now() - start;
+
+        MESSAGE(fmt::format("x740 native decode level = {} | {:9.0f} evt/s "
+                            "{:8.1f} MB/s of raw data",
+                            static_cast<int>(level), kEvents / dt.count(),
+                            buffer.size() / dt.count() / 1e6));
+    }
+}
+
+TEST_CASE("CAEN_X730_NATIVE_DECODE") {
+    constexpr uint32_t kRL = 40;
+    constexpr uint32_t kChannelMask = 0b01011010;
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<uint16_t> distribution(0, 0x3FFF);
+    std::vector<uint16_t> samples(8*kRL);
+    std::generate(samples.begin(), samples.end(),
+                  [&]() { return distribution(gen); });
+
+    const auto buffer = pack_x730_event(samples, kRL, kChannelMask, 3);
+    // Channel 3 is in the event but not saved, 0 is not in the event
+    const std::vector<std::size_t> en_chs = {1, 4, 6};
+    std::vector<uint16_t> out(en_chs.size()*kRL);
+    CAEN_DGTZ_EventInfo_t info;
+    REQUIRE(X730::decode_event(buffer.data(), buffer.size(), en_chs, kRL, out,
+                               info) == CAEN_DGTZ_Success);
+    CHECK(info.EventCounter == 3);
+    CHECK(info.TriggerTimeTag == 30);
+    CHECK(info.ChannelMask == kChannelMask);
+    for (std::size_t row = 0; row < en_chs.size(); row++) {
+        CHECK(std::equal(out.begin() + row*kRL, out.begin() + (row + 1)*kRL,
+                         samples.begin() + en_chs[row]*kRL));
+    }
+
+    // Wrong record length: the event is bad and nothing is written
+    std::fill(out.begin(), out.end(), 0);
+    CHECK(X730::decode_event(buffer.data(), buffer.size(), en_chs, 2*kRL, out,
+                             info) == CAEN_DGTZ_InvalidEvent);
+    CHECK(std::all_of(out.begin(), out.end(), [](uint16_t x) { return x == 0; }));
+    CHECK(X730::decode_event(buffer.data(), 40, en_chs, kRL, out, info)
+          == CAEN_DGTZ_InvalidEvent);
+}
+
+TEST_CASE("SBC_RAW_DUMP_ROUND_TRIP") {
+    using clock = std::chrono::steady_clock;
+    const auto dump_file = std::filesystem::temp_directory_path()
+        / "sbc_raw_dump_test.raw";
+    const auto out_file = std::filesystem::temp_directory_path()
+        / "sbc_raw_dump_test.bin";
+    std::filesystem::remove(dump_file);
+    std::filesystem::remove(out_file);
+
+    constexpr uint32_t kRL = 64;
+    constexpr std::size_t kBlocks = 6;
+    constexpr uint32_t kGroupMask = 0b00000101;
+    BinaryFormat::RawDumpConfig config{CAENDigitizerModel::V1740D,
+                                       CAENDigitizerFamilies::x740,
+                                       CAENGlobalConfig{}, {}};
+    config.GlobalConfig.RecordLength = kRL;
+    config.GlobalConfig.DecimationFactor = 3;
+    config.GroupConfigs[0].Enabled = true;
+    config.GroupConfigs[0].AcquisitionMask.CH.fill(true);
+    config.GroupConfigs[2].Enabled = true;
+    config.GroupConfigs[2].AcquisitionMask.CH[5] = true;
+    config.GroupConfigs[2].TriggerMask.CH[5] = true;
+    config.GroupConfigs[2].DCCorrections[7] = 200;
+
+    // Event e of the dump has samples s + e
+    std::vector<uint16_t> samples(64*kRL);
+    for (std::size_t i = 0; i < samples.size(); i++) {
+        samples[i] = static_cast<uint16_t>((i*37) & 0x0FFF);
+    }
+    auto event_samples = [&](const uint32_t& e) {
+        auto out = samples;
+        for (auto& x : out) {
+            x = static_cast<uint16_t>((x + e) & 0x0FFF);
+        }
+        return out;
+    };
+
+    CAEN_DGTZ_BoardInfo_t board_info{};
+    std::strcpy(board_info.ModelName, "V1740D");
+    board_info.SerialNumber = 1234;
+
+    uint32_t num_events = 0;
+    uint32_t config_hash = 0;
+    {
+        BinaryFormat::RawDumpWriter writer(dump_file.string(), config, 2);
+        config_hash = writer.getConfigHash();
+        CHECK(config_hash == BinaryFormat::RawDump::config_hash(config));
+        for (std::size_t b = 0; b < kBlocks; b++) {
+            std::vector<char> block;
+            for (std::size_t i = 0; i < b + 1; i++, num_events++) {
+                const auto event = pack_x740_event(event_samples(num_events),
+                                                   kRL, kGroupMask, num_events);
+                block.insert(block.end(), event.begin(), event.end());
+            }
+            writer.save_block(block, static_cast<uint32_t>(b + 1), board_info);
+        }
+    }
+    CHECK_FALSE(std::filesystem::is_empty(dump_file));
+
+    {
+        const BinaryFormat::RawDumpReader dump(dump_file.string());
+        CHECK_FALSE(dump.truncated());
+        REQUIRE(dump.configs().size() == 1);
+        const auto& loaded = dump.configs().front();
+        CHECK(BinaryFormat::RawDump::config_hash(loaded) == config_hash);
+        CHECK(loaded.GlobalConfig.DecimationFactor == 3);
+        CHECK(loaded.GroupConfigs[2].TriggerMask.CH[5]);
+        CHECK(loaded.GroupConfigs[2].DCCorrections[7] == 200);
+        REQUIRE(dump.blocks().size() == kBlocks);
+        CHECK(dump.blocks()[2].Header.NumEvents == 3);
+        CHECK(dump.blocks()[2].Header.BoardSerial == 1234);
+        CHECK(std::string(dump.blocks()[2].Header.BoardModel.data()) == "V1740D");
+        CHECK(dump.blocks()[2].Header.HostTime
+              >= dump.blocks()[1].Header.HostTime);
+    }
+
+    BinaryFormat::RawDecodeOptions options;
+    options.NumThreads = 2;
+    auto start = clock::now();
+    const auto report = BinaryFormat::decode_raw_dump(dump_file.string(),
+                                                      out_file.string(),
+                                                      options);
+    std::chrono::duration<double> dt = clock::now() - start;
+    CHECK(report.NumBlocks == kBlocks);
+    CHECK(report.NumEvents == num_events);
+    CHECK(report.CorruptedBlocks == 0);
+    MESSAGE(fmt::format("Raw dump decode: {:9.0f} evt/s",
+                        num_events / dt.count()));
+
+    {
+        const BinaryFormat::Reader<> reader(out_file.string());
+        REQUIRE(reader.size() == num_events);
+        // Group 0 and channel 5 of group 2
+        const std::vector<std::size_t> en_chs = {0, 1, 2, 3, 4, 5, 6, 7, 21};
+        const auto traces = reader.column_index("sipm_traces");
+        const auto time_stamp = reader.column_index("time_stamp");
+        std::vector<uint16_t> out(en_chs.size()*kRL);
+        for (uint32_t e = 0; e < num_events; e++) {
+            uint32_t ttt = 0;
+            std::memcpy(&ttt, reader.get_raw(e, time_stamp).data(), sizeof(ttt));
+            CHECK(ttt == 10*e);
+
+            reader.unpack(e, traces, out);
+            const auto expected = event_samples(e);
+            for (std::size_t row = 0; row < en_chs.size(); row++) {
+                CHECK(std::equal(out.begin() + row*kRL,
+                                 out.begin() + (row + 1)*kRL,
+                                 expected.begin() + en_chs[row]*kRL));
+            }
+        }
+    }
+
+    // A crash in the middle of the last block loses only that block, and a
+    // corrupted block is skipped
+    std::filesystem::resize_file(dump_file,
+                                 std::filesystem::file_size(dump_file) - 10);
+    {
+        using namespace BinaryFormat::RawDump;
+        const auto event_size = pack_x740_event(samples, kRL, kGroupMask, 0)
+            .size();
+        const auto block_1 = BinaryFormat::kRawDumpMagic.size()
+            + kRecordHeaderSize + sizeof(uint32_t) + serialize(config).size()
+            + kRecordHeaderSize + kBlockHeaderSize + event_size
+            + kRecordHeaderSize + kBlockHeaderSize;
+        std::fstream file(dump_file, std::ios::in | std::ios::out
+                                     | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(block_1 + 3));
+        file.put(0);
+    }
+
+    CHECK_THROWS_AS(BinaryFormat::decode_raw_dump(dump_file.string(),
+                                                  out_file.string()),
+                    std::runtime_error);
+    std::filesystem::remove(out_file);
+    const auto cut_report = BinaryFormat::decode_raw_dump(dump_file.string(),
+                                                          out_file.string());
+    CHECK(cut_report.Truncated);
+    CHECK(cut_report.NumBlocks == kBlocks - 1);
+    CHECK(cut_report.CorruptedBlocks == 1);
+    CHECK(cut_report.NumEvents == num_events - kBlocks - 2);
+    CHECK(BinaryFormat::Reader<>(out_file.string()).size()
+          == cut_report.NumEvents);
+
+    // Resuming the dump drops the incomplete block and saves the config
+    // again, which is not repeated when read
+    {
+        BinaryFormat::RawDumpWriter writer(dump_file.string(), config, 2);
+        const auto event = pack_x740_event(samples, kRL, kGroupMask, 0);
+        writer.save_block(event, 1, board_info);
+    }
+    {
+        const BinaryFormat::RawDumpReader dump(dump_file.string());
+        CHECK_FALSE(dump.truncated());
+        CHECK(dump.size() == std::filesystem::file_size(dump_file));
+        CHECK(dump.configs().size() == 1);
+        REQUIRE(dump.blocks().size() == kBlocks);
+        CHECK(dump.blocks().back().Header.NumEvents == 1);
+    }
+
+    std::filesystem::remove(dump_file);
+    std::filesystem::remove(out_file);
+}
+
+TEST_CASE("SBC_RAW_DUMP_REPLAY") {
+    using clock = std::chrono::steady_clock;
+    const auto dump_file = std::filesystem::temp_directory_path()
+        / "sbc_raw_dump_replay_test.raw";
+    const auto out_file = std::filesystem::temp_directory_path()
+        / "sbc_raw_dump_replay_test.bin";
+    std::filesystem::remove(dump_file);
+    std::filesystem::remove(out_file);
+
+    constexpr uint32_t kRL = 256;
+    constexpr std::size_t kBlocks = 8;
+    constexpr uint32_t kEventsPerBlock = 256;
+    constexpr uint32_t kGroupMask = 0b00001111;
+    // Time between the readouts of the recorded blocks
+    constexpr auto kPeriod = std::chrono::milliseconds(20);
+    BinaryFormat::RawDumpConfig config{CAENDigitizerModel::V1740D,
+                                       CAENDigitizerFamilies::x740,
+                                       CAENGlobalConfig{}, {}};
+    config.GlobalConfig.RecordLength = kRL;
+    for (std::size_t gr = 0; gr < 4; gr++) {
+        config.GroupConfigs[gr].Enabled = true;
+        config.GroupConfigs[gr].AcquisitionMask.CH.fill(true);
+    }
+
+    std::vector<uint16_t> samples(64*kRL);
+    for (std::size_t i = 0; i < samples.size(); i++) {
+        samples[i] = static_cast<uint16_t>((i*37) & 0x0FFF);
+    }
+
+    CAEN_DGTZ_BoardInfo_t board_info{};
+    std::strcpy(board_info.ModelName, "V1740D");
+    {
+        BinaryFormat::RawDumpWriter writer(dump_file.string(), config, 2);
+        std::vector<char> block;
+        for (uint32_t i = 0; i < kEventsPerBlock; i++) {
+            const auto event = pack_x740_event(samples, kRL, kGroupMask, i);
+            block.insert(block.end(), event.begin(), event.end());
+        }
+
+        for (std::size_t b = 0; b < kBlocks; b++) {
+            writer.save_block(block, kEventsPerBlock, board_info);
+            std::this_thread::sleep_for(kPeriod);
+        }
+    }
+
+    // At the original cadence it takes as long as the recording
+    {
+        BinaryFormat::RawReplayOptions options;
+        options.Speed = 1.0;
+        BinaryFormat::RawDumpReplay replay(dump_file.string(), options);
+        const auto start = clock::now();
+        while (not replay.done()) {
+            replay.retrieve_block(std::chrono::milliseconds(10));
+        }
+        std::chrono::duration<double> dt = clock::now() - start;
+        CHECK(replay.statistics().Blocks == kBlocks);
+        CHECK(dt.count() >= 0.9*(kBlocks - 1)*kPeriod.count()*1e-3);
+        MESSAGE(fmt::format("Replay at the original cadence: {:.3f} s, "
+                            "recorded {:.3f} s", dt.count(),
+                            (kBlocks - 1)*kPeriod.count()*1e-3));
+    }
+
+    // As fast as possible, through the decoding and the writer, like
+    // SiPMAcquisitionManager does
+    constexpr uint32_t kLoops = 4;
+    BinaryFormat::RawReplayOptions options;
+    options.Loops = kLoops;
+    options.NumThreads = 2;
+    BinaryFormat::RawDumpReplay replay(dump_file.string(), options);
+    REQUIRE(replay.waveforms().capacity() == kEventsPerBlock);
+    const auto start = clock::now();
+    {
+        const auto& replay_config = replay.config();
+        BinaryFormat::SiPMAsyncWriter writer(out_file.string(),
+            replay_config.Family, replay.modelConstants(),
+            replay_config.GlobalConfig, replay_config.GroupConfigs,
+            replay.waveforms().capacity());
+        while (not replay.done()) {
+            REQUIRE(replay.retrieve_block(std::chrono::milliseconds(10)));
+            REQUIRE(replay.decode());
+            const auto waveform = replay.waveform(3);
+            CHECK(waveform.getInfo().EventCounter == 3);
+            CHECK(std::equal(waveform.getData().begin(),
+                             waveform.getData().end(), samples.begin()));
+
+            auto batch = writer.acquire_batch();
+            REQUIRE(replay.swap_waveforms(batch->Waveforms));
+            writer.submit(std::move(batch));
+        }
+    }
+    std::chrono::duration<double> dt = clock::now() - start;
+
+    const auto& stats = replay.statistics();
+    CHECK(stats.Blocks == kLoops*kBlocks);
+    CHECK(stats.Events == kLoops*kBlocks*kEventsPerBlock);
+    CHECK(stats.CorruptedBlocks == 0);
+    CHECK(stats.Lag == 0.0);
+    CHECK(BinaryFormat::Reader<>(out_file.string()).size() == stats.Events);
+    MESSAGE(fmt::format("Replay -> decode -> writer: {:9.0f} evt/s, "
+                        "{:6.1f} MB/s", stats.Events / dt.count(),
+                        stats.Bytes / dt.count() / 1e6));
+
+    std::filesystem::remove(dump_file);
+    std::filesystem::remove(out_file);
+}
@@ -0,0 +1,521 @@
+// Only built with -DCAEN_EMULATOR=ON, the digitizer is the emulator
+#ifdef SBCQUEENS_CAEN_EMULATOR
+
+// C STD includes
+// C 3rd party includes
+// C++ STD include
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// C++ 3rd party includes
+#include <doctest/doctest.h>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+
+// my includes
+#include "caen_emulator.hpp"
+#include "sbcqueens-gui/caen_helper.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+#include "sbcqueens-gui/sipm_helpers/SiPMAsyncWriter.hpp"
+#include "sbcqueens-gui/sipm_helpers/SiPMEventBuilder.hpp"
+
+namespace {
+
+using namespace SBCQueens;
+using clock_type = std::chrono::steady_clock;
+using EmulatedCAEN = CAEN<std::shared_ptr<spdlog::logger>>;
+
+constexpr uint32_t kRL = 256;
+
+// Groups 0 and 1 of a V1740D, every channel triggering
+std::array<CAENGroupConfig, 8> make_group_configs() {
+    std::array<CAENGroupConfig, 8> group_configs;
+    for (std::size_t i = 0; i < 2; i++) {
+        group_configs[i].Enabled = true;
+        group_configs[i].TriggerMask.CH.fill(true);
+        group_configs[i].AcquisitionMask.CH.fill(true);
+    }
+    return group_configs;
+}
+
+CAENGlobalConfig make_global_config() {
+    CAENGlobalConfig global_config;
+    global_config.RecordLength = kRL;
+    global_config.MaxEventsPerRead = 512;
+    global_config.PostTriggerPorcentage = 50;
+    return global_config;
+}
+
+// Reads every board into builder from its own thread, the same as
+// SiPMAcquisitionManager::read_board and stop_board_threads
+class BoardReaders {
+    std::vector<std::thread> _threads;
+    std::atomic<bool> _stop = false;
+    std::atomic<std::size_t> _finished = 0;
+
+ public:
+    // Waveforms and readouts every board decoded
+    std::vector<std::atomic<uint64_t>> Decoded;
+    std::vector<std::atomic<uint32_t>> Readouts;
+
+    BoardReaders(std::vector<std::unique_ptr<EmulatedCAEN>>& boards,
+                 SiPMEventBuilder& builder) :
+        Decoded(boards.size()), Readouts(boards.size()) {
+        for (std::size_t b = 0; b < boards.size(); b++) {
+            _threads.emplace_back([this, &caen = *boards[b], &builder, b]() {
+                while (not _stop) {
+                    if (not caen.RetrieveReadoutBlock(
+                            std::chrono::milliseconds(10))) {
+                        continue;
+                    }
+
+                    caen.DecodeEvents();
+                    Decoded[b] += caen.GetNumberOfEvents();
+                    Readouts[b]++;
+                    // Even if stopped, the readout is not dropped
+                    BoardBatch_ptr batch;
+                    while (not builder.acquire_batch(b, batch,
+                            std::chrono::milliseconds(10))) { }
+
+                    CHECK(caen.SwapWaveforms(batch->Waveforms));
+                    builder.submit(b, std::move(batch));
+                }
+
+                _finished++;
+            });
+        }
+    }
+
+    // Calls merge(false) until every thread finished, a thread can be
+    // waiting for the merge to free one of its batches, and then
+    // merge(true) for what is left.
+    template<typename Merge>
+    void stop(Merge&& merge) {
+        _stop = true;
+        while (_finished < _threads.size()) {
+            merge(false);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        for (auto& thread : _threads) {
+            thread.join();
+        }
+        _threads.clear();
+        merge(true);
+    }
+
+    ~BoardReaders() {
+        _stop = true;
+        for (auto& thread : _threads) {
+            thread.join();
+        }
+    }
+};
+
+// n V1740D of the same chain, acquiring. They keep a reference to logger.
+std::vector<std::unique_ptr<EmulatedCAEN>> make_chain(
+        std::shared_ptr<spdlog::logger>& logger, const std::size_t& n,
+        const double& rate) {
+    std::vector<std::unique_ptr<EmulatedCAEN>> boards;
+    for (std::size_t b = 0; b < n; b++) {
+        CAENEmulator::Config config;
+        config.Model = "V1740D";
+        config.TriggerRate = rate;
+        config.Seed = 20 + static_cast<uint32_t>(b);
+        CAENEmulator::set_config(config, 0, static_cast<int>(b));
+
+        boards.push_back(std::make_unique<EmulatedCAEN>(logger,
+            CAENDigitizerModel::V1740D, CAENConnectionType::A4818, 0,
+            static_cast<int>(b), 0));
+        REQUIRE(boards.back()->IsConnected());
+        boards.back()->Setup(make_global_config(), make_group_configs());
+        boards.back()->SetNativeDecode(true);
+        boards.back()->EnableAcquisition();
+    }
+
+    return boards;
+}
+
+}  // namespace
+
+TEST_CASE("CAEN_EMULATOR_PIPELINE_THROUGHPUT") {
+    CAENEmulator::Config config;
+    config.Model = "V1740D";
+    config.TriggerRate = 20e3;
+    config.Seed = 42;
+    CAENEmulator::set_config(config);
+
+    auto logger = spdlog::default_logger();
+    EmulatedCAEN caen(logger, CAENDigitizerModel::V1740D,
+                      CAENConnectionType::USB, 0, 0, 0);
+    REQUIRE(caen.IsConnected());
+
+    caen.Setup(make_global_config(), make_group_configs());
+    caen.EnableAcquisition();
+    REQUIRE_FALSE(caen.HasError());
+
+    CAENReadoutConfig readout_config;
+    readout_config.NativeDecode = true;
+    readout_config.DecodeThreads = 2;
+    caen.StartReadoutRing(readout_config);
+    REQUIRE(caen.IsReadoutRingRunning());
+
+    const auto out_file = std::filesystem::temp_directory_path()
+        / "sbcqueens_caen_emulator_test.bin";
+    std::size_t events_written = 0;
+    std::chrono::duration<double> dt{};
+    {
+        BinaryFormat::SiPMAsyncWriter writer(out_file.string(), caen.Family,
+            caen.ModelConstants, caen.GetGlobalConfiguration(),
+            caen.GetGroupConfigurations(), caen.GetWaveforms().capacity());
+        REQUIRE(writer.isOpen());
+
+        const auto start = clock_type::now();
+        while (clock_type::now() - start < std::chrono::seconds(1)) {
+            if (not caen.RetrieveReadoutBlock(std::chrono::milliseconds(10))) {
+                continue;
+            }
+
+            caen.DecodeEvents();
+            auto batch = writer.acquire_batch();
+            REQUIRE(caen.SwapWaveforms(batch->Waveforms));
+            events_written += batch->Waveforms.size();
+            writer.submit(std::move(batch));
+        }
+        dt = clock_type::now() - start;
+        caen.DisableAcquisition();
+    }
+
+    const auto stats = CAENEmulator::get_statistics();
+    MESSAGE(fmt::format("Emulator -> writer: {:9.0f} evt/s, {} dropped, "
+                        "generator lag {:.3f} s",
+                        events_written / dt.count(), stats.EventsDropped,
+                        stats.GeneratorLag));
+    CHECK(events_written > 0);
+    // Blocks still in the readout ring when it stopped are not written
+    CHECK(events_written <= stats.EventsRead);
+    CHECK(stats.EventsStored >= stats.EventsRead);
+    CHECK(stats.Triggers == stats.EventsStored + stats.EventsDropped);
+
+    {
+        const BinaryFormat::Reader<> reader(out_file.string());
+        CHECK(reader.size() == events_written);
+    }
+    std::filesystem::remove(out_file);
+}
+
+TEST_CASE("CAEN_EMULATOR_NATIVE_DECODE") {
+    CAENEmulator::Config config;
+    config.Model = "V1740D";
+    config.TriggerRate = 5e3;
+    config.Seed = 7;
+    CAENEmulator::set_config(config);
+
+    auto logger = spdlog::default_logger();
+    EmulatedCAEN caen(logger, CAENDigitizerModel::V1740D,
+                      CAENConnectionType::USB, 0, 0, 0);
+    caen.Setup(make_global_config(), make_group_configs());
+    caen.EnableAcquisition();
+    REQUIRE(caen.WaitForEvents(64, std::chrono::milliseconds(1000)));
+
+    caen.RetrieveData();
+    REQUIRE(caen.GetNumberOfEvents() > 0);
+    // CAEN_DGTZ_DecodeEvent of the emulator and the in-house decoder agree
+    CHECK(caen.VerifyNativeDecode() == 0);
+}
+
+TEST_CASE("CAEN_EMULATOR_LOST_TRIGGERS") {
+    // The event counter counts every trigger (CAEN::Setup) so the triggers
+    // lost while the memory was full are the gaps between events
+    CAENEmulator::Config config;
+    config.Model = "V1740D";
+    config.TriggerRate = 50e3;
+    config.Seed = 11;
+    CAENEmulator::set_config(config);
+
+    auto logger = spdlog::default_logger();
+    EmulatedCAEN caen(logger, CAENDigitizerModel::V1740D,
+                      CAENConnectionType::USB, 0, 0, 0);
+    caen.Setup(make_global_config(), make_group_configs());
+    caen.SetNativeDecode(true);
+    caen.EnableAcquisition();
+    REQUIRE_FALSE(caen.HasError());
+
+    uint64_t events = 0;
+    uint64_t triggers = 0;
+    uint32_t last_counter = 0;
+    auto read_all = [&]() {
+        while (true) {
+            caen.RetrieveData();
+            if (caen.GetNumberOfEvents() == 0) {
+                return;
+            }
+
+            caen.DecodeEvents();
+            for (const auto& info : caen.GetWaveforms().getInfos()) {
+                const uint32_t counter = info.EventCounter & 0x00FFFFFF;
+                triggers += events == 0 ? counter + 1
+                    : (counter - last_counter) & 0x00FFFFFF;
+                last_counter = counter;
+                events++;
+            }
+        }
+    };
+
+    // Fills the memory twice, reading it in between
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    read_all();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    read_all();
+    caen.DisableAcquisition();
+
+    const auto stats = CAENEmulator::get_statistics();
+    MESSAGE(fmt::format("{} events of {} triggers, livetime {:.1f}%",
+                        events, triggers, 100.0*events / triggers));
+    CHECK(events <= stats.EventsStored);
+    // Triggers lost after the last event do not show up in the counter
+    CHECK(triggers > events);
+    CHECK(triggers <= stats.Triggers);
+    CHECK(triggers - events <= stats.EventsDropped);
+}
+
+TEST_CASE("CAEN_EMULATOR_RECONFIGURE") {
+    CAENEmulator::Config config;
+    config.Model = "V1740D";
+    config.TriggerRate = 1e3;
+    config.Seed = 5;
+    CAENEmulator::set_config(config);
+
+    auto logger = spdlog::default_logger();
+    EmulatedCAEN caen(logger, CAENDigitizerModel::V1740D,
+                      CAENConnectionType::USB, 0, 0, 0);
+    auto global_config = make_global_config();
+    auto group_configs = make_group_configs();
+    caen.Setup(global_config, group_configs);
+    caen.EnableAcquisition();
+    REQUIRE_FALSE(caen.HasError());
+    const auto* memory = caen.GetWaveforms().getData().data();
+
+    // A threshold scan: every step only writes the thresholds
+    constexpr int kSteps = 50;
+    const auto start = clock_type::now();
+    for (int step = 0; step < kSteps; step++) {
+        group_configs[0].TriggerThreshold = 1800 + step;
+        group_configs[1].TriggerThreshold = 1800 + step;
+        const auto diff = caen.Reconfigure(global_config, group_configs);
+        REQUIRE(diff.size() == 2);
+        REQUIRE_FALSE(diff.NeedsReset);
+    }
+    const std::chrono::duration<double, std::milli> diff_dt
+        = (clock_type::now() - start) / kSteps;
+    CHECK(caen.IsAcquiring());
+    CHECK(caen.GetGroupConfigurations()[1].TriggerThreshold == 1800 + kSteps - 1);
+    // The memory was kept
+    caen.RetrieveData();
+    caen.DecodeEvents();
+    CHECK(caen.GetWaveforms().getData().data() == memory);
+
+    // Same scan step through the whole setup
+    const auto setup_start = clock_type::now();
+    for (int step = 0; step < kSteps; step++) {
+        group_configs[0].TriggerThreshold = 1900 + step;
+        caen.Setup(global_config, group_configs);
+        caen.EnableAcquisition();
+    }
+    const std::chrono::duration<double, std::milli> setup_dt
+        = (clock_type::now() - setup_start) / kSteps;
+    MESSAGE(fmt::format("Threshold step: {:.3f} ms reconfiguring, {:.3f} ms "
+                        "with the whole setup", diff_dt.count(),
+                        setup_dt.count()));
+
+    // A new record length needs the memory again
+    global_config.RecordLength = 2*kRL;
+    const auto diff = caen.Reconfigure(global_config, group_configs);
+    CHECK(diff.NeedsReset);
+    CHECK(caen.IsAcquiring());
+    CHECK(caen.GetWaveforms().getRecordLength() == 2*kRL);
+}
+
+TEST_CASE("CAEN_EMULATOR_EVENT_BUILDER") {
+    // Two boards of the same chain, each read by its own thread
+    constexpr std::size_t kBoards = 2;
+    auto logger = spdlog::default_logger();
+    auto boards = make_chain(logger, kBoards, 10e3);
+
+    // The waveforms are allocated once acquiring
+    auto& first = *boards.front();
+    SiPMEventBuilder builder(kBoards, first.ModelConstants,
+        first.GetGlobalConfiguration(), first.GetGroupConfigurations(),
+        first.GetWaveforms().capacity());
+
+    CAENReadoutConfig readout_config;
+    readout_config.MaxLatency = 20;
+    for (auto& board : boards) {
+        board->StartReadoutRing(readout_config);
+        REQUIRE(board->IsReadoutRingRunning());
+    }
+
+    auto out = CAENWaveformBatch<uint16_t>(first.ModelConstants,
+        first.GetGlobalConfiguration(), first.GetGroupConfigurations(),
+        first.GetWaveforms().capacity());
+    std::size_t merged = 0;
+    uint64_t max_backlog = 0;
+    uint32_t last_time = 0;
+    bool in_order = true;
+    auto check_merged = [&](const bool& flush) {
+        while (true) {
+            out.resize(0);
+            if (builder.merge(out, flush) == 0) {
+                return;
+            }
+
+            for (const auto& info : out.getInfos()) {
+                in_order &= info.TriggerTimeTag >= last_time;
+                last_time = info.TriggerTimeTag;
+            }
+            merged += out.size();
+        }
+    };
+
+    BoardReaders readers(boards, builder);
+    const auto start = clock_type::now();
+    while (clock_type::now() - start < std::chrono::milliseconds(500)) {
+        check_merged(false);
+        max_backlog = std::max(max_backlog, builder.getStatistics().Backlog);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    readers.stop(check_merged);
+
+    const auto stats = builder.getStatistics();
+    MESSAGE(fmt::format("Merged {} waveforms of {} + {}, largest backlog {}",
+                        merged, stats.BoardEvents[0], stats.BoardEvents[1],
+                        max_backlog));
+    CHECK(stats.BoardEvents[0] > 0);
+    CHECK(stats.BoardEvents[1] > 0);
+    CHECK(merged == stats.BoardEvents[0] + stats.BoardEvents[1]);
+    CHECK(stats.Backlog == 0);
+    CHECK(stats.LateEvents == 0);
+    // Less than 17 s, so no roll over
+    CHECK(in_order);
+}
+
+TEST_CASE("CAEN_EMULATOR_EVENT_BUILDER_STOP") {
+    // A single batch per board that nothing merges: every thread ends up
+    // holding a decoded readout while waiting for a batch
+    constexpr std::size_t kBoards = 2;
+    auto logger = spdlog::default_logger();
+    auto boards = make_chain(logger, kBoards, 10e3);
+    auto& first = *boards.front();
+    EventBuilderOptions options;
+    options.NumBatches = 1;
+    SiPMEventBuilder builder(kBoards, first.ModelConstants,
+        first.GetGlobalConfiguration(), first.GetGroupConfigurations(),
+        first.GetWaveforms().capacity(), options);
+
+    CAENReadoutConfig readout_config;
+    readout_config.MaxLatency = 20;
+    for (auto& board : boards) {
+        board->StartReadoutRing(readout_config);
+    }
+
+    BoardReaders readers(boards, builder);
+    const auto start = clock_type::now();
+    auto all_waiting = [&]() {
+        return std::all_of(readers.Readouts.begin(), readers.Readouts.end(),
+            [](const auto& readouts) { return readouts >= 2; });
+    };
+    while (not all_waiting()
+            and clock_type::now() - start < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // Not REQUIRE: the threads only return once stop merges
+    CHECK(all_waiting());
+
+    auto out = CAENWaveformBatch<uint16_t>(first.ModelConstants,
+        first.GetGlobalConfiguration(), first.GetGroupConfigurations(),
+        first.GetWaveforms().capacity());
+    uint64_t merged = 0;
+    readers.stop([&](const bool& flush) {
+        while (true) {
+            out.resize(0);
+            const auto n = builder.merge(out, flush);
+            if (n == 0) {
+                return;
+            }
+            merged += n;
+        }
+    });
+
+    // The readouts that waited for a batch were merged too
+    const auto stats = builder.getStatistics();
+    for (std::size_t b = 0; b < kBoards; b++) {
+        CHECK(stats.BoardEvents[b] == readers.Decoded[b]);
+    }
+    CHECK(merged == stats.BoardEvents[0] + stats.BoardEvents[1]);
+    CHECK(stats.Backlog == 0);
+}
+
+TEST_CASE("CAEN_EMULATOR_SIPM_PULSES") {
+    // Without noise, dark counts or gain spread, every event holds a whole
+    // number of photoelectrons at the trigger position
+    constexpr double kGain = 50.0;
+    CAENEmulator::Config config;
+    config.Model = "V1740D";
+    config.TriggerRate = 2e3;
+    config.Seed = 3;
+    config.SiPM.DarkRate = 0.0;
+    config.SiPM.Crosstalk = 0.0;
+    config.SiPM.Afterpulsing = 0.0;
+    config.SiPM.GainSpread = 0.0;
+    config.SiPM.Noise = 0.0;
+    config.SiPM.Gain = kGain;
+    config.SiPM.LightMean = 3.0;
+    CAENEmulator::set_config(config);
+
+    auto logger = spdlog::default_logger();
+    EmulatedCAEN caen(logger, CAENDigitizerModel::V1740D,
+                      CAENConnectionType::USB, 0, 0, 0);
+    caen.Setup(make_global_config(), make_group_configs());
+    caen.SetNativeDecode(true);
+    caen.EnableAcquisition();
+    REQUIRE(caen.WaitForEvents(32, std::chrono::milliseconds(1000)));
+
+    caen.RetrieveData();
+    caen.DecodeEvents();
+    const auto n_events = caen.GetNumberOfEvents();
+    REQUIRE(n_events > 0);
+
+    // DC offset of 0x8000 = half of the 12 bit range
+    const double baseline = std::round(4095.0*0x8000 / 0xFFFF);
+    double total_pe = 0.0;
+    uint32_t checked = 0;
+    for (uint32_t i = 0; i < n_events; i++) {
+        const auto waveform = caen.GetWaveform(i);
+        for (std::size_t ch = 0; ch < waveform.getNumEnabledChannels(); ch++) {
+            const auto samples = waveform.getChannel(ch);
+            const auto lowest = *std::min_element(samples.begin(),
+                                                  samples.end());
+            const double n_pe = (baseline - lowest) / kGain;
+            CHECK(std::abs(n_pe - std::round(n_pe)) < 0.05);
+            CHECK(samples.front() == baseline);
+            total_pe += n_pe;
+            checked++;
+        }
+    }
+
+    const double mean_pe = total_pe / checked;
+    MESSAGE(fmt::format("Emulated light: {:.2f} PE/channel", mean_pe));
+    CHECK(mean_pe > 2.0);
+    CHECK(mean_pe < 4.0);
+}
+
+#endif
@@ -0,0 +1,233 @@
+// C STD includes
+#include <ctime>
+// C 3rd party includes
+// C++ STD include
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// C++ 3rd party includes
+#include <doctest/doctest.h>
+#include <spdlog/fmt/fmt.h>
+
+// my includes
+#include "sbcqueens-gui/caen_helper.hpp"
+
+namespace {
+
+using namespace SBCQueens;
+using clock_type = std::chrono::steady_clock;
+
+// Software stand-in for the digitizer event counter and its interrupt
+// line. Events are added by another thread, like triggers.
+struct SoftwareDigitizer {
+    std::mutex Mutex;
+    std::condition_variable IRQLine;
+    uint32_t Events = 0;
+    uint16_t IRQEvents = 0;
+    bool IRQEnabled = false;
+    clock_type::time_point LastTrigger;
+
+    CAENInterruptAPI api() {
+        CAENInterruptAPI out;
+        out.SetInterruptConfig = [this](int, CAEN_DGTZ_EnaDis_t state, uint8_t,
+                uint32_t, uint16_t n_events, CAEN_DGTZ_IRQMode_t) {
+            std::lock_guard lock(Mutex);
+            IRQEnabled = state == CAEN_DGTZ_ENABLE;
+            IRQEvents = n_events;
+            return CAEN_DGTZ_Success;
+        };
+        out.IRQWait = [this](int, uint32_t timeout) {
+            std::unique_lock lock(Mutex);
+            bool raised = IRQLine.wait_for(lock, std::chrono::milliseconds(timeout),
+                [&]() { return IRQEnabled and Events >= IRQEvents; });
+            return raised ? CAEN_DGTZ_Success : CAEN_DGTZ_Timeout;
+        };
+        return out;
+    }
+
+    CAEN_DGTZ_ErrorCode read_events(uint32_t& events) {
+        std::lock_guard lock(Mutex);
+        events = Events;
+        return CAEN_DGTZ_Success;
+    }
+
+    void trigger() {
+        {
+            std::lock_guard lock(Mutex);
+            Events++;
+            LastTrigger = clock_type::now();
+        }
+        IRQLine.notify_all();
+    }
+
+    // What the readout does
+    void clear() {
+        std::lock_guard lock(Mutex);
+        Events = 0;
+    }
+};
+
+struct WaitBenchmark {
+    double MeanLatency = 0.0;  // ms
+    double CPUTime = 0.0;  // ms
+    CAENEventWaiterStatistics Statistics;
+};
+
+// Triggers an event every period until there have been n_reads readouts
+// of n_events. Measures the time between the last trigger of each readout
+// and the wake up. CPU time is of the whole process, triggers included.
+WaitBenchmark benchmark_waiter(const bool& use_irq, const uint16_t& n_events,
+                               const std::chrono::microseconds& period,
+                               const std::size_t& n_reads) {
+    SoftwareDigitizer digitizer;
+    CAENEventWaiter waiter(std::chrono::microseconds(1000), digitizer.api());
+    if (use_irq) {
+        CHECK(waiter.enableInterrupts(0, n_events) == CAEN_DGTZ_Success);
+    }
+
+    std::atomic<bool> stop = false;
+    std::thread triggers([&]() {
+        while (not stop) {
+            std::this_thread::sleep_for(period);
+            digitizer.trigger();
+        }
+    });
+
+    WaitBenchmark out;
+    const std::clock_t cpu_start = std::clock();
+    std::size_t reads = 0;
+    while (reads < n_reads) {
+        uint32_t events = 0;
+        auto err = waiter.wait(0, n_events, std::chrono::milliseconds(100),
+            [&](uint32_t& e) { return digitizer.read_events(e); }, events);
+        CHECK(err == CAEN_DGTZ_Success);
+        if (events < n_events) {
+            continue;
+        }
+
+        std::chrono::duration<double, std::milli> latency;
+        {
+            std::lock_guard lock(digitizer.Mutex);
+            latency = clock_type::now() - digitizer.LastTrigger;
+        }
+        out.MeanLatency += latency.count() / n_reads;
+        digitizer.clear();
+        reads++;
+    }
+    out.CPUTime = 1000.0*(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+    stop = true;
+    triggers.join();
+    out.Statistics = waiter.getStatistics();
+    return out;
+}
+
+}  // namespace
+
+TEST_CASE("CAEN_EVENT_WAITER_INTERRUPT_WAKE_UP") {
+    SoftwareDigitizer digitizer;
+    CAENEventWaiter waiter(std::chrono::microseconds(1000), digitizer.api());
+    REQUIRE(waiter.enableInterrupts(0, 3) == CAEN_DGTZ_Success);
+    CHECK(waiter.interruptsEnabled());
+
+    std::thread triggers([&]() {
+        for (int i = 0; i < 3; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            digitizer.trigger();
+        }
+    });
+
+    uint32_t events = 0;
+    auto err = waiter.wait(0, 3, std::chrono::seconds(5),
+        [&](uint32_t& e) { return digitizer.read_events(e); }, events);
+    triggers.join();
+
+    CHECK(err == CAEN_DGTZ_Success);
+    CHECK(events >= 3);
+    auto stats = waiter.getStatistics();
+    CHECK(stats.Interrupts == 1);
+    // The register is not read when the interrupt arrives
+    CHECK(stats.RegisterReads == 0);
+}
+
+TEST_CASE("CAEN_EVENT_WAITER_TIMEOUT_FALLS_BACK_TO_REGISTER") {
+    SoftwareDigitizer digitizer;
+    CAENEventWaiter waiter(std::chrono::microseconds(1000), digitizer.api());
+    REQUIRE(waiter.enableInterrupts(0, 10) == CAEN_DGTZ_Success);
+
+    // Not enough events for the interrupt
+    digitizer.trigger();
+    digitizer.trigger();
+
+    uint32_t events = 0;
+    auto err = waiter.wait(0, 10, std::chrono::milliseconds(20),
+        [&](uint32_t& e) { return digitizer.read_events(e); }, events);
+    CHECK(err == CAEN_DGTZ_Success);
+    CHECK(events == 2);
+    auto stats = waiter.getStatistics();
+    CHECK(stats.Interrupts == 0);
+    CHECK(stats.Timeouts == 1);
+    CHECK(stats.RegisterReads == 1);
+
+    CHECK(waiter.disableInterrupts(0) == CAEN_DGTZ_Success);
+    CHECK(not waiter.interruptsEnabled());
+    CHECK(not digitizer.IRQEnabled);
+}
+
+TEST_CASE("CAEN_EVENT_WAITER_IRQ_VS_POLLING") {
+    constexpr std::size_t kReads = 50;
+    for (uint16_t n_events : {1, 16}) {
+        for (bool use_irq : {false, true}) {
+            auto result = benchmark_waiter(use_irq, n_events,
+                                           std::chrono::microseconds(300), kReads);
+            MESSAGE(fmt::format("{:7} | {:3} events per read | latency {:6.3f} ms "
+                                "| CPU {:7.2f} ms | register reads {:6}",
+                                use_irq ? "IRQ" : "polling", n_events,
+                                result.MeanLatency, result.CPUTime,
+                                result.Statistics.RegisterReads));
+        }
+    }
+}
+
+TEST_CASE("CAEN_READOUT_THRESHOLD_FOLLOWS_TRIGGER_RATE") {
+    using namespace std::chrono_literals;
+    const auto start = clock_type::now();
+    auto make_threshold = [&]() {
+        return CAENReadoutThreshold(100ms, 16, 1024, start);
+    };
+    CHECK(make_threshold().get() == 16);
+
+    // Low rates are bounded by the min block size and the latency
+    auto low = make_threshold();
+    low.update(10.0, 1ms, start);
+    CHECK(low.get() == 16);
+    CHECK(not low.isLate(start + 50ms));
+    CHECK(low.isLate(start + 100ms));
+
+    // Medium rates read about every max latency
+    auto medium = make_threshold();
+    medium.update(2000.0, 1ms, start);
+    CHECK(medium.get() == 200);
+
+    // High rates leave room for the events that arrive during the readout:
+    // 10 kHz * 100 ms = 1000 events, but 2 * 10 kHz * 20 ms = 400 arrive
+    // while reading
+    auto high = make_threshold();
+    high.update(10000.0, 20ms, start);
+    CHECK(high.get() == 624);
+    // Readouts longer than the buffer lasts still read something
+    high.update(10000.0, 1s, start);
+    CHECK(high.get() == 1);
+
+    // The rate is smoothed
+    auto jump = make_threshold();
+    jump.update(2000.0, 1ms, start);
+    jump.update(12000.0, 1ms, start);
+    CHECK(std::abs(jump.getRate() - 5000.0) < 1e-6);
+    CHECK(jump.get() == 500);
+}
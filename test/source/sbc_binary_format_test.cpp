@@ -0,0 +1,1585 @@
+// C STD includes
+// C 3rd party includes
+// C++ STD include
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// C++ 3rd party includes
+#include <doctest/doctest.h>
+#include <spdlog/fmt/fmt.h>
+
+// my includes
+#include "sbcqueens-gui/sipm_helpers/BitPacking.hpp"
+#include "sbcqueens-gui/sipm_helpers/Checksum.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCScan.hpp"
+#include "sbcqueens-gui/sipm_helpers/SiPMAsyncWriter.hpp"
+
+namespace {
+
+using namespace SBCQueens::BinaryFormat;
+
+// Same shape as the non-constant part of the SiPM files.
+using BenchWriter = DynamicWriter<uint32_t, uint32_t, uint16_t>;
+
+const std::array<std::string, 3> kBenchNames = {"time_stamp", "trg_source",
+                                                "sipm_traces"};
+const std::array<std::size_t, 3> kBenchRanks = {1, 1, 2};
+
+struct BenchEvents {
+    std::vector<uint32_t> TimeStamps;
+    std::vector<uint32_t> TriggerSources;
+    std::vector<std::vector<uint16_t>> Traces;
+    std::vector<BenchWriter::tuple_type> Tuples;
+
+    BenchEvents(std::size_t n_events, std::size_t n_chs, std::size_t rl) :
+        TimeStamps(n_events), TriggerSources(n_events), Traces(n_events) {
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<uint16_t> distribution(0, 0x0FFF);
+
+        for (std::size_t i = 0; i < n_events; i++) {
+            TimeStamps[i] = static_cast<uint32_t>(i);
+            TriggerSources[i] = 1;
+            Traces[i].resize(n_chs*rl);
+            std::generate(Traces[i].begin(), Traces[i].end(),
+                          [&]() { return distribution(gen); });
+        }
+
+        for (std::size_t i = 0; i < n_events; i++) {
+            Tuples.emplace_back(std::span<uint32_t>(&TimeStamps[i], 1),
+                                std::span<uint32_t>(&TriggerSources[i], 1),
+                                std::span<uint16_t>(Traces[i]));
+        }
+    }
+};
+
+// The per event path before save_batch(...) and the layout computed once:
+// the sizes of every column are summed up again for every event and the
+// line is filled byte by byte. Only writes the lines, it is only there to
+// compare the other paths against.
+class OriginalLineWriter {
+    std::ofstream _stream;
+    std::array<std::size_t, 3> _ranks;
+    std::vector<std::size_t> _sizes;
+    std::string _line_buffer;
+
+    template<std::size_t i>
+    void _save_item(const BenchWriter::tuple_type& items, std::size_t& loc) {
+        auto item = std::get<i>(items);
+        const auto total_rank_up_to_i = std::accumulate(_ranks.begin(),
+                                                        &_ranks[i], 0ul);
+        const std::size_t expected_size = std::accumulate(
+            &_sizes[total_rank_up_to_i], &_sizes[total_rank_up_to_i + _ranks[i]],
+            1ul, std::multiplies<std::size_t>());
+        if (expected_size != item.size()) {
+            throw std::out_of_range("memory is out of range");
+        }
+
+        auto item_bytes = std::as_bytes(item);
+        for (std::size_t byte = 0; byte < item.size_bytes(); byte++) {
+            _line_buffer.at(loc + byte) = static_cast<char>(item_bytes[byte]);
+        }
+        loc += item.size_bytes();
+    }
+
+ public:
+    OriginalLineWriter(const std::filesystem::path& file,
+                       const std::vector<std::size_t>& sizes,
+                       const std::size_t& line_size) :
+        _stream(file, std::ios::app | std::ofstream::binary),
+        _ranks{kBenchRanks}, _sizes{sizes}, _line_buffer(line_size, 'A') { }
+
+    void save(const BenchWriter::tuple_type& event) {
+        std::size_t loc = 0;
+        _save_item<0>(event, loc);
+        _save_item<1>(event, loc);
+        _save_item<2>(event, loc);
+        _stream << _line_buffer;
+    }
+};
+
+std::string read_all(const std::filesystem::path& file) {
+    std::ifstream in(file, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in),
+            std::istreambuf_iterator<char>()};
+}
+
+}  // namespace
+
+TEST_CASE("SBC_BINARY_BATCH_MATCHES_PER_EVENT") {
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto per_event_file = dir / "sbc_batch_test_per_event.bin";
+    const auto batch_file = dir / "sbc_batch_test_batch.bin";
+    std::filesystem::remove(per_event_file);
+    std::filesystem::remove(batch_file);
+
+    const std::size_t n_chs = 4, rl = 50;
+    BenchEvents events(20, n_chs, rl);
+    {
+        BenchWriter per_event(per_event_file.string(), kBenchNames,
+                              kBenchRanks, {1, 1, n_chs, rl});
+        BenchWriter batch(batch_file.string(), kBenchNames,
+                          kBenchRanks, {1, 1, n_chs, rl});
+        for (auto& [ts, trg, trace] : events.Tuples) {
+            per_event.save(ts, trg, trace);
+        }
+        batch.save_batch(events.Tuples);
+    }
+
+    const auto per_event_bytes = read_all(per_event_file);
+    CHECK(not per_event_bytes.empty());
+    CHECK(per_event_bytes == read_all(batch_file));
+
+    std::filesystem::remove(per_event_file);
+    std::filesystem::remove(batch_file);
+}
+
+TEST_CASE("SBC_BINARY_BATCH_THROUGHPUT") {
+    using clock = std::chrono::steady_clock;
+    // 500 events is what acquisition_endless usually gets per readout
+    constexpr std::size_t kEventsPerBlock = 500;
+    constexpr std::size_t kBlocks = 4;
+
+    const auto file = std::filesystem::temp_directory_path()
+        / "sbc_batch_throughput.bin";
+
+    for (std::size_t rl : {100ul, 350ul, 1000ul}) {
+        for (std::size_t n_chs : {8ul, 32ul, 64ul}) {
+            BenchEvents events(kEventsPerBlock, n_chs, rl);
+            const std::vector<std::size_t> sizes = {1, 1, n_chs, rl};
+
+            auto time_it = [&](auto&& write_block) {
+                std::filesystem::remove(file);
+                BenchWriter writer(file.string(), kBenchNames,
+                                   kBenchRanks, sizes);
+                auto start = clock::now();
+                for (std::size_t block = 0; block < kBlocks; block++) {
+                    write_block(writer);
+                }
+                std::chrono::duration<double> dt = clock::now() - start;
+                return std::make_pair(dt.count(), writer.getLineByteSize());
+            };
+
+            auto [per_event_s, line_size] = time_it([&](BenchWriter& w) {
+                for (auto& [ts, trg, trace] : events.Tuples) {
+                    w.save(ts, trg, trace);
+                }
+            });
+
+            auto [batch_s, _] = time_it([&](BenchWriter& w) {
+                w.save_batch(events.Tuples);
+            });
+
+            std::filesystem::remove(file);
+            double original_s = 0.0;
+            {
+                OriginalLineWriter original(file, sizes, line_size);
+                auto start = clock::now();
+                for (std::size_t block = 0; block < kBlocks; block++) {
+                    for (const auto& event : events.Tuples) {
+                        original.save(event);
+                    }
+                }
+                std::chrono::duration<double> dt = clock::now() - start;
+                original_s = dt.count();
+            }
+
+            const double n_events = kEventsPerBlock*kBlocks;
+            const double mbytes = n_events*static_cast<double>(line_size) / 1e6;
+            MESSAGE(fmt::format("rl = {:5} chs = {:3} | original: {:8.1f} MB/s "
+                                "| per event: {:8.1f} MB/s | batch: {:8.1f} MB/s "
+                                "{:9.0f} evt/s | speed up: {:.2f}x ({:.2f}x "
+                                "over per event)",
+                                rl, n_chs, mbytes / original_s,
+                                mbytes / per_event_s,
+                                mbytes / batch_s, n_events / batch_s,
+                                original_s / batch_s, per_event_s / batch_s));
+        }
+    }
+
+    std::filesystem::remove(file);
+}
+
+TEST_CASE("SBC_BINARY_FIXED_COLUMNS") {
+    using clock = std::chrono::steady_clock;
+    using FixedWriter = DynamicWriter<FixedColumn<uint32_t, 1>,
+                                      FixedColumn<uint32_t, 1>, uint16_t>;
+    static_assert(std::is_same_v<FixedWriter::tuple_type, BenchWriter::tuple_type>);
+    static_assert(FixedWriter::fixed_offsets[2] == 2*sizeof(uint32_t));
+    static_assert(BenchWriter::fixed_offsets[1] == std::dynamic_extent);
+
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto dynamic_file = dir / "sbc_fixed_test_dynamic.bin";
+    const auto fixed_file = dir / "sbc_fixed_test_fixed.bin";
+
+    // Small events are where the per column work shows
+    constexpr std::size_t kEvents = 200000;
+    const std::size_t n_chs = 2, rl = 20;
+    const std::vector<std::size_t> sizes = {1, 1, n_chs, rl};
+    BenchEvents events(kEvents, n_chs, rl);
+
+    auto time_it = [&](auto writer_type, const std::filesystem::path& file) {
+        using Writer = typename decltype(writer_type)::type;
+        std::filesystem::remove(file);
+        Writer writer(file.string(), kBenchNames, kBenchRanks, sizes);
+        auto start = clock::now();
+        writer.save_batch(events.Tuples);
+        std::chrono::duration<double> dt = clock::now() - start;
+        return dt.count();
+    };
+
+    const auto dynamic_s = time_it(std::type_identity<BenchWriter>{},
+                                   dynamic_file);
+    const auto fixed_s = time_it(std::type_identity<FixedWriter>{}, fixed_file);
+    MESSAGE(fmt::format("rl = {} chs = {} | dynamic: {:9.0f} evt/s | "
+                        "fixed: {:9.0f} evt/s | speed up: {:.2f}x",
+                        rl, n_chs, kEvents / dynamic_s, kEvents / fixed_s,
+                        dynamic_s / fixed_s));
+
+    // Same file, and the same checks on the sizes
+    const auto dynamic_bytes = read_all(dynamic_file);
+    CHECK(not dynamic_bytes.empty());
+    CHECK(dynamic_bytes == read_all(fixed_file));
+
+    std::filesystem::remove(fixed_file);
+    {
+        FixedWriter writer(fixed_file.string(), kBenchNames, kBenchRanks, sizes);
+        uint32_t two[2] = {0, 0};
+        auto& [ts, trg, trace] = events.Tuples[0];
+        CHECK_THROWS_AS(writer.save(two, trg, trace), std::out_of_range);
+        CHECK_THROWS_AS(writer.save(ts, trg, trace.first(rl)),
+                        std::out_of_range);
+    }
+
+    std::filesystem::remove(fixed_file);
+    CHECK_THROWS_AS(FixedWriter(fixed_file.string(), kBenchNames, kBenchRanks,
+                                {2, 1, n_chs, rl}),
+                    std::invalid_argument);
+    std::filesystem::remove(fixed_file);
+    CHECK_THROWS_AS(FixedWriter(fixed_file.string(), kBenchNames, kBenchRanks,
+                                sizes, {}, {12, 0, 0}),
+                    std::invalid_argument);
+
+    std::filesystem::remove(dynamic_file);
+    std::filesystem::remove(fixed_file);
+}
+
+TEST_CASE("SBC_BINARY_READER_ROUND_TRIP") {
+    const auto file = std::filesystem::temp_directory_path()
+        / "sbc_reader_test.bin";
+    std::filesystem::remove(file);
+
+    const std::size_t n_chs = 3, rl = 17;
+    BenchEvents events(25, n_chs, rl);
+    std::size_t line_size = 0;
+    {
+        BenchWriter writer(file.string(), kBenchNames, kBenchRanks,
+                           {1, 1, n_chs, rl});
+        writer.save_batch(events.Tuples);
+        line_size = writer.getLineByteSize();
+    }
+
+    // An incomplete line at the end, as if the run was interrupted
+    {
+        std::ofstream out(file, std::ios::binary | std::ios::app);
+        out.write("abc", 3);
+    }
+
+    using BenchReader = Reader<uint32_t, uint32_t, uint16_t>;
+    using WrongReader = Reader<uint32_t, uint16_t, uint16_t>;
+    BenchReader reader(file.string());
+    REQUIRE(reader.size() == events.Tuples.size());
+    CHECK(reader.header().LineByteSize == line_size);
+    REQUIRE(reader.header().Columns.size() == 3);
+    CHECK(reader.header().Columns[2].Name == "sipm_traces");
+    const std::vector<std::size_t> trace_sizes = {n_chs, rl};
+    CHECK(reader.header().Columns[2].Sizes == trace_sizes);
+
+    for (std::size_t i = 0; i < reader.size(); i++) {
+        CHECK(reader.get<0>(i)[0] == events.TimeStamps[i]);
+        auto [ts, trg, traces] = reader.event(i);
+        CHECK(trg[0] == events.TriggerSources[i]);
+        CHECK(std::equal(traces.begin(), traces.end(),
+                         events.Traces[i].begin(), events.Traces[i].end()));
+    }
+
+    std::size_t n_streamed = 0;
+    for (auto [ts, trg, traces] : reader.stream(5, 1)) {
+        CHECK(ts[0] == events.TimeStamps[5 + n_streamed]);
+        n_streamed++;
+    }
+    CHECK(n_streamed == events.Tuples.size() - 5);
+
+    CHECK_THROWS(std::ignore = reader.get<0>(reader.size()));
+    CHECK_THROWS(WrongReader{file.string()});
+
+    Reader<> untyped(file.string());
+    CHECK(untyped.size() == reader.size());
+    CHECK(untyped.get_raw(3, 2).size() == n_chs*rl*sizeof(uint16_t));
+
+    std::filesystem::remove(file);
+}
+
+TEST_CASE("SBC_BINARY_V2_RUN_CONSTANTS") {
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto v1_file = dir / "sbc_v1_test.bin";
+    const auto v2_file = dir / "sbc_v2_test.bin";
+    std::filesystem::remove(v1_file);
+    std::filesystem::remove(v2_file);
+
+    const std::size_t n_chs = 2, rl = 8;
+    BenchEvents events(10, n_chs, rl);
+    const std::vector<uint16_t> thresholds = {100, 200};
+    const double sample_rate = 62.5e6;
+
+    RunConstants constants;
+    constants.add("sample_rate", sample_rate)
+             .add("thresholds", thresholds);
+    {
+        BenchWriter writer(v2_file.string(), kBenchNames, kBenchRanks,
+                           {1, 1, n_chs, rl}, constants);
+        writer.save_batch(events.Tuples);
+    }
+
+    // Same events but with the constants saved per event, like v1 SiPM files
+    {
+        using V1Writer = DynamicWriter<double, uint32_t, uint32_t, uint16_t>;
+        V1Writer writer(v1_file.string(),
+                        {"sample_rate", "time_stamp", "trg_source", "sipm_traces"},
+                        {1, 1, 1, 2}, {1, 1, 1, n_chs, rl});
+        double rate[1] = {sample_rate};
+        for (auto& [ts, trg, trace] : events.Tuples) {
+            writer.save(rate, ts, trg, trace);
+        }
+    }
+
+    using BenchReader = Reader<uint32_t, uint32_t, uint16_t>;
+    BenchReader v2_reader(v2_file.string());
+    CHECK(v2_reader.header().Version == 2);
+    REQUIRE(v2_reader.size() == events.Tuples.size());
+    CHECK(v2_reader.constant<double>("sample_rate")[0] == sample_rate);
+    auto v2_thresholds = v2_reader.constant<uint16_t>("thresholds");
+    CHECK(std::equal(v2_thresholds.begin(), v2_thresholds.end(),
+                     thresholds.begin(), thresholds.end()));
+    CHECK_THROWS(std::ignore = v2_reader.constant<float>("sample_rate"));
+    CHECK_THROWS(std::ignore = v2_reader.constant_raw("dc_offsets"));
+
+    for (std::size_t i = 0; i < v2_reader.size(); i++) {
+        auto [ts, trg, traces] = v2_reader.event(i);
+        CHECK(ts[0] == events.TimeStamps[i]);
+        CHECK(std::equal(traces.begin(), traces.end(),
+                         events.Traces[i].begin(), events.Traces[i].end()));
+    }
+
+    // v1 files can still be read and their constants are taken
+    // from the first event
+    Reader<> v1_reader(v1_file.string());
+    CHECK(v1_reader.header().Version == 1);
+    CHECK(v1_reader.size() == v2_reader.size());
+    CHECK(v1_reader.constant<double>("sample_rate")[0] == sample_rate);
+    CHECK(v2_reader.header().LineByteSize + sizeof(double)
+          == v1_reader.header().LineByteSize);
+
+    std::filesystem::remove(v1_file);
+    std::filesystem::remove(v2_file);
+}
+
+TEST_CASE("SBC_SIPM_ASYNC_WRITER") {
+    using namespace SBCQueens;
+    const auto file = std::filesystem::temp_directory_path()
+        / "sbc_async_writer_test.bin";
+    std::filesystem::remove(file);
+
+    const auto model_consts = CAENDigitizerModelsConstantsMap.at(
+        CAENDigitizerModel::DT5730B);
+    CAENGlobalConfig global_config;
+    global_config.RecordLength = 20;
+    std::array<CAENGroupConfig, 8> group_configs;
+    group_configs[1].Enabled = true;
+    group_configs[4].Enabled = true;
+
+    constexpr std::size_t kBatchSize = 16;
+    constexpr std::size_t kNumBatches = 5;
+    // Stand in for the waveforms the digitizer fills
+    CAENWaveformBatch<uint16_t> digitizer(model_consts, global_config,
+                                          group_configs, kBatchSize);
+
+    std::size_t line_size = 0;
+    {
+        BinaryFormat::SiPMAsyncWriter writer(file.string(),
+            CAENDigitizerFamilies::x730, model_consts, global_config,
+            group_configs, kBatchSize);
+        REQUIRE(writer.isOpen());
+        // time stamp + trigger source + 2 channels packed to 14 bits
+        line_size = 4 + 4 + 14*2*global_config.RecordLength / 8;
+
+        for (std::size_t n = 0; n < kNumBatches; n++) {
+            digitizer.resize(kBatchSize);
+            for (std::size_t i = 0; i < digitizer.size(); i++) {
+                auto data = digitizer[i].getData();
+                std::fill(data.begin(), data.end(), static_cast<uint16_t>(n));
+            }
+
+            // Same hand off as in CAEN::SwapWaveforms
+            auto batch = writer.acquire_batch();
+            REQUIRE(batch->Waveforms.hasSameLayout(digitizer));
+            batch->Waveforms.swap(digitizer);
+            writer.submit(std::move(batch));
+        }
+    }
+
+    BinaryFormat::Reader<uint32_t, uint32_t, uint16_t> reader(file.string());
+    CHECK(reader.header().LineByteSize == line_size);
+    CHECK(reader.header().Columns[2].Type == "upack14");
+    REQUIRE(reader.size() == kBatchSize*kNumBatches);
+    std::vector<uint16_t> traces(2*global_config.RecordLength);
+    for (std::size_t i = 0; i < reader.size(); i++) {
+        reader.unpack(i, 2, traces);
+        const auto expected = static_cast<uint16_t>(i / kBatchSize);
+        CHECK(std::all_of(traces.begin(), traces.end(),
+                          [&](uint16_t x) { return x == expected; }));
+    }
+
+    std::filesystem::remove(file);
+}
+
+TEST_CASE("SBC_SIPM_FILE_NEW_RUN_CONSTANTS") {
+    using namespace SBCQueens;
+    const auto dir = std::filesystem::temp_directory_path()
+        / "sbc_run_constants_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const auto file = (dir / "SiPM.bin").string();
+
+    const auto model_consts = CAENDigitizerModelsConstantsMap.at(
+        CAENDigitizerModel::DT5730B);
+    CAENGlobalConfig global_config;
+    global_config.RecordLength = 20;
+    std::array<CAENGroupConfig, 8> group_configs;
+    group_configs[1].Enabled = true;
+
+    constexpr std::size_t kBatchSize = 4;
+    CAENWaveformBatch<uint16_t> digitizer(model_consts, global_config,
+                                          group_configs, kBatchSize);
+    // Same as acquisition_endless: the file is opened again once the
+    // digitizer was reconfigured
+    auto write = [&]() {
+        BinaryFormat::SiPMAsyncWriter writer(file,
+            CAENDigitizerFamilies::x730, model_consts, global_config,
+            group_configs, kBatchSize);
+        REQUIRE(writer.isOpen());
+        auto batch = writer.acquire_batch();
+        digitizer.resize(kBatchSize);
+        batch->Waveforms.swap(digitizer);
+        writer.submit(std::move(batch));
+    };
+
+    auto num_events = [](const std::string& name) {
+        return BinaryFormat::Reader<>(name).size();
+    };
+
+    auto thresholds = [](const std::string& name) {
+        const BinaryFormat::Reader<> reader(name);
+        return reader.constant<uint16_t>("thresholds")[0];
+    };
+
+    write();
+    // Same settings: appended
+    write();
+    CHECK(num_events(file) == 2*kBatchSize);
+
+    // Only the threshold changed: the events cannot go to the same file,
+    // but they are not lost either
+    group_configs[1].TriggerThreshold += 1;
+    const auto second = RunManifest::segment_name(file, 1);
+    REQUIRE_NOTHROW(write());
+    REQUIRE(std::filesystem::exists(second));
+    CHECK(num_events(file) == 2*kBatchSize);
+    CHECK(num_events(second) == kBatchSize);
+    CHECK(thresholds(second) == thresholds(file) + 1);
+
+    // Back to the first threshold, appended to the first file
+    group_configs[1].TriggerThreshold -= 1;
+    write();
+    CHECK(num_events(file) == 3*kBatchSize);
+    CHECK(num_events(second) == kBatchSize);
+
+    // Anything else still cannot be appended to
+    global_config.RecordLength = 40;
+    digitizer = CAENWaveformBatch<uint16_t>(model_consts, global_config,
+                                            group_configs, kBatchSize);
+    CHECK_THROWS_AS(write(), std::runtime_error);
+    CHECK_FALSE(std::filesystem::exists(RunManifest::segment_name(file, 2)));
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("SBC_BIT_PACKING_ROUND_TRIP") {
+    using namespace BitPacking;
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<uint16_t> distribution(0, 0xFFFF);
+    // Sizes that are and are not multiples of the SIMD vectors
+    for (std::size_t n : {0ul, 1ul, 7ul, 8ul, 9ul, 16ul, 17ul, 1001ul}) {
+        std::vector<uint16_t> samples(n);
+        std::generate(samples.begin(), samples.end(),
+                      [&]() { return distribution(gen); });
+
+        for (uint8_t bits = 1; bits <= kMaxBits; bits++) {
+            const uint16_t mask = static_cast<uint16_t>((1u << bits) - 1);
+            std::vector<char> scalar_packed(packed_size(n, bits) + 1, 'x');
+            pack(samples, bits, scalar_packed.data(), SIMDLevel::Scalar);
+            // Nothing is written past the packed size
+            CHECK(scalar_packed.back() == 'x');
+
+            for (auto level : {SIMDLevel::Scalar, SIMDLevel::SSE41}) {
+                if (level > best_simd_level()) {
+                    continue;
+                }
+
+                std::vector<char> packed(packed_size(n, bits));
+                pack(samples, bits, packed.data(), level);
+                CHECK(std::equal(packed.begin(), packed.end(),
+                                 scalar_packed.begin()));
+
+                std::vector<uint16_t> unpacked(n);
+                unpack(packed.data(), bits, unpacked, level);
+                for (std::size_t k = 0; k < n; k++) {
+                    REQUIRE(unpacked[k] == (samples[k] & mask));
+                }
+            }
+        }
+    }
+
+    // 12 bits is the same layout as the x740 raw data: 2 samples in 3 bytes
+    const std::vector<uint16_t> pair = {0x0ABC, 0x0123};
+    std::array<char, 3> bytes;
+    pack(pair, 12, bytes.data());
+    CHECK(static_cast<uint8_t>(bytes[0]) == 0xBC);
+    CHECK(static_cast<uint8_t>(bytes[1]) == 0x3A);
+    CHECK(static_cast<uint8_t>(bytes[2]) == 0x12);
+}
+
+TEST_CASE("SBC_BINARY_PACKED_COLUMN") {
+    const auto file = std::filesystem::temp_directory_path()
+        / "sbc_packed_test.bin";
+    std::filesystem::remove(file);
+
+    const std::size_t n_chs = 3, rl = 17;
+    BenchEvents events(10, n_chs, rl);
+    {
+        BenchWriter writer(file.string(), kBenchNames, kBenchRanks,
+                           {1, 1, n_chs, rl}, {}, {0, 0, 12});
+        CHECK(writer.getLineByteSize() == 4 + 4 + (12*n_chs*rl + 7) / 8);
+        writer.save_batch(events.Tuples);
+        auto& [ts, trg, trace] = events.Tuples[0];
+        writer.save(ts, trg, trace);
+    }
+
+    CHECK_THROWS_AS(BenchWriter(file.string(), kBenchNames, kBenchRanks,
+                                {1, 1, n_chs, rl}, {}, {12, 0, 0}),
+                    std::invalid_argument);
+
+    Reader<uint32_t, uint32_t, uint16_t> reader(file.string());
+    REQUIRE(reader.size() == events.Tuples.size() + 1);
+    CHECK(reader.header().Columns[2].Type == "upack12");
+    CHECK(reader.is_packed(2));
+    CHECK(not reader.is_packed(0));
+    CHECK_THROWS(std::ignore = reader.get<2>(0));
+
+    std::vector<uint16_t> traces(n_chs*rl);
+    for (std::size_t i = 0; i < reader.size(); i++) {
+        CHECK(reader.get<0>(i)[0] == events.TimeStamps[i % events.Tuples.size()]);
+        reader.unpack(i, 2, traces);
+        const auto& expected = events.Traces[i % events.Tuples.size()];
+        CHECK(std::equal(traces.begin(), traces.end(),
+                         expected.begin(), expected.end()));
+    }
+    CHECK_THROWS(reader.unpack(0, 0, traces));
+
+    std::filesystem::remove(file);
+}
+
+TEST_CASE("SBC_BIT_PACKING_THROUGHPUT") {
+    using namespace BitPacking;
+    using clock = std::chrono::steady_clock;
+    // A full x740 event: 64 channels of 1000 samples
+    constexpr std::size_t kSamples = 64*1000;
+    constexpr std::size_t kRepeats = 200;
+    std::vector<uint16_t> samples(kSamples);
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<uint16_t> distribution(0, 0x0FFF);
+    std::generate(samples.begin(), samples.end(),
+                  [&]() { return distribution(gen); });
+
+    for (uint8_t bits : {12, 14}) {
+        std::vector<char> packed(packed_size(kSamples, bits));
+        std::vector<uint16_t> unpacked(kSamples);
+        for (auto level : {SIMDLevel::Scalar, SIMDLevel::SSE41}) {
+            if (level > best_simd_level()) {
+                continue;
+            }
+
+            auto start = clock::now();
+            for (std::size_t r = 0; r < kRepeats; r++) {
+                pack(samples, bits, packed.data(), level);
+            }
+            std::chrono::duration<double> pack_dt = clock::now() - start;
+
+            start = clock::now();
+            for (std::size_t r = 0; r < kRepeats; r++) {
+                unpack(packed.data(), bits, unpacked, level);
+            }
+            std::chrono::duration<double> unpack_dt = clock::now() - start;
+
+            const double mbytes = kRepeats*kSamples*sizeof(uint16_t) / 1e6;
+            MESSAGE(fmt::format("upack{} {:>6} | pack {:8.1f} MB/s "
+                                "| unpack {:8.1f} MB/s | {:.0f}% of uint16",
+                                bits,
+                                level == SIMDLevel::SSE41 ? "sse4.1" : "scalar",
+                                mbytes / pack_dt.count(),
+                                mbytes / unpack_dt.count(),
+                                100.0*packed.size() / (kSamples*sizeof(uint16_t))));
+        }
+    }
+}
+
+TEST_CASE("SBC_BINARY_COMPRESSED_ROUND_TRIP") {
+    const auto file = std::filesystem::temp_directory_path()
+        / "sbc_compressed_test.bin";
+    std::filesystem::remove(file);
+
+    const std::size_t n_chs = 3, rl = 40;
+    BenchEvents events(50, n_chs, rl);
+    CompressionOptions compression;
+    compression.Level = 3;
+    compression.NumThreads = 2;
+    compression.ChunkEvents = 7;
+
+    std::size_t file_size_with_index = 0;
+    {
+        BenchWriter writer(file.string(), kBenchNames, kBenchRanks,
+                           {1, 1, n_chs, rl}, {}, {}, compression);
+        REQUIRE(writer.isOpen());
+        writer.save_batch(std::span(events.Tuples).first(40));
+        for (std::size_t i = 40; i < events.Tuples.size(); i++) {
+            auto& [ts, trg, trace] = events.Tuples[i];
+            writer.save(ts, trg, trace);
+        }
+    }
+    file_size_with_index = std::filesystem::file_size(file);
+    {
+        const auto bytes = read_all(file);
+        CHECK(bytes.ends_with(Tools::kTrailerMagic));
+        CHECK(std::string_view(bytes).substr(0, bytes.size()
+            - Tools::kTrailerSize).ends_with(Tools::kChunkIndexMagic));
+    }
+
+    auto check_events = [&](const auto& reader, const std::size_t& n) {
+        REQUIRE(reader.size() == n);
+        for (std::size_t i = 0; i < n; i++) {
+            const auto k = i % events.Tuples.size();
+            CHECK(reader.template get<0>(i)[0] == events.TimeStamps[k]);
+            auto traces = reader.template get<2>(i);
+            REQUIRE(std::equal(traces.begin(), traces.end(),
+                               events.Traces[k].begin(), events.Traces[k].end()));
+        }
+    };
+
+    {
+        Reader<uint32_t, uint32_t, uint16_t> reader(file.string());
+        CHECK(reader.header().Flags == (Tools::kFlagCompressed
+              | Tools::kFlagDeltaFilter | Tools::kFlagTrailer));
+        check_events(reader, events.Tuples.size());
+
+        // Going back to an earlier chunk decompresses it again
+        CHECK(reader.get<0>(3)[0] == events.TimeStamps[3]);
+        std::size_t n_streamed = 0;
+        for (auto [ts, trg, trace] : reader.stream()) {
+            CHECK(ts[0] == events.TimeStamps[n_streamed]);
+            n_streamed++;
+        }
+        CHECK(n_streamed == events.Tuples.size());
+    }
+
+    // Appending keeps the old chunks and writes a new index
+    {
+        BenchWriter writer(file.string(), kBenchNames, kBenchRanks,
+                           {1, 1, n_chs, rl}, {}, {}, compression);
+        REQUIRE(writer.isOpen());
+        writer.save_batch(events.Tuples);
+    }
+    CHECK(std::filesystem::file_size(file) > file_size_with_index);
+    {
+        Reader<uint32_t, uint32_t, uint16_t> reader(file.string());
+        check_events(reader, 2*events.Tuples.size());
+    }
+
+    // A crash leaves no index and part of a chunk: only the complete chunks
+    // are read
+    std::size_t data_end = 0;
+    {
+        SBCQueens::MemoryMappedFile mapped(file.string());
+        Reader<> reader(file.string());
+        data_end = Tools::read_chunk_index(mapped.data(),
+            mapped.size() - Tools::kTrailerSize,
+            reader.header().HeaderByteSize).DataEnd;
+    }
+    std::filesystem::resize_file(file, data_end - 20);
+    {
+        Reader<uint32_t, uint32_t, uint16_t> reader(file.string());
+        // The last chunk had 1 event (50 = 7*7 + 1)
+        CHECK(reader.size() == 2*events.Tuples.size() - 1);
+        CHECK_FALSE(reader.summary());
+        check_events(reader, reader.size());
+    }
+
+    // Recovering writes the index and trailer back
+    const auto report = recover_file(file.string());
+    CHECK_FALSE(report.WasClosed);
+    CHECK(report.NumEvents == 2*events.Tuples.size() - 1);
+    {
+        Reader<uint32_t, uint32_t, uint16_t> reader(file.string());
+        REQUIRE(reader.summary());
+        CHECK(reader.summary()->NumEvents == reader.size());
+        CHECK(reader.summary()->Recoveries == 1);
+        CHECK(reader.verify_checksum());
+        CHECK(reader.header().NumLines
+              == static_cast<int32_t>(2*events.Tuples.size() - 1));
+        check_events(reader, reader.size());
+    }
+    CHECK(recover_file(file.string()).WasClosed);
+
+    std::filesystem::remove(file);
+}
+
+TEST_CASE("SBC_CHECKSUM_CRC32C") {
+    using clock = std::chrono::steady_clock;
+    // Check value of the CRC32C standard
+    const std::string_view check = "123456789";
+    CHECK(Checksum::crc32c(check) == 0xE3069283);
+    CHECK(Checksum::crc32c({}) == 0);
+
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    std::vector<char> data(1 << 20);
+    std::generate(data.begin(), data.end(),
+                  [&]() { return static_cast<char>(distribution(gen)); });
+
+    // Computed a piece at a time, with pieces that do not end on 8 bytes
+    const auto whole = Checksum::crc32c(data);
+    uint32_t pieces = 0;
+    std::size_t pos = 0;
+    for (std::size_t piece : {1ul, 7ul, 13ul, 4096ul, 100001ul}) {
+        pieces = Checksum::crc32c(std::span(data).subspan(pos, piece), pieces);
+        pos += piece;
+    }
+    pieces = Checksum::crc32c(std::span(data).subspan(pos), pieces);
+    CHECK(pieces == whole);
+
+    data[12345] ^= 1;
+    CHECK(Checksum::crc32c(data) != whole);
+
+    const auto start = clock::now();
+    uint32_t crc = 0;
+    constexpr int kRepeats = 64;
+    for (int i = 0; i < kRepeats; i++) {
+        crc = Checksum::crc32c(data, crc);
+    }
+    std::chrono::duration<double> dt = clock::now() - start;
+    CHECK(crc != 0);
+    MESSAGE(fmt::format("crc32c {} | {:8.1f} MB/s",
+                        Checksum::has_hardware_crc32c() ? "sse4.2" : "scalar",
+                        kRepeats*static_cast<double>(data.size()) / 1e6
+                        / dt.count()));
+}
+
+TEST_CASE("SBC_BINARY_CRASH_RECOVERY") {
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto v1_file = dir / "sbc_recovery_v1_test.bin";
+    const auto v2_file = dir / "sbc_recovery_v2_test.bin";
+    std::filesystem::remove(v1_file);
+    std::filesystem::remove(v2_file);
+
+    const std::size_t n_chs = 2, rl = 16;
+    BenchEvents events(30, n_chs, rl);
+    RunConstants constants;
+    constants.add("sample_rate", 62.5e6);
+    using BenchReader = Reader<uint32_t, uint32_t, uint16_t>;
+
+    std::size_t line_size = 0;
+    {
+        BenchWriter writer(v2_file.string(), kBenchNames, kBenchRanks,
+                           {1, 1, n_chs, rl}, constants);
+        REQUIRE(writer.isOpen());
+        line_size = writer.getLineByteSize();
+        writer.save_batch(std::span(events.Tuples).first(10));
+        writer.flush();
+        {
+            BenchReader reader(v2_file.string());
+            CHECK(reader.header().NumLines == 10);
+            CHECK(reader.size() == 10);
+            CHECK_FALSE(reader.summary());
+        }
+
+        writer.save_batch(std::span(events.Tuples).subspan(10));
+    }
+
+    std::size_t header_size = 0;
+    {
+        BenchReader reader(v2_file.string());
+        header_size = reader.header().HeaderByteSize;
+        CHECK(reader.header().Flags == Tools::kFlagTrailer);
+        CHECK(reader.header().NumLines == 30);
+        REQUIRE(reader.size() == 30);
+        REQUIRE(reader.summary());
+        const auto& summary = *reader.summary();
+        CHECK(summary.NumEvents == 30);
+        CHECK(summary.DataBytes == 30*line_size);
+        CHECK(summary.Sessions == 1);
+        CHECK(summary.Recoveries == 0);
+        CHECK(summary.FirstOpened > 0);
+        CHECK(summary.LastClosed >= summary.FirstOpened);
+        CHECK(reader.verify_checksum());
+    }
+    CHECK(std::filesystem::file_size(v2_file)
+          == header_size + 30*line_size + Tools::kTrailerSize);
+    CHECK(recover_file(v2_file.string()).WasClosed);
+
+    // Appending keeps the summary and checksum going
+    {
+        BenchWriter writer(v2_file.string(), kBenchNames, kBenchRanks,
+                           {1, 1, n_chs, rl}, constants);
+        REQUIRE(writer.isOpen());
+        CHECK(writer.getNumEvents() == 30);
+        writer.save_batch(events.Tuples);
+    }
+    {
+        BenchReader reader(v2_file.string());
+        REQUIRE(reader.size() == 60);
+        REQUIRE(reader.summary());
+        CHECK(reader.summary()->Sessions == 2);
+        CHECK(reader.verify_checksum());
+        for (std::size_t i = 0; i < reader.size(); i++) {
+            CHECK(reader.get<0>(i)[0] == events.TimeStamps[i % 30]);
+        }
+    }
+
+    // A crash in the middle of a line, before the last header update
+    std::filesystem::resize_file(v2_file, header_size + 55*line_size - 5);
+    {
+        std::fstream out(v2_file, std::ios::in | std::ios::out | std::ios::binary);
+        Tools::write_num_lines(out, header_size, 40);
+    }
+    {
+        BenchReader reader(v2_file.string());
+        CHECK(reader.size() == 40);
+        CHECK_FALSE(reader.summary());
+        CHECK_FALSE(reader.verify_checksum());
+    }
+
+    auto report = recover_file(v2_file.string());
+    CHECK_FALSE(report.WasClosed);
+    CHECK(report.NumEvents == 54);
+    CHECK(report.BytesRemoved == line_size - 5);
+    {
+        BenchReader reader(v2_file.string());
+        CHECK(reader.header().NumLines == 54);
+        REQUIRE(reader.size() == 54);
+        REQUIRE(reader.summary());
+        CHECK(reader.summary()->Recoveries == 1);
+        // The old trailer was lost with the crash
+        CHECK(reader.summary()->FirstOpened == 0);
+        CHECK(reader.verify_checksum());
+        CHECK(reader.get<0>(53)[0] == events.TimeStamps[53 % 30]);
+    }
+    CHECK(recover_file(v2_file.string()).WasClosed);
+
+    // Any changed byte is caught by the checksum
+    {
+        std::fstream out(v2_file, std::ios::in | std::ios::out | std::ios::binary);
+        out.seekp(static_cast<std::streamoff>(header_size + 3*line_size + 9));
+        out.put('\x7F');
+    }
+    CHECK_FALSE(BenchReader(v2_file.string()).verify_checksum());
+
+    // v1 files have no trailer but keep their number of lines
+    {
+        BenchWriter writer(v1_file.string(), kBenchNames, kBenchRanks,
+                           {1, 1, n_chs, rl});
+        writer.save_batch(events.Tuples);
+    }
+    std::filesystem::resize_file(v1_file,
+                                 std::filesystem::file_size(v1_file) - 1);
+    {
+        BenchReader reader(v1_file.string());
+        CHECK(reader.header().NumLines == 30);
+        CHECK(reader.size() == 29);
+    }
+    report = recover_file(v1_file.string());
+    CHECK(report.NumEvents == 29);
+    CHECK(BenchReader(v1_file.string()).header().NumLines == 29);
+    CHECK(recover_file(v1_file.string()).WasClosed);
+
+    std::filesystem::remove(v1_file);
+    std::filesystem::remove(v2_file);
+}
+
+namespace {
+
+// Baseline with band limited noise and a few SiPM-like pulses, like the
+// real waveforms.
+void make_sipm_like(BenchEvents& events) {
+    std::mt19937 gen(7);
+    std::normal_distribution<double> noise(0.0, 2.0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (auto& trace : events.Traces) {
+        double pulse = 0.0;
+        double baseline = 0.0;
+        for (auto& sample : trace) {
+            if (uniform(gen) < 0.002) {
+                pulse += 400.0*uniform(gen);
+            }
+            pulse *= 0.95;
+            baseline = 0.8*baseline + noise(gen);
+            sample = static_cast<uint16_t>(std::clamp(
+                3500.0 - pulse + baseline, 0.0, 4095.0));
+        }
+    }
+}
+
+void compression_benchmark(BenchEvents& events, const std::size_t& n_chs,
+                           const std::size_t& rl, std::string_view label) {
+    using clock = std::chrono::steady_clock;
+    const auto file = std::filesystem::temp_directory_path()
+        / "sbc_compression_bench.bin";
+    const double raw_mbytes = static_cast<double>(events.Tuples.size())
+        *(8 + 2*n_chs*rl) / 1e6;
+
+    const std::size_t max_threads = std::max(1u,
+                                             std::thread::hardware_concurrency());
+    for (bool delta : {false, true}) {
+        for (int level : {0, 1, 3, 9}) {
+            for (std::size_t threads : {std::size_t{1}, max_threads}) {
+                if ((level == 0 or max_threads == 1) and threads != 1) {
+                    continue;
+                }
+
+                CompressionOptions compression;
+                compression.Level = level;
+                compression.NumThreads = threads;
+                compression.DeltaFilter = delta;
+
+                std::filesystem::remove(file);
+                auto start = clock::now();
+                {
+                    BenchWriter writer(file.string(), kBenchNames, kBenchRanks,
+                                       {1, 1, n_chs, rl}, {}, {}, compression);
+                    writer.save_batch(events.Tuples);
+                }
+                std::chrono::duration<double> write_dt = clock::now() - start;
+                const double file_mbytes
+                    = static_cast<double>(std::filesystem::file_size(file)) / 1e6;
+
+                start = clock::now();
+                uint64_t checksum = 0;
+                {
+                    Reader<uint32_t, uint32_t, uint16_t> reader(file.string());
+                    for (auto [ts, trg, trace] : reader.stream()) {
+                        checksum += trace[0];
+                    }
+                }
+                std::chrono::duration<double> read_dt = clock::now() - start;
+                CHECK(checksum > 0);
+
+                MESSAGE(fmt::format("{} | delta = {:d} level = {} threads = {:2} "
+                                    "| ratio = {:5.2f} | write {:8.1f} MB/s "
+                                    "| read {:8.1f} MB/s", label, delta, level,
+                                    threads, raw_mbytes / file_mbytes,
+                                    raw_mbytes / write_dt.count(),
+                                    raw_mbytes / read_dt.count()));
+            }
+        }
+    }
+
+    std::filesystem::remove(file);
+}
+
+}  // namespace
+
+// Set SBC_BENCH_FILE to a recorded SiPM file to benchmark on real data
+// instead of the simulated waveforms.
+TEST_CASE("SBC_BINARY_COMPRESSION_THROUGHPUT") {
+    if (const char* recorded = std::getenv("SBC_BENCH_FILE")) {
+        Reader<uint32_t, uint32_t, uint16_t> reader(recorded);
+        const auto& sizes = reader.header().Columns[2].Sizes;
+        REQUIRE(sizes.size() == 2);
+        const std::size_t n_events = std::min<std::size_t>(reader.size(), 20000);
+        BenchEvents events(n_events, sizes[0], sizes[1]);
+        for (std::size_t i = 0; i < n_events; i++) {
+            events.TimeStamps[i] = reader.get<0>(i)[0];
+            events.TriggerSources[i] = reader.get<1>(i)[0];
+            reader.unpack(i, 2, events.Traces[i]);
+        }
+
+        compression_benchmark(events, sizes[0], sizes[1], "recorded");
+        return;
+    }
+
+    const std::size_t n_chs = 16, rl = 1000;
+    BenchEvents events(2000, n_chs, rl);
+    make_sipm_like(events);
+    compression_benchmark(events, n_chs, rl, "simulated");
+}
+
+TEST_CASE("SBC_EVENT_INDEX") {
+    using namespace SBCQueens;
+    const auto file = std::filesystem::temp_directory_path()
+        / "sbc_event_index_test.bin";
+    const auto index_file = EventIndex::sidecar_name(file.string());
+
+    const auto model_consts = CAENDigitizerModelsConstantsMap.at(
+        CAENDigitizerModel::DT5730B);
+    CAENGlobalConfig global_config;
+    global_config.RecordLength = 20;
+    std::array<CAENGroupConfig, 8> group_configs;
+    group_configs[0].Enabled = true;
+    group_configs[3].Enabled = true;
+
+    constexpr std::size_t kBatchSize = 16;
+    constexpr uint32_t kStride = 10;
+    // The trigger time tag rolls over every 16 events
+    constexpr uint64_t kStep = uint64_t{1} << 27;
+    CAENWaveformBatch<uint16_t> digitizer(model_consts, global_config,
+                                          group_configs, kBatchSize);
+    auto write = [&](const CompressionOptions& compression,
+                     const std::size_t& first, const std::size_t& num_batches) {
+        SiPMDynamicWriter writer(file.string(), CAENDigitizerFamilies::x730,
+            model_consts, global_config, group_configs, compression, kStride);
+        REQUIRE(writer.isOpen());
+        for (std::size_t n = 0; n < num_batches; n++) {
+            digitizer.resize(kBatchSize);
+            for (std::size_t i = 0; i < kBatchSize; i++) {
+                const auto event = first + n*kBatchSize + i;
+                CAEN_DGTZ_EventInfo_t info{};
+                info.TriggerTimeTag = static_cast<uint32_t>(
+                    (event*kStep) & TriggerTimeUnwrapper::kMask);
+                digitizer[i].setInfo(info);
+            }
+            writer.save_waveforms(digitizer);
+        }
+    };
+
+    CompressionOptions compressed;
+    compressed.Level = 1;
+    compressed.ChunkEvents = 7;
+    for (const auto& compression : {CompressionOptions{}, compressed}) {
+        std::filesystem::remove(file);
+        std::filesystem::remove(index_file);
+        write(compression, 0, 5);
+        // Appending keeps counting events and roll overs
+        write(compression, 5*kBatchSize, 1);
+
+        const Reader<> reader(file.string());
+        REQUIRE(reader.size() == 6*kBatchSize);
+        const auto& index = reader.event_index();
+        CHECK(index.stride() == kStride);
+        REQUIRE(index.size() == 10);
+        for (std::size_t j = 0; j < index.size(); j++) {
+            const auto& entry = index.entries()[j];
+            CHECK(entry.EventNumber == j*kStride);
+            CHECK(entry.TriggerTime == j*kStride*kStep);
+            CHECK(entry.ByteOffset == (compression.enabled() ? 0
+                : reader.file_offset(entry.EventNumber)));
+            CHECK(entry.WallTime > 0);
+        }
+
+        for (std::size_t i = 0; i < reader.size(); i++) {
+            REQUIRE(reader.find_trigger_time(i*kStep) == i);
+            REQUIRE(reader.find_trigger_time(i*kStep + 1) == i + 1);
+        }
+        CHECK(reader.find_trigger_time(reader.size()*kStep) == reader.size());
+        CHECK(reader.find_wall_time({}) == 0);
+        CHECK(reader.find_wall_time(std::chrono::system_clock::now()) == 90);
+        CHECK(index.find_event(95).EventNumber == 90);
+        CHECK_THROWS_AS(static_cast<void>(EventIndex(kStride, {}).find_event(0)),
+                        std::out_of_range);
+
+        // Same index from the file alone, split between threads
+        const auto rebuilt = rebuild_event_index(file.string(), kStride, 3);
+        REQUIRE(rebuilt.size() == index.size());
+        for (std::size_t j = 0; j < index.size(); j++) {
+            CHECK(rebuilt.entries()[j].EventNumber
+                  == index.entries()[j].EventNumber);
+            CHECK(rebuilt.entries()[j].ByteOffset
+                  == index.entries()[j].ByteOffset);
+            CHECK(rebuilt.entries()[j].TriggerTime
+                  == index.entries()[j].TriggerTime);
+            CHECK(rebuilt.entries()[j].WallTime == 0);
+        }
+        CHECK(EventIndex(index_file).size() == index.size());
+    }
+
+    std::filesystem::remove(file);
+    std::filesystem::remove(index_file);
+}
+
+TEST_CASE("SBC_SIPM_FILE_ROLLOVER") {
+    using namespace SBCQueens;
+    const auto dir = std::filesystem::temp_directory_path()
+        / "sbc_rollover_test";
+    const auto file = (dir / "SiPM.bin").string();
+    const auto manifest_file = RunManifest::manifest_name(file);
+    CHECK(manifest_file == (dir / "SiPM.manifest.json").string());
+    CHECK(RunManifest::segment_name(file, 3) == (dir / "SiPM_0003.bin").string());
+
+    const auto model_consts = CAENDigitizerModelsConstantsMap.at(
+        CAENDigitizerModel::DT5730B);
+    CAENGlobalConfig global_config;
+    global_config.RecordLength = 20;
+    std::array<CAENGroupConfig, 8> group_configs;
+    group_configs[0].Enabled = true;
+    group_configs[3].Enabled = true;
+
+    constexpr std::size_t kBatchSize = 16;
+    constexpr uint32_t kStride = 10;
+    // The trigger time tag rolls over every 16 events
+    constexpr uint64_t kStep = uint64_t{1} << 27;
+    CAENWaveformBatch<uint16_t> digitizer(model_consts, global_config,
+                                          group_configs, kBatchSize);
+    RolloverOptions rollover;
+    ChecksumOptions checksums;
+    checksums.BlockChecksums = true;
+    checksums.BlockLines = 5;
+    checksums.VerifySegments = true;
+    auto write = [&](const CompressionOptions& compression,
+                     const std::size_t& num_batches) {
+        SiPMDynamicWriter writer(file, CAENDigitizerFamilies::x730,
+            model_consts, global_config, group_configs, compression, kStride,
+            rollover, checksums);
+        REQUIRE(writer.isOpen());
+        REQUIRE(writer.manifest());
+        for (std::size_t n = 0; n < num_batches; n++) {
+            digitizer.resize(kBatchSize);
+            for (std::size_t i = 0; i < kBatchSize; i++) {
+                const auto event = n*kBatchSize + i;
+                CAEN_DGTZ_EventInfo_t info{};
+                info.TriggerTimeTag = static_cast<uint32_t>(
+                    (event*kStep) & TriggerTimeUnwrapper::kMask);
+                digitizer[i].setInfo(info);
+            }
+            writer.save_waveforms(digitizer);
+        }
+    };
+
+    // Every segment is a complete file with its own index, and together
+    // they have all the events in order
+    auto check_segments = [&](const RunManifest& manifest,
+                              const std::size_t& first_segment,
+                              const uint64_t& first_event,
+                              const uint64_t& num_events) {
+        const auto& segments = manifest.segments();
+        uint64_t event = first_event;
+        for (auto j = first_segment; j < segments.size(); j++) {
+            const auto& segment = segments[j];
+            const auto path = manifest.path(segment);
+            CHECK(segment.FileName
+                  == std::filesystem::path(
+                      RunManifest::segment_name(file, j)).filename().string());
+            CHECK(segment.Closed);
+            CHECK(segment.Verified == std::optional<bool>(true));
+            CHECK(segment.FirstEvent == event);
+            CHECK(segment.NumEvents % kBatchSize == 0);
+            CHECK(segment.Bytes == std::filesystem::file_size(path));
+            CHECK(segment.StartTime <= segment.EndTime);
+
+            const auto session_event = event - first_event;
+            CHECK(segment.FirstTriggerTime == session_event*kStep);
+            CHECK(segment.LastTriggerTime
+                  == (session_event + segment.NumEvents - 1)*kStep);
+
+            const Reader<> reader(path);
+            REQUIRE(reader.size() == segment.NumEvents);
+            CHECK(reader.verify_checksum());
+            CHECK(reader.event_index().size()
+                  == (segment.NumEvents + kStride - 1) / kStride);
+            CHECK(reader.event_index().entries().front().TriggerTime
+                  == segment.FirstTriggerTime);
+            event += segment.NumEvents;
+        }
+        CHECK(event == first_event + num_events);
+        // The pre-opened segment that was not used is removed
+        CHECK_FALSE(std::filesystem::exists(
+            RunManifest::segment_name(file, segments.size())));
+        CHECK_FALSE(std::filesystem::exists(file));
+    };
+
+    CompressionOptions compressed;
+    compressed.Level = 1;
+    compressed.ChunkEvents = 7;
+    for (const auto& compression : {CompressionOptions{}, compressed}) {
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        // About 3 batches per segment
+        rollover.MaxBytes = compression.enabled() ? 400 : 3000;
+        write(compression, 10);
+
+        std::size_t num_segments = 0;
+        {
+            const RunManifest manifest(manifest_file);
+            num_segments = manifest.segments().size();
+            REQUIRE(num_segments > 2);
+            check_segments(manifest, 0, 0, 10*kBatchSize);
+        }
+
+        // A restart continues after the last segment
+        write(compression, 4);
+        {
+            const RunManifest manifest(manifest_file);
+            REQUIRE(manifest.segments().size() > num_segments);
+            check_segments(manifest, num_segments, 10*kBatchSize, 4*kBatchSize);
+            num_segments = manifest.segments().size();
+        }
+
+        // A segment left open by a crash gets closed with its events
+        // counted from the file
+        {
+            RunManifest manifest(manifest_file);
+            manifest.segments().back().NumEvents = 0;
+            manifest.segments().back().Closed = false;
+            manifest.save();
+        }
+        write(compression, 0);
+        const RunManifest manifest(manifest_file);
+        REQUIRE(manifest.segments().size() == num_segments);
+        CHECK(manifest.segments().back().Closed);
+        CHECK(manifest.next_event() == 14*kBatchSize);
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("SBC_BINARY_BLOCK_CHECKSUMS") {
+    using clock = std::chrono::steady_clock;
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto file = dir / "sbc_block_checksums_test.bin";
+    const auto reference_file = dir / "sbc_block_checksums_reference.bin";
+
+    const std::size_t n_chs = 2, rl = 30;
+    const std::vector<std::size_t> sizes = {1, 1, n_chs, rl};
+    BenchEvents events(50, n_chs, rl);
+    const std::span<const BenchWriter::tuple_type> all(events.Tuples);
+
+    ChecksumOptions checksums;
+    checksums.BlockChecksums = true;
+    checksums.BlockLines = 7;
+    CompressionOptions compressed;
+    compressed.Level = 1;
+    compressed.ChunkEvents = 5;
+    for (const auto& compression : {CompressionOptions{}, compressed}) {
+        std::filesystem::remove(file);
+        std::filesystem::remove(reference_file);
+        auto write = [&](const std::filesystem::path& path,
+                         std::span<const BenchWriter::tuple_type> tuples) {
+            BenchWriter writer(path.string(), kBenchNames, kBenchRanks, sizes,
+                               {}, {}, compression, checksums);
+            writer.save_batch(tuples);
+        };
+
+        // Appending continues the block that was not full
+        write(file, all.first(31));
+        write(file, all.subspan(31));
+        write(reference_file, all);
+
+        std::vector<std::pair<uint64_t, uint64_t>> blocks;
+        {
+            const Reader<> reader(file.string());
+            const Reader<> reference(reference_file.string());
+            REQUIRE(reader.size() == all.size());
+            CHECK((reader.header().Flags & Tools::kFlagBlockChecksums) != 0);
+            REQUIRE(reader.block_checksums());
+            REQUIRE(reference.block_checksums());
+            CHECK(reader.block_checksums()->BlockLines
+                  == (compression.enabled() ? 0 : 7));
+            // Closing writes the last chunk even if it is not full, so the
+            // appended compressed file has more chunks
+            if (compression.enabled()) {
+                CHECK(reader.block_checksums()->Checksums.size() == 7 + 4);
+                CHECK(reference.block_checksums()->Checksums.size() == 10);
+            } else {
+                CHECK(reader.block_checksums()->Checksums
+                      == reference.block_checksums()->Checksums);
+                CHECK(reader.block_checksums()->Checksums.size() == 8);
+            }
+            CHECK(reader.find_corrupted_blocks(3).empty());
+            CHECK(reader.verify_checksum());
+        }
+
+        auto report = verify_file(file.string(), 2);
+        CHECK(report.Ok);
+        CHECK(report.NumEvents == all.size());
+        CHECK(report.NumBlocks == (compression.enabled() ? 11 : 8));
+
+        // A flipped bit is narrowed down to the events of its block
+        std::size_t corrupted_byte = 0;
+        {
+            const Reader<> reader(file.string());
+            corrupted_byte = reader.file_offset(23) + Tools::kChunkHeaderSize + 3;
+        }
+        {
+            std::fstream out(file, std::ios::in | std::ios::out | std::ios::binary);
+            out.seekg(static_cast<std::streamoff>(corrupted_byte));
+            char byte = 0;
+            out.read(&byte, 1);
+            byte ^= 0x10;
+            out.seekp(static_cast<std::streamoff>(corrupted_byte));
+            out.write(&byte, 1);
+        }
+        report = verify_file(file.string(), 3);
+        CHECK_FALSE(report.Ok);
+        REQUIRE(report.CorruptedEvents.size() == 1);
+        CHECK(report.CorruptedEvents[0] == (compression.enabled()
+              ? std::pair<uint64_t, uint64_t>{20, 25}
+              : std::pair<uint64_t, uint64_t>{21, 28}));
+
+        // Checked on its own thread: a good file, a corrupted one and one
+        // that cannot be read
+        {
+            BackgroundVerifier verifier;
+            verifier.submit(reference_file.string());
+            verifier.submit(file.string());
+            verifier.submit((dir / "sbc_block_checksums_missing.bin").string());
+            const auto results = verifier.finish();
+            REQUIRE(results.size() == 3);
+            CHECK(results[0].Report.Ok);
+            CHECK(results[0].Error.empty());
+            CHECK_FALSE(results[1].Report.Ok);
+            CHECK(results[1].Error.empty());
+            CHECK_FALSE(results[2].Error.empty());
+        }
+
+        // A crash loses them, recovering computes them again
+        std::filesystem::resize_file(reference_file,
+            std::filesystem::file_size(reference_file) - Tools::kTrailerSize - 1);
+        CHECK_THROWS_AS(static_cast<void>(verify_file(reference_file.string())),
+                        std::runtime_error);
+        CHECK_FALSE(recover_file(reference_file.string()).WasClosed);
+        report = verify_file(reference_file.string());
+        CHECK(report.Ok);
+        CHECK(report.NumBlocks > 0);
+        CHECK(recover_file(reference_file.string()).WasClosed);
+    }
+
+    // Checking is split between threads
+    {
+        std::filesystem::remove(file);
+        BenchEvents big(2000, 32, 500);
+        checksums.BlockLines = 64;
+        {
+            BenchWriter writer(file.string(), kBenchNames, kBenchRanks,
+                               {1, 1, 32, 500}, {}, {}, {}, checksums);
+            writer.save_batch(big.Tuples);
+        }
+
+        const Reader<> reader(file.string());
+        const double mbytes = static_cast<double>(
+            std::filesystem::file_size(file)) / 1e6;
+        for (std::size_t threads : {1ul, 4ul}) {
+            auto start = clock::now();
+            CHECK(reader.find_corrupted_blocks(threads).empty());
+            std::chrono::duration<double> dt = clock::now() - start;
+            MESSAGE(fmt::format("verify | threads = {} | {:8.1f} MB/s", threads,
+                                mbytes / dt.count()));
+        }
+    }
+
+    std::filesystem::remove(file);
+    std::filesystem::remove(reference_file);
+}
+
+TEST_CASE("SBC_BINARY_PARALLEL_SCAN") {
+    using clock = std::chrono::steady_clock;
+    const auto dir = std::filesystem::temp_directory_path();
+
+    CHECK(Tools::scan_tasks({10, 10}, {{}, {0, 7}}, 4).size() == 5);
+    CHECK(Tools::scan_tasks({10, 10}, {{}, {0, 7}}, 4).back().First == 7);
+    CHECK(Tools::scan_tasks({0}, {{}}, 4).empty());
+
+    // Baseline (first 10 samples) sums per channel and trigger source
+    // counts, the usual quick look
+    const std::size_t n_chs = 3, rl = 40, baseline = 10;
+    struct Stats {
+        std::vector<uint64_t> Sum;
+        std::vector<uint64_t> SumSq;
+        std::array<uint64_t, 3> Sources{};
+        uint64_t N = 0;
+
+        bool operator==(const Stats&) const = default;
+    };
+    const Stats empty{std::vector<uint64_t>(n_chs, 0),
+                      std::vector<uint64_t>(n_chs, 0), {}, 0};
+    auto add = [&](Stats& stats, const uint32_t& source,
+                   std::span<const uint16_t> traces) {
+        stats.Sources[static_cast<std::size_t>(std::countr_zero(source))]++;
+        stats.N++;
+        for (std::size_t ch = 0; ch < n_chs; ch++) {
+            for (std::size_t s = 0; s < baseline; s++) {
+                const uint64_t sample = traces[ch*rl + s];
+                stats.Sum[ch] += sample;
+                stats.SumSq[ch] += sample*sample;
+            }
+        }
+    };
+    auto merge = [](Stats& into, Stats&& other) {
+        for (std::size_t ch = 0; ch < into.Sum.size(); ch++) {
+            into.Sum[ch] += other.Sum[ch];
+            into.SumSq[ch] += other.SumSq[ch];
+        }
+        for (std::size_t s = 0; s < into.Sources.size(); s++) {
+            into.Sources[s] += other.Sources[s];
+        }
+        into.N += other.N;
+    };
+    auto scan_traces = [&](Stats& stats, const ScanEvent& event) {
+        std::vector<uint16_t> traces(n_chs*rl);
+        event.unpack(2, traces);
+        add(stats, event.keys().TriggerSource, traces);
+    };
+    // Events of trigger source 2 are skipped
+    auto predicate = [](const ScanKeys& keys) {
+        return keys.TriggerSource != 2;
+    };
+
+    BenchEvents events(60, n_chs, rl);
+    for (std::size_t i = 0; i < events.TriggerSources.size(); i++) {
+        events.TriggerSources[i] = 1u << (i % 3);
+    }
+    const std::span<const BenchWriter::tuple_type> all(events.Tuples);
+
+    // The middle file is compressed
+    CompressionOptions compressed;
+    compressed.Level = 1;
+    compressed.ChunkEvents = 7;
+    const std::vector<std::string> files = {
+        (dir / "sbc_scan_test_0.bin").string(),
+        (dir / "sbc_scan_test_1.bin").string(),
+        (dir / "sbc_scan_test_2.bin").string()};
+    const std::array<std::size_t, 4> bounds = {0, 25, 45, 60};
+    for (std::size_t f = 0; f < files.size(); f++) {
+        std::filesystem::remove(files[f]);
+        BenchWriter writer(files[f], kBenchNames, kBenchRanks,
+                           {1, 1, n_chs, rl}, {}, {},
+                           f == 1 ? compressed : CompressionOptions{});
+        writer.save_batch(all.subspan(bounds[f], bounds[f + 1] - bounds[f]));
+    }
+
+    Stats expected = empty;
+    for (std::size_t i = 0; i < all.size(); i++) {
+        if (events.TriggerSources[i] != 2) {
+            add(expected, events.TriggerSources[i], events.Traces[i]);
+        }
+    }
+    CHECK(expected.N == 40);
+
+    for (std::size_t threads : {1ul, 4ul}) {
+        ScanOptions options;
+        options.NumThreads = threads;
+        options.TaskEvents = 4;
+        const auto result = scan_files(files, empty, predicate, scan_traces,
+                                       merge, options);
+        CHECK(result.NumEvents == all.size());
+        CHECK(result.NumMatched == expected.N);
+        CHECK(result.Value == expected);
+    }
+
+    // The keys say where the event is
+    {
+        const auto result = scan_files(files, std::vector<uint32_t>{},
+            [](const ScanKeys& keys) { return keys.File == 2; },
+            [](std::vector<uint32_t>& out, const ScanEvent& event) {
+                out.push_back(event.keys().TimeStamp
+                              - static_cast<uint32_t>(event.keys().Event));
+            },
+            [](std::vector<uint32_t>& into, std::vector<uint32_t>&& other) {
+                into.insert(into.end(), other.begin(), other.end());
+            });
+        CHECK(result.Value == std::vector<uint32_t>(15, 45));
+    }
+
+    // Errors of the files and of the functor reach the caller
+    CHECK_THROWS_AS(static_cast<void>(scan_files(
+        {files[0], (dir / "sbc_scan_test_missing.bin").string()}, empty,
+        predicate, scan_traces, merge)), std::runtime_error);
+    CHECK_THROWS_AS(static_cast<void>(scan_files(files, empty, predicate,
+        [](Stats&, const ScanEvent& event) {
+            if (event.keys().Event == 13) {
+                throw std::runtime_error("bad event");
+            }
+        }, merge)), std::runtime_error);
+
+    for (const auto& file : files) {
+        std::filesystem::remove(file);
+    }
+
+    // Throughput of a full scan and of one where 1 in 10 events passes
+    const auto big_file = (dir / "sbc_scan_test_big.bin").string();
+    std::filesystem::remove(big_file);
+    const std::size_t big_chs = 16, big_rl = 500;
+    BenchEvents big(4000, big_chs, big_rl);
+    for (std::size_t i = 0; i < big.TriggerSources.size(); i++) {
+        big.TriggerSources[i] = i % 10 == 0 ? 4 : 1;
+    }
+    {
+        BenchWriter writer(big_file, kBenchNames, kBenchRanks,
+                           {1, 1, big_chs, big_rl});
+        writer.save_batch(big.Tuples);
+    }
+
+    const double mbytes = static_cast<double>(
+        std::filesystem::file_size(big_file)) / 1e6;
+    auto sum_traces = [&](uint64_t& sum, const ScanEvent& event) {
+        const auto raw = event.raw(2);
+        for (std::size_t s = 0; s < raw.size(); s += sizeof(uint16_t)) {
+            uint16_t sample = 0;
+            std::memcpy(&sample, raw.data() + s, sizeof(uint16_t));
+            sum += sample;
+        }
+    };
+    auto sum_merge = [](uint64_t& into, uint64_t&& other) { into += other; };
+    for (const bool selective : {false, true}) {
+        for (std::size_t threads : {1ul, 4ul}) {
+            ScanOptions options;
+            options.NumThreads = threads;
+            options.TaskEvents = 256;
+            const auto start = clock::now();
+            const auto result = scan_files({big_file}, uint64_t{0},
+                [&](const ScanKeys& keys) {
+                    return not selective or keys.TriggerSource == 4;
+                }, sum_traces, sum_merge, options);
+            std::chrono::duration<double> dt = clock::now() - start;
+            CHECK(result.NumMatched == (selective ? 400 : 4000));
+            MESSAGE(fmt::format("scan | {:9} | threads = {} | {:8.1f} MB/s",
+                                selective ? "1 in 10" : "all", threads,
+                                mbytes / dt.count()));
+        }
+    }
+
+    std::filesystem::remove(big_file);
+}
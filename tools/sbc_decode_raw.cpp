@@ -0,0 +1,72 @@
+// C STD includes
+#include <cstdlib>
+// C 3rd party includes
+// C++ STD includes
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// C++ 3rd party includes
+#include <spdlog/fmt/fmt.h>
+
+// my includes
+#include "sbcqueens-gui/sipm_helpers/SBCRawDump.hpp"
+
+// Decodes raw dumps saved with RawDump = true into SiPM files next to them
+// (file.raw -> file.bin), with block checksums. The events of every block
+// are decoded with all the threads while the previous block is written.
+//
+// Usage: sbc-decode-raw [-j threads] [-l level] file.raw [file2.raw ...]
+// -l is the zstd compression level of the SiPM files, 0 = not compressed.
+// Exit status: 0 if every dump was decoded without corrupted blocks, 1
+// otherwise, 2 if the arguments are wrong.
+int main(int argc, char* argv[]) {
+    using namespace SBCQueens::BinaryFormat;
+    RawDecodeOptions options;
+    options.Checksums.BlockChecksums = true;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg == "-j" and i + 1 < argc) {
+            options.NumThreads = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "-l" and i + 1 < argc) {
+            options.Compression.Level = std::atoi(argv[++i]);
+        } else {
+            files.emplace_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        fmt::print(stderr, "Usage: {0} [-j threads] [-l level] file.raw "
+                   "[file2.raw ...]\n", argv[0]);
+        return 2;
+    }
+
+    options.Compression.NumThreads = options.NumThreads;
+    int status = 0;
+    for (const auto& file : files) {
+        const auto out = std::filesystem::path(file).replace_extension(".bin")
+            .string();
+        try {
+            const auto report = decode_raw_dump(file, out, options);
+            fmt::print("{0} -> {1}: {2} events from {3} blocks.", file, out,
+                       report.NumEvents, report.NumBlocks);
+            if (report.CorruptedBlocks > 0) {
+                fmt::print(" {0} corrupted blocks skipped.",
+                           report.CorruptedBlocks);
+                status = 1;
+            }
+            if (report.Truncated) {
+                fmt::print(" The dump was cut short, its last block is lost.");
+            }
+            fmt::print("\n");
+        } catch (std::exception& err) {
+            fmt::print(stderr, "{0}: {1}\n", file, err.what());
+            status = 1;
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,39 @@
+// C++ STD includes
+#include <exception>
+
+// C++ 3rd party includes
+#include <spdlog/fmt/fmt.h>
+
+// my includes
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+
+// Finishes closing SBC binary files left open by a crash: cuts the
+// incomplete event at their end and writes their number of lines, chunk
+// index and trailer. Files that were closed properly are not touched.
+//
+// Usage: sbc-recover file.bin [file2.bin ...]
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fmt::print(stderr, "Usage: {0} file.bin [file2.bin ...]\n", argv[0]);
+        return 2;
+    }
+
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        try {
+            const auto report = SBCQueens::BinaryFormat::recover_file(argv[i]);
+            if (report.WasClosed) {
+                fmt::print("{0}: closed properly, {1} events.\n", argv[i],
+                           report.NumEvents);
+            } else {
+                fmt::print("{0}: recovered {1} events, {2} bytes removed.\n",
+                           argv[i], report.NumEvents, report.BytesRemoved);
+            }
+        } catch (std::exception& err) {
+            fmt::print(stderr, "{0}: {1}\n", argv[i], err.what());
+            status = 1;
+        }
+    }
+
+    return status;
+}
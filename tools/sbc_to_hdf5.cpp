@@ -0,0 +1,715 @@
+// C STD includes
+#include <cstdlib>
+#include <cstring>
+// C 3rd party includes
+#include <hdf5.h>
+#include <zlib.h>
+// C++ STD includes
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// C++ 3rd party includes
+#include <nlohmann/json.hpp>
+#include <spdlog/fmt/fmt.h>
+
+// my includes
+#include "sbcqueens-gui/multithreading_helpers/WorkerPool.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCRunManifest.hpp"
+
+namespace {
+
+using namespace SBCQueens;
+using namespace SBCQueens::BinaryFormat;
+using json = nlohmann::json;
+
+// Run constants of the v1 SiPM files, which were saved with every event
+const std::array<std::string_view, 7> kV1Constants = {"sample_rate",
+    "en_chs", "trg_mask", "thresholds", "dc_offsets", "dc_corrections",
+    "dc_range"};
+
+// Root attribute with the files converted so far, as JSON:
+//   [{"file": "SiPM_0000.bin", "num_events": ...}, ...]
+constexpr auto kSourcesAttribute = "sbc_sources";
+
+// Traces chunks of about this size if the events per chunk are not given
+constexpr std::size_t kAutoChunkBytes = 1 << 20;
+
+// Closes an HDF5 object when it goes out of scope
+class H5Handle {
+    hid_t _id = H5I_INVALID_HID;
+    herr_t (*_close)(hid_t) = nullptr;
+
+ public:
+    H5Handle() = default;
+    H5Handle(const hid_t id, herr_t (*close)(hid_t), std::string_view what) :
+        _id{id}, _close{close} {
+        if (_id < 0) {
+            throw std::runtime_error("HDF5 could not " + std::string(what));
+        }
+    }
+
+    H5Handle(H5Handle&& other) noexcept :
+        _id{std::exchange(other._id, H5I_INVALID_HID)}, _close{other._close} {}
+
+    H5Handle& operator=(H5Handle&& other) noexcept {
+        if (this != &other) {
+            reset();
+            _id = std::exchange(other._id, H5I_INVALID_HID);
+            _close = other._close;
+        }
+        return *this;
+    }
+
+    H5Handle(const H5Handle&) = delete;
+    H5Handle& operator=(const H5Handle&) = delete;
+
+    ~H5Handle() { reset(); }
+
+    void reset() noexcept {
+        if (_id >= 0) {
+            _close(_id);
+            _id = H5I_INVALID_HID;
+        }
+    }
+
+    operator hid_t() const noexcept { return _id; }
+};
+
+void h5_check(const herr_t status, std::string_view what) {
+    if (status < 0) {
+        throw std::runtime_error("HDF5 could not " + std::string(what));
+    }
+}
+
+// Type of the column in memory. Packed columns are unpacked to uint16.
+hid_t h5_type(const ColumnDescription& column) {
+    const auto& type = column.Type;
+    if (column.PackedBits > 0 or type == "uint16") {
+        return H5T_NATIVE_USHORT;
+    } else if (type == "char") {
+        return H5T_NATIVE_CHAR;
+    } else if (type == "int8") {
+        return H5T_NATIVE_SCHAR;
+    } else if (type == "uint8") {
+        return H5T_NATIVE_UCHAR;
+    } else if (type == "int16") {
+        return H5T_NATIVE_SHORT;
+    } else if (type == "int32") {
+        return H5T_NATIVE_INT;
+    } else if (type == "uint32") {
+        return H5T_NATIVE_UINT;
+    } else if (type == "int64") {
+        return H5T_NATIVE_LLONG;
+    } else if (type == "uint64") {
+        return H5T_NATIVE_ULLONG;
+    } else if (type == "single" or type == "float32") {
+        return H5T_NATIVE_FLOAT;
+    } else if (type == "double" or type == "float64") {
+        return H5T_NATIVE_DOUBLE;
+    }
+
+    throw std::runtime_error("Column " + column.Name + " is of type " + type
+                             + ", which cannot be saved to HDF5.");
+}
+
+// Size 1 dimensions are dropped, so single values become scalars
+std::vector<hsize_t> h5_dims(const ColumnDescription& column) {
+    if (column.NumElements == 1) {
+        return {};
+    }
+
+    return {column.Sizes.begin(), column.Sizes.end()};
+}
+
+// A column that changes event to event, saved as a dataset of shape
+// [events, Dims...]
+struct EventColumn {
+    std::string Name;
+    // Position in the file
+    std::size_t Index = 0;
+    bool Packed = false;
+    hid_t Type = H5I_INVALID_HID;
+    std::size_t TypeSize = 0;
+    std::size_t NumElements = 0;
+    std::vector<hsize_t> Dims;
+
+    [[nodiscard]] std::size_t event_bytes() const noexcept {
+        return TypeSize*NumElements;
+    }
+
+    bool operator==(const EventColumn& other) const {
+        return Name == other.Name and TypeSize == other.TypeSize
+            and Dims == other.Dims;
+    }
+};
+
+std::vector<EventColumn> event_columns(const FileHeader& header) {
+    std::vector<EventColumn> out;
+    for (std::size_t c = 0; c < header.Columns.size(); c++) {
+        const auto& column = header.Columns[c];
+        if (header.Version == 1 and std::ranges::find(kV1Constants,
+                column.Name) != kV1Constants.end()) {
+            continue;
+        }
+
+        out.push_back({column.Name, c, column.PackedBits > 0, h5_type(column),
+                       column.TypeSize, column.NumElements, h5_dims(column)});
+    }
+
+    return out;
+}
+
+// Run constants of a file and their values
+std::vector<std::pair<ColumnDescription, std::span<const char>>>
+run_constants(const Reader<>& reader) {
+    std::vector<std::pair<ColumnDescription, std::span<const char>>> out;
+    const auto& header = reader.header();
+    for (const auto& constant : header.Constants) {
+        out.emplace_back(constant, reader.constant_raw(constant.Name));
+    }
+
+    if (header.Version == 1 and not reader.empty()) {
+        for (const auto& column : header.Columns) {
+            if (std::ranges::find(kV1Constants, column.Name)
+                    != kV1Constants.end()) {
+                out.emplace_back(column, reader.constant_raw(column.Name));
+            }
+        }
+    }
+
+    return out;
+}
+
+// Copies column of events [first, last) into out, unpacking it if needed
+void decode(const Reader<>& reader, const EventColumn& column,
+            const std::size_t& first, const std::size_t& last, char* out) {
+    for (auto i = first; i < last; i++) {
+        if (column.Packed) {
+            reader.unpack(i, column.Index, {reinterpret_cast<uint16_t*>(out),
+                                            column.NumElements});
+        } else {
+            std::memcpy(out, reader.get_raw(i, column.Index).data(),
+                        column.event_bytes());
+        }
+        out += column.event_bytes();
+    }
+}
+
+// Same bytes the shuffle and deflate filters of the datasets give, so the
+// chunk can be written as is with H5Dwrite_chunk and HDF5 does not
+// compress anything on the writing thread.
+void filter_chunk(std::span<const char> raw, const std::size_t& type_size,
+                  const int& level, std::vector<char>& shuffled,
+                  std::vector<char>& out) {
+    const std::size_t n = raw.size() / type_size;
+    // The shuffle filter does nothing for chunks of one element
+    if (type_size > 1 and n > 1) {
+        shuffled.resize(raw.size());
+        for (std::size_t e = 0; e < n; e++) {
+            for (std::size_t b = 0; b < type_size; b++) {
+                shuffled[b*n + e] = raw[e*type_size + b];
+            }
+        }
+        raw = shuffled;
+    }
+
+    const uLong raw_size = raw.size();
+    auto size = compressBound(raw_size);
+    out.resize(size);
+    if (compress2(reinterpret_cast<Bytef*>(out.data()), &size,
+                  reinterpret_cast<const Bytef*>(raw.data()),
+                  raw_size, level) != Z_OK) {
+        throw std::runtime_error("Could not compress a chunk.");
+    }
+    out.resize(size);
+}
+
+// Appends SBC binary files to an HDF5 file: one extensible dataset per
+// event column, chunked every events_per_chunk events and compressed with
+// the shuffle and deflate filters, and the run constants as attributes of
+// the root group. The files converted so far are saved in the HDF5 file so
+// it can be extended as the segments of a run are closed.
+//
+// The chunks are decoded and compressed by the worker pool while the
+// previous batch is written on another thread.
+class Hdf5Converter {
+    using Batch = std::vector<std::vector<std::vector<char>>>;
+
+    H5Handle _file;
+    hsize_t _chunk_events = 0;
+    int _level = 4;
+    WorkerPool _pool;
+    // One per worker, so compressed chunks are not shared
+    std::vector<std::optional<Reader<>>> _readers;
+
+    json _sources = json::array();
+    std::vector<EventColumn> _columns;
+    std::vector<H5Handle> _datasets;
+
+    void _save_sources() {
+        if (H5Aexists(_file, kSourcesAttribute) > 0) {
+            h5_check(H5Adelete(_file, kSourcesAttribute), "replace sources");
+        }
+
+        const auto text = _sources.dump();
+        H5Handle type(H5Tcopy(H5T_C_S1), H5Tclose, "create a string type");
+        h5_check(H5Tset_size(type, text.size()), "create a string type");
+        H5Handle space(H5Screate(H5S_SCALAR), H5Sclose, "create a dataspace");
+        H5Handle attribute(H5Acreate2(_file, kSourcesAttribute, type, space,
+                                      H5P_DEFAULT, H5P_DEFAULT),
+                           H5Aclose, "create the sources attribute");
+        h5_check(H5Awrite(attribute, type, text.data()), "write sources");
+    }
+
+    void _load_sources() {
+        H5Handle attribute(H5Aopen(_file, kSourcesAttribute, H5P_DEFAULT),
+                           H5Aclose, "find the converted files, is it an "
+                           "sbc-to-hdf5 file?");
+        H5Handle type(H5Aget_type(attribute), H5Tclose, "read sources");
+        std::string text(H5Tget_size(type), '\0');
+        h5_check(H5Aread(attribute, type, text.data()), "read sources");
+        _sources = json::parse(text);
+    }
+
+    void _write_constants(const Reader<>& reader) {
+        for (const auto& [column, bytes] : run_constants(reader)) {
+            const auto dims = h5_dims(column);
+            H5Handle space(dims.empty() ? H5Screate(H5S_SCALAR)
+                : H5Screate_simple(static_cast<int>(dims.size()), dims.data(),
+                                   nullptr), H5Sclose, "create a dataspace");
+            H5Handle attribute(H5Acreate2(_file, column.Name.c_str(),
+                h5_type(column), space, H5P_DEFAULT, H5P_DEFAULT),
+                H5Aclose, "create attribute " + column.Name);
+            h5_check(H5Awrite(attribute, h5_type(column), bytes.data()),
+                     "write attribute " + column.Name);
+        }
+    }
+
+    // Segments of one run must have the same constants
+    void _check_constants(const Reader<>& reader) {
+        for (const auto& [column, bytes] : run_constants(reader)) {
+            const auto attribute_id = H5Aexists(_file, column.Name.c_str()) > 0
+                ? H5Aopen(_file, column.Name.c_str(), H5P_DEFAULT)
+                : H5I_INVALID_HID;
+            std::vector<char> saved(bytes.size());
+            if (attribute_id >= 0) {
+                H5Handle attribute(attribute_id, H5Aclose, "");
+                H5Handle space(H5Aget_space(attribute), H5Sclose,
+                               "read attribute " + column.Name);
+                if (static_cast<std::size_t>(H5Sget_simple_extent_npoints(space))
+                        == column.NumElements) {
+                    h5_check(H5Aread(attribute, h5_type(column), saved.data()),
+                             "read attribute " + column.Name);
+                    if (std::ranges::equal(saved, bytes)) {
+                        continue;
+                    }
+                }
+            }
+
+            throw std::runtime_error(reader.name() + " has a different "
+                "constant " + column.Name + ", is it from another run?");
+        }
+    }
+
+    void _create_datasets(const std::vector<EventColumn>& columns,
+                          const hsize_t& chunk_events) {
+        for (const auto& column : columns) {
+            std::vector<hsize_t> dims = {0};
+            std::vector<hsize_t> max_dims = {H5S_UNLIMITED};
+            std::vector<hsize_t> chunk = {chunk_events};
+            for (const auto& dim : column.Dims) {
+                dims.push_back(dim);
+                max_dims.push_back(dim);
+                chunk.push_back(dim);
+            }
+
+            const auto rank = static_cast<int>(dims.size());
+            H5Handle space(H5Screate_simple(rank, dims.data(), max_dims.data()),
+                           H5Sclose, "create a dataspace");
+            H5Handle properties(H5Pcreate(H5P_DATASET_CREATE), H5Pclose,
+                                "create dataset properties");
+            h5_check(H5Pset_chunk(properties, rank, chunk.data()),
+                     "set the chunks of " + column.Name);
+            if (column.TypeSize > 1) {
+                h5_check(H5Pset_shuffle(properties),
+                         "set the filters of " + column.Name);
+            }
+            h5_check(H5Pset_deflate(properties, static_cast<unsigned>(_level)),
+                     "set the filters of " + column.Name);
+            _datasets.emplace_back(H5Dcreate2(_file, column.Name.c_str(),
+                column.Type, space, H5P_DEFAULT, properties, H5P_DEFAULT),
+                H5Dclose, "create dataset " + column.Name);
+        }
+    }
+
+    void _open_datasets(const std::vector<EventColumn>& columns) {
+        for (const auto& column : columns) {
+            H5Handle dataset(H5Dopen2(_file, column.Name.c_str(), H5P_DEFAULT),
+                             H5Dclose, "open dataset " + column.Name);
+            H5Handle space(H5Dget_space(dataset), H5Sclose,
+                           "read the shape of " + column.Name);
+            H5Handle type(H5Dget_type(dataset), H5Tclose,
+                          "read the type of " + column.Name);
+            std::vector<hsize_t> dims(column.Dims.size() + 1);
+            if (H5Sget_simple_extent_ndims(space) != static_cast<int>(dims.size())
+                    or H5Tget_size(type) != column.TypeSize) {
+                throw std::runtime_error("Dataset " + column.Name + " does "
+                                         "not match the files.");
+            }
+
+            h5_check(H5Sget_simple_extent_dims(space, dims.data(), nullptr),
+                     "read the shape of " + column.Name);
+            if (not std::equal(column.Dims.begin(), column.Dims.end(),
+                               dims.begin() + 1)) {
+                throw std::runtime_error("Dataset " + column.Name + " does "
+                                         "not match the files.");
+            }
+
+            H5Handle properties(H5Dget_create_plist(dataset), H5Pclose,
+                                "read the chunks of " + column.Name);
+            std::vector<hsize_t> chunk(dims.size());
+            h5_check(H5Pget_chunk(properties, static_cast<int>(chunk.size()),
+                                  chunk.data()),
+                     "read the chunks of " + column.Name);
+            _chunk_events = chunk[0];
+            _datasets.push_back(std::move(dataset));
+        }
+    }
+
+    void _set_extent(const uint64_t& num_events) {
+        for (std::size_t c = 0; c < _columns.size(); c++) {
+            std::vector<hsize_t> dims = {num_events};
+            dims.insert(dims.end(), _columns[c].Dims.begin(),
+                        _columns[c].Dims.end());
+            h5_check(H5Dset_extent(_datasets[c], dims.data()),
+                     "resize " + _columns[c].Name);
+        }
+    }
+
+    // Through HDF5 on this thread, for events that do not fill a chunk
+    void _write_events(const Reader<>& reader, const std::size_t& first,
+                       const std::size_t& last, const uint64_t& at) {
+        std::vector<char> raw;
+        for (std::size_t c = 0; c < _columns.size(); c++) {
+            const auto& column = _columns[c];
+            raw.resize((last - first)*column.event_bytes());
+            decode(reader, column, first, last, raw.data());
+
+            std::vector<hsize_t> start(column.Dims.size() + 1, 0);
+            std::vector<hsize_t> count = {last - first};
+            start[0] = at;
+            count.insert(count.end(), column.Dims.begin(), column.Dims.end());
+            const auto rank = static_cast<int>(count.size());
+            H5Handle memory(H5Screate_simple(rank, count.data(), nullptr),
+                            H5Sclose, "create a dataspace");
+            H5Handle space(H5Dget_space(_datasets[c]), H5Sclose,
+                           "select events of " + column.Name);
+            h5_check(H5Sselect_hyperslab(space, H5S_SELECT_SET, start.data(),
+                                         nullptr, count.data(), nullptr),
+                     "select events of " + column.Name);
+            h5_check(H5Dwrite(_datasets[c], column.Type, memory, space,
+                              H5P_DEFAULT, raw.data()),
+                     "write " + column.Name);
+        }
+    }
+
+    // Chunks [first_chunk, first_chunk + out.size()) of the events after
+    // head, in parallel
+    void _filter_batch(const std::string& file_name, const std::size_t& head,
+                       const std::size_t& num_events,
+                       const std::size_t& first_chunk, Batch& out) {
+        std::vector<std::string> errors(_pool.size());
+        _pool.for_each_chunk(out.size(), [&](std::size_t begin,
+                                             std::size_t end,
+                                             std::size_t worker) {
+            try {
+                auto& reader = _readers[worker];
+                if (not reader) {
+                    reader.emplace(file_name);
+                }
+
+                std::vector<char> raw;
+                std::vector<char> shuffled;
+                for (auto k = begin; k < end; k++) {
+                    const auto first = head + (first_chunk + k)*_chunk_events;
+                    const auto last = std::min<std::size_t>(num_events,
+                                                            first + _chunk_events);
+                    out[k].resize(_columns.size());
+                    for (std::size_t c = 0; c < _columns.size(); c++) {
+                        const auto& column = _columns[c];
+                        // The last chunk is padded with zeros
+                        raw.assign(_chunk_events*column.event_bytes(), 0);
+                        decode(*reader, column, first, last, raw.data());
+                        filter_chunk(raw, column.TypeSize, _level, shuffled,
+                                     out[k][c]);
+                    }
+                }
+            } catch (std::exception& err) {
+                errors[worker] = err.what();
+            }
+        });
+
+        for (const auto& error : errors) {
+            if (not error.empty()) {
+                throw std::runtime_error(error);
+            }
+        }
+    }
+
+    void _write_batch(const uint64_t& first_event, const uint64_t& end_event,
+                      const Batch& batch) {
+        _set_extent(end_event);
+        for (std::size_t k = 0; k < batch.size(); k++) {
+            for (std::size_t c = 0; c < _columns.size(); c++) {
+                std::vector<hsize_t> offset(_columns[c].Dims.size() + 1, 0);
+                offset[0] = first_event + k*_chunk_events;
+                h5_check(H5Dwrite_chunk(_datasets[c], H5P_DEFAULT, 0,
+                                        offset.data(), batch[k][c].size(),
+                                        batch[k][c].data()),
+                         "write a chunk of " + _columns[c].Name);
+            }
+        }
+    }
+
+ public:
+    // chunk_events = 0 picks about 1 MiB chunks for the largest column. It
+    // is ignored if the file exists, its chunks are kept.
+    Hdf5Converter(const std::string& file_name, const hsize_t& chunk_events,
+                  const int& level, const std::size_t& num_threads) :
+        _chunk_events{chunk_events}, _level{level}, _pool{num_threads},
+        _readers(_pool.size()) {
+        if (std::filesystem::exists(file_name)) {
+            _file = H5Handle(H5Fopen(file_name.c_str(), H5F_ACC_RDWR,
+                                     H5P_DEFAULT), H5Fclose,
+                             "open " + file_name);
+            _load_sources();
+            return;
+        }
+
+        // Newer than 1.6 so attributes can be larger than 64 KiB
+        H5Handle access(H5Pcreate(H5P_FILE_ACCESS), H5Pclose,
+                        "create file properties");
+        h5_check(H5Pset_libver_bounds(access, H5F_LIBVER_V18,
+                                      H5F_LIBVER_LATEST),
+                 "create file properties");
+        _file = H5Handle(H5Fcreate(file_name.c_str(), H5F_ACC_EXCL,
+                                   H5P_DEFAULT, access), H5Fclose,
+                         "create " + file_name);
+        _save_sources();
+    }
+
+    [[nodiscard]] bool contains(std::string_view file_name) const {
+        const auto name = std::filesystem::path(file_name).filename().string();
+        return std::ranges::any_of(_sources, [&](const json& source) {
+            return source.at("file").get<std::string>() == name;
+        });
+    }
+
+    [[nodiscard]] uint64_t size() const {
+        uint64_t out = 0;
+        for (const auto& source : _sources) {
+            out += source.at("num_events").get<uint64_t>();
+        }
+        return out;
+    }
+
+    // Appends the events of file_name. Returns how many there were.
+    uint64_t append(const std::string& file_name) {
+        const Reader<> reader(file_name);
+        const auto columns = event_columns(reader.header());
+        if (columns.empty()) {
+            throw std::runtime_error(file_name + " does not have event "
+                                     "columns.");
+        }
+
+        if (_datasets.empty()) {
+            if (H5Lexists(_file, columns.front().Name.c_str(), H5P_DEFAULT) > 0) {
+                _open_datasets(columns);
+                _check_constants(reader);
+            } else {
+                if (_chunk_events == 0) {
+                    const auto largest = std::ranges::max(columns, {},
+                        &EventColumn::event_bytes).event_bytes();
+                    _chunk_events = std::max<std::size_t>(1,
+                        kAutoChunkBytes / largest);
+                }
+                _create_datasets(columns, _chunk_events);
+                _write_constants(reader);
+            }
+            _columns = columns;
+        } else {
+            if (columns != _columns) {
+                throw std::runtime_error(file_name + " does not have the "
+                                         "columns of the other files.");
+            }
+            _check_constants(reader);
+        }
+
+        // Events written by a conversion that was interrupted are dropped
+        const uint64_t first = size();
+        _set_extent(first);
+
+        const std::size_t num_events = reader.size();
+        // Events until the next chunk starts are written through HDF5 so
+        // the rest can be written as whole chunks
+        const std::size_t head = std::min<std::size_t>(num_events,
+            (_chunk_events - first % _chunk_events) % _chunk_events);
+        if (head > 0) {
+            _set_extent(first + head);
+            _write_events(reader, 0, head, first);
+        }
+
+        const std::size_t num_chunks = (num_events - head + _chunk_events - 1)
+            / _chunk_events;
+        const std::size_t batch_size = 2*_pool.size();
+        for (auto& local : _readers) {
+            local.reset();
+        }
+
+        // While a batch is written, the next one is decoded and compressed
+        std::array<Batch, 2> batches;
+        std::future<void> writing;
+        for (std::size_t k = 0, b = 0; k < num_chunks; k += batch_size, b++) {
+            auto& batch = batches[b % 2];
+            batch.resize(std::min(batch_size, num_chunks - k));
+            _filter_batch(file_name, head, num_events, k, batch);
+
+            if (writing.valid()) {
+                writing.get();
+            }
+
+            const uint64_t batch_first = first + head + k*_chunk_events;
+            const uint64_t batch_end = std::min<uint64_t>(first + num_events,
+                batch_first + batch.size()*_chunk_events);
+            writing = std::async(std::launch::async, [this, batch_first,
+                                                      batch_end, &batch]() {
+                _write_batch(batch_first, batch_end, batch);
+            });
+        }
+
+        if (writing.valid()) {
+            writing.get();
+        }
+
+        _sources.push_back({
+            {"file", std::filesystem::path(file_name).filename().string()},
+            {"num_events", num_events}});
+        _save_sources();
+        h5_check(H5Fflush(_file, H5F_SCOPE_GLOBAL), "flush");
+        return num_events;
+    }
+};
+
+bool is_manifest(std::string_view file_name) {
+    return file_name.ends_with(".json");
+}
+
+}  // namespace
+
+// Converts SBC binary files to HDF5 for the tools of other groups. Every
+// event column becomes a dataset of shape [events, ...] (the traces
+// [events, channels, samples]) chunked every N events, and the run
+// constants attributes of the root group.
+//
+// Files already in out.h5 (by file name, so use one out.h5 per run) are
+// skipped, so it can be run again as the segments of a run are closed. Manifests (.json) convert their closed
+// segments in order; with -w it keeps waiting for new segments until the
+// run ends (every segment is closed).
+//
+// Usage: sbc-to-hdf5 [-j threads] [-n events per chunk] [-l level] [-w]
+//                    out.h5 file.bin|run.manifest.json ...
+// Exit status: 0 if everything was converted, 1 if something could not be,
+// 2 if the arguments are wrong.
+int main(int argc, char* argv[]) {
+    std::size_t num_threads = 0;
+    hsize_t chunk_events = 0;
+    int level = 4;
+    bool watch = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg == "-j" and i + 1 < argc) {
+            num_threads = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "-n" and i + 1 < argc) {
+            chunk_events = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "-l" and i + 1 < argc) {
+            level = std::clamp(std::atoi(argv[++i]), 0, 9);
+        } else if (arg == "-w") {
+            watch = true;
+        } else {
+            files.emplace_back(arg);
+        }
+    }
+
+    if (files.size() < 2) {
+        fmt::print(stderr, "Usage: {0} [-j threads] [-n events per chunk] "
+                   "[-l level] [-w] out.h5 file.bin|run.manifest.json ...\n",
+                   argv[0]);
+        return 2;
+    }
+
+    // Errors are reported through the exceptions
+    H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+    try {
+        Hdf5Converter converter(files.front(), chunk_events, level,
+                                num_threads);
+        auto convert = [&](const std::string& file_name) {
+            if (converter.contains(file_name)) {
+                return;
+            }
+
+            const auto num_events = converter.append(file_name);
+            fmt::print("{0}: {1} events, {2} in total.\n", file_name,
+                       num_events, converter.size());
+        };
+
+        // True once every file is converted and every run has ended
+        auto convert_all = [&]() {
+            bool done = true;
+            for (std::size_t i = 1; i < files.size(); i++) {
+                if (not is_manifest(files[i])) {
+                    convert(files[i]);
+                    continue;
+                }
+
+                if (not std::filesystem::exists(files[i])) {
+                    done = false;
+                    continue;
+                }
+
+                const BinaryFormat::RunManifest manifest(files[i]);
+                for (const auto& segment : manifest.segments()) {
+                    // Later segments wait so the events stay in order
+                    if (not segment.Closed) {
+                        done = false;
+                        break;
+                    }
+                    convert(manifest.path(segment));
+                }
+            }
+            return done;
+        };
+
+        while (not convert_all() and watch) {
+            std::this_thread::sleep_for(std::chrono::seconds(5));
+        }
+    } catch (std::exception& err) {
+        fmt::print(stderr, "{0}\n", err.what());
+        return 1;
+    }
+
+    return 0;
+}
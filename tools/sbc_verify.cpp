@@ -0,0 +1,87 @@
+// C STD includes
+#include <cstdlib>
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// C++ 3rd party includes
+#include <spdlog/fmt/fmt.h>
+
+// my includes
+#include "sbcqueens-gui/multithreading_helpers/WorkerPool.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+
+// Checks SBC binary files against the checksums their writer saved. The
+// files are split between the threads; if there are fewer files than
+// threads, each file is also checked with more than one thread (only files
+// with block checksums can be).
+//
+// Usage: sbc-verify [-j threads] file.bin [file2.bin ...]
+// Exit status: 0 if every file matches, 1 if any does not or could not be
+// checked, 2 if the arguments are wrong.
+int main(int argc, char* argv[]) {
+    using namespace SBCQueens;
+    std::size_t num_threads = 0;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg == "-j" and i + 1 < argc) {
+            num_threads = std::strtoull(argv[++i], nullptr, 10);
+        } else {
+            files.emplace_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        fmt::print(stderr, "Usage: {0} [-j threads] file.bin [file2.bin ...]\n",
+                   argv[0]);
+        return 2;
+    }
+
+    WorkerPool pool(num_threads);
+    const std::size_t threads_per_file = std::max<std::size_t>(1,
+        pool.size() / files.size());
+    std::vector<std::string> lines(files.size());
+    std::vector<uint8_t> failed(files.size(), 0);
+    pool.for_each_chunk(files.size(), [&](std::size_t begin, std::size_t end,
+                                          std::size_t) {
+        for (auto i = begin; i < end; i++) {
+            try {
+                const auto report = BinaryFormat::verify_file(files[i],
+                                                              threads_per_file);
+                failed[i] = not report.Ok;
+                if (report.Ok) {
+                    lines[i] = fmt::format("{0}: OK, {1} events, {2} blocks.",
+                                           files[i], report.NumEvents,
+                                           report.NumBlocks);
+                } else if (report.NumBlocks == 0) {
+                    lines[i] = fmt::format("{0}: CORRUPTED, the data does not "
+                                           "match its checksum.", files[i]);
+                } else {
+                    lines[i] = fmt::format("{0}: CORRUPTED, {1} of {2} blocks "
+                                           "do not match. Events:", files[i],
+                                           report.CorruptedEvents.size(),
+                                           report.NumBlocks);
+                    for (const auto& [first, last] : report.CorruptedEvents) {
+                        lines[i] += fmt::format(" [{0}, {1})", first, last);
+                    }
+                }
+            } catch (std::exception& err) {
+                failed[i] = 1;
+                lines[i] = fmt::format("{0}: {1}", files[i], err.what());
+            }
+        }
+    });
+
+    int status = 0;
+    for (std::size_t i = 0; i < files.size(); i++) {
+        fmt::print(failed[i] ? stderr : stdout, "{0}\n", lines[i]);
+        status = failed[i] ? 1 : status;
+    }
+
+    return status;
+}